@@ -7,6 +7,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "rax.h"
@@ -18,6 +19,12 @@ typedef struct AsgFile AsgFile;
 
 typedef struct AsgItem AsgItem;
 typedef struct AsgMeta AsgMeta;
+
+// The position of a named field or argument that has not been resolved (yet).
+#define ASG_NO_POSITION SIZE_MAX
+
+// The frame slot of a val that is not a local of a function.
+#define ASG_NO_SLOT SIZE_MAX
 typedef struct AsgType AsgType;
 typedef struct AsgExp AsgExp;
 typedef struct AsgRepeat AsgRepeat;
@@ -38,8 +45,10 @@ typedef struct AsgItemFfiVal AsgItemFfiVal;
 typedef struct AsgBinding AsgBinding;
 typedef struct OoType OoType;
 
+// The types of the type checker. They are hash-consed by the OoTypeTable of
+// the context (see types.h), so all OoType pointers point to the unique type
+// of their structure, and types are compared by pointer.
 typedef enum {
-  OO_TYPE_UNINITIALIZED, // default value before type checking
   OO_TYPE_BINDING,
   OO_TYPE_PTR,
   OO_TYPE_PTR_MUT,
@@ -56,22 +65,22 @@ typedef enum {
 
 typedef struct OoTypeProductRepeated {
   OoType *inner;
-  uint32_t repetitions;
+  uint64_t repetitions;
 } OoTypeProductRepeated;
 
 typedef struct OoTypeProductNamed {
-  OoType *types; // stretchy buffer
-  AsgSid *sids; // stretchy buffer, same length as inners
+  OoType **types; // stretchy buffer
+  AsgSid *sids; // stretchy buffer, same length as types, only the names are set
 } OoTypeProductNamed;
 
 typedef struct OoTypeFunAnon {
-  OoType *args; // stretchy buffer
+  OoType **args; // stretchy buffer
   OoType *ret;
 } OoTypeFunAnon;
 
 typedef struct OoTypeFunNamed {
-  OoType *arg_types; // stretchy buffer
-  AsgSid *arg_sids; // stretchy buffer, same length as arg_types
+  OoType **arg_types; // stretchy buffer
+  AsgSid *arg_sids; // stretchy buffer, same length as arg_types, only the names are set
   OoType *ret;
 } OoTypeFunNamed;
 
@@ -81,19 +90,19 @@ typedef struct OoTypeGeneric {
 } OoTypeGeneric;
 
 typedef struct OoTypeApp {
-  OoTypeGeneric *tlf; // not owning
-  OoType *args; // stretchy buffer
+  AsgItemType *tlf; // the applied generic type, its oo_type is an OO_TYPE_GENERIC
+  OoType **args; // stretchy buffer
 } OoTypeApp;
 
 typedef struct OoType {
   OoTypeTag tag;
   union {
-    AsgBinding *binding;
+    AsgBinding *binding; // a canonical copy, only the tag and the referenced node are set
     OoType *ptr;
     OoType *ptr_mut;
     OoType *array;
     OoTypeProductRepeated product_repeated;
-    OoType *product_anon; // stretchy buffer
+    OoType **product_anon; // stretchy buffer
     OoTypeProductNamed product_named;
     OoTypeFunAnon fun_anon;
     OoTypeFunNamed fun_named;
@@ -151,7 +160,8 @@ typedef struct AsgBindingVal {
   bool mut;
   AsgSid *sid;
   AsgType *type; // NULL if no type annoation or fun or summand (TODO does this actually get used?)
-  OoType oo_type; // tag OO_TYPE_UNINITIALIZED if no type annotation
+  OoType *oo_type; // NULL if no type annotation, or before type checking
+  size_t slot; // the frame slot of an argument or pattern (see AsgItemFun.frame_size), ASG_NO_SLOT otherwise
   TagVal tag;
   union {
     AsgItemVal *val;
@@ -167,6 +177,7 @@ typedef struct AsgBindingVal {
 typedef struct AsgBinding {
   TagBinding tag;
   bool private; // If false, the non-public information of the binding should not be accessed.
+  bool pub; // Whether the binding is visible from outside of the namespace that contains it.
   AsgFile *file; // File in which the binding is defined. NULL for directories, mod, dep, primitives, etc.
   union {
     AsgItemType *type;
@@ -191,8 +202,7 @@ typedef enum {
 // A namespace. These are owned by AsgFiles, sum AsgTypeSums, and by the OoContext (for
 // the mod and dep namespace, and for all directories).
 typedef struct AsgNS {
-  rax *bindings_by_sid;
-  rax *pub_bindings_by_sid;
+  rax *bindings_by_sid; // all bindings, lookups from outside must check AsgBinding.pub
   AsgBinding *bindings; // owning stretchy buffer
   TagNS tag;
   union {
@@ -291,6 +301,16 @@ typedef struct AsgFile {
   AsgItem *items; // owning stretchy buffer
   AsgMeta **attrs; // owning stretchy buffer of owning stretchy buffers, same length as items
   AsgNS ns;
+  bool loaded; // false while a lazily loaded file has not been read yet (no str, items, attrs)
+  bool coarse_bound; // whether the top-level bindings in ns have been fully resolved
+  bool fine_bound; // whether the bindings inside the items have been resolved
+  bool kind_checked;
+  bool typed; // whether the items have been assigned their types
+  // Stretchy buffer of the files whose analysis looked into this file (by
+  // resolving a use or a path through it), which need to be analyzed again
+  // when this file changes. Owned by the context.
+  AsgFile **dependents;
+  bool iface; // loaded from an interface file, function bodies and val expressions are placeholders
 } AsgFile;
 
 // Filters out all items and expressions with cc (conditional compilation)
@@ -307,6 +327,7 @@ typedef struct AsgMeta {
   Str str;
   TagMeta tag;
   Str name;
+  uint32_t feature; // id of the feature of a cc attribute, OO_FEATURE_NONE otherwise (see cc.h)
   union {
     AsgLiteral unary;
     AsgMeta *nested; // stretchy buffer
@@ -382,6 +403,8 @@ typedef struct AsgTypeAppAnon {
   AsgType *args; // stretchy buffer
 } AsgTypeAppAnon;
 
+// Kind checking requires the sids to be in the order of the arguments of the
+// type-level function, so types[i] is always its i-th argument.
 typedef struct AsgTypeAppNamed {
   AsgId tlf;
   AsgType *types; // stretchy buffer
@@ -440,7 +463,8 @@ typedef struct AsgType {
 typedef struct AsgItemType {
   AsgSid sid;
   AsgType type;
-  OoType oo_type;
+  OoType *oo_type; // NULL before type checking
+  OoType *canonical; // oo_type with alias chains resolved, NULL until computed
 } AsgItemType;
 
 typedef enum {
@@ -458,11 +482,15 @@ typedef struct AsgPatternId {
   bool mut;
   AsgSid sid;
   AsgType *type; // may be null if no type annotation is present
+  size_t slot; // the frame slot of the local, set by fine binding (see AsgItemFun.frame_size)
 } AsgPatternId;
 
 typedef struct AsgPatternProductNamed {
   AsgPattern *inners; // stretchy buffer
   AsgSid *sids; // stretchy buffer, same length as inners
+  // Stretchy buffer, same length as inners: the index of each field in the
+  // matched product type. Set by the type checker, NULL until then.
+  size_t *positions;
 } AsgPatternProductNamed;
 
 typedef struct AsgPatternSummandAnon {
@@ -474,6 +502,10 @@ typedef struct AsgPatternSummandNamed {
   AsgId id;
   AsgPattern *fields; // stretchy buffer
   AsgSid *sids; // stretchy buffer,  same length as fields
+  // Stretchy buffer, same length as fields: the index of each field in the
+  // summand. Set by fine binding (which reports OO_ERR_SUMMAND_FIELD if the
+  // sids do not match the fields of the summand), NULL until then.
+  size_t *positions;
 } AsgPatternSummandNamed;
 
 typedef struct AsgPattern {
@@ -557,6 +589,9 @@ typedef struct AsgExpProductAccessAnon {
 typedef struct AsgExpProductAccessNamed {
   AsgExp *inner;
   AsgSid field;
+  // The index of the field in the type of inner. Set by the type checker (or
+  // when evaluating a val), ASG_NO_POSITION until then.
+  size_t position;
 } AsgExpProductAccessNamed;
 
 typedef struct AsgExpFunAppAnon {
@@ -568,6 +603,9 @@ typedef struct AsgExpFunAppNamed {
   AsgExp *fun;
   AsgExp *args; // stretchy buffer
   AsgSid *sids; // stretchy buffer,  same length as args
+  // Stretchy buffer, same length as args: the index of each argument in the
+  // signature of fun. Set by the type checker, NULL until then.
+  size_t *positions;
 } AsgExpFunAppNamed;
 
 typedef struct AsgExpCast {
@@ -635,6 +673,7 @@ typedef struct AsgExpLoop {
 typedef struct AsgExp {
   Str str;
   ExpTag tag;
+  bool disabled; // set by conditional compilation, disabled expressions are ignored by all analyses
   union {
     AsgId id;
     AsgMacroInv macro;
@@ -688,7 +727,16 @@ typedef struct AsgItemFun {
   bool *arg_muts; // stretchy buffer, same length as arg_sids
   AsgType *arg_types; // stretchy buffer, same length as arg_sids
   AsgType ret; // empty anon product if return type is omitted in the syntax
+  // If the body was skipped by a lazy parse, it has no expressions yet and
+  // body_src points to its source (see oo_cx_force_body). NULL once parsed.
+  const char *body_src;
   AsgBlock body;
+  // The number of frame slots of the locals, set by fine binding. The
+  // arguments take the first slots, in order, followed by the ids bound by the
+  // patterns of the body in the order of their bindings. The ids of different
+  // arms of the same case or loop share slots, since they are never in scope
+  // at the same time.
+  size_t frame_size;
 } AsgItemFun;
 
 typedef struct AsgItemFfiInclude {
@@ -706,6 +754,7 @@ typedef struct AsgItem {
   Str str;
   TagItem tag;
   bool pub; // ignored for ffi_includes
+  bool disabled; // set by conditional compilation, disabled items are ignored by all analyses
   union {
     AsgUseTree use;
     AsgItemType type;
@@ -716,4 +765,14 @@ typedef struct AsgItem {
   };
 } AsgItem;
 
+// The index of the given name among the (declared) sids, ASG_NO_POSITION if
+// there is none.
+size_t asg_position(const AsgSid *declared, Str name);
+
+// The positions of the used sids among the declared ones: a stretchy buffer of
+// the same length as used, or NULL if a used sid is not declared or occurs more
+// than once. *missing is set to the index of the first such sid, -1 if there
+// is none.
+size_t *asg_positions(const AsgSid *declared, const AsgSid *used, int *missing);
+
 #endif
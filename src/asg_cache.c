@@ -0,0 +1,1274 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "asg_cache.h"
+#include "parser.h"
+#include "stretchy_buffer.h"
+
+#define MAGIC "LOOKASG"
+#define IFACE_MAGIC "LOOKIFC"
+#define NO_OFFSET UINT64_MAX
+
+typedef struct Writer {
+  char *buf; // stretchy buffer
+  // A string at src is stored at offset base.
+  const char *src;
+  uint64_t base;
+  // Set while writing an interface: function bodies and val expressions are
+  // replaced by empty placeholders at end, the end of the written source.
+  bool signatures;
+  const char *end;
+} Writer;
+
+static void write_bytes(Writer *w, const void *bytes, size_t len) {
+  memcpy(sb_add(w->buf, (int) len), bytes, len);
+}
+
+static void write_u8(Writer *w, uint8_t x) {
+  write_bytes(w, &x, sizeof(x));
+}
+
+static void write_u32(Writer *w, uint32_t x) {
+  write_bytes(w, &x, sizeof(x));
+}
+
+static void write_u64(Writer *w, uint64_t x) {
+  write_bytes(w, &x, sizeof(x));
+}
+
+static void write_count(Writer *w, int count) {
+  write_u32(w, (uint32_t) count);
+}
+
+static void write_offset(Writer *w, const char *ptr) {
+  write_u64(w, ptr == NULL ? NO_OFFSET : (uint64_t) (ptr - w->src) + w->base);
+}
+
+static void write_str(Writer *w, Str s) {
+  write_offset(w, s.start);
+  write_u64(w, s.len);
+}
+
+static void write_type(Writer *w, const AsgType *data);
+static void write_exp(Writer *w, const AsgExp *data);
+static void write_pattern(Writer *w, const AsgPattern *data);
+static void write_metas(Writer *w, AsgMeta *sb);
+
+static void write_sid(Writer *w, const AsgSid *data) {
+  write_str(w, data->str);
+}
+
+static void write_sids(Writer *w, AsgSid *sb) {
+  write_count(w, sb_count(sb));
+  for (int i = 0; i < sb_count(sb); i++) {
+    write_sid(w, &sb[i]);
+  }
+}
+
+static void write_id(Writer *w, const AsgId *data) {
+  write_str(w, data->str);
+  write_sids(w, data->sids);
+}
+
+static void write_macro_inv(Writer *w, const AsgMacroInv *data) {
+  write_str(w, data->str);
+  write_str(w, data->name);
+  write_str(w, data->args);
+}
+
+static void write_literal(Writer *w, const AsgLiteral *data) {
+  write_str(w, data->str);
+  write_u32(w, data->tag);
+}
+
+static void write_repeat(Writer *w, const AsgRepeat *data) {
+  write_str(w, data->str);
+  write_u32(w, data->tag);
+  switch (data->tag) {
+    case REPEAT_INT:
+      break;
+    case REPEAT_MACRO:
+      write_macro_inv(w, &data->macro);
+      break;
+    case REPEAT_SIZE_OF:
+      write_type(w, data->size_of);
+      break;
+    case REPEAT_ALIGN_OF:
+      write_type(w, data->align_of);
+      break;
+    case REPEAT_BIN_OP:
+      write_u32(w, data->bin_op.op);
+      write_repeat(w, data->bin_op.lhs);
+      write_repeat(w, data->bin_op.rhs);
+      break;
+  }
+}
+
+static void write_types(Writer *w, AsgType *sb) {
+  write_count(w, sb_count(sb));
+  for (int i = 0; i < sb_count(sb); i++) {
+    write_type(w, &sb[i]);
+  }
+}
+
+static void write_summand(Writer *w, const AsgSummand *data) {
+  write_str(w, data->str);
+  write_u32(w, data->tag);
+  write_sid(w, &data->sid);
+  switch (data->tag) {
+    case SUMMAND_ANON:
+      write_types(w, data->anon);
+      break;
+    case SUMMAND_NAMED:
+      write_types(w, data->named.inners);
+      write_sids(w, data->named.sids);
+      break;
+  }
+}
+
+static void write_type(Writer *w, const AsgType *data) {
+  write_str(w, data->str);
+  write_u32(w, data->tag);
+  switch (data->tag) {
+    case TYPE_ID:
+      write_id(w, &data->id);
+      break;
+    case TYPE_MACRO:
+      write_macro_inv(w, &data->macro);
+      break;
+    case TYPE_PTR:
+      write_type(w, data->ptr);
+      break;
+    case TYPE_PTR_MUT:
+      write_type(w, data->ptr_mut);
+      break;
+    case TYPE_ARRAY:
+      write_type(w, data->array);
+      break;
+    case TYPE_PRODUCT_REPEATED:
+      write_type(w, data->product_repeated.inner);
+      write_repeat(w, &data->product_repeated.repeat);
+      break;
+    case TYPE_PRODUCT_ANON:
+      write_types(w, data->product_anon);
+      break;
+    case TYPE_PRODUCT_NAMED:
+      write_types(w, data->product_named.types);
+      write_sids(w, data->product_named.sids);
+      break;
+    case TYPE_FUN_ANON:
+      write_types(w, data->fun_anon.args);
+      write_type(w, data->fun_anon.ret);
+      break;
+    case TYPE_FUN_NAMED:
+      write_types(w, data->fun_named.arg_types);
+      write_sids(w, data->fun_named.arg_sids);
+      write_type(w, data->fun_named.ret);
+      break;
+    case TYPE_APP_ANON:
+      write_id(w, &data->app_anon.tlf);
+      write_types(w, data->app_anon.args);
+      break;
+    case TYPE_APP_NAMED:
+      write_id(w, &data->app_named.tlf);
+      write_types(w, data->app_named.types);
+      write_sids(w, data->app_named.sids);
+      break;
+    case TYPE_GENERIC:
+      write_sids(w, data->generic.args);
+      write_type(w, data->generic.inner);
+      break;
+    case TYPE_SUM:
+      write_u8(w, data->sum.pub);
+      write_count(w, sb_count(data->sum.summands));
+      for (int i = 0; i < sb_count(data->sum.summands); i++) {
+        write_summand(w, &data->sum.summands[i]);
+      }
+      break;
+  }
+}
+
+static void write_patterns(Writer *w, AsgPattern *sb) {
+  write_count(w, sb_count(sb));
+  for (int i = 0; i < sb_count(sb); i++) {
+    write_pattern(w, &sb[i]);
+  }
+}
+
+static void write_pattern(Writer *w, const AsgPattern *data) {
+  write_str(w, data->str);
+  write_u32(w, data->tag);
+  switch (data->tag) {
+    case PATTERN_ID:
+      write_u8(w, data->id.mut);
+      write_sid(w, &data->id.sid);
+      write_u8(w, data->id.type != NULL);
+      if (data->id.type != NULL) {
+        write_type(w, data->id.type);
+      }
+      break;
+    case PATTERN_BLANK:
+      break;
+    case PATTERN_LITERAL:
+      write_literal(w, &data->lit);
+      break;
+    case PATTERN_PTR:
+      write_pattern(w, data->ptr);
+      break;
+    case PATTERN_PRODUCT_ANON:
+      write_patterns(w, data->product_anon);
+      break;
+    case PATTERN_PRODUCT_NAMED:
+      write_patterns(w, data->product_named.inners);
+      write_sids(w, data->product_named.sids);
+      break;
+    case PATTERN_SUMMAND_ANON:
+      write_id(w, &data->summand_anon.id);
+      write_patterns(w, data->summand_anon.fields);
+      break;
+    case PATTERN_SUMMAND_NAMED:
+      write_id(w, &data->summand_named.id);
+      write_patterns(w, data->summand_named.fields);
+      write_sids(w, data->summand_named.sids);
+      break;
+  }
+}
+
+static void write_meta(Writer *w, const AsgMeta *data) {
+  write_str(w, data->str);
+  write_u32(w, data->tag);
+  write_str(w, data->name);
+  // Feature ids are specific to a context, only remember whether to intern one.
+  write_u8(w, data->feature != OO_FEATURE_NONE);
+  switch (data->tag) {
+    case META_NULLARY:
+      break;
+    case META_UNARY:
+      write_literal(w, &data->unary);
+      break;
+    case META_NESTED:
+      write_metas(w, data->nested);
+      break;
+  }
+}
+
+static void write_metas(Writer *w, AsgMeta *sb) {
+  write_count(w, sb_count(sb));
+  for (int i = 0; i < sb_count(sb); i++) {
+    write_meta(w, &sb[i]);
+  }
+}
+
+static void write_attrs(Writer *w, AsgMeta **sb) {
+  write_count(w, sb_count(sb));
+  for (int i = 0; i < sb_count(sb); i++) {
+    write_metas(w, sb[i]);
+  }
+}
+
+static void write_exps(Writer *w, AsgExp *sb) {
+  write_count(w, sb_count(sb));
+  for (int i = 0; i < sb_count(sb); i++) {
+    write_exp(w, &sb[i]);
+  }
+}
+
+static void write_block(Writer *w, const AsgBlock *data) {
+  write_str(w, data->str);
+  write_exps(w, data->exps);
+  write_attrs(w, data->attrs);
+}
+
+static void write_blocks(Writer *w, AsgBlock *sb) {
+  write_count(w, sb_count(sb));
+  for (int i = 0; i < sb_count(sb); i++) {
+    write_block(w, &sb[i]);
+  }
+}
+
+static void write_exp(Writer *w, const AsgExp *data) {
+  write_str(w, data->str);
+  write_u32(w, data->tag);
+  switch (data->tag) {
+    case EXP_ID:
+      write_id(w, &data->id);
+      break;
+    case EXP_MACRO:
+      write_macro_inv(w, &data->macro);
+      break;
+    case EXP_LITERAL:
+      write_literal(w, &data->lit);
+      break;
+    case EXP_REF:
+      write_exp(w, data->ref);
+      break;
+    case EXP_REF_MUT:
+      write_exp(w, data->ref_mut);
+      break;
+    case EXP_DEREF:
+      write_exp(w, data->deref);
+      break;
+    case EXP_DEREF_MUT:
+      write_exp(w, data->deref_mut);
+      break;
+    case EXP_ARRAY:
+      write_exp(w, data->array);
+      break;
+    case EXP_ARRAY_INDEX:
+      write_exp(w, data->array_index.arr);
+      write_exp(w, data->array_index.index);
+      break;
+    case EXP_PRODUCT_REPEATED:
+      write_exp(w, data->product_repeated.inner);
+      write_repeat(w, &data->product_repeated.repeat);
+      break;
+    case EXP_PRODUCT_ANON:
+      write_exps(w, data->product_anon);
+      break;
+    case EXP_PRODUCT_NAMED:
+      write_exps(w, data->product_named.inners);
+      write_sids(w, data->product_named.sids);
+      break;
+    case EXP_PRODUCT_ACCESS_ANON:
+      write_exp(w, data->product_access_anon.inner);
+      write_u64(w, data->product_access_anon.field);
+      break;
+    case EXP_PRODUCT_ACCESS_NAMED:
+      write_exp(w, data->product_access_named.inner);
+      write_sid(w, &data->product_access_named.field);
+      break;
+    case EXP_FUN_APP_ANON:
+      write_exp(w, data->fun_app_anon.fun);
+      write_exps(w, data->fun_app_anon.args);
+      break;
+    case EXP_FUN_APP_NAMED:
+      write_exp(w, data->fun_app_named.fun);
+      write_exps(w, data->fun_app_named.args);
+      write_sids(w, data->fun_app_named.sids);
+      break;
+    case EXP_CAST:
+      write_exp(w, data->cast.inner);
+      write_type(w, data->cast.type);
+      break;
+    case EXP_SIZE_OF:
+      write_type(w, data->size_of);
+      break;
+    case EXP_ALIGN_OF:
+      write_type(w, data->align_of);
+      break;
+    case EXP_NOT:
+      write_exp(w, data->exp_not);
+      break;
+    case EXP_NEGATE:
+      write_exp(w, data->exp_negate);
+      break;
+    case EXP_WRAPPING_NEGATE:
+      write_exp(w, data->exp_wrapping_negate);
+      break;
+    case EXP_BIN_OP:
+      write_u32(w, data->bin_op.op);
+      write_exp(w, data->bin_op.lhs);
+      write_exp(w, data->bin_op.rhs);
+      break;
+    case EXP_ASSIGN:
+      write_u32(w, data->assign.op);
+      write_exp(w, data->assign.lhs);
+      write_exp(w, data->assign.rhs);
+      break;
+    case EXP_VAL:
+      write_pattern(w, &data->val);
+      break;
+    case EXP_VAL_ASSIGN:
+      write_pattern(w, &data->val_assign.lhs);
+      write_exp(w, data->val_assign.rhs);
+      break;
+    case EXP_BLOCK:
+      write_block(w, &data->block);
+      break;
+    case EXP_IF:
+      write_exp(w, data->exp_if.cond);
+      write_block(w, &data->exp_if.if_block);
+      write_block(w, &data->exp_if.else_block);
+      break;
+    case EXP_CASE:
+      write_exp(w, data->exp_case.matcher);
+      write_patterns(w, data->exp_case.patterns);
+      write_blocks(w, data->exp_case.blocks);
+      break;
+    case EXP_WHILE:
+      write_exp(w, data->exp_while.cond);
+      write_block(w, &data->exp_while.block);
+      break;
+    case EXP_LOOP:
+      write_exp(w, data->exp_loop.matcher);
+      write_patterns(w, data->exp_loop.patterns);
+      write_blocks(w, data->exp_loop.blocks);
+      break;
+    case EXP_RETURN:
+      write_u8(w, data->exp_return != NULL);
+      if (data->exp_return != NULL) {
+        write_exp(w, data->exp_return);
+      }
+      break;
+    case EXP_BREAK:
+      write_u8(w, data->exp_break != NULL);
+      if (data->exp_break != NULL) {
+        write_exp(w, data->exp_break);
+      }
+      break;
+    case EXP_GOTO:
+      write_sid(w, &data->exp_goto);
+      break;
+    case EXP_LABEL:
+      write_sid(w, &data->exp_label);
+      break;
+  }
+}
+
+static void write_use_tree(Writer *w, const AsgUseTree *data) {
+  write_str(w, data->str);
+  write_u32(w, data->tag);
+  write_sid(w, &data->sid);
+  switch (data->tag) {
+    case USE_TREE_LEAF:
+      break;
+    case USE_TREE_RENAME:
+      write_sid(w, &data->rename);
+      break;
+    case USE_TREE_BRANCH:
+      write_count(w, sb_count(data->branch));
+      for (int i = 0; i < sb_count(data->branch); i++) {
+        write_use_tree(w, &data->branch[i]);
+      }
+      break;
+  }
+}
+
+// An empty string at the end of the source written so far, see Writer.signatures.
+static void write_placeholder_str(Writer *w) {
+  write_str(w, str_new(w->end, 0));
+}
+
+static void write_item(Writer *w, const AsgItem *data) {
+  if (w->signatures) {
+    write_str(w, str_new(data->str.start, w->end - data->str.start));
+  } else {
+    write_str(w, data->str);
+  }
+  write_u32(w, data->tag);
+  write_u8(w, data->pub);
+  switch (data->tag) {
+    case ITEM_USE:
+      write_use_tree(w, &data->use);
+      break;
+    case ITEM_TYPE:
+      write_sid(w, &data->type.sid);
+      write_type(w, &data->type.type);
+      break;
+    case ITEM_VAL:
+      write_u8(w, data->val.mut);
+      write_sid(w, &data->val.sid);
+      write_type(w, &data->val.type);
+      if (w->signatures) {
+        write_placeholder_str(w);
+        write_u32(w, EXP_PRODUCT_ANON);
+        write_count(w, 0);
+      } else {
+        write_exp(w, &data->val.exp);
+      }
+      break;
+    case ITEM_FUN:
+      write_sid(w, &data->fun.sid);
+      write_sids(w, data->fun.type_args);
+      write_sids(w, data->fun.arg_sids);
+      write_count(w, sb_count(data->fun.arg_muts));
+      for (int i = 0; i < sb_count(data->fun.arg_muts); i++) {
+        write_u8(w, data->fun.arg_muts[i]);
+      }
+      write_types(w, data->fun.arg_types);
+      write_type(w, &data->fun.ret);
+      if (w->signatures) {
+        write_offset(w, NULL);
+        write_placeholder_str(w);
+        write_count(w, 0);
+        write_count(w, 0);
+      } else {
+        write_offset(w, data->fun.body_src);
+        write_block(w, &data->fun.body);
+      }
+      break;
+    case ITEM_FFI_INCLUDE:
+      write_str(w, data->ffi_include.include);
+      break;
+    case ITEM_FFI_VAL:
+      write_u8(w, data->ffi_val.mut);
+      write_sid(w, &data->ffi_val.sid);
+      write_type(w, &data->ffi_val.type);
+      break;
+  }
+}
+
+char *oo_asg_serialize(const AsgFile *asg, const char *src) {
+  Writer w;
+  w.buf = NULL;
+  w.src = src;
+  w.base = 0;
+  w.signatures = false;
+  w.end = NULL;
+
+  write_bytes(&w, MAGIC, sizeof(MAGIC));
+  write_str(&w, asg->str);
+  write_count(&w, sb_count(asg->items));
+  for (int i = 0; i < sb_count(asg->items); i++) {
+    write_item(&w, &asg->items[i]);
+  }
+  write_attrs(&w, asg->attrs);
+  return w.buf;
+}
+
+// Uses and types are kept even if private, public signatures may need them.
+static bool in_interface(const AsgItem *item) {
+  if (item->disabled) {
+    return false;
+  }
+
+  switch (item->tag) {
+    case ITEM_USE:
+    case ITEM_TYPE:
+    case ITEM_FFI_INCLUDE:
+      return true;
+    default:
+      return item->pub;
+  }
+}
+
+// The source of an item that an interface retains: its attributes and the
+// item itself, up to the body of a function or the expression of a val.
+static Str interface_src(const AsgFile *asg, int i) {
+  const AsgItem *item = &asg->items[i];
+  const char *start = sb_count(asg->attrs[i]) > 0 ? asg->attrs[i][0].str.start : item->str.start;
+  const char *end;
+  switch (item->tag) {
+    case ITEM_FUN:
+      end = item->fun.body.str.start;
+      break;
+    case ITEM_VAL:
+      end = item->val.exp.str.start;
+      break;
+    default:
+      end = item->str.start + item->str.len;
+      break;
+  }
+  return str_new(start, end - start);
+}
+
+char *oo_iface_serialize(const AsgFile *asg) {
+  char *text = NULL; // stretchy buffer
+  int *kept = NULL; // stretchy buffer of item indices
+  uint64_t *bases = NULL; // stretchy buffer, offset of the source of each kept item in text
+  for (int i = 0; i < sb_count(asg->items); i++) {
+    if (in_interface(&asg->items[i])) {
+      Str src = interface_src(asg, i);
+      sb_push(kept, i);
+      sb_push(bases, sb_count(text));
+      memcpy(sb_add(text, (int) src.len + 1), src.start, src.len);
+      sb_last(text) = '\n';
+    }
+  }
+
+  Writer w;
+  w.buf = NULL;
+  w.signatures = true;
+  write_bytes(&w, IFACE_MAGIC, sizeof(IFACE_MAGIC));
+  write_u64(&w, sb_count(text));
+  if (text != NULL) {
+    write_bytes(&w, text, sb_count(text));
+  }
+
+  write_u64(&w, 0);
+  write_u64(&w, sb_count(text));
+  write_count(&w, sb_count(kept));
+  for (int i = 0; i < sb_count(kept); i++) {
+    Str src = interface_src(asg, kept[i]);
+    w.src = src.start;
+    w.base = bases[i];
+    w.end = src.start + src.len;
+    write_item(&w, &asg->items[kept[i]]);
+  }
+  write_count(&w, sb_count(kept));
+  for (int i = 0; i < sb_count(kept); i++) {
+    Str src = interface_src(asg, kept[i]);
+    w.src = src.start;
+    w.base = bases[i];
+    write_metas(&w, asg->attrs[kept[i]]);
+  }
+
+  sb_free(text);
+  sb_free(kept);
+  sb_free(bases);
+  return w.buf;
+}
+
+// Reading never goes out of bounds: once the data is found to be malformed,
+// ok is cleared and all further reads yield zeros. Since zeroed nodes are
+// valid (if meaningless), a partially read asg can always be freed normally.
+typedef struct Reader {
+  const char *data;
+  size_t len;
+  size_t pos;
+  const char *src;
+  size_t src_len;
+  AsgFile *asg;
+  OoFeatureTable *features;
+  bool ok;
+} Reader;
+
+static void read_bytes(Reader *r, void *out, size_t len) {
+  if (!r->ok || r->len - r->pos < len) {
+    r->ok = false;
+    memset(out, 0, len);
+    return;
+  }
+  memcpy(out, r->data + r->pos, len);
+  r->pos += len;
+}
+
+static uint8_t read_u8(Reader *r) {
+  uint8_t x;
+  read_bytes(r, &x, sizeof(x));
+  return x;
+}
+
+static bool read_bool(Reader *r) {
+  return read_u8(r) != 0;
+}
+
+static uint32_t read_u32(Reader *r) {
+  uint32_t x;
+  read_bytes(r, &x, sizeof(x));
+  return x;
+}
+
+static uint64_t read_u64(Reader *r) {
+  uint64_t x;
+  read_bytes(r, &x, sizeof(x));
+  return x;
+}
+
+// Reads a tag of an enum with count variants.
+static uint32_t read_tag(Reader *r, uint32_t count) {
+  uint32_t tag = read_u32(r);
+  if (tag >= count) {
+    r->ok = false;
+    return 0;
+  }
+  return tag;
+}
+
+// Reads the length of a stretchy buffer. Every element takes at least one
+// byte, which bounds the allocation by the size of the data.
+static int read_count(Reader *r) {
+  uint32_t count = read_u32(r);
+  if (count > r->len - r->pos) {
+    r->ok = false;
+    return 0;
+  }
+  return (int) count;
+}
+
+static const char *read_offset(Reader *r, size_t len) {
+  uint64_t offset = read_u64(r);
+  if (offset == NO_OFFSET) {
+    return NULL;
+  }
+  if (offset > r->src_len || len > r->src_len - offset) {
+    r->ok = false;
+    return r->src;
+  }
+  return r->src + offset;
+}
+
+static Str read_str(Reader *r) {
+  uint64_t offset = read_u64(r);
+  Str s;
+  s.len = read_u64(r);
+  if (offset == NO_OFFSET) {
+    s.start = NULL;
+  } else if (offset > r->src_len || s.len > r->src_len - offset) {
+    r->ok = false;
+    s.start = r->src;
+    s.len = 0;
+  } else {
+    s.start = r->src + offset;
+  }
+  return s;
+}
+
+static void read_type(Reader *r, AsgType *data);
+static void read_exp(Reader *r, AsgExp *data);
+static void read_pattern(Reader *r, AsgPattern *data);
+static AsgMeta *read_metas(Reader *r);
+
+static AsgType *read_type_ptr(Reader *r) {
+  AsgType *data = malloc(sizeof(AsgType));
+  read_type(r, data);
+  return data;
+}
+
+static AsgExp *read_exp_ptr(Reader *r) {
+  AsgExp *data = malloc(sizeof(AsgExp));
+  read_exp(r, data);
+  return data;
+}
+
+static AsgPattern *read_pattern_ptr(Reader *r) {
+  AsgPattern *data = malloc(sizeof(AsgPattern));
+  read_pattern(r, data);
+  return data;
+}
+
+static void read_sid(Reader *r, AsgSid *data) {
+  memset(data, 0, sizeof(AsgSid));
+  data->str = read_str(r);
+}
+
+static AsgSid *read_sids(Reader *r) {
+  int count = read_count(r);
+  AsgSid *sb = NULL;
+  for (int i = 0; i < count; i++) {
+    read_sid(r, sb_add(sb, 1));
+  }
+  return sb;
+}
+
+static void read_id(Reader *r, AsgId *data) {
+  memset(data, 0, sizeof(AsgId));
+  data->str = read_str(r);
+  data->sids = read_sids(r);
+}
+
+static void read_macro_inv(Reader *r, AsgMacroInv *data) {
+  data->str = read_str(r);
+  data->name = read_str(r);
+  data->args = read_str(r);
+}
+
+static void read_literal(Reader *r, AsgLiteral *data) {
+  data->str = read_str(r);
+  data->tag = read_tag(r, LITERAL_HALT + 1);
+}
+
+static void read_repeat(Reader *r, AsgRepeat *data) {
+  memset(data, 0, sizeof(AsgRepeat));
+  data->str = read_str(r);
+  data->tag = read_tag(r, REPEAT_BIN_OP + 1);
+  switch (data->tag) {
+    case REPEAT_INT:
+      break;
+    case REPEAT_MACRO:
+      read_macro_inv(r, &data->macro);
+      break;
+    case REPEAT_SIZE_OF:
+      data->size_of = read_type_ptr(r);
+      break;
+    case REPEAT_ALIGN_OF:
+      data->align_of = read_type_ptr(r);
+      break;
+    case REPEAT_BIN_OP:
+      data->bin_op.op = read_tag(r, OP_WRAPPING_TIMES + 1);
+      data->bin_op.lhs = malloc(sizeof(AsgRepeat));
+      read_repeat(r, data->bin_op.lhs);
+      data->bin_op.rhs = malloc(sizeof(AsgRepeat));
+      read_repeat(r, data->bin_op.rhs);
+      break;
+  }
+}
+
+static AsgType *read_types(Reader *r) {
+  int count = read_count(r);
+  AsgType *sb = NULL;
+  for (int i = 0; i < count; i++) {
+    read_type(r, sb_add(sb, 1));
+  }
+  return sb;
+}
+
+static void read_summand(Reader *r, AsgSummand *data) {
+  memset(data, 0, sizeof(AsgSummand));
+  data->str = read_str(r);
+  data->tag = read_tag(r, SUMMAND_NAMED + 1);
+  read_sid(r, &data->sid);
+  switch (data->tag) {
+    case SUMMAND_ANON:
+      data->anon = read_types(r);
+      break;
+    case SUMMAND_NAMED:
+      data->named.inners = read_types(r);
+      data->named.sids = read_sids(r);
+      break;
+  }
+}
+
+static void read_type(Reader *r, AsgType *data) {
+  memset(data, 0, sizeof(AsgType));
+  data->str = read_str(r);
+  data->tag = read_tag(r, TYPE_SUM + 1);
+  switch (data->tag) {
+    case TYPE_ID:
+      read_id(r, &data->id);
+      break;
+    case TYPE_MACRO:
+      read_macro_inv(r, &data->macro);
+      break;
+    case TYPE_PTR:
+      data->ptr = read_type_ptr(r);
+      break;
+    case TYPE_PTR_MUT:
+      data->ptr_mut = read_type_ptr(r);
+      break;
+    case TYPE_ARRAY:
+      data->array = read_type_ptr(r);
+      break;
+    case TYPE_PRODUCT_REPEATED:
+      data->product_repeated.inner = read_type_ptr(r);
+      read_repeat(r, &data->product_repeated.repeat);
+      break;
+    case TYPE_PRODUCT_ANON:
+      data->product_anon = read_types(r);
+      break;
+    case TYPE_PRODUCT_NAMED:
+      data->product_named.types = read_types(r);
+      data->product_named.sids = read_sids(r);
+      break;
+    case TYPE_FUN_ANON:
+      data->fun_anon.args = read_types(r);
+      data->fun_anon.ret = read_type_ptr(r);
+      break;
+    case TYPE_FUN_NAMED:
+      data->fun_named.arg_types = read_types(r);
+      data->fun_named.arg_sids = read_sids(r);
+      data->fun_named.ret = read_type_ptr(r);
+      break;
+    case TYPE_APP_ANON:
+      read_id(r, &data->app_anon.tlf);
+      data->app_anon.args = read_types(r);
+      break;
+    case TYPE_APP_NAMED:
+      read_id(r, &data->app_named.tlf);
+      data->app_named.types = read_types(r);
+      data->app_named.sids = read_sids(r);
+      break;
+    case TYPE_GENERIC:
+      data->generic.args = read_sids(r);
+      data->generic.inner = read_type_ptr(r);
+      break;
+    case TYPE_SUM: {
+        data->sum.pub = read_bool(r);
+        int count = read_count(r);
+        for (int i = 0; i < count; i++) {
+          read_summand(r, sb_add(data->sum.summands, 1));
+        }
+        // the namespace (already zeroed) is created by the coarse binding pass
+      }
+      break;
+  }
+}
+
+static AsgPattern *read_patterns(Reader *r) {
+  int count = read_count(r);
+  AsgPattern *sb = NULL;
+  for (int i = 0; i < count; i++) {
+    read_pattern(r, sb_add(sb, 1));
+  }
+  return sb;
+}
+
+static void read_pattern(Reader *r, AsgPattern *data) {
+  memset(data, 0, sizeof(AsgPattern));
+  data->str = read_str(r);
+  data->tag = read_tag(r, PATTERN_SUMMAND_NAMED + 1);
+  switch (data->tag) {
+    case PATTERN_ID:
+      data->id.mut = read_bool(r);
+      data->id.slot = 0;
+      read_sid(r, &data->id.sid);
+      if (read_bool(r)) {
+        data->id.type = read_type_ptr(r);
+      }
+      break;
+    case PATTERN_BLANK:
+      break;
+    case PATTERN_LITERAL:
+      read_literal(r, &data->lit);
+      break;
+    case PATTERN_PTR:
+      data->ptr = read_pattern_ptr(r);
+      break;
+    case PATTERN_PRODUCT_ANON:
+      data->product_anon = read_patterns(r);
+      break;
+    case PATTERN_PRODUCT_NAMED:
+      data->product_named.inners = read_patterns(r);
+      data->product_named.sids = read_sids(r);
+      data->product_named.positions = NULL;
+      break;
+    case PATTERN_SUMMAND_ANON:
+      read_id(r, &data->summand_anon.id);
+      data->summand_anon.fields = read_patterns(r);
+      break;
+    case PATTERN_SUMMAND_NAMED:
+      read_id(r, &data->summand_named.id);
+      data->summand_named.fields = read_patterns(r);
+      data->summand_named.sids = read_sids(r);
+      data->summand_named.positions = NULL;
+      break;
+  }
+}
+
+static void read_meta(Reader *r, AsgMeta *data) {
+  memset(data, 0, sizeof(AsgMeta));
+  data->str = read_str(r);
+  data->tag = read_tag(r, META_NESTED + 1);
+  data->name = read_str(r);
+  bool feature = read_bool(r);
+  data->feature = OO_FEATURE_NONE;
+  switch (data->tag) {
+    case META_NULLARY:
+      break;
+    case META_UNARY:
+      read_literal(r, &data->unary);
+      // same as parse_attrs: the feature is the string literal without its quotes
+      if (feature && r->features != NULL && data->unary.str.len >= 2) {
+        data->feature = oo_features_intern(r->features, data->unary.str.start + 1, data->unary.str.len - 2);
+      }
+      break;
+    case META_NESTED:
+      data->nested = read_metas(r);
+      break;
+  }
+}
+
+static AsgMeta *read_metas(Reader *r) {
+  int count = read_count(r);
+  AsgMeta *sb = NULL;
+  for (int i = 0; i < count; i++) {
+    read_meta(r, sb_add(sb, 1));
+  }
+  return sb;
+}
+
+static AsgMeta **read_attrs(Reader *r) {
+  int count = read_count(r);
+  AsgMeta **sb = NULL;
+  for (int i = 0; i < count; i++) {
+    sb_push(sb, read_metas(r));
+  }
+  return sb;
+}
+
+static AsgExp *read_exps(Reader *r) {
+  int count = read_count(r);
+  AsgExp *sb = NULL;
+  for (int i = 0; i < count; i++) {
+    read_exp(r, sb_add(sb, 1));
+  }
+  return sb;
+}
+
+static void read_block(Reader *r, AsgBlock *data) {
+  data->str = read_str(r);
+  data->exps = read_exps(r);
+  data->attrs = read_attrs(r);
+}
+
+static AsgBlock *read_blocks(Reader *r) {
+  int count = read_count(r);
+  AsgBlock *sb = NULL;
+  for (int i = 0; i < count; i++) {
+    read_block(r, sb_add(sb, 1));
+  }
+  return sb;
+}
+
+static void read_exp(Reader *r, AsgExp *data) {
+  memset(data, 0, sizeof(AsgExp));
+  data->str = read_str(r);
+  data->tag = read_tag(r, EXP_LABEL + 1);
+  switch (data->tag) {
+    case EXP_ID:
+      read_id(r, &data->id);
+      break;
+    case EXP_MACRO:
+      read_macro_inv(r, &data->macro);
+      break;
+    case EXP_LITERAL:
+      read_literal(r, &data->lit);
+      break;
+    case EXP_REF:
+      data->ref = read_exp_ptr(r);
+      break;
+    case EXP_REF_MUT:
+      data->ref_mut = read_exp_ptr(r);
+      break;
+    case EXP_DEREF:
+      data->deref = read_exp_ptr(r);
+      break;
+    case EXP_DEREF_MUT:
+      data->deref_mut = read_exp_ptr(r);
+      break;
+    case EXP_ARRAY:
+      data->array = read_exp_ptr(r);
+      break;
+    case EXP_ARRAY_INDEX:
+      data->array_index.arr = read_exp_ptr(r);
+      data->array_index.index = read_exp_ptr(r);
+      break;
+    case EXP_PRODUCT_REPEATED:
+      data->product_repeated.inner = read_exp_ptr(r);
+      read_repeat(r, &data->product_repeated.repeat);
+      break;
+    case EXP_PRODUCT_ANON:
+      data->product_anon = read_exps(r);
+      break;
+    case EXP_PRODUCT_NAMED:
+      data->product_named.inners = read_exps(r);
+      data->product_named.sids = read_sids(r);
+      break;
+    case EXP_PRODUCT_ACCESS_ANON:
+      data->product_access_anon.inner = read_exp_ptr(r);
+      data->product_access_anon.field = read_u64(r);
+      break;
+    case EXP_PRODUCT_ACCESS_NAMED:
+      data->product_access_named.inner = read_exp_ptr(r);
+      read_sid(r, &data->product_access_named.field);
+      data->product_access_named.position = ASG_NO_POSITION;
+      break;
+    case EXP_FUN_APP_ANON:
+      data->fun_app_anon.fun = read_exp_ptr(r);
+      data->fun_app_anon.args = read_exps(r);
+      break;
+    case EXP_FUN_APP_NAMED:
+      data->fun_app_named.fun = read_exp_ptr(r);
+      data->fun_app_named.args = read_exps(r);
+      data->fun_app_named.sids = read_sids(r);
+      data->fun_app_named.positions = NULL;
+      break;
+    case EXP_CAST:
+      data->cast.inner = read_exp_ptr(r);
+      data->cast.type = read_type_ptr(r);
+      break;
+    case EXP_SIZE_OF:
+      data->size_of = read_type_ptr(r);
+      break;
+    case EXP_ALIGN_OF:
+      data->align_of = read_type_ptr(r);
+      break;
+    case EXP_NOT:
+      data->exp_not = read_exp_ptr(r);
+      break;
+    case EXP_NEGATE:
+      data->exp_negate = read_exp_ptr(r);
+      break;
+    case EXP_WRAPPING_NEGATE:
+      data->exp_wrapping_negate = read_exp_ptr(r);
+      break;
+    case EXP_BIN_OP:
+      data->bin_op.op = read_tag(r, OP_WRAPPING_TIMES + 1);
+      data->bin_op.lhs = read_exp_ptr(r);
+      data->bin_op.rhs = read_exp_ptr(r);
+      break;
+    case EXP_ASSIGN:
+      data->assign.op = read_tag(r, ASSIGN_WRAPPING_TIMES + 1);
+      data->assign.lhs = read_exp_ptr(r);
+      data->assign.rhs = read_exp_ptr(r);
+      break;
+    case EXP_VAL:
+      read_pattern(r, &data->val);
+      break;
+    case EXP_VAL_ASSIGN:
+      read_pattern(r, &data->val_assign.lhs);
+      data->val_assign.rhs = read_exp_ptr(r);
+      break;
+    case EXP_BLOCK:
+      read_block(r, &data->block);
+      break;
+    case EXP_IF:
+      data->exp_if.cond = read_exp_ptr(r);
+      read_block(r, &data->exp_if.if_block);
+      read_block(r, &data->exp_if.else_block);
+      break;
+    case EXP_CASE:
+      data->exp_case.matcher = read_exp_ptr(r);
+      data->exp_case.patterns = read_patterns(r);
+      data->exp_case.blocks = read_blocks(r);
+      break;
+    case EXP_WHILE:
+      data->exp_while.cond = read_exp_ptr(r);
+      read_block(r, &data->exp_while.block);
+      break;
+    case EXP_LOOP:
+      data->exp_loop.matcher = read_exp_ptr(r);
+      data->exp_loop.patterns = read_patterns(r);
+      data->exp_loop.blocks = read_blocks(r);
+      break;
+    case EXP_RETURN:
+      if (read_bool(r)) {
+        data->exp_return = read_exp_ptr(r);
+      }
+      break;
+    case EXP_BREAK:
+      if (read_bool(r)) {
+        data->exp_break = read_exp_ptr(r);
+      }
+      break;
+    case EXP_GOTO:
+      read_sid(r, &data->exp_goto);
+      break;
+    case EXP_LABEL:
+      read_sid(r, &data->exp_label);
+      break;
+  }
+}
+
+static void read_use_tree(Reader *r, AsgUseTree *data) {
+  memset(data, 0, sizeof(AsgUseTree));
+  data->asg = r->asg;
+  data->str = read_str(r);
+  data->tag = read_tag(r, USE_TREE_BRANCH + 1);
+  read_sid(r, &data->sid);
+  switch (data->tag) {
+    case USE_TREE_LEAF:
+      break;
+    case USE_TREE_RENAME:
+      read_sid(r, &data->rename);
+      break;
+    case USE_TREE_BRANCH: {
+        int count = read_count(r);
+        for (int i = 0; i < count; i++) {
+          read_use_tree(r, sb_add(data->branch, 1));
+        }
+      }
+      break;
+  }
+}
+
+static void read_item(Reader *r, AsgItem *data) {
+  memset(data, 0, sizeof(AsgItem));
+  data->asg = r->asg;
+  data->str = read_str(r);
+  data->tag = read_tag(r, ITEM_FFI_VAL + 1);
+  data->pub = read_bool(r);
+  switch (data->tag) {
+    case ITEM_USE:
+      read_use_tree(r, &data->use);
+      break;
+    case ITEM_TYPE:
+      read_sid(r, &data->type.sid);
+      read_type(r, &data->type.type);
+      break;
+    case ITEM_VAL:
+      data->val.mut = read_bool(r);
+      read_sid(r, &data->val.sid);
+      read_type(r, &data->val.type);
+      read_exp(r, &data->val.exp);
+      break;
+    case ITEM_FUN: {
+        read_sid(r, &data->fun.sid);
+        data->fun.type_args = read_sids(r);
+        data->fun.arg_sids = read_sids(r);
+        int count = read_count(r);
+        for (int i = 0; i < count; i++) {
+          sb_push(data->fun.arg_muts, read_bool(r));
+        }
+        data->fun.arg_types = read_types(r);
+        read_type(r, &data->fun.ret);
+        data->fun.body_src = read_offset(r, 0);
+        data->fun.frame_size = 0;
+        read_block(r, &data->fun.body);
+      }
+      break;
+    case ITEM_FFI_INCLUDE:
+      data->ffi_include.include = read_str(r);
+      break;
+    case ITEM_FFI_VAL:
+      data->ffi_val.mut = read_bool(r);
+      read_sid(r, &data->ffi_val.sid);
+      read_type(r, &data->ffi_val.type);
+      break;
+  }
+}
+
+// Reads the encoding of the file at the position of the reader, which must
+// extend exactly to the end of the data.
+static bool read_file(Reader *r, AsgFile *asg) {
+  Str str = read_str(r);
+  AsgItem *items = NULL;
+  int count = read_count(r);
+  for (int i = 0; i < count; i++) {
+    read_item(r, sb_add(items, 1));
+  }
+  AsgMeta **attrs = read_attrs(r);
+
+  if (!r->ok || r->pos != r->len || sb_count(attrs) != sb_count(items)) {
+    for (int i = 0; i < sb_count(items); i++) {
+      free_inner_item(items[i]);
+    }
+    sb_free(items);
+    for (int i = 0; i < sb_count(attrs); i++) {
+      free_sb_meta(attrs[i]);
+    }
+    sb_free(attrs);
+    return false;
+  }
+
+  asg->path = NULL;
+  asg->str = str;
+  asg->items = items;
+  asg->attrs = attrs;
+  asg->ns.bindings = NULL;
+  asg->ns.tag = NS_FILE;
+  asg->ns.file = asg;
+  return true;
+}
+
+bool oo_asg_deserialize(const char *data, size_t len, const char *src, size_t src_len, AsgFile *asg, OoFeatureTable *features) {
+  Reader r;
+  r.data = data;
+  r.len = len;
+  r.pos = 0;
+  r.src = src;
+  r.src_len = src_len;
+  r.asg = asg;
+  r.features = features;
+  r.ok = true;
+
+  char magic[sizeof(MAGIC)];
+  read_bytes(&r, magic, sizeof(MAGIC));
+  if (!r.ok || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+    return false;
+  }
+
+  return read_file(&r, asg);
+}
+
+bool oo_iface_deserialize(const char *data, size_t len, AsgFile *asg, OoFeatureTable *features) {
+  Reader r;
+  r.data = data;
+  r.len = len;
+  r.pos = 0;
+  r.asg = asg;
+  r.features = features;
+  r.ok = true;
+
+  char magic[sizeof(IFACE_MAGIC)];
+  read_bytes(&r, magic, sizeof(IFACE_MAGIC));
+  uint64_t text_len = read_u64(&r);
+  if (!r.ok || memcmp(magic, IFACE_MAGIC, sizeof(IFACE_MAGIC)) != 0 || text_len > len - r.pos) {
+    return false;
+  }
+  r.src = data + r.pos;
+  r.src_len = text_len;
+  r.pos += text_len;
+
+  return read_file(&r, asg);
+}
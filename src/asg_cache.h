@@ -0,0 +1,46 @@
+// A binary encoding of freshly parsed asgs, so that unchanged files need not
+// be parsed again (see OoContext.cache_dir). All strings are stored as offsets
+// into the source text and are relocated when loading, so an encoding is only
+// valid together with the exact source it was parsed from.
+//
+// The same encoding backs interface files (see OoContext.dep_ifaces), which
+// carry their own excerpt of the source.
+#ifndef OO_ASG_CACHE_H
+#define OO_ASG_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "asg.h"
+#include "cc.h"
+
+// Part of every cache key. Bump whenever the parser or the layout of the asg
+// changes, so that stale encodings are never loaded.
+#define OO_ASG_CACHE_VERSION "look-asg-2"
+
+// Encodes an asg as returned by parse_file (no bindings, types or cc filtering),
+// all of whose strings point into src. Returns an owning stretchy buffer.
+// The encoding uses the native byte order, it is not meant to be portable.
+char *oo_asg_serialize(const AsgFile *asg, const char *src);
+
+// Rebuilds an asg from an encoding of oo_asg_serialize, relocating all strings
+// into src (of length src_len), and sets the same fields of asg as parse_file.
+// The features of cc attributes are interned into features unless it is NULL.
+// Returns false if the data is malformed, in which case asg is left untouched.
+bool oo_asg_deserialize(const char *data, size_t len, const char *src, size_t src_len, AsgFile *asg, OoFeatureTable *features);
+
+// Encodes the interface of a file: what dependent code can observe of it.
+// That is all public items (but only the signatures of functions and the
+// types of vals), plus all uses and type definitions. The result is self
+// contained, it embeds the source of the retained items. Returns an owning
+// stretchy buffer.
+char *oo_iface_serialize(const AsgFile *asg);
+
+// Rebuilds the asg of an interface file, setting the same fields as
+// oo_asg_deserialize. All strings point into data, which is meant to be a
+// read-only mapping of the file, and must outlive the asg. Function bodies
+// are empty and the expressions of vals are empty products, analyses must
+// skip both (see AsgFile.iface).
+bool oo_iface_deserialize(const char *data, size_t len, AsgFile *asg, OoFeatureTable *features);
+
+#endif
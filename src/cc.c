@@ -1,4 +1,5 @@
-// Conditional compilation: This provides the implementation of oo_filter_cc.
+// Conditional compilation: This provides the implementation of oo_cc_enabled
+// and oo_filter_cc.
 #include <stdbool.h>
 #include <string.h>
 
@@ -6,68 +7,102 @@
 #include "parser.h"
 #include "stretchy_buffer.h"
 
-static bool should_stay(AsgMeta *attrs, rax *features) {
-  int i;
+void oo_features_init(OoFeatureTable *table) {
+  table->ids = raxNew();
+  table->count = 0;
+}
+
+uint32_t oo_features_intern(OoFeatureTable *table, const char *name, size_t len) {
+  void *id = raxFind(table->ids, name, len);
+  if (id != raxNotFound) {
+    return (uint32_t) (uintptr_t) id;
+  }
+
+  raxInsert(table->ids, name, len, (void *) (uintptr_t) table->count, NULL);
+  table->count += 1;
+  return table->count - 1;
+}
+
+void oo_features_free(OoFeatureTable *table) {
+  raxFree(table->ids);
+}
+
+OoFeatureSet oo_feature_set_compile(OoFeatureTable *table, rax *features) {
+  OoFeatureSet set;
+  set.words = NULL;
+
+  raxIterator it;
+  raxStart(&it, features);
+  raxSeek(&it, "^", NULL, 0);
+  while (raxNext(&it)) {
+    uint32_t id = oo_features_intern(table, it.key, it.key_len);
+    int word = (int) (id / 64);
+    if (word >= sb_count(set.words)) {
+      int missing = word + 1 - sb_count(set.words);
+      memset(sb_add(set.words, missing), 0, missing * sizeof(uint64_t));
+    }
+    set.words[word] |= ((uint64_t) 1) << (id % 64);
+  }
+  raxStop(&it);
+
+  return set;
+}
+
+bool oo_feature_set_has(const OoFeatureSet *set, uint32_t feature) {
+  return feature / 64 < (uint32_t) sb_count(set->words) &&
+    (set->words[feature / 64] & (((uint64_t) 1) << (feature % 64))) != 0;
+}
+
+void oo_feature_set_free(OoFeatureSet set) {
+  sb_free(set.words);
+}
+
+bool oo_cc_enabled(AsgMeta *attrs, const OoFeatureSet *features) {
+  if (features == NULL) {
+    return true;
+  }
+
   int count = sb_count(attrs);
-  for (i = 0; i < count; i++) {
-    if (attrs[i].tag == META_UNARY && str_eq_parts(attrs[i].name, "cc", 2)) {
-      if (attrs[i].unary.tag == LITERAL_STRING &&
-        raxFind(features, attrs[i].unary.str.start + 1, attrs[i].unary.str.len - 2) == raxNotFound) {
-        return false;
-      }
+  for (int i = 0; i < count; i++) {
+    if (attrs[i].feature != OO_FEATURE_NONE && !oo_feature_set_has(features, attrs[i].feature)) {
+      return false;
     }
   }
 
   return true;
 }
 
-static void filter_exp_sb(AsgExp *exps, rax *features);
-
-static void filter_block(AsgBlock *block, rax *features) {
-  AsgMeta **new_attrs = NULL;
-  AsgExp *new_exps = NULL;
+static void filter_exp(AsgExp *exp, const OoFeatureSet *features);
 
-  int i;
-  size_t copied = 0;
+static void filter_block(AsgBlock *block, const OoFeatureSet *features) {
   int count = sb_count(block->exps);
-  for (i = 0; i < count; i++) {
-    if (should_stay(block->attrs[i], features)) {
-      sb_add(new_attrs, 1);
-      new_attrs[copied] = block->attrs[i];
-      sb_add(new_exps, 1);
-      new_exps[copied] = block->exps[i];
-      copied += 1;
-    } else {
-      free_sb_meta(block->attrs[i]);
-      free_inner_exp(block->exps[i]);
+  for (int i = 0; i < count; i++) {
+    block->exps[i].disabled = !oo_cc_enabled(block->attrs[i], features);
+    if (!block->exps[i].disabled) {
+      filter_exp(&block->exps[i], features);
     }
-
-    filter_exp_sb(block->exps, features);
   }
+}
 
-  sb_free(block->attrs);
-  block->attrs = new_attrs;
-  sb_free(block->exps);
-  block->exps = new_exps;
+void oo_filter_cc_block(AsgBlock *block, const OoFeatureSet *features) {
+  filter_block(block, features);
 }
 
-static void filter_block_sb(AsgBlock *blocks, rax *features) {
+static void filter_block_sb(AsgBlock *blocks, const OoFeatureSet *features) {
   int count = sb_count(blocks);
   for (int i = 0; i < count; i++) {
     filter_block(&blocks[i], features);
   }
 }
 
-static void filter_exp(AsgExp *exp, rax *features);
-
-static void filter_exp_sb(AsgExp *exps, rax *features) {
+static void filter_exp_sb(AsgExp *exps, const OoFeatureSet *features) {
   int count = sb_count(exps);
   for (int i = 0; i < count; i++) {
     filter_exp(&exps[i], features);
   }
 }
 
-static void filter_exp(AsgExp *exp, rax *features) {
+static void filter_exp(AsgExp *exp, const OoFeatureSet *features) {
   switch (exp->tag) {
     case EXP_REF:
       filter_exp(exp->ref, features);
@@ -166,32 +201,23 @@ static void filter_exp(AsgExp *exp, rax *features) {
   }
 }
 
-void oo_filter_cc(AsgFile *asg, rax *features) {
-  AsgMeta **new_attrs = NULL;
-  AsgItem *new_items = NULL;
-
-  int i;
-  size_t copied = 0;
+void oo_filter_cc(AsgFile *asg, const OoFeatureSet *features) {
   int count = sb_count(asg->items);
-  for (i = 0; i < count; i++) {
-    if (should_stay(asg->attrs[i], features)) {
-      sb_add(new_attrs, 1);
-      new_attrs[copied] = asg->attrs[i];
-      sb_add(new_items, 1);
-      new_items[copied] = asg->items[i];
-
-      if (new_items[copied].tag == ITEM_FUN) {
-        filter_block(&new_items[copied].fun.body, features);
-      }
-      copied += 1;
-    } else {
-      free_sb_meta(asg->attrs[i]);
-      free_inner_item(asg->items[i]);
+  for (int i = 0; i < count; i++) {
+    asg->items[i].disabled = !oo_cc_enabled(asg->attrs[i], features);
+    if (asg->items[i].disabled) {
+      continue;
     }
-  }
 
-  sb_free(asg->attrs);
-  asg->attrs = new_attrs;
-  sb_free(asg->items);
-  asg->items = new_items;
+    switch (asg->items[i].tag) {
+      case ITEM_VAL:
+        filter_exp(&asg->items[i].val.exp, features);
+        break;
+      case ITEM_FUN:
+        filter_block(&asg->items[i].fun.body, features);
+        break;
+      default:
+        break;
+    }
+  }
 }
@@ -1,11 +1,48 @@
 #ifndef OO_CC_H
 #define OO_CC_H
 
+#include <stdint.h>
+
 #include "asg.h"
 #include "rax.h"
 
-// Removes items fom the asg whose cc (conditional compilation) attributes don't
-// match the given set of features.
-void oo_filter_cc(AsgFile *asg, rax *features);
+// Feature id of attributes that are not (resolved) cc attributes.
+#define OO_FEATURE_NONE UINT32_MAX
+
+// Assigns dense ids to feature names, so that sets of features can be bitsets.
+typedef struct OoFeatureTable {
+  rax *ids; // feature names (without quotes) to ids, stored as uintptr_t
+  uint32_t count;
+} OoFeatureTable;
+
+void oo_features_init(OoFeatureTable *table);
+// Returns the id of the feature of the given name, assigning a new one if needed.
+uint32_t oo_features_intern(OoFeatureTable *table, const char *name, size_t len);
+void oo_features_free(OoFeatureTable *table);
+
+// A set of features, as a bitset indexed by feature ids.
+typedef struct OoFeatureSet {
+  uint64_t *words; // stretchy buffer, missing words are all zero
+} OoFeatureSet;
+
+// Converts a rax whose keys are feature names into a set of feature ids,
+// interning all names into the table.
+OoFeatureSet oo_feature_set_compile(OoFeatureTable *table, rax *features);
+bool oo_feature_set_has(const OoFeatureSet *set, uint32_t feature);
+void oo_feature_set_free(OoFeatureSet set);
+
+// Whether all cc (conditional compilation) attributes in the given stretchy
+// buffer of attributes have a feature in the given set. If features is NULL,
+// everything is enabled. cc attributes that were not resolved to a feature id
+// are ignored.
+bool oo_cc_enabled(AsgMeta *attrs, const OoFeatureSet *features);
+
+// Marks the items and block expressions of the asg whose cc (conditional
+// compilation) attributes don't match the given set of features as disabled,
+// and all others as enabled. Nodes are never moved or freed, so this can be
+// applied repeatedly with different feature sets to the same asg.
+void oo_filter_cc(AsgFile *asg, const OoFeatureSet *features);
+// Like oo_filter_cc, but for a single block (e.g. a lazily parsed function body).
+void oo_filter_cc_block(AsgBlock *block, const OoFeatureSet *features);
 
 #endif
@@ -3,18 +3,31 @@
 #endif
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <libgen.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 
+#include "asg_cache.h"
 #include "context.h"
+#include "eval.h"
+#include "layout.h"
 #include "parser.h"
 #include "rax.h"
 #include "cc.h"
 #include "stretchy_buffer.h"
 #include "util.h"
 
+// Shrinks a non-empty stretchy buffer to its first n elements.
+#define sb_truncate(a, n) (stb__sbn(a) = (n))
+
 bool is_type_binding(AsgBinding b) {
   return b.tag == BINDING_TYPE ||
   b.tag == BINDING_SUM_TYPE ||
@@ -22,7 +35,36 @@ bool is_type_binding(AsgBinding b) {
   b.tag == BINDING_PRIMITIVE;
 }
 
-static void print_location(Str loc, Str file) {
+size_t asg_position(const AsgSid *declared, Str name) {
+  for (int i = 0; i < sb_count((AsgSid *) declared); i++) {
+    if (str_eq(declared[i].str, name)) {
+      return i;
+    }
+  }
+  return ASG_NO_POSITION;
+}
+
+size_t *asg_positions(const AsgSid *declared, const AsgSid *used, int *missing) {
+  size_t *positions = NULL;
+  *missing = -1;
+  for (int i = 0; i < sb_count((AsgSid *) used); i++) {
+    size_t position = asg_position(declared, used[i].str);
+    for (int j = 0; j < i && position != ASG_NO_POSITION; j++) {
+      if (positions[j] == position) {
+        position = ASG_NO_POSITION;
+      }
+    }
+    if (position == ASG_NO_POSITION) {
+      *missing = i;
+      sb_free(positions);
+      return NULL;
+    }
+    sb_push(positions, position);
+  }
+  return positions;
+}
+
+static void print_location(FILE *f, Str loc, Str file) {
   size_t line = 0;
   size_t col = 0;
 
@@ -39,71 +81,92 @@ static void print_location(Str loc, Str file) {
     }
   }
 
-  printf("line %zu, col %zu\n", line, col);
+  fprintf(f, "line %zu, col %zu\n", line, col);
 }
 
-void err_print(OoError *err) {
+void err_fprint(FILE *f, OoError *err) {
   switch (err->tag) {
     case OO_ERR_NONE:
-      printf("%s\n", "no error");
+      fprintf(f, "%s\n", "no error");
       break;
     case OO_ERR_SYNTAX:
       break;
     case OO_ERR_FILE:
-      printf("%s\n", "file error");
+      fprintf(f, "%s\n", "file error");
       break;
     case OO_ERR_CYCLIC_IMPORTS:
-      printf("%s\n", "cyclic imports error");
+      fprintf(f, "%s\n", "cyclic imports error");
       break;
     case OO_ERR_DUP_ID_ITEM:
-      printf("%s\n", "duplicate item id error");
+      fprintf(f, "%s\n", "duplicate item id error");
       break;
     case OO_ERR_DUP_ID_ITEM_USE:
-      printf("%s\n", "duplicate item id due to use error");
+      fprintf(f, "%s\n", "duplicate item id due to use error");
       break;
     case OO_ERR_INVALID_BRANCH:
-      printf("%s\n", "invalid branch error");
+      fprintf(f, "%s\n", "invalid branch error");
       break;
     case OO_ERR_NONEXISTING_SID_USE:
-      printf("%s\n", "nonexisting sid use error");
+      fprintf(f, "%s\n", "nonexisting sid use error");
       break;
     case OO_ERR_NONEXISTING_SID:
-      printf("%s\n", "nonexisting sid error");
+      fprintf(f, "%s\n", "nonexisting sid error");
       break;
     case OO_ERR_ID_NOT_A_NS:
-      printf("%s\n", "id is not a namespace error");
+      fprintf(f, "%s\n", "id is not a namespace error");
       break;
     case OO_ERR_ID_NOT_IN_NS:
-      printf("%s\n", "id is not in namespace error");
+      fprintf(f, "%s\n", "id is not in namespace error");
       break;
     case OO_ERR_BINDING_NOT_TYPE:
-      printf("%s\n", "binding is not a type error");
+      fprintf(f, "%s\n", "binding is not a type error");
       break;
     case OO_ERR_BINDING_NOT_EXP:
-      printf("%s\n", "binding is not an expression error");
+      fprintf(f, "%s\n", "binding is not an expression error");
       break;
     case OO_ERR_DUP_ID_SCOPE:
-      printf("%s\n", "duplicate id in scope error");
+      fprintf(f, "%s\n", "duplicate id in scope error");
       break;
     case OO_ERR_BINDING_NOT_SUMMAND:
-      printf("%s\n", "binding is not a summand error");
+      fprintf(f, "%s\n", "binding is not a summand error");
       break;
     case OO_ERR_NOT_CONST_EXP:
-      printf("%s\n", "invalid top level val (not a constant expression) error");
+      fprintf(f, "%s\n", "invalid top level val (not a constant expression) error");
       break;
     case OO_ERR_WRONG_NUMBER_OF_TYPE_ARGS:
-      printf("%s\n", "wrong number of type args error");
+      fprintf(f, "%s\n", "wrong number of type args error");
       break;
     case OO_ERR_HIGHER_ORDER_TYPE_ARG:
-      printf("%s\n", "higher order type arg error");
+      fprintf(f, "%s\n", "higher order type arg error");
       break;
     case OO_ERR_NAMED_TYPE_APP_SID:
-      printf("%s\n", "named type application sid error");
+      fprintf(f, "%s\n", "named type application sid error");
+      break;
+    case OO_ERR_CYCLIC_ALIAS:
+      fprintf(f, "%s\n", "cyclic type alias error");
+      break;
+    case OO_ERR_NO_LAYOUT:
+      fprintf(f, "%s\n", "type without layout error");
+      break;
+    case OO_ERR_CONST_ARITHMETIC:
+      fprintf(f, "%s\n", "constant arithmetic error");
+      break;
+    case OO_ERR_TYPE_MISMATCH:
+      fprintf(f, "%s\n", "type mismatch error");
+      break;
+    case OO_ERR_NOT_CONST_REPEAT:
+      fprintf(f, "%s\n", "non-constant repetition error");
+      break;
+    case OO_ERR_SUMMAND_FIELD:
+      fprintf(f, "%s\n", "summand field error");
+      break;
+    case OO_ERR_IFACE_VAL:
+      fprintf(f, "%s\n", "interface val error");
       break;
   }
 
   if (err->tag != OO_ERR_NONE && err->tag != OO_ERR_SYNTAX && err->tag != OO_ERR_FILE) {
-    printf("In file %s\n", err->asg->path);
+    fprintf(f, "In file %s\n", err->asg->path);
   }
 
   switch (err->tag) {
@@ -111,141 +174,183 @@ void err_print(OoError *err) {
     case OO_ERR_FILE:
       break;
     case OO_ERR_SYNTAX:
-      printf("In file %s\n", err->parser.path);
+      fprintf(f, "In file %s\n", err->parser.path);
       switch (err->parser.tag) {
         case ERR_NONE:
           abort();
           break;
         case ERR_SID:
-          printf("syntax error parsing a simple identifier\n");
+          fprintf(f, "syntax error parsing a simple identifier\n");
           break;
         case ERR_ID:
-          printf("syntax error parsing an identifier\n");
+          fprintf(f, "syntax error parsing an identifier\n");
           break;
         case ERR_MACRO_INV:
-          printf("syntax error parsing a macro invocation\n");
+          fprintf(f, "syntax error parsing a macro invocation\n");
           break;
         case ERR_LITERAL:
-          printf("syntax error parsing a literal\n");
+          fprintf(f, "syntax error parsing a literal\n");
           break;
         case ERR_SIZE_OF:
-          printf("syntax error parsing a sizeof\n");
+          fprintf(f, "syntax error parsing a sizeof\n");
           break;
         case ERR_ALIGN_OF:
-          printf("syntax error parsing an alignof\n");
+          fprintf(f, "syntax error parsing an alignof\n");
           break;
         case ERR_REPEAT:
-          printf("syntax error parsing a repeat\n");
+          fprintf(f, "syntax error parsing a repeat\n");
           break;
         case ERR_BIN_OP:
-          printf("syntax error parsing a binary operator\n");
+          fprintf(f, "syntax error parsing a binary operator\n");
           break;
         case ERR_ASSIGN_OP:
-          printf("syntax error parsing an assingment operator\n");
+          fprintf(f, "syntax error parsing an assingment operator\n");
           break;
         case ERR_TYPE:
-          printf("syntax error parsing a type\n");
+          fprintf(f, "syntax error parsing a type\n");
           break;
         case ERR_SUMMAND:
-          printf("syntax error parsing a summand\n");
+          fprintf(f, "syntax error parsing a summand\n");
           break;
         case ERR_PATTERN:
-          printf("syntax error parsing a pattern\n");
+          fprintf(f, "syntax error parsing a pattern\n");
           break;
         case ERR_EXP:
-          printf("syntax error parsing an expression\n");
+          fprintf(f, "syntax error parsing an expression\n");
           break;
         case ERR_BLOCK:
-          printf("syntax error parsing a block\n");
+          fprintf(f, "syntax error parsing a block\n");
           break;
         case ERR_ATTR:
-          printf("syntax error parsing an attribute\n");
+          fprintf(f, "syntax error parsing an attribute\n");
           break;
         case ERR_META:
-          printf("syntax error parsing a meta item\n");
+          fprintf(f, "syntax error parsing a meta item\n");
           break;
         case ERR_USE_TREE:
-          printf("syntax error parsing a use tree\n");
+          fprintf(f, "syntax error parsing a use tree\n");
           break;
         case ERR_ITEM:
-          printf("syntax error parsing an item\n");
+          fprintf(f, "syntax error parsing an item\n");
           break;
         case ERR_FILE:
-          printf("syntax error parsing a file\n");
+          fprintf(f, "syntax error parsing a file\n");
           break;
       }
       if (token_type_error(err->parser.tt) != NULL) {
-        printf("%s\n", token_type_error(err->parser.tt));
+        fprintf(f, "%s\n", token_type_error(err->parser.tt));
       } else {
-        printf("Unexpected token: %s\n", token_type_name(err->parser.tt));
+        fprintf(f, "Unexpected token: %s\n", token_type_name(err->parser.tt));
       }
-      print_location(str_new(err->parser.src, 0), str_new(err->parser.full_src, strlen(err->parser.full_src)));
+      print_location(f, str_new(err->parser.src, 0), str_new(err->parser.full_src, strlen(err->parser.full_src)));
       break;
     case OO_ERR_CYCLIC_IMPORTS:
-      print_location(err->cyclic_import->str, err->asg->str);
-      str_print(err->cyclic_import->str);
+      print_location(f, err->cyclic_import->str, err->asg->str);
+      str_fprint(f, err->cyclic_import->str);
       break;
     case OO_ERR_DUP_ID_ITEM:
-      print_location(err->dup_item->str, err->asg->str);
-      str_print(err->dup_item->str);
+      print_location(f, err->dup_item->str, err->asg->str);
+      str_fprint(f, err->dup_item->str);
       break;
     case OO_ERR_DUP_ID_ITEM_USE:
-      print_location(err->dup_item_use->str, err->asg->str);
-      str_print(err->dup_item_use->str);
+      print_location(f, err->dup_item_use->str, err->asg->str);
+      str_fprint(f, err->dup_item_use->str);
       break;
     case OO_ERR_INVALID_BRANCH:
-      print_location(err->invalid_branch->str, err->asg->str);
-      str_print(err->invalid_branch->str);
+      print_location(f, err->invalid_branch->str, err->asg->str);
+      str_fprint(f, err->invalid_branch->str);
       break;
     case OO_ERR_NONEXISTING_SID_USE:
-      print_location(err->nonexisting_sid_use->str, err->asg->str);
-      str_print(err->nonexisting_sid_use->str);
+      print_location(f, err->nonexisting_sid_use->str, err->asg->str);
+      str_fprint(f, err->nonexisting_sid_use->str);
       break;
     case OO_ERR_NONEXISTING_SID:
-      print_location(err->nonexisting_sid->str, err->asg->str);
-      str_print(err->nonexisting_sid->str);
+      print_location(f, err->nonexisting_sid->str, err->asg->str);
+      str_fprint(f, err->nonexisting_sid->str);
       break;
     case OO_ERR_ID_NOT_A_NS:
-      print_location(err->id_not_a_ns->str, err->asg->str);
-      str_print(err->id_not_a_ns->str);
+      print_location(f, err->id_not_a_ns->str, err->asg->str);
+      str_fprint(f, err->id_not_a_ns->str);
       break;
     case OO_ERR_ID_NOT_IN_NS:
-      print_location(err->id_not_in_ns->str, err->asg->str);
-      str_print(err->id_not_in_ns->str);
+      print_location(f, err->id_not_in_ns->str, err->asg->str);
+      str_fprint(f, err->id_not_in_ns->str);
       break;
     case OO_ERR_BINDING_NOT_TYPE:
-      print_location(err->binding_not_type->str, err->asg->str);
-      str_print(err->binding_not_type->str);
+      print_location(f, err->binding_not_type->str, err->asg->str);
+      str_fprint(f, err->binding_not_type->str);
       break;
     case OO_ERR_BINDING_NOT_EXP:
-      print_location(err->binding_not_exp->str, err->asg->str);
-      str_print(err->binding_not_exp->str);
+      print_location(f, err->binding_not_exp->str, err->asg->str);
+      str_fprint(f, err->binding_not_exp->str);
       break;
     case OO_ERR_DUP_ID_SCOPE:
-      print_location(err->dup_id_scope, err->asg->str);
-      str_print(err->dup_id_scope);
+      print_location(f, err->dup_id_scope, err->asg->str);
+      str_fprint(f, err->dup_id_scope);
       break;
     case OO_ERR_BINDING_NOT_SUMMAND:
-      print_location(err->binding_not_summand->str, err->asg->str);
-      str_print(err->binding_not_summand->str);
+      print_location(f, err->binding_not_summand->str, err->asg->str);
+      str_fprint(f, err->binding_not_summand->str);
       break;
     case OO_ERR_NOT_CONST_EXP:
-      print_location(err->not_const_exp->str, err->asg->str);
-      str_print(err->not_const_exp->str);
+      print_location(f, err->not_const_exp->str, err->asg->str);
+      str_fprint(f, err->not_const_exp->str);
       break;
     case OO_ERR_WRONG_NUMBER_OF_TYPE_ARGS:
-      print_location(err->wrong_number_of_type_args->str, err->asg->str);
-      str_print(err->wrong_number_of_type_args->str);
+      print_location(f, err->wrong_number_of_type_args->str, err->asg->str);
+      str_fprint(f, err->wrong_number_of_type_args->str);
       break;
     case OO_ERR_HIGHER_ORDER_TYPE_ARG:
-      print_location(err->higher_order_type_arg->str, err->asg->str);
-      str_print(err->higher_order_type_arg->str);
+      print_location(f, err->higher_order_type_arg->str, err->asg->str);
+      str_fprint(f, err->higher_order_type_arg->str);
       break;
     case OO_ERR_NAMED_TYPE_APP_SID:
-      print_location(err->named_type_app_sid->str, err->asg->str);
-      str_print(err->named_type_app_sid->str);
+      print_location(f, err->named_type_app_sid->str, err->asg->str);
+      str_fprint(f, err->named_type_app_sid->str);
+      break;
+    case OO_ERR_CYCLIC_ALIAS:
+      print_location(f, err->cyclic_alias->str, err->asg->str);
+      str_fprint(f, err->cyclic_alias->str);
+      break;
+    case OO_ERR_NO_LAYOUT:
+      print_location(f, err->no_layout->str, err->asg->str);
+      str_fprint(f, err->no_layout->str);
+      break;
+    case OO_ERR_CONST_ARITHMETIC:
+      print_location(f, err->const_arithmetic, err->asg->str);
+      str_fprint(f, err->const_arithmetic);
+      break;
+    case OO_ERR_TYPE_MISMATCH:
+      print_location(f, err->type_mismatch->str, err->asg->str);
+      str_fprint(f, err->type_mismatch->str);
       break;
+    case OO_ERR_NOT_CONST_REPEAT:
+      print_location(f, err->not_const_repeat->str, err->asg->str);
+      str_fprint(f, err->not_const_repeat->str);
+      break;
+    case OO_ERR_SUMMAND_FIELD:
+      print_location(f, err->summand_field->str, err->asg->str);
+      str_fprint(f, err->summand_field->str);
+      break;
+    case OO_ERR_IFACE_VAL:
+      print_location(f, err->iface_val->sid.str, err->asg->str);
+      str_fprint(f, err->iface_val->sid.str);
+      break;
+  }
+}
+
+void err_print(OoError *err) {
+  err_fprint(stdout, err);
+}
+
+AsgFile *oo_cx_file_of(OoContext *cx, Str s) {
+  for (int i = 0; i < sb_count(cx->files); i++) {
+    Str src = cx->files[i]->str;
+    if (s.start >= src.start && s.start < src.start + src.len) {
+      return cx->files[i];
+    }
   }
+  return NULL;
 }
 
 static bool is_ns_uninitialized(AsgNS *ns) {
@@ -256,8 +361,36 @@ static bool is_ns_fully_initialized(AsgNS *ns) {
   return (uint) sb_count(ns->bindings) == raxSize(ns->bindings_by_sid);
 }
 
-static bool is_ns_initializing(AsgNS *ns) {
-  return !is_ns_uninitialized(ns) && !is_ns_fully_initialized(ns);
+static void *cx_rax_malloc(void *pool, size_t size) {
+  return oo_pool_alloc(pool, size);
+}
+
+static void *cx_rax_realloc(void *pool, void *ptr, size_t size) {
+  return oo_pool_realloc(pool, ptr, size);
+}
+
+static void cx_rax_free(void *pool, void *ptr) {
+  oo_pool_free(pool, ptr);
+}
+
+// State of a thread binding the files of a wave, see coarse_waves.
+typedef struct CoarseWorker {
+  OoContext *cx;
+  raxAllocator *alloc; // backs all raxes created by the thread
+  rax *wave; // the files of the wave (keyed by address), read-only
+  AsgFile **files; // the files of the wave
+  atomic_int *next; // index of the next file of the wave to bind, shared by all workers
+  AsgFile **edges; // stretchy buffer of (file, dependent) pairs to record after the wave
+  AsgFile **failed; // stretchy buffer of files whose binding failed or was blocked
+} CoarseWorker;
+
+// The worker of the current thread, NULL unless it binds the files of a wave.
+static _Thread_local CoarseWorker *worker = NULL;
+
+// Creates a rax whose nodes live in the rax_pool of the context (or in the pool
+// of the current worker thread).
+static rax *cx_rax_new(OoContext *cx) {
+  return raxNewWithAllocator(worker != NULL ? worker->alloc : &cx->rax_alloc);
 }
 
 void oo_cx_init(OoContext *cx, const char *mods, const char *deps) {
@@ -266,9 +399,334 @@ void oo_cx_init(OoContext *cx, const char *mods, const char *deps) {
   cx->files = NULL;
   cx->dirs = NULL;
   cx->sources = NULL;
+  cx->dep_ifaces = NULL;
+  cx->mappings = NULL;
+  oo_features_init(&cx->features);
+  oo_types_init(&cx->types);
+  cx->layouts = raxNew();
+  cx->consts = raxNew();
+  oo_queries_init(&cx->queries);
+  cx->items_by_attr = NULL;
+  cx->lazy_bodies = false;
+  cx->lazy_deps = false;
+  cx->streaming = false;
+  cx->cache_dir = NULL;
+  cx->parse_enabled.words = NULL;
+  cx->filter.words = NULL;
+  cx->filtered = false;
+
+  oo_pool_init(&cx->rax_pool);
+  cx->rax_alloc.malloc = cx_rax_malloc;
+  cx->rax_alloc.realloc = cx_rax_realloc;
+  cx->rax_alloc.free = cx_rax_free;
+  cx->rax_alloc.ctx = &cx->rax_pool;
+  cx->threads = 0;
+  cx->worker_pools = NULL;
+  cx->released_syntax = 0;
+
+  cx->attr_ids = cx_rax_new(cx);
+}
+
+// Adds the items of the file to the attribute index of the context.
+static void index_attrs(OoContext *cx, AsgFile *asg) {
+  int count = sb_count(asg->items);
+  for (int i = 0; i < count; i++) {
+    for (int j = 0; j < sb_count(asg->attrs[i]); j++) {
+      Str name = asg->attrs[i][j].name;
+      void *id = raxFind(cx->attr_ids, name.start, name.len);
+      if (id == raxNotFound) {
+        id = (void *) (uintptr_t) sb_count(cx->items_by_attr);
+        raxInsert(cx->attr_ids, name.start, name.len, id, NULL);
+        sb_push(cx->items_by_attr, NULL);
+      }
+
+      AsgItem ***items = &cx->items_by_attr[(uintptr_t) id];
+      if (sb_count(*items) == 0 || sb_last(*items) != &asg->items[i]) {
+        sb_push(*items, &asg->items[i]);
+      }
+    }
+  }
+}
+
+// Sets up a file that has not been read yet, taking ownership of the path.
+static void init_unloaded_file(AsgFile *asg, const char *path) {
+  asg->path = path;
+  asg->str.start = NULL;
+  asg->str.len = 0;
+  asg->items = NULL;
+  asg->attrs = NULL;
+  asg->loaded = false;
+  asg->coarse_bound = false;
+  asg->fine_bound = false;
+  asg->kind_checked = false;
+  asg->typed = false;
+  asg->dependents = NULL;
+  asg->iface = false;
+  asg->ns.bindings = NULL;
+  asg->ns.bindings_by_sid = NULL;
+  asg->ns.tag = NS_FILE;
+  asg->ns.file = asg;
+}
+
+// Hashes the parse options into cx->cache_config. features are the names
+// passed to oo_cx_parse (NULL to keep everything).
+static void compute_cache_config(OoContext *cx, rax *features) {
+  OoSha256 h;
+  oo_sha256_init(&h);
+  oo_sha256_update(&h, OO_ASG_CACHE_VERSION, sizeof(OO_ASG_CACHE_VERSION));
+  uint8_t options[2] = {cx->pcx.lazy_bodies, features != NULL};
+  oo_sha256_update(&h, options, sizeof(options));
+
+  if (features != NULL) {
+    // rax iterates in lexicographic order, so equal sets hash equally
+    raxIterator it;
+    raxStart(&it, features);
+    raxSeek(&it, "^", NULL, 0);
+    while (raxNext(&it)) {
+      oo_sha256_update(&h, it.key, it.key_len);
+      oo_sha256_update(&h, "", 1);
+    }
+    raxStop(&it);
+  }
+
+  oo_sha256_final(&h, cx->cache_config);
+}
+
+// Returns the (owned) path of the cache entry for the given source text.
+static char *cache_entry_path(OoContext *cx, const char *src, size_t len) {
+  OoSha256 h;
+  uint8_t digest[OO_SHA256_LEN];
+  oo_sha256_init(&h);
+  oo_sha256_update(&h, cx->cache_config, OO_SHA256_LEN);
+  oo_sha256_update(&h, src, len);
+  oo_sha256_final(&h, digest);
+
+  size_t dir_len = strlen(cx->cache_dir);
+  char *entry = malloc(dir_len + 1 + 2 * OO_SHA256_LEN + 1);
+  memcpy(entry, cx->cache_dir, dir_len);
+  entry[dir_len] = '/';
+  oo_sha256_hex(digest, entry + dir_len + 1);
+  return entry;
+}
+
+// Tries to load the asg from a cache entry. Missing or unreadable entries
+// are simply cache misses, the file is parsed instead.
+static bool cache_load(OoContext *cx, const char *entry, const char *src, size_t src_len, AsgFile *asg) {
+  FILE *f = fopen(entry, "rb");
+  if (f == NULL) {
+    return false;
+  }
+
+  char *data = NULL;
+  bool ok = false;
+  if (fseek(f, 0, SEEK_END) == 0) {
+    long len = ftell(f);
+    if (len > 0) {
+      rewind(f);
+      data = malloc(len);
+      if (fread(data, len, 1, f) == 1) {
+        ok = oo_asg_deserialize(data, len, src, src_len, asg, cx->pcx.features);
+      }
+    }
+  }
+
+  free(data);
+  fclose(f);
+  return ok;
+}
+
+// Writes a cache entry for a freshly parsed asg. The entry is written to a
+// temporary file first, so that concurrent runs never see partial entries.
+// Failures are ignored, they merely cost a parse next time.
+static void cache_store(const char *entry, AsgFile *asg, const char *src) {
+  char *data = oo_asg_serialize(asg, src);
+
+  size_t entry_len = strlen(entry);
+  char *tmp = malloc(entry_len + 32);
+  sprintf(tmp, "%s.%ld.tmp", entry, (long) getpid());
+
+  FILE *f = fopen(tmp, "wb");
+  if (f != NULL) {
+    bool ok = fwrite(data, sb_count(data), 1, f) == 1;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp, entry) != 0) {
+      remove(tmp);
+    }
+  }
+
+  free(tmp);
+  sb_free(data);
+}
+
+// Maps an interface file set up by init_unloaded_file and decodes its asg.
+// Malformed interface files are reported as OO_ERR_FILE.
+static void load_iface(OoContext *cx, OoError *err, AsgFile *asg) {
+  int fd = open(asg->path, O_RDONLY);
+  if (fd < 0) {
+    err->tag = OO_ERR_FILE;
+    err->file = asg->path;
+    return;
+  }
+
+  struct stat st;
+  void *addr = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (addr == MAP_FAILED) {
+    err->tag = OO_ERR_FILE;
+    err->file = asg->path;
+    return;
+  }
+
+  OoMapping *m = sb_add(cx->mappings, 1);
+  m->addr = addr;
+  m->len = st.st_size;
+
+  const char *path = asg->path;
+  if (!oo_iface_deserialize(addr, st.st_size, asg, cx->pcx.features)) {
+    err->tag = OO_ERR_FILE;
+    err->file = path;
+    return;
+  }
+  asg->path = path;
+  asg->loaded = true;
+  index_attrs(cx, asg);
+  if (cx->filtered) {
+    oo_filter_cc(asg, &cx->filter);
+  }
+}
+
+// Maps the source of a file rather than copying it, so that its pages can be
+// released once the file has been streamed (see oo_cx_stream). The parser
+// needs a terminating 0 byte, which the mapping only provides if the file does
+// not end on a page boundary. Returns NULL for such files and on failure, they
+// are read instead.
+static const char *map_source(OoContext *cx, const char *path, long *len) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat st;
+  void *addr = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size % sysconf(_SC_PAGESIZE) != 0) {
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return NULL;
+  }
+
+  OoMapping *m = sb_add(cx->mappings, 1);
+  m->addr = addr;
+  m->len = st.st_size;
+  *len = st.st_size;
+  return addr;
+}
+
+// Reads the source of a file into cx->sources.
+static const char *read_source(OoContext *cx, OoError *err, const char *path, long *len) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    err->tag = OO_ERR_FILE;
+    err->file = path;
+    return NULL;
+  }
+  if (fseek(f, 0, SEEK_END)) {
+    err->tag = OO_ERR_FILE;
+    err->file = path;
+    fclose(f);
+    return NULL;
+  }
+  long fsize = ftell(f);
+  if (fsize < 0) {
+    err->tag = OO_ERR_FILE;
+    err->file = path;
+    fclose(f);
+    return NULL;
+  }
+  rewind(f);
+
+  char **src = sb_add(cx->sources, 1);
+  *src = malloc(fsize + 1);
+  fread(*src, fsize, 1, f);
+  if (ferror(f)) {
+    err->tag = OO_ERR_FILE;
+    err->file = path;
+    fclose(f);
+    return NULL;
+  }
+  (*src)[fsize] = 0;
+
+  if (fclose(f)) {
+    err->tag = OO_ERR_FILE;
+    err->file = path;
+    return NULL;
+  }
+
+  *len = fsize;
+  return *src;
+}
+
+// Reads and parses a file set up by init_unloaded_file.
+static void load_file(OoContext *cx, OoError *err, AsgFile *asg) {
+  if (asg->iface) {
+    load_iface(cx, err, asg);
+    return;
+  }
+
+  long fsize;
+  const char *src = cx->streaming ? map_source(cx, asg->path, &fsize) : NULL;
+  if (src == NULL) {
+    src = read_source(cx, err, asg->path, &fsize);
+    if (src == NULL) {
+      return;
+    }
+  }
+
+  const char *path = asg->path;
+  char *entry = NULL;
+  if (cx->cache_dir != NULL) {
+    entry = cache_entry_path(cx, src, fsize);
+    if (cache_load(cx, entry, src, fsize, asg)) {
+      free(entry);
+      asg->path = path;
+      asg->loaded = true;
+      index_attrs(cx, asg);
+      if (cx->filtered) {
+        oo_filter_cc(asg, &cx->filter);
+      }
+      return;
+    }
+  }
+
+  parse_file(src, &err->parser, asg, &cx->pcx);
+  asg->path = path;
+  if (err->parser.tag != ERR_NONE) {
+    err->tag = OO_ERR_SYNTAX;
+    err->parser.path = path;
+    asg->items = NULL;
+    asg->attrs = NULL;
+    free(entry);
+    return;
+  }
+  if (entry != NULL) {
+    cache_store(entry, asg, src);
+    free(entry);
+  }
+  asg->loaded = true;
+  index_attrs(cx, asg);
+  if (cx->filtered) {
+    oo_filter_cc(asg, &cx->filter);
+  }
 }
 
-static void parse_handle_dir(const char *path, AsgNS *ns, OoContext *cx, OoError *err, rax *features) {
+// Adds the directory and its contents to the namespace ns. Files are only
+// parsed if lazy is false, otherwise they are loaded by prepare_file. If iface
+// is set, the files are interface files rather than sources.
+static void parse_handle_dir(const char *path, AsgNS *ns, OoContext *cx, OoError *err, bool lazy, bool iface) {
   DIR *dp;
   struct dirent *ep;
   size_t path_len = strlen(path);
@@ -293,6 +751,7 @@ static void parse_handle_dir(const char *path, AsgNS *ns, OoContext *cx, OoError
 
   ns->bindings[0].tag = BINDING_NS;
   ns->bindings[0].private = true;
+  ns->bindings[0].pub = false;
   ns->bindings[0].file = NULL;
   ns->bindings[0].ns = ns;
   raxInsert(ns->bindings_by_sid, "mod", 3, (void *) &ns->bindings[0], NULL);
@@ -315,20 +774,18 @@ static void parse_handle_dir(const char *path, AsgNS *ns, OoContext *cx, OoError
     // printf("  ep->d_name: %s\n", ep->d_name);
 
     AsgNS *dir_ns;
-    FILE *f;
-    char **src;
     AsgFile *asg;
     switch (ep->d_type) {
       case DT_DIR:
         sb_push(cx->dirs, malloc(sizeof(AsgNS)));
         dir_ns = cx->dirs[sb_count(cx->dirs) - 1];
         dir_ns->bindings = NULL;
-        dir_ns->bindings_by_sid = raxNew();
-        dir_ns->pub_bindings_by_sid = NULL;
+        dir_ns->bindings_by_sid = cx_rax_new(cx);
         dir_ns->tag = NS_DIR;
 
         inner_binding->tag = BINDING_NS;
         inner_binding->private = true;
+        inner_binding->pub = true;
         inner_binding->file = NULL;
         inner_binding->ns = dir_ns;
 
@@ -338,70 +795,28 @@ static void parse_handle_dir(const char *path, AsgNS *ns, OoContext *cx, OoError
         // raxShow(ns->bindings_by_sid);
         // printf("\n");
 
-        parse_handle_dir(inner_path, dir_ns, cx, err, features);
+        parse_handle_dir(inner_path, dir_ns, cx, err, lazy, iface);
         free(inner_path);
         if (err->tag != OO_ERR_NONE) {
           goto done;
         }
         break;
       case DT_REG:
-        // printf("  %s\n", "regular file");
-        // printf("  inner_path: %s\n", inner_path);
-        f = fopen(inner_path, "r");
-        if (f == NULL) {
-          err->tag = OO_ERR_FILE;
-          err->file = inner_path;
-          goto done;
-        }
-        if (fseek(f, 0, SEEK_END)) {
-          err->tag = OO_ERR_FILE;
-          err->file = inner_path;
-          fclose(f);
-          goto done;
-        }
-        long fsize = ftell(f);
-        if (fsize < 0) {
-          err->tag = OO_ERR_FILE;
-          err->file = inner_path;
-          fclose(f);
-          goto done;
-        }
-        rewind(f);
-
-        src = sb_add(cx->sources, 1);
-        *src = malloc(fsize + 1);
-        fread(*src, fsize, 1, f);
-        if (ferror(f)) {
-          err->tag = OO_ERR_FILE;
-          err->file = inner_path;
-          fclose(f);
-          goto done;
-        }
-        (*src)[fsize] = 0;
-
-        if (fclose(f)) {
-          err->tag = OO_ERR_FILE;
-          err->file = inner_path;
-          goto done;
-        }
-        // printf("  %s\n", "file ops done");
-        // end file handling
-
         sb_push(cx->files, malloc(sizeof(AsgFile)));
         asg = cx->files[sb_count(cx->files) - 1];
+        init_unloaded_file(asg, inner_path);
+        asg->iface = iface;
 
-        parse_file(*src, &err->parser, asg);
-        if (err->parser.tag != ERR_NONE) {
-          err->tag = OO_ERR_SYNTAX;
-          err->parser.path = inner_path;
-          goto done;
+        if (!lazy) {
+          load_file(cx, err, asg);
+          if (err->tag != OO_ERR_NONE) {
+            goto done;
+          }
         }
-        asg->path = inner_path;
-
-        // oo_filter_cc(asg, features); FIXME filtering changes the addresses of asg nodes, breaking bindings, frees and everything... Solution: Add asg nodes that represent filtered nodes
 
         inner_binding->tag = BINDING_NS;
         inner_binding->private = false;
+        inner_binding->pub = true;
         inner_binding->file = asg;
         inner_binding->ns = &asg->ns;
         raxInsert(ns->bindings_by_sid, ep->d_name, strlen(ep->d_name) - 3 /* removes the .oo extension*/, (void *) inner_binding, NULL);
@@ -424,95 +839,648 @@ void oo_cx_parse(OoContext *cx, OoError *err, rax *features) {
 
   cx->dirs[0] = malloc(sizeof(AsgNS));
   cx->dirs[0]->bindings = NULL;
-  cx->dirs[0]->bindings_by_sid = raxNew();
-  cx->dirs[0]->pub_bindings_by_sid = NULL;
+  cx->dirs[0]->bindings_by_sid = cx_rax_new(cx);
   cx->dirs[0]->tag = NS_MODS;
 
   cx->dirs[1] = malloc(sizeof(AsgNS));
   cx->dirs[1]->bindings = NULL;
-  cx->dirs[1]->bindings_by_sid = raxNew();
-  cx->dirs[1]->pub_bindings_by_sid = NULL;
+  cx->dirs[1]->bindings_by_sid = cx_rax_new(cx);
   cx->dirs[1]->tag = NS_DEPS;
 
-  parse_handle_dir(cx->mods, cx->dirs[0], cx, err, features);
+  cx->pcx.features = &cx->features;
+  cx->pcx.enabled = NULL;
+  cx->pcx.lazy_bodies = cx->lazy_bodies || cx->streaming;
+  if (features != NULL) {
+    cx->parse_enabled = oo_feature_set_compile(&cx->features, features);
+    cx->pcx.enabled = &cx->parse_enabled;
+  }
+  if (cx->cache_dir != NULL) {
+    compute_cache_config(cx, features);
+  }
+
+  parse_handle_dir(cx->mods, cx->dirs[0], cx, err, false, false);
   if (err->tag != OO_ERR_NONE) {
     return;
   }
 
-  parse_handle_dir(cx->deps, cx->dirs[1], cx, err, features);
+  if (cx->dep_ifaces != NULL) {
+    parse_handle_dir(cx->dep_ifaces, cx->dirs[1], cx, err, cx->lazy_deps, true);
+  } else {
+    parse_handle_dir(cx->deps, cx->dirs[1], cx, err, cx->lazy_deps, false);
+  }
 }
 
-void oo_cx_free(OoContext *cx) {
+void oo_cx_filter_cc(OoContext *cx, rax *features) {
+  oo_feature_set_free(cx->filter);
+  cx->filter = oo_feature_set_compile(&cx->features, features);
+  cx->filtered = true;
+
   int count = sb_count(cx->files);
   for (int i = 0; i < count; i++) {
-    free_inner_file(*(cx->files[i]));
-    free(cx->files[i]);
+    oo_filter_cc(cx->files[i], &cx->filter);
   }
-  sb_free(cx->files);
+}
 
-  count = sb_count(cx->dirs);
-  for (int i = 0; i < count; i++) {
-    free_ns(*(cx->dirs[i]));
-    free(cx->dirs[i]);
+void oo_cx_force_body(OoContext *cx, OoError *err, AsgItem *item) {
+  AsgItemFun *fun = &item->fun;
+  if (fun->body_src == NULL) {
+    return;
   }
-  sb_free(cx->dirs);
 
-  count = sb_count(cx->sources);
-  for (int i = 0; i < count; i++) {
-    free((void *) cx->sources[i]);
+  err->parser.full_src = item->asg->str.start;
+  parse_block(fun->body_src, &err->parser, &fun->body, &cx->pcx);
+  if (err->parser.tag != ERR_NONE) {
+    err->tag = OO_ERR_SYNTAX;
+    err->asg = item->asg;
+    err->parser.path = item->asg->path;
+    return;
+  }
+
+  fun->body_src = NULL;
+  if (cx->filtered) {
+    oo_filter_cc_block(&fun->body, &cx->filter);
   }
-  sb_free(cx->sources);
 }
 
-static void file_coarse_bindings(OoContext *cx, OoError *err, AsgFile *asg);
-static void dir_coarse_bindings(OoContext *cx, OoError *err, AsgNS *dir);
-static void resolve_use(AsgUseTree *use, bool pub, AsgNS *ns, AsgNS *parent, Str parent_name, OoContext *cx, OoError *err, AsgFile *asg);
+static void reset_ns(AsgNS *ns) {
+  free_ns(*ns);
+  ns->bindings_by_sid = NULL;
+  ns->bindings = NULL;
+}
 
-void oo_cx_coarse_bindings(OoContext *cx, OoError *err) {
+static void reset_file_analysis(AsgFile *asg) {
+  asg->fine_bound = false;
+  asg->kind_checked = false;
+  asg->typed = false;
+  if (is_ns_uninitialized(&asg->ns)) {
+    return;
+  }
+
+  for (int i = 0; i < sb_count(asg->items); i++) {
+    AsgItem *item = &asg->items[i];
+    switch (item->tag) {
+      case ITEM_TYPE:
+        if (item->type.type.tag == TYPE_SUM) {
+          reset_ns(&item->type.type.sum.ns);
+        } else if (item->type.type.tag == TYPE_GENERIC && item->type.type.generic.inner->tag == TYPE_SUM) {
+          reset_ns(&item->type.type.generic.inner->sum.ns);
+        }
+        item->type.oo_type = NULL; // types live in cx->types
+        item->type.canonical = NULL;
+        break;
+      case ITEM_VAL:
+        item->val.sid.binding.val.oo_type = NULL;
+        break;
+      case ITEM_FUN:
+        item->fun.sid.binding.val.oo_type = NULL;
+        break;
+      case ITEM_FFI_VAL:
+        item->ffi_val.sid.binding.val.oo_type = NULL;
+        break;
+      default:
+        break;
+    }
+  }
+
+  reset_ns(&asg->ns);
+  asg->coarse_bound = false;
+}
+
+// Instantiations, layouts and values of vals may refer to the reset items, so
+// they are computed again on demand. The interned types themselves stay valid.
+static void forget_derived_types(OoContext *cx) {
+  oo_types_forget_instances(&cx->types);
+  oo_cx_forget_layouts(cx);
+  oo_cx_forget_consts(cx);
+}
+
+void oo_cx_reset_analysis(OoContext *cx) {
   int count = sb_count(cx->files);
   for (int i = 0; i < count; i++) {
-    if (is_ns_uninitialized(&cx->files[i]->ns)) {
-      file_coarse_bindings(cx, err, cx->files[i]);
-      if (err->tag != OO_ERR_NONE) {
-        return;
+    reset_file_analysis(cx->files[i]);
+  }
+  oo_queries_clear(&cx->queries);
+  forget_derived_types(cx);
+}
+
+// Frees the syntax of a loaded file (whose analysis has been reset) together
+// with its source, and removes its items from the attribute index.
+static void unload_file(OoContext *cx, AsgFile *asg) {
+  for (int i = 0; i < sb_count(cx->items_by_attr); i++) {
+    AsgItem **items = cx->items_by_attr[i];
+    int kept = 0;
+    for (int j = 0; j < sb_count(items); j++) {
+      if (items[j]->asg != asg) {
+        items[kept] = items[j];
+        kept++;
       }
     }
+    if (items != NULL) {
+      sb_truncate(items, kept);
+    }
+  }
+
+  for (int i = 0; i < sb_count(asg->items); i++) {
+    free_inner_item(asg->items[i]);
+  }
+  sb_free(asg->items);
+  asg->items = NULL;
+  for (int i = 0; i < sb_count(asg->attrs); i++) {
+    free_sb_meta(asg->attrs[i]);
+  }
+  sb_free(asg->attrs);
+  asg->attrs = NULL;
+
+  // The source (or mapping) is found by the start of the file, order does not matter.
+  for (int i = 0; i < sb_count(cx->sources); i++) {
+    if (cx->sources[i] == asg->str.start) {
+      free(cx->sources[i]);
+      cx->sources[i] = sb_last(cx->sources);
+      sb_truncate(cx->sources, sb_count(cx->sources) - 1);
+      break;
+    }
+  }
+  for (int i = 0; i < sb_count(cx->mappings); i++) {
+    const char *addr = cx->mappings[i].addr;
+    if (asg->str.start >= addr && asg->str.start < addr + cx->mappings[i].len) {
+      munmap(cx->mappings[i].addr, cx->mappings[i].len);
+      cx->mappings[i] = sb_last(cx->mappings);
+      sb_truncate(cx->mappings, sb_count(cx->mappings) - 1);
+      break;
+    }
   }
+
+  asg->str = str_new(NULL, 0);
+  asg->loaded = false;
 }
 
-static void prepare_file(OoContext *cx, OoError *err, AsgFile *file, AsgSid *sid) {
-  if (is_ns_initializing(&file->ns)) {
-    err->tag = OO_ERR_CYCLIC_IMPORTS;
-    err->cyclic_import = sid;
-    err->asg = file;
-    return;
-  } else if (is_ns_uninitialized(&file->ns)) {
-    file_coarse_bindings(cx, err, file);
-    if (err->tag != OO_ERR_NONE) {
-      return;
+// Whether a query that is not reached through the functions of the dirty files
+// (a stretchy buffer) is outdated by a reload: layouts are forgotten as a
+// whole, and expressions and locals of the dirty files may have been requested
+// on their own (see oo_cx_exp_type).
+static bool outdated_query(const OoQuery *q, void *data) {
+  AsgFile **dirty = data;
+  Str str;
+  switch (q->kind) {
+    case OO_QUERY_LAYOUT:
+      return true;
+    case OO_QUERY_EXP_TYPE:
+      str = ((const AsgExp *) q->key)->str;
+      break;
+    case OO_QUERY_LOCAL_TYPE:
+      str = ((const AsgPatternId *) q->key)->sid.str;
+      break;
+    default:
+      return false;
+  }
+  for (int i = 0; i < sb_count(dirty); i++) {
+    Str src = dirty[i]->str;
+    if (str.start >= src.start && str.start < src.start + src.len) {
+      return true;
     }
   }
+  return false;
 }
 
-// (Recursively) add all bindings from the given UseTree to the mod.
-static void resolve_use(
-  AsgUseTree *use,
-  bool pub,
-  AsgNS *ns, /* where to put the resolved bindings */
-  AsgNS *parent, /* where to look for the sid */
-  Str parent_name,
-  OoContext *cx,
-  OoError *err,
-  AsgFile *asg) {
-    AsgBinding *b = raxFind(parent->bindings_by_sid, use->sid.str.start, use->sid.str.len);
+void oo_cx_reload(OoContext *cx, OoError *err, AsgFile **changed) {
+  // All files whose analysis may have looked into a changed file, transitively.
+  AsgFile **dirty = NULL;
+  for (int i = 0; i < sb_count(changed); i++) {
+    sb_push(dirty, changed[i]);
+  }
+  for (int i = 0; i < sb_count(dirty); i++) {
+    for (int j = 0; j < sb_count(dirty[i]->dependents); j++) {
+      AsgFile *dependent = dirty[i]->dependents[j];
+      int k = 0;
+      while (k < sb_count(dirty) && dirty[k] != dependent) {
+        k++;
+      }
+      if (k == sb_count(dirty)) {
+        sb_push(dirty, dependent);
+      }
+    }
+  }
 
-    // printf("resolve use for ");
-    // str_print(use->str);
-    // printf(" in %s\n", use->asg->path);
+  // Only the queries about the dirty files and the ones computed from them are
+  // outdated, the bodies of all other files are not checked again. Their keys
+  // must still be valid, so this happens before the changed files are unloaded.
+  for (int i = 0; i < sb_count(dirty); i++) {
+    for (int j = 0; j < sb_count(dirty[i]->items); j++) {
+      if (dirty[i]->items[j].tag == ITEM_FUN) {
+        oo_queries_invalidate(&cx->queries, OO_QUERY_FUN_TYPE, &dirty[i]->items[j].fun);
+        oo_queries_forget_body(&cx->queries, &dirty[i]->items[j].fun);
+      }
+    }
+  }
+  oo_queries_invalidate_where(&cx->queries, outdated_query, dirty);
 
-    if (b == raxNotFound) {
-      err->tag = OO_ERR_NONEXISTING_SID_USE;
-      err->asg = asg;
+  for (int i = 0; i < sb_count(dirty); i++) {
+    reset_file_analysis(dirty[i]);
+  }
+  sb_free(dirty);
+  forget_derived_types(cx);
+
+  for (int i = 0; i < sb_count(changed); i++) {
+    if (changed[i]->loaded) {
+      unload_file(cx, changed[i]);
+      load_file(cx, err, changed[i]);
+      if (err->tag != OO_ERR_NONE) {
+        return;
+      }
+    }
+  }
+}
+
+OoMemStats oo_cx_mem_stats(OoContext *cx) {
+  OoMemStats stats;
+  struct rusage usage;
+  stats.peak_rss = getrusage(RUSAGE_SELF, &usage) == 0 ? (size_t) usage.ru_maxrss * 1024 : 0; // kilobytes on linux
+
+  stats.ns_in_use = cx->rax_pool.in_use;
+  stats.ns_peak = cx->rax_pool.peak;
+  for (int i = 0; i < sb_count(cx->worker_pools); i++) {
+    stats.ns_in_use += cx->worker_pools[i]->pool.in_use;
+    stats.ns_peak += cx->worker_pools[i]->pool.peak;
+  }
+  stats.released_syntax = cx->released_syntax;
+  return stats;
+}
+
+uint32_t oo_cx_attr_id(OoContext *cx, const char *name, size_t len) {
+  void *id = raxFind(cx->attr_ids, name, len);
+  return id == raxNotFound ? OO_ATTR_NONE : (uint32_t) (uintptr_t) id;
+}
+
+AsgItem **oo_cx_items_with_attr(OoContext *cx, const char *name, size_t len) {
+  uint32_t id = oo_cx_attr_id(cx, name, len);
+  return id == OO_ATTR_NONE ? NULL : cx->items_by_attr[id];
+}
+
+void oo_cx_free(OoContext *cx) {
+  // All namespace raxes are released with the pool below, so don't bother
+  // returning their nodes one by one.
+  cx->rax_alloc.free = NULL;
+  for (int i = 0; i < sb_count(cx->worker_pools); i++) {
+    cx->worker_pools[i]->alloc.free = NULL;
+  }
+
+  int count = sb_count(cx->files);
+  for (int i = 0; i < count; i++) {
+    sb_free(cx->files[i]->dependents);
+    free_inner_file(*(cx->files[i]));
+    free(cx->files[i]);
+  }
+  sb_free(cx->files);
+
+  count = sb_count(cx->dirs);
+  for (int i = 0; i < count; i++) {
+    free_ns(*(cx->dirs[i]));
+    free(cx->dirs[i]);
+  }
+  sb_free(cx->dirs);
+
+  count = sb_count(cx->sources);
+  for (int i = 0; i < count; i++) {
+    free((void *) cx->sources[i]);
+  }
+  sb_free(cx->sources);
+
+  count = sb_count(cx->mappings);
+  for (int i = 0; i < count; i++) {
+    munmap(cx->mappings[i].addr, cx->mappings[i].len);
+  }
+  sb_free(cx->mappings);
+
+  oo_features_free(&cx->features);
+  oo_queries_free(&cx->queries);
+  oo_cx_forget_consts(cx);
+  raxFree(cx->consts);
+  oo_cx_forget_layouts(cx);
+  raxFree(cx->layouts);
+  oo_types_free(&cx->types);
+  oo_feature_set_free(cx->parse_enabled);
+  oo_feature_set_free(cx->filter);
+  count = sb_count(cx->items_by_attr);
+  for (int i = 0; i < count; i++) {
+    sb_free(cx->items_by_attr[i]);
+  }
+  sb_free(cx->items_by_attr);
+  oo_pool_release(&cx->rax_pool);
+
+  count = sb_count(cx->worker_pools);
+  for (int i = 0; i < count; i++) {
+    oo_pool_release(&cx->worker_pools[i]->pool);
+    free(cx->worker_pools[i]);
+  }
+  sb_free(cx->worker_pools);
+}
+
+static void file_coarse_bindings(OoContext *cx, OoError *err, AsgFile *asg);
+static void dir_coarse_bindings(OoContext *cx, OoError *err, AsgNS *dir);
+static void resolve_use(AsgUseTree *use, bool pub, AsgNS *ns, AsgNS *parent, Str parent_name, OoContext *cx, OoError *err, AsgFile *asg);
+
+// Records that the analysis of the file from depends on file.
+static void add_dependent(AsgFile *file, AsgFile *from) {
+  if (file == from) {
+    return;
+  }
+
+  int count = sb_count(file->dependents);
+  int i = 0;
+  while (i < count && file->dependents[i] != from) {
+    i++;
+  }
+  if (i == count) {
+    sb_push(file->dependents, from);
+  }
+}
+
+// Adds the files a use tree (below a `mod` or `dep` root) reaches through
+// directories only, i.e. the imports that can be told without binding any file.
+static void use_targets(AsgUseTree *use, AsgNS *parent, AsgFile ***targets) {
+  AsgBinding *b = raxFind(parent->bindings_by_sid, use->sid.str.start, use->sid.str.len);
+  if (b == raxNotFound || b->tag != BINDING_NS) {
+    return;
+  }
+
+  if (b->ns->tag == NS_FILE) {
+    sb_push(*targets, b->ns->file);
+  } else if (use->tag == USE_TREE_BRANCH) {
+    for (int i = 0; i < sb_count(use->branch); i++) {
+      use_targets(&use->branch[i], b->ns, targets);
+    }
+  }
+}
+
+static void file_use_targets(OoContext *cx, AsgFile *asg, AsgFile ***targets) {
+  for (int i = 0; i < sb_count(asg->items); i++) {
+    AsgItem *item = &asg->items[i];
+    if (item->disabled || item->tag != ITEM_USE || item->use.tag != USE_TREE_BRANCH) {
+      continue;
+    }
+
+    AsgNS *root;
+    if (str_eq_parts(item->use.sid.str, "mod", 3)) {
+      root = cx->dirs[0];
+    } else if (str_eq_parts(item->use.sid.str, "dep", 3)) {
+      root = cx->dirs[1];
+    } else {
+      continue; // goes through the bindings of the file itself
+    }
+
+    for (int j = 0; j < sb_count(item->use.branch); j++) {
+      use_targets(&item->use.branch[j], root, targets);
+    }
+  }
+}
+
+static void *coarse_worker_run(void *arg) {
+  CoarseWorker *w = arg;
+  worker = w;
+
+  int count = sb_count(w->files);
+  int i;
+  while ((i = atomic_fetch_add(w->next, 1)) < count) {
+    OoError err;
+    err.tag = OO_ERR_NONE;
+    file_coarse_bindings(w->cx, &err, w->files[i]);
+    if (err.tag != OO_ERR_NONE) {
+      sb_push(w->failed, w->files[i]);
+    }
+  }
+
+  worker = NULL;
+  return NULL;
+}
+
+// Binds all files of the wave concurrently, using the given workers (one per
+// thread). Returns whether all of them were bound, failed files are reset.
+static bool coarse_wave(OoContext *cx, AsgFile **files, CoarseWorker *workers, int threads) {
+  rax *wave = raxNew();
+  for (int i = 0; i < sb_count(files); i++) {
+    raxInsert(wave, (const char *) &files[i], sizeof(AsgFile *), NULL, NULL);
+  }
+
+  atomic_int next = 0;
+  if (threads > sb_count(files)) {
+    threads = sb_count(files);
+  }
+  for (int t = 0; t < threads; t++) {
+    workers[t].cx = cx;
+    workers[t].wave = wave;
+    workers[t].files = files;
+    workers[t].next = &next;
+  }
+
+  pthread_t *handles = malloc(sizeof(pthread_t) * threads);
+  int started = 1; // the calling thread is worker 0
+  while (started < threads && pthread_create(&handles[started], NULL, coarse_worker_run, &workers[started]) == 0) {
+    started++;
+  }
+  coarse_worker_run(&workers[0]);
+  for (int t = 1; t < started; t++) {
+    pthread_join(handles[t], NULL);
+  }
+  free(handles);
+  raxFree(wave);
+
+  bool ok = true;
+  for (int t = 0; t < threads; t++) {
+    for (int i = 0; i < sb_count(workers[t].edges); i += 2) {
+      add_dependent(workers[t].edges[i], workers[t].edges[i + 1]);
+    }
+    sb_free(workers[t].edges);
+    workers[t].edges = NULL;
+
+    for (int i = 0; i < sb_count(workers[t].failed); i++) {
+      reset_file_analysis(workers[t].failed[i]);
+      ok = false;
+    }
+    sb_free(workers[t].failed);
+    workers[t].failed = NULL;
+  }
+  return ok;
+}
+
+// Binds the files whose imports can be read off their use trees, in waves:
+// a file is bound as soon as all files it imports are, concurrently with all
+// other such files. Files in (or depending on) an import cycle never become
+// ready, and neither do files importing files that have not been loaded yet.
+// These, and all files after a failed wave, are left unbound for the
+// sequential pass, which then reports errors exactly as if it had run alone.
+static void coarse_waves(OoContext *cx, int threads) {
+  AsgFile **pending = NULL; // the files to bind
+  rax *indices = raxNew(); // maps pending files (by address) to their index + 1
+  for (int i = 0; i < sb_count(cx->files); i++) {
+    AsgFile *asg = cx->files[i];
+    if (asg->loaded && is_ns_uninitialized(&asg->ns)) {
+      sb_push(pending, asg);
+      raxInsert(indices, (const char *) &asg, sizeof(AsgFile *), (void *) (uintptr_t) sb_count(pending), NULL);
+    }
+  }
+
+  int count = sb_count(pending);
+  int *missing = NULL; // per pending file, how many of its imports are still unbound
+  AsgFile ***importers = NULL; // per pending file, the pending files importing it
+  sb_add(missing, count);
+  sb_add(importers, count);
+  AsgFile **targets = NULL;
+  for (int i = 0; i < count; i++) {
+    missing[i] = 0;
+    importers[i] = NULL;
+  }
+  for (int i = 0; i < count; i++) {
+    sb_free(targets);
+    targets = NULL;
+    file_use_targets(cx, pending[i], &targets);
+    for (int j = 0; j < sb_count(targets); j++) {
+      void *index = raxFind(indices, (const char *) &targets[j], sizeof(AsgFile *));
+      if (index != raxNotFound) {
+        sb_push(importers[(uintptr_t) index - 1], pending[i]);
+        missing[i]++;
+      } else if (!targets[j]->loaded) {
+        missing[i]++; // loading is left to the sequential pass
+      }
+    }
+  }
+  sb_free(targets);
+
+  // The pools are kept for later passes (e.g. after a reload), which reuse the
+  // memory freed in them.
+  while (sb_count(cx->worker_pools) < threads) {
+    OoWorkerPool *wp = malloc(sizeof(OoWorkerPool));
+    oo_pool_init(&wp->pool);
+    wp->alloc.malloc = cx_rax_malloc;
+    wp->alloc.realloc = cx_rax_realloc;
+    wp->alloc.free = cx_rax_free;
+    wp->alloc.ctx = &wp->pool;
+    sb_push(cx->worker_pools, wp);
+  }
+
+  CoarseWorker *workers = malloc(sizeof(CoarseWorker) * threads);
+  for (int t = 0; t < threads; t++) {
+    workers[t].alloc = &cx->worker_pools[t]->alloc;
+    workers[t].edges = NULL;
+    workers[t].failed = NULL;
+  }
+
+  AsgFile **ready = NULL;
+  for (int i = 0; i < count; i++) {
+    if (missing[i] == 0) {
+      sb_push(ready, pending[i]);
+    }
+  }
+  while (sb_count(ready) > 0) {
+    AsgFile **wave = ready;
+    ready = NULL;
+    if (!coarse_wave(cx, wave, workers, threads)) {
+      sb_free(wave);
+      break;
+    }
+
+    for (int i = 0; i < sb_count(wave); i++) {
+      void *index = raxFind(indices, (const char *) &wave[i], sizeof(AsgFile *));
+      AsgFile **imps = importers[(uintptr_t) index - 1];
+      for (int j = 0; j < sb_count(imps); j++) {
+        uintptr_t k = (uintptr_t) raxFind(indices, (const char *) &imps[j], sizeof(AsgFile *)) - 1;
+        missing[k]--;
+        if (missing[k] == 0) {
+          sb_push(ready, pending[k]);
+        }
+      }
+    }
+    sb_free(wave);
+  }
+  sb_free(ready);
+
+  free(workers);
+  for (int i = 0; i < count; i++) {
+    sb_free(importers[i]);
+  }
+  sb_free(importers);
+  sb_free(missing);
+  raxFree(indices);
+  sb_free(pending);
+}
+
+void oo_cx_coarse_bindings(OoContext *cx, OoError *err) {
+  int threads = cx->threads > 0 ? cx->threads : (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads > 1) {
+    coarse_waves(cx, threads);
+  }
+
+  // Binds whatever the waves left over, in file order.
+  int count = sb_count(cx->files);
+  for (int i = 0; i < count; i++) {
+    if (cx->files[i]->loaded && is_ns_uninitialized(&cx->files[i]->ns)) {
+      file_coarse_bindings(cx, err, cx->files[i]);
+      if (err->tag != OO_ERR_NONE) {
+        return;
+      }
+    }
+  }
+}
+
+// Makes sure the file is loaded and its top-level bindings are resolved.
+// Records that the analysis of the file from depends on it.
+static void prepare_file(OoContext *cx, OoError *err, AsgFile *file, AsgSid *sid, AsgFile *from) {
+  if (worker != NULL) {
+    // Other files of the wave are being bound concurrently, so only files
+    // bound before the wave can be looked into. Anything else blocks the
+    // file, the error merely unwinds and is discarded by the worker.
+    if (file != from) {
+      sb_push(worker->edges, file);
+      sb_push(worker->edges, from);
+    }
+    if (raxFind(worker->wave, (const char *) &file, sizeof(AsgFile *)) != raxNotFound || !file->loaded || !file->coarse_bound) {
+      err->tag = OO_ERR_CYCLIC_IMPORTS;
+      err->cyclic_import = sid;
+      err->asg = file;
+    }
+    return;
+  }
+
+  add_dependent(file, from);
+
+  if (!file->loaded) {
+    load_file(cx, err, file);
+    if (err->tag != OO_ERR_NONE) {
+      return;
+    }
+  }
+
+  if (is_ns_uninitialized(&file->ns)) {
+    file_coarse_bindings(cx, err, file);
+    if (err->tag != OO_ERR_NONE) {
+      return;
+    }
+  } else if (!file->coarse_bound) {
+    err->tag = OO_ERR_CYCLIC_IMPORTS;
+    err->cyclic_import = sid;
+    err->asg = file;
+    return;
+  }
+}
+
+// (Recursively) add all bindings from the given UseTree to the mod.
+static void resolve_use(
+  AsgUseTree *use,
+  bool pub,
+  AsgNS *ns, /* where to put the resolved bindings */
+  AsgNS *parent, /* where to look for the sid */
+  Str parent_name,
+  OoContext *cx,
+  OoError *err,
+  AsgFile *asg) {
+    AsgBinding *b = raxFind(parent->bindings_by_sid, use->sid.str.start, use->sid.str.len);
+
+    // printf("resolve use for ");
+    // str_print(use->str);
+    // printf(" in %s\n", use->asg->path);
+
+    if (b == raxNotFound) {
+      err->tag = OO_ERR_NONEXISTING_SID_USE;
+      err->asg = asg;
       err->nonexisting_sid_use = use;
       // printf("unfound str: ");
       // str_print(use->sid.str);
@@ -523,7 +1491,7 @@ static void resolve_use(
     }
 
     if (b->tag == BINDING_NS && b->ns->tag == NS_FILE) {
-      prepare_file(cx, err, b->ns->file, &use->sid);
+      prepare_file(cx, err, b->ns->file, &use->sid, asg);
       if (err->tag != OO_ERR_NONE) {
         return;
       }
@@ -550,11 +1518,9 @@ static void resolve_use(
         use->sid.binding.private = false;
         use->sid.binding.file = asg;
 
-        if (raxInsert(ns->bindings_by_sid, str.start, str.len, &use->sid.binding, NULL)) {
-          if (pub && ns->tag != NS_DIR) {
-            raxInsert(ns->pub_bindings_by_sid, str.start, str.len, &use->sid.binding, NULL);
-          }
-        } else {
+        use->sid.binding.pub = pub && ns->tag != NS_DIR;
+
+        if (!raxInsert(ns->bindings_by_sid, str.start, str.len, &use->sid.binding, NULL)) {
           err->tag = OO_ERR_DUP_ID_ITEM_USE;
           err->asg = asg;
           err->dup_item_use = use;
@@ -590,118 +1556,139 @@ static void file_coarse_bindings(OoContext *cx, OoError *err, AsgFile *asg) {
 
   size_t count = sb_count(asg->items);
   sb_add(asg->ns.bindings, 18 + (int) count); // mod, dep, and the 14 primitive types
-  asg->ns.bindings_by_sid = raxNew();
-  asg->ns.pub_bindings_by_sid = raxNew();
+  asg->ns.bindings_by_sid = cx_rax_new(cx);
 
   asg->ns.bindings[0].tag = BINDING_NS;
   asg->ns.bindings[0].private = true;
+  asg->ns.bindings[0].pub = false;
   asg->ns.bindings[0].file = NULL;
   asg->ns.bindings[0].ns = cx->dirs[0];
   raxInsert(asg->ns.bindings_by_sid, "mod", 3, &asg->ns.bindings[0], NULL);
 
   asg->ns.bindings[1].tag = BINDING_NS;
   asg->ns.bindings[1].private = true;
+  asg->ns.bindings[1].pub = false;
   asg->ns.bindings[1].file = NULL;
   asg->ns.bindings[1].ns = cx->dirs[1];
   raxInsert(asg->ns.bindings_by_sid, "dep", 3, &asg->ns.bindings[1], NULL);
 
   asg->ns.bindings[2].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[2].private = false;
+  asg->ns.bindings[2].pub = false;
   asg->ns.bindings[2].file = NULL;
   asg->ns.bindings[2].primitive = PRIM_U8;
   raxInsert(asg->ns.bindings_by_sid, "U8", 2, &asg->ns.bindings[2], NULL);
 
   asg->ns.bindings[3].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[3].private = false;
+  asg->ns.bindings[3].pub = false;
   asg->ns.bindings[3].file = NULL;
   asg->ns.bindings[3].primitive = PRIM_U16;
   raxInsert(asg->ns.bindings_by_sid, "U16", 3, &asg->ns.bindings[3], NULL);
 
   asg->ns.bindings[4].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[4].private = false;
+  asg->ns.bindings[4].pub = false;
   asg->ns.bindings[4].file = NULL;
   asg->ns.bindings[4].primitive = PRIM_U32;
   raxInsert(asg->ns.bindings_by_sid, "U32", 3, &asg->ns.bindings[4], NULL);
 
   asg->ns.bindings[5].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[5].private = false;
+  asg->ns.bindings[5].pub = false;
   asg->ns.bindings[5].file = NULL;
   asg->ns.bindings[5].primitive = PRIM_U64;
   raxInsert(asg->ns.bindings_by_sid, "U64", 3, &asg->ns.bindings[5], NULL);
 
   asg->ns.bindings[6].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[6].private = false;
+  asg->ns.bindings[6].pub = false;
   asg->ns.bindings[6].file = NULL;
   asg->ns.bindings[6].primitive = PRIM_USIZE;
   raxInsert(asg->ns.bindings_by_sid, "Usize", 5, &asg->ns.bindings[6], NULL);
 
   asg->ns.bindings[7].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[7].private = false;
+  asg->ns.bindings[7].pub = false;
   asg->ns.bindings[7].file = NULL;
   asg->ns.bindings[7].primitive = PRIM_I8;
   raxInsert(asg->ns.bindings_by_sid, "I8", 2, &asg->ns.bindings[7], NULL);
 
   asg->ns.bindings[8].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[8].private = false;
+  asg->ns.bindings[8].pub = false;
   asg->ns.bindings[8].file = NULL;
   asg->ns.bindings[8].primitive = PRIM_I16;
   raxInsert(asg->ns.bindings_by_sid, "I16", 3, &asg->ns.bindings[8], NULL);
 
   asg->ns.bindings[9].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[9].private = false;
+  asg->ns.bindings[9].pub = false;
   asg->ns.bindings[9].file = NULL;
   asg->ns.bindings[9].primitive = PRIM_I32;
   raxInsert(asg->ns.bindings_by_sid, "I32", 3, &asg->ns.bindings[9], NULL);
 
   asg->ns.bindings[10].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[10].private = false;
+  asg->ns.bindings[10].pub = false;
   asg->ns.bindings[10].file = NULL;
   asg->ns.bindings[10].primitive = PRIM_I64;
   raxInsert(asg->ns.bindings_by_sid, "I64", 3, &asg->ns.bindings[10], NULL);
 
   asg->ns.bindings[11].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[11].private = false;
+  asg->ns.bindings[11].pub = false;
   asg->ns.bindings[11].file = NULL;
   asg->ns.bindings[11].primitive = PRIM_ISIZE;
   raxInsert(asg->ns.bindings_by_sid, "Isize", 5, &asg->ns.bindings[11], NULL);
 
   asg->ns.bindings[12].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[12].private = false;
+  asg->ns.bindings[12].pub = false;
   asg->ns.bindings[12].file = NULL;
   asg->ns.bindings[12].primitive = PRIM_F32;
   raxInsert(asg->ns.bindings_by_sid, "F32", 3, &asg->ns.bindings[12], NULL);
 
   asg->ns.bindings[13].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[13].private = false;
+  asg->ns.bindings[13].pub = false;
   asg->ns.bindings[13].file = NULL;
   asg->ns.bindings[13].primitive = PRIM_F64;
   raxInsert(asg->ns.bindings_by_sid, "F64", 3, &asg->ns.bindings[13], NULL);
 
   asg->ns.bindings[14].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[14].private = false;
+  asg->ns.bindings[14].pub = false;
   asg->ns.bindings[14].file = NULL;
   asg->ns.bindings[14].primitive = PRIM_VOID;
   raxInsert(asg->ns.bindings_by_sid, "Void", 4, &asg->ns.bindings[14], NULL);
 
   asg->ns.bindings[15].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[15].private = false;
+  asg->ns.bindings[15].pub = false;
   asg->ns.bindings[15].file = NULL;
   asg->ns.bindings[15].primitive = PRIM_BOOL;
   raxInsert(asg->ns.bindings_by_sid, "Bool", 4, &asg->ns.bindings[15], NULL);
 
   asg->ns.bindings[16].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[16].private = false;
+  asg->ns.bindings[16].pub = false;
   asg->ns.bindings[16].file = NULL;
   asg->ns.bindings[16].primitive = PRIM_U128;
   raxInsert(asg->ns.bindings_by_sid, "U128", 4, &asg->ns.bindings[16], NULL);
 
   asg->ns.bindings[17].tag = BINDING_PRIMITIVE;
   asg->ns.bindings[17].private = false;
+  asg->ns.bindings[17].pub = false;
   asg->ns.bindings[17].file = NULL;
   asg->ns.bindings[17].primitive = PRIM_I128;
   raxInsert(asg->ns.bindings_by_sid, "I128", 4, &asg->ns.bindings[17], NULL);
 
   for (size_t i = 0; i < count; i++) {
+    if (asg->items[i].disabled) {
+      continue;
+    }
+
     Str str;
     switch (asg->items[i].tag) {
       case ITEM_TYPE:
@@ -732,8 +1719,7 @@ static void file_coarse_bindings(OoContext *cx, OoError *err, AsgFile *asg) {
               sum->ns.tag = NS_SUM;
               sum->ns.sum = sum;
 
-              sum->ns.bindings_by_sid = raxNew();
-              sum->ns.pub_bindings_by_sid = raxNew();
+              sum->ns.bindings_by_sid = cx_rax_new(cx);
               sum->ns.bindings = NULL;
               int count = sb_count(sum->summands) + 1;
               sb_add(sum->ns.bindings, count);
@@ -741,17 +1727,19 @@ static void file_coarse_bindings(OoContext *cx, OoError *err, AsgFile *asg) {
               sum->ns.bindings[0].tag = BINDING_SUM_TYPE;
               sum->ns.bindings[0].sum.type = &asg->items[i];
               sum->ns.bindings[0].sum.ns = &sum->ns;
+              sum->ns.bindings[0].pub = true;
               raxInsert(sum->ns.bindings_by_sid, "mod", 3, (void *) &sum->ns.bindings[0], NULL);
-              raxInsert(sum->ns.pub_bindings_by_sid, "mod", 3, (void *) &sum->ns.bindings[0], NULL);
 
               for (int j = 1; j < count; j++) {
                 sum->ns.bindings[j].tag = BINDING_VAL;
                 sum->ns.bindings[j].private = true;
+                sum->ns.bindings[j].pub = sum->pub;
                 sum->ns.bindings[j].file = asg;
                 sum->ns.bindings[j].val.mut = false;
                 sum->ns.bindings[j].val.sid = &sum->summands[j - 1].sid;
                 sum->ns.bindings[j].val.type = NULL;
-                sum->ns.bindings[j].val.oo_type.tag = OO_TYPE_UNINITIALIZED;
+                sum->ns.bindings[j].val.oo_type = NULL;
+                sum->ns.bindings[j].val.slot = ASG_NO_SLOT;
                 sum->ns.bindings[j].val.tag = VAL_SUMMAND;
                 sum->ns.bindings[j].val.summand = &sum->summands[j - 1];
 
@@ -762,16 +1750,6 @@ static void file_coarse_bindings(OoContext *cx, OoError *err, AsgFile *asg) {
                   &sum->ns.bindings[j],
                   NULL
                 );
-
-                if (sum->pub) {
-                  raxInsert(
-                    sum->ns.pub_bindings_by_sid,
-                    sum->summands[j - 1].sid.str.start,
-                    sum->summands[j - 1].sid.str.len,
-                    &sum->ns.bindings[j],
-                    NULL
-                  );
-                }
               }
 
               asg->ns.bindings[i + 18].tag = BINDING_SUM_TYPE;
@@ -788,7 +1766,8 @@ static void file_coarse_bindings(OoContext *cx, OoError *err, AsgFile *asg) {
             asg->ns.bindings[i + 18].val.mut = asg->items[i].val.mut;
             asg->ns.bindings[i + 18].val.sid = &asg->items[i].val.sid;
             asg->ns.bindings[i + 18].val.type = &asg->items[i].val.type;
-            asg->ns.bindings[i + 18].val.oo_type.tag = OO_TYPE_UNINITIALIZED;
+            asg->ns.bindings[i + 18].val.oo_type = NULL;
+            asg->ns.bindings[i + 18].val.slot = ASG_NO_SLOT;
             asg->ns.bindings[i + 18].val.tag = VAL_VAL;
             asg->ns.bindings[i + 18].val.val = &asg->items[i].val;
             break;
@@ -800,7 +1779,8 @@ static void file_coarse_bindings(OoContext *cx, OoError *err, AsgFile *asg) {
             asg->ns.bindings[i + 18].val.mut = false;
             asg->ns.bindings[i + 18].val.sid = &asg->items[i].fun.sid;
             asg->ns.bindings[i + 18].val.type = NULL;
-            asg->ns.bindings[i + 18].val.oo_type.tag = OO_TYPE_UNINITIALIZED;
+            asg->ns.bindings[i + 18].val.oo_type = NULL;
+            asg->ns.bindings[i + 18].val.slot = ASG_NO_SLOT;
             asg->ns.bindings[i + 18].val.tag = VAL_FUN;
             asg->ns.bindings[i + 18].val.fun = &asg->items[i].fun;
             break;
@@ -812,7 +1792,8 @@ static void file_coarse_bindings(OoContext *cx, OoError *err, AsgFile *asg) {
             asg->ns.bindings[i + 18].val.mut = asg->items[i].ffi_val.mut;
             asg->ns.bindings[i + 18].val.sid = &asg->items[i].ffi_val.sid;
             asg->ns.bindings[i + 18].val.type = &asg->items[i].ffi_val.type;
-            asg->ns.bindings[i + 18].val.oo_type.tag = OO_TYPE_UNINITIALIZED;
+            asg->ns.bindings[i + 18].val.oo_type = NULL;
+            asg->ns.bindings[i + 18].val.slot = ASG_NO_SLOT;
             asg->ns.bindings[i + 18].val.tag = VAL_FFI;
             asg->ns.bindings[i + 18].val.ffi = &asg->items[i].ffi_val;
             break;
@@ -820,11 +1801,8 @@ static void file_coarse_bindings(OoContext *cx, OoError *err, AsgFile *asg) {
             abort(); // unreachable
         }
 
-        if (raxInsert(asg->ns.bindings_by_sid, str.start, str.len, &asg->ns.bindings[i + 18], NULL)) {
-          if (asg->items[i].pub) {
-            raxInsert(asg->ns.pub_bindings_by_sid, str.start, str.len, &asg->ns.bindings[i + 18], NULL);
-          }
-        } else {
+        asg->ns.bindings[i + 18].pub = asg->items[i].pub;
+        if (!raxInsert(asg->ns.bindings_by_sid, str.start, str.len, &asg->ns.bindings[i + 18], NULL)) {
           err->tag = OO_ERR_DUP_ID_ITEM;
           err->asg = asg;
           err->dup_item = &asg->items[i];
@@ -846,6 +1824,8 @@ static void file_coarse_bindings(OoContext *cx, OoError *err, AsgFile *asg) {
         break;
     }
   }
+
+  asg->coarse_bound = true;
 }
 
 typedef struct ScopeStackFrame {
@@ -857,18 +1837,37 @@ typedef struct ScopeStackFrame {
 // Nested scopes (mappings from sids to AsgBindings).
 // Allows to manipulate the stack of scopes, and to look up bindings, by
 // traversing the scopes from the innermost to the outermost one.
-// Does not own any data.
+// Only owns the bindings and raxes its frames were told to own, and the path cache.
 typedef struct ScopeStack {
   ScopeStackFrame *frames; // stretchy buffer of stack frames.
   size_t len; // how many items are on the stack
+  // Memoized resolutions of multi-segment ids of the current file, see id_fine_bindings.
+  // Maps path keys to owning stretchy buffers of AsgBinding pointers, one per
+  // segment after the first.
+  rax *paths;
+  char *path_key; // reused to build keys for paths
+  size_t path_key_len;
+  size_t path_key_cap;
 } ScopeStack;
 
-static void ss_init(ScopeStack *ss) {
+static void ss_init(ScopeStack *ss, rax *paths) {
   ss->frames = NULL;
   ss->len = 0;
+  ss->paths = paths;
+  ss->path_key = NULL;
+  ss->path_key_len = 0;
+  ss->path_key_cap = 0;
+}
+
+static void free_path(void *path) {
+  AsgBinding **bindings = path;
+  sb_free(bindings);
 }
 
 static void ss_free(const ScopeStack *ss) {
+  raxFreeWithCallback(ss->paths, free_path);
+  free(ss->path_key);
+
   for (size_t i = 0; i < ss->len; i++) {
     for (int j = 0; j < sb_count(ss->frames[i].owned_bindings); j++) {
       free(ss->frames[i].owned_bindings[j]);
@@ -956,122 +1955,189 @@ static AsgNS *binding_get_ns(AsgBinding b) {
   }
 }
 
-static void file_fine_bindings(OoContext *cx, OoError *err, AsgFile *asg);
-static void type_fine_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgType *type, AsgFile *asg);
-static void id_fine_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgId *id, AsgFile *asg);
-static void summand_fine_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgSummand *summand, AsgFile *asg);
-static void exp_fine_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgExp *exp, AsgFile *asg);
-static void block_fine_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgBlock *block, AsgFile *asg);
-
-// bindings and sids are pointers to stretchy buffers, bindings is an sb of owning pointers
-void add_pattern_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgPattern *p, AsgFile *asg) {
-  size_t count;
-  switch (p->tag) {
-    case PATTERN_ID:
-      if (p->id.type != NULL) {
-        type_fine_bindings(cx, err, ss, p->id.type, asg);
-      }
+// Looks up the binding of a sid in a namespace, returns raxNotFound if there is
+// none. Unless private is set, bindings that are not pub are treated as absent.
+static AsgBinding *ns_lookup(const AsgNS *ns, Str sid, bool private) {
+  AsgBinding *b = raxFind(ns->bindings_by_sid, sid.start, sid.len);
+  if (b != raxNotFound && !private && !b->pub) {
+    return raxNotFound;
+  }
+  return b;
+}
 
-      AsgBinding *b = malloc(sizeof(AsgBinding));
-      b->tag = BINDING_VAL;
-      b->private = true;
-      b->file = asg;
-      b->val.mut = p->id.mut;
-      b->val.sid = &p->id.sid;
-      b->val.type = p->id.type;
-      b->val.oo_type.tag = OO_TYPE_UNINITIALIZED;
-      b->val.tag = VAL_PATTERN;
-      b->val.pattern = &p->id;
-
-      ss_add(err, asg, ss, p->id.sid.str, b);
-      break;
-    case PATTERN_BLANK:
-    case PATTERN_LITERAL:
-      // noop
-      break;
-    case PATTERN_PTR:
-      add_pattern_bindings(cx, err, ss, p->ptr, asg);
-      break;
-    case PATTERN_PRODUCT_ANON:
-      count = sb_count(p->product_anon);
-      for (size_t i = 0; i < count; i++) {
-        add_pattern_bindings(cx, err, ss, &p->product_anon[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case PATTERN_PRODUCT_NAMED:
-      count = sb_count(p->product_named.inners);
-      for (size_t i = 0; i < count; i++) {
-        add_pattern_bindings(cx, err, ss, &p->product_named.inners[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case PATTERN_SUMMAND_ANON:
-      id_fine_bindings(cx, err, ss, &p->summand_anon.id, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      } else {
-        if (p->summand_anon.id.binding.tag != BINDING_VAL && p->summand_anon.id.binding.val.tag != VAL_SUMMAND) {
-          err->tag = OO_ERR_BINDING_NOT_SUMMAND;
-          err->binding_not_summand = &p->summand_anon.id;
-          return;
-        }
-      }
+// Builds the path cache key for the segments after the first one of the given
+// id into ss->path_key, and looks it up in ss->paths.
+// The key consists of the privacy flag and the address of the namespace in
+// which the second segment is resolved, followed by the remaining segments.
+static AsgBinding **path_key_find(ScopeStack *ss, AsgNS *ns, bool private, const AsgId *id) {
+  size_t count = sb_count(id->sids);
+  size_t len = 1 + sizeof(AsgNS *);
+  for (size_t i = 1; i < count; i++) {
+    len += 1 + id->sids[i].str.len;
+  }
 
-      count = sb_count(p->summand_anon.fields);
-      for (size_t i = 0; i < count; i++) {
-        add_pattern_bindings(cx, err, ss, &p->summand_anon.fields[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case PATTERN_SUMMAND_NAMED:
-      id_fine_bindings(cx, err, ss, &p->summand_named.id, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      } else {
-        if (p->summand_anon.id.binding.tag != BINDING_VAL && p->summand_anon.id.binding.val.tag != VAL_SUMMAND) {
-          err->tag = OO_ERR_BINDING_NOT_SUMMAND;
-          err->binding_not_summand = &p->summand_named.id;
-          return;
-        }
-      }
+  if (len > ss->path_key_cap) {
+    ss->path_key_cap = 2 * len;
+    ss->path_key = realloc(ss->path_key, ss->path_key_cap);
+  }
 
-      count = sb_count(p->summand_named.fields);
-      for (size_t i = 0; i < count; i++) {
-        add_pattern_bindings(cx, err, ss, &p->summand_named.fields[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
+  char *key = ss->path_key;
+  *key = private ? 1 : 0;
+  key += 1;
+  memcpy(key, &ns, sizeof(AsgNS *));
+  key += sizeof(AsgNS *);
+  for (size_t i = 1; i < count; i++) {
+    *key = ':'; // sids never contain colons
+    memcpy(key + 1, id->sids[i].str.start, id->sids[i].str.len);
+    key += 1 + id->sids[i].str.len;
   }
+  ss->path_key_len = len;
+
+  return raxFind(ss->paths, ss->path_key, len);
 }
 
-void oo_cx_fine_bindings(OoContext *cx, OoError *err) {
-  int count = sb_count(cx->files);
-  for (int i = 0; i < count; i++) {
-    file_fine_bindings(cx, err, cx->files[i]);
-    if (err->tag != OO_ERR_NONE) {
+// Frees the parsed bodies of the functions of the file. They are reset to the
+// state of a lazy parse, so oo_cx_force_body parses them again if needed.
+static void drop_bodies(OoContext *cx, AsgFile *asg) {
+  if (asg->iface) {
+    return; // bodies are empty placeholders
+  }
+
+  for (int i = 0; i < sb_count(asg->items); i++) {
+    AsgItemFun *fun = &asg->items[i].fun;
+    if (asg->items[i].tag != ITEM_FUN || fun->body_src != NULL) {
+      continue;
+    }
+
+    oo_queries_forget_body(&cx->queries, fun);
+    free_inner_block(fun->body);
+    fun->body.exps = NULL;
+    fun->body.attrs = NULL;
+    fun->body_src = fun->body.str.start;
+  }
+}
+
+// Gives the pages of the mapping holding the source of the file back to the
+// kernel. Sources that were read into memory are kept.
+static void release_source(OoContext *cx, AsgFile *asg) {
+  for (int i = 0; i < sb_count(cx->mappings); i++) {
+    const char *addr = cx->mappings[i].addr;
+    if (asg->str.start >= addr && asg->str.start < addr + cx->mappings[i].len) {
+      madvise(cx->mappings[i].addr, cx->mappings[i].len, MADV_DONTNEED);
       return;
     }
   }
 }
 
-// Return whether the expression can be assigned to a top level val item.
-static bool is_item_val(AsgExp *exp) {
-  switch (exp->tag) {
-    case EXP_ID:
-    case EXP_LITERAL:
-    case EXP_SIZE_OF:
-    case EXP_ALIGN_OF:
-      return true;
-    case EXP_REF:
+// Appends the loaded files that have not been type checked yet to order, such
+// that each file comes after the files it depends on. Files in a dependency
+// cycle come last, in file order.
+static void stream_order(OoContext *cx, AsgFile ***order) {
+  AsgFile **todo = NULL;
+  rax *indices = raxNew(); // maps files of todo (by address) to their index + 1
+  for (int i = 0; i < sb_count(cx->files); i++) {
+    AsgFile *asg = cx->files[i];
+    if (asg->loaded && !asg->typed) {
+      sb_push(todo, asg);
+      raxInsert(indices, (const char *) &asg, sizeof(AsgFile *), (void *) (uintptr_t) sb_count(todo), NULL);
+    }
+  }
+
+  int count = sb_count(todo);
+  int *missing = NULL; // per file of todo, how many of its dependencies are not ordered yet
+  sb_add(missing, count);
+  for (int i = 0; i < count; i++) {
+    missing[i] = 0;
+  }
+  for (int i = 0; i < count; i++) {
+    for (int j = 0; j < sb_count(todo[i]->dependents); j++) {
+      void *index = raxFind(indices, (const char *) &todo[i]->dependents[j], sizeof(AsgFile *));
+      if (index != raxNotFound) {
+        missing[(uintptr_t) index - 1]++;
+      }
+    }
+  }
+
+  int start = sb_count(*order);
+  for (int i = 0; i < count; i++) {
+    if (missing[i] == 0) {
+      sb_push(*order, todo[i]);
+    }
+  }
+  for (int i = start; i < sb_count(*order); i++) {
+    AsgFile *asg = (*order)[i];
+    for (int j = 0; j < sb_count(asg->dependents); j++) {
+      void *index = raxFind(indices, (const char *) &asg->dependents[j], sizeof(AsgFile *));
+      if (index != raxNotFound) {
+        missing[(uintptr_t) index - 1]--;
+        if (missing[(uintptr_t) index - 1] == 0) {
+          sb_push(*order, asg->dependents[j]);
+        }
+      }
+    }
+  }
+  for (int i = 0; i < count; i++) {
+    if (missing[i] > 0) {
+      sb_push(*order, todo[i]);
+    }
+  }
+
+  sb_free(missing);
+  raxFree(indices);
+  sb_free(todo);
+}
+
+void oo_cx_stream(OoContext *cx, OoError *err, OoStreamFn emit, void *data) {
+  oo_cx_coarse_bindings(cx, err);
+  if (err->tag != OO_ERR_NONE) {
+    return;
+  }
+
+  // Binding paths may load further (lazy) deps, these are ordered in the next round.
+  AsgFile **order = NULL;
+  stream_order(cx, &order);
+  while (sb_count(order) > 0) {
+    for (int i = 0; i < sb_count(order); i++) {
+      AsgFile *asg = order[i];
+      oo_cx_bind_and_kind_check_file(cx, err, asg);
+      if (err->tag != OO_ERR_NONE) {
+        goto done;
+      }
+      oo_cx_type_check_file(cx, err, asg);
+      if (err->tag != OO_ERR_NONE) {
+        goto done;
+      }
+      oo_cx_check_file_bodies(cx, err, asg);
+      if (err->tag != OO_ERR_NONE) {
+        goto done;
+      }
+
+      if (emit != NULL) {
+        emit(cx, asg, data);
+      }
+      drop_bodies(cx, asg);
+      oo_cx_release_file_syntax_types(cx, asg);
+      release_source(cx, asg);
+    }
+
+    sb_free(order);
+    order = NULL;
+    stream_order(cx, &order);
+  }
+
+  done:
+    sb_free(order);
+}
+
+// Return whether the expression can be assigned to a top level val item.
+static bool is_item_val(AsgExp *exp) {
+  switch (exp->tag) {
+    case EXP_ID:
+    case EXP_LITERAL:
+    case EXP_SIZE_OF:
+    case EXP_ALIGN_OF:
+      return true;
+    case EXP_REF:
       return is_item_val(exp->ref);
     case EXP_REF_MUT:
       return is_item_val(exp->ref_mut);
@@ -1118,238 +2184,322 @@ static bool is_item_val(AsgExp *exp) {
   }
 }
 
-static void file_fine_bindings(OoContext *cx, OoError *err, AsgFile *asg) {
+// Fine binding is a visitor (see visit.h) that keeps the scopes of the
+// traversal in a ScopeStack. It resolves ids in the pre hooks and adds the
+// bindings introduced by patterns in their post hooks, after the types of the
+// patterns have been bound. It also assigns the frame slots of the locals of
+// each function (see AsgItemFun.frame_size).
+typedef struct Binder {
+  OoContext *cx;
+  AsgFile *asg;
   ScopeStack ss;
-  ss_init(&ss);
-  ss_push(&ss, asg->ns.bindings_by_sid);
-
-  size_t count = sb_count(asg->items);
-  for (size_t i = 0; i < count; i++) {
-    switch (asg->items[i].tag) {
-      case ITEM_TYPE:
-        type_fine_bindings(cx, err, &ss, &asg->items[i].type.type, asg);
-        break;
-      case ITEM_VAL:
-        if (is_item_val(&asg->items[i].val.exp)) {
-          type_fine_bindings(cx, err, &ss, &asg->items[i].val.type, asg);
-          if (err->tag != OO_ERR_NONE) {
-            ss_free(&ss);
-            return;
-          }
-          exp_fine_bindings(cx, err, &ss, &asg->items[i].val.exp, asg);
-        } else {
-          err->tag = OO_ERR_NOT_CONST_EXP;
-          err->not_const_exp = &asg->items[i].val.exp;
-          ss_free(&ss);
-          return;
-        }
-        break;
-      case ITEM_FUN:
-        if (sb_count(asg->items[i].fun.type_args) > 0) {
-          ss_push_owning(&ss, raxNew());
-
-          for (size_t j = 0; j < (size_t) sb_count(asg->items[i].fun.type_args); j++) {
-            AsgBinding *b = malloc(sizeof(AsgBinding));
-            b->tag = BINDING_TYPE_VAR;
-            b->private = true;
-            b->file = asg;
-            b->type_var = &asg->items[i].fun.type_args[j];
-            ss_add(err, asg, &ss, asg->items[i].fun.type_args[j].str, b);
-            if (err->tag != OO_ERR_NONE) {
-              ss_free(&ss);
-              return;
-            }
-          }
-        }
-
-        for (size_t j = 0; j < (size_t) sb_count(asg->items[i].fun.arg_types); j++) {
-          type_fine_bindings(cx, err, &ss, &asg->items[i].fun.arg_types[j], asg);
-          if (err->tag != OO_ERR_NONE) {
-            ss_free(&ss);
-            return;
-          }
-        }
+  AsgItemFun *fun; // the function whose locals are numbered
+  size_t next_slot; // the slot of the next local of fun
+  size_t *arm_slots; // stretchy buffer, the next_slot at the start of each enclosing arm
+} Binder;
 
-        type_fine_bindings(cx, err, &ss, &asg->items[i].fun.ret, asg);
-        if (err->tag != OO_ERR_NONE) {
-          ss_free(&ss);
-          return;
-        }
+static void id_fine_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgId *id, AsgFile *asg);
 
-        if (sb_count(asg->items[i].fun.arg_types) > 0) {
-          ss_push_owning(&ss, raxNew());
-
-          for (size_t j = 0; j < (size_t) sb_count(asg->items[i].fun.arg_types); j++) {
-            AsgBinding *b = malloc(sizeof(AsgBinding));
-            b->tag = BINDING_VAL;
-            b->private = true;
-            b->file = asg;
-            b->val.mut = asg->items[i].fun.arg_muts[j];
-            b->val.sid = &asg->items[i].fun.arg_sids[j];
-            b->val.type = &asg->items[i].fun.arg_types[j];
-            b->val.oo_type.tag = OO_TYPE_UNINITIALIZED;
-            b->val.tag = VAL_ARG;
-            b->val.arg = &asg->items[i].fun.arg_sids[j];
-
-            ss_add(err, asg, &ss, asg->items[i].fun.arg_sids[j].str, b);
-            if (err->tag != OO_ERR_NONE) {
-              ss_free(&ss);
-              return;
-            }
-          }
-        }
+// Resolves the id, which must refer to a type.
+static void type_id_fine_bindings(Binder *b, OoError *err, AsgId *id) {
+  id_fine_bindings(b->cx, err, &b->ss, id, b->asg);
+  if (err->tag == OO_ERR_NONE && !is_type_binding(id->binding)) {
+    err->tag = OO_ERR_BINDING_NOT_TYPE;
+    err->asg = b->asg;
+    err->binding_not_type = id;
+  }
+}
 
-        block_fine_bindings(cx, err, &ss, &asg->items[i].fun.body, asg);
+static void add_type_var_bindings(Binder *b, OoError *err, AsgSid *type_args) {
+  for (size_t i = 0; i < (size_t) sb_count(type_args); i++) {
+    AsgBinding *binding = malloc(sizeof(AsgBinding));
+    binding->tag = BINDING_TYPE_VAR;
+    binding->private = true;
+    binding->file = b->asg;
+    binding->type_var = &type_args[i];
+    ss_add(err, b->asg, &b->ss, type_args[i].str, binding);
+    if (err->tag != OO_ERR_NONE) {
+      return;
+    }
+  }
+}
 
-        if (sb_count(asg->items[i].fun.arg_types) > 0) {
-          ss_pop(&ss);
-        }
+static void bind_item_pre(void *data, OoError *err, AsgItem *item) {
+  Binder *b = data;
+  if (item->tag == ITEM_VAL && !b->asg->iface && !is_item_val(&item->val.exp)) {
+    err->tag = OO_ERR_NOT_CONST_EXP;
+    err->asg = b->asg;
+    err->not_const_exp = &item->val.exp;
+  } else if (item->tag == ITEM_FUN) {
+    b->fun = &item->fun;
+    b->next_slot = sb_count(item->fun.arg_types);
+    item->fun.frame_size = b->next_slot;
+
+    if (sb_count(item->fun.type_args) > 0) {
+      ss_push_owning(&b->ss, cx_rax_new(b->cx));
+      add_type_var_bindings(b, err, item->fun.type_args);
+    }
+  }
+}
 
-        if (sb_count(asg->items[i].fun.type_args) > 0) {
-          ss_pop(&ss);
-        }
-        break;
-      case ITEM_FFI_VAL:
-        type_fine_bindings(cx, err, &ss, &asg->items[i].ffi_val.type, asg);
-        break;
-      case ITEM_USE:
-      case ITEM_FFI_INCLUDE:
-        // noop
-        break;
+static void bind_item_post(void *data, OoError *err, AsgItem *item) {
+  (void) err;
+  Binder *b = data;
+  if (item->tag == ITEM_FUN) {
+    b->fun = NULL;
+    if (sb_count(item->fun.type_args) > 0) {
+      ss_pop(&b->ss);
     }
+  }
+}
+
+static void bind_body_pre(void *data, OoError *err, AsgItem *item) {
+  Binder *b = data;
+  AsgItemFun *fun = &item->fun;
+  if (sb_count(fun->arg_types) == 0) {
+    return;
+  }
 
+  ss_push_owning(&b->ss, cx_rax_new(b->cx));
+  for (size_t i = 0; i < (size_t) sb_count(fun->arg_types); i++) {
+    AsgBinding *binding = malloc(sizeof(AsgBinding));
+    binding->tag = BINDING_VAL;
+    binding->private = true;
+    binding->file = b->asg;
+    binding->val.mut = fun->arg_muts[i];
+    binding->val.sid = &fun->arg_sids[i];
+    binding->val.type = &fun->arg_types[i];
+    binding->val.oo_type = NULL;
+    binding->val.slot = i;
+    binding->val.tag = VAL_ARG;
+    binding->val.arg = &fun->arg_sids[i];
+
+    ss_add(err, b->asg, &b->ss, fun->arg_sids[i].str, binding);
     if (err->tag != OO_ERR_NONE) {
-      ss_free(&ss);
       return;
     }
   }
+}
+
+static void bind_body_post(void *data, OoError *err, AsgItem *item) {
+  (void) err;
+  Binder *b = data;
+  if (sb_count(item->fun.arg_types) > 0) {
+    ss_pop(&b->ss);
+  }
+}
 
-  ss_free(&ss);
+// The bindings of the pattern of an arm are only in scope in its block, so
+// their slots can be reused after it.
+static void bind_arm_pre(void *data, OoError *err, AsgPattern *p, AsgBlock *block) {
+  (void) err;
+  (void) p;
+  (void) block;
+  Binder *b = data;
+  ss_push_owning(&b->ss, cx_rax_new(b->cx));
+  sb_push(b->arm_slots, b->next_slot);
 }
 
-static void type_fine_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgType *type, AsgFile *asg) {
-  size_t count;
+static void bind_arm_post(void *data, OoError *err, AsgPattern *p, AsgBlock *block) {
+  (void) err;
+  (void) p;
+  (void) block;
+  Binder *b = data;
+  ss_pop(&b->ss);
+  b->next_slot = sb_last(b->arm_slots);
+  stb__sbn(b->arm_slots) -= 1;
+}
+
+static void bind_type_pre(void *data, OoError *err, AsgType *type) {
+  Binder *b = data;
   switch (type->tag) {
     case TYPE_ID:
-      id_fine_bindings(cx, err, ss, &type->id, asg);
-      if (err->tag == OO_ERR_NONE && !is_type_binding(type->id.binding)) {
-        err->tag = OO_ERR_BINDING_NOT_TYPE;
-        err->binding_not_type = &type->id;
-        return;
-      }
+      type_id_fine_bindings(b, err, &type->id);
       break;
     case TYPE_MACRO:
-      abort(); // macros get are evaluated before binding resolution
-      break;
-    case TYPE_PTR:
-      type_fine_bindings(cx, err, ss, type->ptr, asg);
-      break;
-    case TYPE_PTR_MUT:
-      type_fine_bindings(cx, err, ss, type->ptr_mut, asg);
-      break;
-    case TYPE_ARRAY:
-      type_fine_bindings(cx, err, ss, type->array, asg);
-      break;
-    case TYPE_PRODUCT_REPEATED:
-      type_fine_bindings(cx, err, ss, type->product_repeated.inner, asg);
+      abort(); // macros are evaluated before binding resolution
       break;
-    case TYPE_PRODUCT_ANON:
-      count = sb_count(type->product_anon);
-      for (size_t i = 0; i < count; i++) {
-        type_fine_bindings(cx, err, ss, &type->product_anon[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
+    case TYPE_APP_ANON:
+      type_id_fine_bindings(b, err, &type->app_anon.tlf);
       break;
-    case TYPE_PRODUCT_NAMED:
-      count = sb_count(type->product_named.types);
-      for (size_t i = 0; i < count; i++) {
-        type_fine_bindings(cx, err, ss, &type->product_named.types[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
+    case TYPE_APP_NAMED:
+      type_id_fine_bindings(b, err, &type->app_named.tlf);
       break;
-    case TYPE_FUN_ANON:
-      count = sb_count(type->fun_anon.args);
-      for (size_t i = 0; i < count; i++) {
-        type_fine_bindings(cx, err, ss, &type->fun_anon.args[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      type_fine_bindings(cx, err, ss, type->fun_anon.ret, asg);
+    case TYPE_GENERIC:
+      ss_push_owning(&b->ss, cx_rax_new(b->cx));
+      add_type_var_bindings(b, err, type->generic.args);
       break;
-    case TYPE_FUN_NAMED:
-      count = sb_count(type->fun_named.arg_types);
-      for (size_t i = 0; i < count; i++) {
-        type_fine_bindings(cx, err, ss, &type->fun_named.arg_types[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      type_fine_bindings(cx, err, ss, type->fun_named.ret, asg);
+    default:
       break;
-    case TYPE_APP_ANON:
-      id_fine_bindings(cx, err, ss, &type->app_anon.tlf, asg);
-      if (err->tag == OO_ERR_NONE && !is_type_binding(type->app_anon.tlf.binding)) {
-        err->tag = OO_ERR_BINDING_NOT_TYPE;
-        err->binding_not_type = &type->app_anon.tlf;
-        return;
-      }
+  }
+}
 
-      count = sb_count(type->app_anon.args);
-      for (size_t i = 0; i < count; i++) {
-        type_fine_bindings(cx, err, ss, &type->app_anon.args[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case TYPE_APP_NAMED:
-      id_fine_bindings(cx, err, ss, &type->app_named.tlf, asg);
-      if (err->tag == OO_ERR_NONE && !is_type_binding(type->app_named.tlf.binding)) {
-        err->tag = OO_ERR_BINDING_NOT_TYPE;
-        err->binding_not_type = &type->app_named.tlf;
-        return;
-      }
+static void bind_type_post(void *data, OoError *err, AsgType *type) {
+  (void) err;
+  Binder *b = data;
+  if (type->tag == TYPE_GENERIC) {
+    ss_pop(&b->ss);
+  }
+}
 
-      count = sb_count(type->app_named.types);
-      for (size_t i = 0; i < count; i++) {
-        type_fine_bindings(cx, err, ss, &type->app_named.types[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case TYPE_GENERIC:
-      ss_push_owning(ss, raxNew());
-
-      for (size_t i = 0; i < (size_t) sb_count(type->generic.args); i++) {
-        AsgBinding *b = malloc(sizeof(AsgBinding));
-        b->tag = BINDING_TYPE_VAR;
-        b->private = true;
-        b->file = asg;
-        b->type_var = &type->generic.args[i];
-        ss_add(err, asg, ss, type->generic.args[i].str, b);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
+// Resolves the id of a summand pattern.
+static void summand_id_fine_bindings(Binder *b, OoError *err, AsgId *id) {
+  id_fine_bindings(b->cx, err, &b->ss, id, b->asg);
+  if (err->tag == OO_ERR_NONE && id->binding.tag != BINDING_VAL && id->binding.val.tag != VAL_SUMMAND) {
+    err->tag = OO_ERR_BINDING_NOT_SUMMAND;
+    err->asg = b->asg;
+    err->binding_not_summand = id;
+  }
+}
 
-      type_fine_bindings(cx, err, ss, type->generic.inner, asg);
-      ss_pop(ss);
-      break;
-    case TYPE_SUM:
-      count = sb_count(type->sum.summands);
-      for (size_t i = 0; i < count; i++) {
-        summand_fine_bindings(cx, err, ss, &type->sum.summands[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
+static void bind_pattern_pre(void *data, OoError *err, AsgPattern *p) {
+  Binder *b = data;
+  if (p->tag == PATTERN_SUMMAND_ANON) {
+    summand_id_fine_bindings(b, err, &p->summand_anon.id);
+  } else if (p->tag == PATTERN_SUMMAND_NAMED) {
+    summand_id_fine_bindings(b, err, &p->summand_named.id);
+    AsgBinding *summand = &p->summand_named.id.binding;
+    if (err->tag == OO_ERR_NONE && summand->tag == BINDING_VAL && summand->val.tag == VAL_SUMMAND) {
+      // the fields of an anonymous summand have no sids, so none of the pattern match
+      AsgSid *declared = summand->val.summand->tag == SUMMAND_NAMED ? summand->val.summand->named.sids : NULL;
+      int missing;
+      sb_free(p->summand_named.positions);
+      p->summand_named.positions = asg_positions(declared, p->summand_named.sids, &missing);
+      if (missing >= 0) {
+        err->tag = OO_ERR_SUMMAND_FIELD;
+        err->asg = b->asg;
+        err->summand_field = &p->summand_named.sids[missing];
       }
-      break;
+    }
+  }
+}
+
+static void bind_pattern_post(void *data, OoError *err, AsgPattern *p) {
+  Binder *b = data;
+  if (p->tag != PATTERN_ID) {
+    return;
+  }
+
+  p->id.slot = b->next_slot;
+  b->next_slot += 1;
+  if (b->fun != NULL && b->next_slot > b->fun->frame_size) {
+    b->fun->frame_size = b->next_slot;
+  }
+
+  AsgBinding *binding = malloc(sizeof(AsgBinding));
+  binding->tag = BINDING_VAL;
+  binding->private = true;
+  binding->file = b->asg;
+  binding->val.mut = p->id.mut;
+  binding->val.sid = &p->id.sid;
+  binding->val.type = p->id.type;
+  binding->val.oo_type = NULL;
+  binding->val.slot = p->id.slot;
+  binding->val.tag = VAL_PATTERN;
+  binding->val.pattern = &p->id;
+
+  ss_add(err, b->asg, &b->ss, p->id.sid.str, binding);
+}
+
+static void bind_exp_pre(void *data, OoError *err, AsgExp *exp) {
+  Binder *b = data;
+  // Labels and gotos are not resolved, we can compile to C without properly
+  // resolving them... It's ugly, but it works for the temporary compiler.
+  // TODO don't be lazy, implement proper bindings for labels and goto...
+  if (exp->tag != EXP_ID) {
+    return;
+  }
+
+  id_fine_bindings(b->cx, err, &b->ss, &exp->id, b->asg);
+  if (err->tag == OO_ERR_NONE && exp->id.binding.tag != BINDING_VAL) {
+    err->tag = OO_ERR_BINDING_NOT_EXP;
+    err->asg = b->asg;
+    err->binding_not_exp = &exp->id;
+  }
+}
+
+static void binder_init(Binder *b, OoVisitor *v, OoContext *cx, AsgFile *asg) {
+  b->cx = cx;
+  b->asg = asg;
+  b->fun = NULL;
+  b->next_slot = 0;
+  b->arm_slots = NULL;
+  ss_init(&b->ss, cx_rax_new(cx));
+  ss_push(&b->ss, asg->ns.bindings_by_sid);
+
+  oo_visitor_init(v, b);
+  v->item_pre = bind_item_pre;
+  v->item_post = bind_item_post;
+  v->body_pre = bind_body_pre;
+  v->body_post = bind_body_post;
+  v->arm_pre = bind_arm_pre;
+  v->arm_post = bind_arm_post;
+  v->type_pre = bind_type_pre;
+  v->type_post = bind_type_post;
+  v->pattern_pre = bind_pattern_pre;
+  v->pattern_post = bind_pattern_post;
+  v->exp_pre = bind_exp_pre;
+}
+
+static void binder_free(Binder *b) {
+  ss_free(&b->ss);
+  sb_free(b->arm_slots);
+}
+
+void oo_cx_fine_bind_file(OoContext *cx, OoError *err, AsgFile *asg) {
+  if (!asg->loaded || asg->fine_bound) {
+    return;
+  }
+
+  Binder b;
+  OoVisitor v;
+  binder_init(&b, &v, cx, asg);
+  oo_visit_file(cx, err, asg, &v, 1);
+  binder_free(&b);
+  if (err->tag != OO_ERR_NONE) {
+    return;
+  }
+  asg->fine_bound = true;
+}
+
+void oo_cx_fine_bindings(OoContext *cx, OoError *err) {
+  // Files may get loaded while resolving paths, so the count is not fixed.
+  for (int i = 0; i < sb_count(cx->files); i++) {
+    oo_cx_fine_bind_file(cx, err, cx->files[i]);
+    if (err->tag != OO_ERR_NONE) {
+      return;
+    }
+  }
+}
+
+void oo_cx_bind_and_kind_check_file(OoContext *cx, OoError *err, AsgFile *asg) {
+  if (!asg->loaded || asg->fine_bound) {
+    oo_cx_fine_bind_file(cx, err, asg);
+    if (err->tag == OO_ERR_NONE) {
+      oo_cx_kind_check_file(cx, err, asg);
+    }
+    return;
+  }
+
+  Binder b;
+  OoVisitor passes[2];
+  binder_init(&b, &passes[0], cx, asg);
+  oo_kind_check_visitor(&passes[1], asg);
+  oo_visit_file(cx, err, asg, passes, 2);
+  binder_free(&b);
+  if (err->tag != OO_ERR_NONE) {
+    return;
+  }
+  asg->fine_bound = true;
+  asg->kind_checked = true;
+}
+
+void oo_cx_bind_and_kind_check(OoContext *cx, OoError *err) {
+  for (int i = 0; i < sb_count(cx->files); i++) {
+    oo_cx_bind_and_kind_check_file(cx, err, cx->files[i]);
+    if (err->tag != OO_ERR_NONE) {
+      return;
+    }
   }
 }
 
@@ -1363,7 +2513,7 @@ static void id_fine_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgId
   }
 
   if (base->tag == BINDING_NS && base->ns->tag == NS_FILE) {
-    prepare_file(cx, err, base->ns->file, &id->sids[0]);
+    prepare_file(cx, err, base->ns->file, &id->sids[0], asg);
     if (err->tag != OO_ERR_NONE) {
       return;
     }
@@ -1372,286 +2522,57 @@ static void id_fine_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgId
   id->sids[0].binding = *base;
 
   size_t count = sb_count(id->sids);
+  AsgNS *base_ns = binding_get_ns(*base);
+  if (count > 1 && base_ns != NULL) {
+    // Resolution of the remaining segments only depends on the namespace of
+    // the base and on its privacy, both of which go into the key.
+    AsgBinding **cached = path_key_find(ss, base_ns, base->private, id);
+    if (cached != raxNotFound) {
+      for (size_t i = 1; i < count; i++) {
+        id->sids[i].binding = *cached[i - 1];
+      }
+      id->binding = id->sids[count - 1].binding;
+      return;
+    }
+  }
+
+  AsgBinding **path = NULL;
   for (size_t i = 1; i < count; i++) {
     AsgNS *ns = binding_get_ns(id->sids[i - 1].binding);
     if (ns == NULL) {
       err->tag = OO_ERR_ID_NOT_A_NS;
       err->asg = asg;
       err->id_not_a_ns = &id->sids[i - 1];
+      sb_free(path);
       return;
     }
 
-    rax *scope = ns->pub_bindings_by_sid;
-    if (id->sids[i - 1].binding.private) {
-      scope = ns->bindings_by_sid;
+    if (ns->tag == NS_FILE) {
+      prepare_file(cx, err, ns->file, &id->sids[i - 1], asg);
+      if (err->tag != OO_ERR_NONE) {
+        sb_free(path);
+        return;
+      }
     }
 
-    AsgBinding *b = raxFind(scope, id->sids[i].str.start, id->sids[i].str.len);
+    AsgBinding *b = ns_lookup(ns, id->sids[i].str, id->sids[i - 1].binding.private);
     if (b == raxNotFound) {
       err->tag = OO_ERR_ID_NOT_IN_NS;
       err->asg = asg;
       err->id_not_in_ns = &id->sids[i];
+      sb_free(path);
       return;
     }
 
     id->sids[i].binding = *b;
+    sb_push(path, b);
   }
 
-  id->binding = id->sids[count - 1].binding;
-}
-
-static void summand_fine_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgSummand *summand, AsgFile *asg) {
-  size_t count;
-  switch (summand->tag) {
-    case SUMMAND_ANON:
-      count = sb_count(summand->anon);
-      for (size_t i = 0; i < count; i++) {
-        type_fine_bindings(cx, err, ss, &summand->anon[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case SUMMAND_NAMED:
-      count = sb_count(summand->named.inners);
-      for (size_t i = 0; i < count; i++) {
-        type_fine_bindings(cx, err, ss, &summand->named.inners[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
+  if (path != NULL) {
+    // path_key still holds the key built by the failed lookup above
+    raxInsert(ss->paths, ss->path_key, ss->path_key_len, path, NULL);
   }
-}
 
-static void exp_fine_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgExp *exp, AsgFile *asg) {
-  size_t count;
-  switch (exp->tag) {
-    case EXP_ID:
-      id_fine_bindings(cx, err, ss, &exp->id, asg);
-      if (err->tag == OO_ERR_NONE && exp->id.binding.tag != BINDING_VAL) {
-        err->tag = OO_ERR_BINDING_NOT_EXP;
-        err->binding_not_exp = &exp->id;
-        return;
-      }
-      break;
-    case EXP_MACRO:
-      abort(); // macros are evaluated before binding resolution
-      break;
-    case EXP_LITERAL:
-      // noop
-      break;
-    case EXP_REF:
-      exp_fine_bindings(cx, err, ss, exp->ref, asg);
-      break;
-    case EXP_REF_MUT:
-      exp_fine_bindings(cx, err, ss, exp->ref_mut, asg);
-      break;
-    case EXP_DEREF:
-      exp_fine_bindings(cx, err, ss, exp->deref, asg);
-      break;
-    case EXP_DEREF_MUT:
-      exp_fine_bindings(cx, err, ss, exp->deref_mut, asg);
-      break;
-    case EXP_ARRAY:
-      exp_fine_bindings(cx, err, ss, exp->array, asg);
-      break;
-    case EXP_ARRAY_INDEX:
-      exp_fine_bindings(cx, err, ss, exp->array_index.arr, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-      exp_fine_bindings(cx, err, ss, exp->array_index.index, asg);
-      break;
-    case EXP_PRODUCT_REPEATED:
-      exp_fine_bindings(cx, err, ss, exp->product_repeated.inner, asg);
-      break;
-    case EXP_PRODUCT_ANON:
-      count = sb_count(exp->product_anon);
-      for (size_t i = 0; i < count; i++) {
-        exp_fine_bindings(cx, err, ss, &exp->product_anon[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case EXP_PRODUCT_NAMED:
-      count = sb_count(exp->product_named.inners);
-      for (size_t i = 0; i < count; i++) {
-        exp_fine_bindings(cx, err, ss, &exp->product_named.inners[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case EXP_PRODUCT_ACCESS_ANON:
-      exp_fine_bindings(cx, err, ss, exp->product_access_anon.inner, asg);
-      break;
-    case EXP_PRODUCT_ACCESS_NAMED:
-      exp_fine_bindings(cx, err, ss, exp->product_access_named.inner, asg);
-      break;
-    case EXP_FUN_APP_ANON:
-      exp_fine_bindings(cx, err, ss, exp->fun_app_anon.fun, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-
-      count = sb_count(exp->fun_app_anon.args);
-      for (size_t i = 0; i < count; i++) {
-        exp_fine_bindings(cx, err, ss, &exp->fun_app_anon.args[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case EXP_FUN_APP_NAMED:
-      exp_fine_bindings(cx, err, ss, exp->fun_app_named.fun, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-
-      count = sb_count(exp->fun_app_named.args);
-      for (size_t i = 0; i < count; i++) {
-        exp_fine_bindings(cx, err, ss, &exp->fun_app_named.args[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case EXP_CAST:
-      exp_fine_bindings(cx, err, ss, exp->cast.inner, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-
-      type_fine_bindings(cx, err, ss, exp->cast.type, asg);
-      break;
-    case EXP_SIZE_OF:
-      type_fine_bindings(cx, err, ss, exp->size_of, asg);
-      break;
-    case EXP_ALIGN_OF:
-      type_fine_bindings(cx, err, ss, exp->align_of, asg);
-      break;
-    case EXP_NOT:
-      exp_fine_bindings(cx, err, ss, exp->exp_not, asg);
-      break;
-    case EXP_NEGATE:
-      exp_fine_bindings(cx, err, ss, exp->exp_negate, asg);
-      break;
-    case EXP_WRAPPING_NEGATE:
-      exp_fine_bindings(cx, err, ss, exp->exp_wrapping_negate, asg);
-      break;
-    case EXP_BIN_OP:
-      exp_fine_bindings(cx, err, ss, exp->bin_op.lhs, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-
-      exp_fine_bindings(cx, err, ss, exp->bin_op.rhs, asg);
-      break;
-    case EXP_ASSIGN:
-      exp_fine_bindings(cx, err, ss, exp->assign.lhs, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-
-      exp_fine_bindings(cx, err, ss, exp->assign.rhs, asg);
-      break;
-    case EXP_VAL:
-      add_pattern_bindings(cx, err, ss, &exp->val, asg);
-      break;
-    case EXP_VAL_ASSIGN:
-      exp_fine_bindings(cx, err, ss, exp->val_assign.rhs, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-
-      add_pattern_bindings(cx, err, ss, &exp->val_assign.lhs, asg);
-      break;
-    case EXP_BLOCK:
-      block_fine_bindings(cx, err, ss, &exp->block, asg);
-      break;
-    case EXP_IF:
-      exp_fine_bindings(cx, err, ss, exp->exp_if.cond, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-
-      block_fine_bindings(cx, err, ss, &exp->exp_if.if_block, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-
-      block_fine_bindings(cx, err, ss, &exp->exp_if.else_block, asg);
-      break;
-    case EXP_CASE:
-      exp_fine_bindings(cx, err, ss, exp->exp_case.matcher, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-
-      count = sb_count(exp->exp_case.patterns);
-      for (size_t i = 0; i < count; i++) {
-        ss_push_owning(ss, raxNew());
-        add_pattern_bindings(cx, err, ss, &exp->exp_case.patterns[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-        block_fine_bindings(cx, err, ss, &exp->exp_case.blocks[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-        ss_pop(ss);
-      }
-      break;
-    case EXP_WHILE:
-      exp_fine_bindings(cx, err, ss, exp->exp_while.cond, asg);
-      block_fine_bindings(cx, err, ss, &exp->exp_while.block, asg);
-      break;
-    case EXP_LOOP:
-      exp_fine_bindings(cx, err, ss, exp->exp_loop.matcher, asg);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-
-      count = sb_count(exp->exp_loop.patterns);
-      for (size_t i = 0; i < count; i++) {
-        ss_push_owning(ss, raxNew());
-        add_pattern_bindings(cx, err, ss, &exp->exp_loop.patterns[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-        block_fine_bindings(cx, err, ss, &exp->exp_loop.blocks[i], asg);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-        ss_pop(ss);
-      }
-      break;
-    case EXP_RETURN:
-      if (exp->exp_return != NULL) {
-        exp_fine_bindings(cx, err, ss, exp->exp_return, asg);
-      }
-      break;
-    case EXP_BREAK:
-      if (exp->exp_break != NULL) {
-        exp_fine_bindings(cx, err, ss, exp->exp_break, asg);
-      }
-      break;
-    case EXP_GOTO:
-    case EXP_LABEL:
-      // we can compile to C without properly resolving these... It's ugly, but
-      // it works for the temporary compiler.
-      // TODO don't be lazy, implement proper bindings for labels and goto...
-      break;
-  }
+  id->binding = id->sids[count - 1].binding;
 }
 
-static void block_fine_bindings(OoContext *cx, OoError *err, ScopeStack *ss, AsgBlock *block, AsgFile *asg) {
-  for (size_t i = 0; i < (size_t) sb_count(block->exps); i++) {
-    exp_fine_bindings(cx, err, ss, &block->exps[i], asg);
-    if (err->tag != OO_ERR_NONE) {
-      return;
-    }
-  }
-}
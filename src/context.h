@@ -1,10 +1,18 @@
 #ifndef OO_CONTEXT_H
 #define OO_CONTEXT_H
 
+#include <stdio.h>
+
 #include "asg.h"
+#include "cc.h"
+#include "sha256.h"
 #include "parser.h"
+#include "pool.h"
+#include "query.h"
 #include "rax.h"
+#include "types.h"
 #include "util.h"
+#include "visit.h"
 
 // TODO move error stuff into its own header
 typedef enum {
@@ -14,7 +22,9 @@ typedef enum {
   OO_ERR_ID_NOT_IN_NS, OO_ERR_BINDING_NOT_TYPE, OO_ERR_BINDING_NOT_EXP,
   OO_ERR_DUP_ID_SCOPE, OO_ERR_BINDING_NOT_SUMMAND, OO_ERR_NOT_CONST_EXP,
   OO_ERR_WRONG_NUMBER_OF_TYPE_ARGS, OO_ERR_HIGHER_ORDER_TYPE_ARG,
-  OO_ERR_NAMED_TYPE_APP_SID
+  OO_ERR_NAMED_TYPE_APP_SID, OO_ERR_CYCLIC_ALIAS, OO_ERR_NO_LAYOUT,
+  OO_ERR_CONST_ARITHMETIC, OO_ERR_TYPE_MISMATCH, OO_ERR_NOT_CONST_REPEAT,
+  OO_ERR_SUMMAND_FIELD, OO_ERR_IFACE_VAL
 } OoErrorTag;
 
 typedef struct OoError {
@@ -39,10 +49,31 @@ typedef struct OoError {
     AsgType *wrong_number_of_type_args; // TYPE_APP_ANON or TYPE_APP_NAMED
     AsgType *higher_order_type_arg;
     AsgSid *named_type_app_sid;
+    AsgSid *cyclic_alias; // a type item whose chain of aliases loops
+    AsgType *no_layout; // argument of a sizeof or alignof without a size
+    Str const_arithmetic; // an operation that overflows, divides by zero or shifts too far
+    AsgExp *type_mismatch; // an expression whose type does not fit its context
+    AsgRepeat *not_const_repeat; // a repetition that can not be evaluated at compile time
+    AsgSid *summand_field; // a field of a named summand pattern that the summand lacks or that is repeated
+    AsgItemVal *iface_val; // a val of an interface file, whose expression is not available
   };
 } OoError;
 
 void err_print(OoError *err);
+// Like err_print, but writes to the given stream.
+void err_fprint(FILE *f, OoError *err);
+
+// A read-only memory mapping of a file.
+typedef struct OoMapping {
+  void *addr;
+  size_t len;
+} OoMapping;
+
+// Backs the raxes created by one worker thread of a parallel pass.
+typedef struct OoWorkerPool {
+  OoPool pool;
+  raxAllocator alloc;
+} OoWorkerPool;
 
 // Owns all data related to the multiple asgs of a parser run (including the asgs themselves).
 typedef struct OoContext {
@@ -59,17 +90,104 @@ typedef struct OoContext {
   AsgNS **dirs;
   // Owning stretchy buffer of the source text of all files
   char **sources;
+  // If set before calling oo_cx_parse, the `dep` namespace is built from this
+  // directory instead of from deps. It must mirror the deps directory, but
+  // contain the interface files emitted by look_iface instead of the sources.
+  // Defaults to NULL.
+  const char *dep_ifaces;
+  // Owning stretchy buffer of the mappings of all loaded interface files,
+  // the asgs of these files point into them.
+  OoMapping *mappings;
+  // Ids of all features named by cc attributes or by feature sets passed to the context.
+  OoFeatureTable features;
+  // Owns all OoTypes assigned by the type checker.
+  OoTypeTable types;
+  // Memoized layouts, from interned OoTypes to owned OoLayouts (see layout.h).
+  rax *layouts;
+  // Memoized values of val items, from AsgItemVal pointers to owned OoConsts
+  // (see eval.h).
+  rax *consts;
+  // Memoized results of checking function bodies, and their dependencies.
+  OoQueryTable queries;
+  // If set before calling oo_cx_parse, the files in the deps directory are only
+  // enumerated, and each is read and parsed once a use or a path reaches it.
+  // Defaults to false.
+  bool lazy_deps;
+  // If set before calling oo_cx_parse, function bodies are only parsed once
+  // they are needed, see oo_cx_force_body. Defaults to false.
+  bool lazy_bodies;
+  // If set before calling oo_cx_parse, sources are mapped from their files
+  // instead of being read into memory, and function bodies are parsed lazily,
+  // see oo_cx_stream. Defaults to false.
+  bool streaming;
+  // If set before calling oo_cx_parse, the asgs of parsed files are stored in
+  // this (existing) directory, keyed by a hash of their source, the parser
+  // version and the parse options. Files whose key is found there are loaded
+  // instead of being parsed. Defaults to NULL, which disables the cache.
+  const char *cache_dir;
+  // Hash of everything besides the source text that the asgs in the cache
+  // depend on, set by oo_cx_parse.
+  uint8_t cache_config[OO_SHA256_LEN];
+  // The parser state, kept around for parsing function bodies lazily.
+  ParserCx pcx;
+  // The features oo_cx_parse was called with, backs pcx.enabled.
+  OoFeatureSet parse_enabled;
+  // The features of the last call to oo_cx_filter_cc, only valid if filtered is set.
+  OoFeatureSet filter;
+  bool filtered;
+  // Attribute registry: maps the names of all item attributes to dense ids.
+  rax *attr_ids;
+  // Inverted attribute index: stretchy buffer indexed by attribute id, of
+  // owning stretchy buffers of all items carrying the attribute (including
+  // disabled items), in the order in which they were parsed.
+  AsgItem ***items_by_attr;
+  // Backs all raxes of namespaces and scopes, its counters report their memory usage.
+  OoPool rax_pool;
+  // Allocator handle for rax_pool, referenced by every rax created by the context.
+  raxAllocator rax_alloc;
+  // Number of threads oo_cx_coarse_bindings may use. 0 (the default) uses one
+  // per online processor, 1 binds all files on the calling thread.
+  int threads;
+  // Owning stretchy buffer of owned pools, one per worker thread, these back the
+  // raxes created by worker threads instead of rax_pool. Created by the first
+  // parallel pass and reused by all later ones.
+  OoWorkerPool **worker_pools;
+  // Bytes freed by oo_cx_release_syntax_types so far.
+  size_t released_syntax;
 } OoContext;
 
 // Initializes a context, but does not perform any parsing yet.
+// The context must not be moved in memory after initialization.
 void oo_cx_init(OoContext *cx, const char *mods, const char *deps);
 
 // Parses all files relevant to the current mod and deps, and adds them to cx->files.
-// Applies conditional compilation based on the given features.
+// Applies conditional compilation based on the given features, disabled code
+// is not even added to the asgs. Pass NULL to keep everything, e.g. in order
+// to analyze several configurations via oo_cx_filter_cc.
 // Also creates the cx->dirs.
 void oo_cx_parse(OoContext *cx, OoError *err, rax *features);
 
-// Resolves the top-level bindings of all files.
+// Marks all items and expressions whose cc attributes don't match the given
+// features as disabled (and all others as enabled), without moving any nodes.
+// Call oo_cx_reset_analysis before analyzing the context again.
+void oo_cx_filter_cc(OoContext *cx, rax *features);
+
+// Discards the results of all analyses (namespaces, bindings, types), so that
+// the context can be analyzed again, e.g. for a different set of features.
+void oo_cx_reset_analysis(OoContext *cx);
+
+// Reads the given files (a stretchy buffer) again, and discards the analysis
+// results of these files and of all files that transitively depend on them
+// (see AsgFile.dependents). The passes only analyze files that have not been
+// analyzed yet, so running them afterwards only recomputes what changed. The
+// queries about the other files (see query.h) are kept, except for layouts.
+// Files that have not been loaded yet are left to be loaded on demand.
+// Adding or removing files is not supported, use a fresh context for that.
+void oo_cx_reload(OoContext *cx, OoError *err, AsgFile **changed);
+
+// Resolves the top-level bindings of all files. Files whose imports can be
+// read off their use trees are bound in parallel waves (see threads), the
+// results and errors are the same as when binding them one after the other.
 void oo_cx_coarse_bindings(OoContext *cx, OoError *err);
 
 // Resolves the bindings inside the items of all files.
@@ -78,10 +196,115 @@ void oo_cx_fine_bindings(OoContext *cx, OoError *err);
 // Checks that all type-level applications use types of the correct kinds and names.
 void oo_cx_kind_checking(OoContext *cx, OoError *err);
 
+// Fine binding and kind checking of all files, fused into a single traversal
+// of each file (see visit.h). The results are the same as those of running the
+// two passes one after the other, except that an error of kind checking in one
+// file may be reported before an error of binding in a later file.
+void oo_cx_bind_and_kind_check(OoContext *cx, OoError *err);
+
 // Assigns a type to each expression, and checks that the typing rules are satisfied.
 void oo_cx_type_checking(OoContext *cx, OoError *err);
 
+// Function bodies are checked on demand, by memoized queries (see query.h).
+// Errors in bodies are reported as OO_ERR_TYPE_MISMATCH (or as the errors of
+// sizeof, alignof and constant repeats). Bodies of interface files, and bodies
+// that are not bound (skipped by a lazy parse, or dropped by oo_cx_stream), are
+// not checked.
+
+// Checks the body of a function item against its signature.
+void oo_cx_check_fun(OoContext *cx, OoError *err, AsgItem *item);
+
+// Checks the bodies of all function items of the file.
+void oo_cx_check_file_bodies(OoContext *cx, OoError *err, AsgFile *asg);
+
+// Checks the bodies of the given function items (a stretchy buffer) and of all
+// functions they refer to, transitively. Nothing else is checked.
+void oo_cx_check_reachable(OoContext *cx, OoError *err, AsgItem **roots);
+
+// The type of an expression in a function body, NULL if it can not be
+// inferred. The result is the one computed when checking the body, if that has
+// happened already.
+OoType *oo_cx_exp_type(OoContext *cx, OoError *err, AsgExp *exp);
+
+// Like the corresponding passes on the whole context, but only analyze the
+// given file (whose imports must have been analyzed already).
+void oo_cx_fine_bind_file(OoContext *cx, OoError *err, AsgFile *asg);
+void oo_cx_kind_check_file(OoContext *cx, OoError *err, AsgFile *asg);
+void oo_cx_bind_and_kind_check_file(OoContext *cx, OoError *err, AsgFile *asg);
+
+// Sets up v as the visitor of kind checking the given (fine bound) file, to be
+// run after a visitor that resolves bindings or on its own.
+void oo_kind_check_visitor(OoVisitor *v, AsgFile *asg);
+void oo_cx_type_check_file(OoContext *cx, OoError *err, AsgFile *asg);
+
+// Lowers a (fine bound) AsgType to its interned OoType, NULL for macros.
+OoType *oo_cx_lower_type(OoContext *cx, OoError *err, AsgType *type);
+
+// Resolves the chain of aliases starting at the type item if that has not
+// happened yet (see oo_cx_canonical_type), lowering the items along it. Loops
+// are reported as OO_ERR_CYCLIC_ALIAS, in the file of the first item of the loop.
+OoType *oo_cx_resolve_alias(OoContext *cx, OoError *err, AsgItemType *item);
+
+// Resolves aliases in O(1): if t names a type item, returns the first type along
+// the chain of aliases starting at that item that does not name another type
+// item, else t itself. Type checking a file resolves the chains of all its type
+// items (erroring with OO_ERR_CYCLIC_ALIAS on loops) and caches the result on
+// every item along them, so the item must be in a typed file.
+OoType *oo_cx_canonical_type(OoType *t);
+
+// Frees the syntax of the types of all typed files that no later phase reads:
+// OoTypes only refer to the final bindings of ids, not to their path segments.
+// The spans of all nodes are kept for diagnostics. The bindings of the
+// affected files cannot be resolved again afterwards, so oo_cx_reset_analysis
+// and oo_cx_reload must not be used.
+void oo_cx_release_syntax_types(OoContext *cx);
+// Like oo_cx_release_syntax_types, but for a single file.
+void oo_cx_release_file_syntax_types(OoContext *cx, AsgFile *asg);
+
+// Memory usage of the process and of a context.
+typedef struct OoMemStats {
+  size_t peak_rss; // maximum resident set size of the process so far, in bytes
+  size_t ns_in_use; // bytes of namespace nodes currently allocated, over all pools
+  size_t ns_peak; // sum of the peaks of all pools of namespace nodes
+  size_t released_syntax; // see oo_cx_release_syntax_types
+} OoMemStats;
+
+OoMemStats oo_cx_mem_stats(OoContext *cx);
+
+// Receives each file analyzed by oo_cx_stream, before its bodies are dropped.
+typedef void (*OoStreamFn)(OoContext *cx, AsgFile *asg, void *data);
+
+// Runs all passes while keeping only one file's bodies in memory at a time
+// (set streaming before oo_cx_parse). After resolving the top-level bindings of
+// all files, the files are analyzed one by one in dependency order and passed
+// to emit (which may be NULL). Then the function bodies of the file are freed
+// and the pages of its source are released. The namespaces, signatures and
+// val expressions stay resident, with the syntax of the signature types
+// released (see oo_cx_release_syntax_types). The source is paged in again when
+// accessed. Afterwards, the bodies of the files are unbound again when forced.
+void oo_cx_stream(OoContext *cx, OoError *err, OoStreamFn emit, void *data);
+
+// Parses the body of a function item if that has been deferred by a lazy parse
+// (see lazy_bodies), otherwise does nothing. Errors are reported as OO_ERR_SYNTAX.
+void oo_cx_force_body(OoContext *cx, OoError *err, AsgItem *item);
+
+#define OO_ATTR_NONE UINT32_MAX
+
+// Returns the id of the attribute of the given name, or OO_ATTR_NONE if no
+// parsed item carries such an attribute.
+uint32_t oo_cx_attr_id(OoContext *cx, const char *name, size_t len);
+
+// Returns a stretchy buffer of all items carrying the attribute of the given
+// name (e.g. "test_pure"). The buffer is owned by the context, NULL if there
+// are no such items.
+AsgItem **oo_cx_items_with_attr(OoContext *cx, const char *name, size_t len);
+
+// Finds the file whose source contains s, NULL if there is none. For reporting
+// errors in nodes that are reached through other files.
+AsgFile *oo_cx_file_of(OoContext *cx, Str s);
+
 // Frees all data owned by the context, including all parsed files and all namespaces.
+// The raxes of the namespaces are released in bulk together with rax_pool.
 // The `mods` and `deps` directory paths are not freed.
 void oo_cx_free(OoContext *cx);
 
@@ -0,0 +1,618 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "eval.h"
+#include "layout.h"
+#include "stretchy_buffer.h"
+
+// Memoized for vals whose value is being computed. Reaching such a val again
+// means that it depends on itself.
+static OoConst in_progress;
+
+static size_t width(AsgPrimitive prim) {
+  switch (prim) {
+    case PRIM_U8:
+    case PRIM_I8:
+      return 8;
+    case PRIM_U16:
+    case PRIM_I16:
+      return 16;
+    case PRIM_U32:
+    case PRIM_I32:
+      return 32;
+    case PRIM_U64:
+    case PRIM_I64:
+      return 64;
+    case PRIM_U128:
+    case PRIM_I128:
+      return 128;
+    case PRIM_USIZE:
+    case PRIM_ISIZE:
+      return 8 * OO_PTR_SIZE;
+    default:
+      return 0; // not an integer type
+  }
+}
+
+static bool is_signed(AsgPrimitive prim) {
+  return prim == PRIM_I8 || prim == PRIM_I16 || prim == PRIM_I32 ||
+    prim == PRIM_I64 || prim == PRIM_I128 || prim == PRIM_ISIZE;
+}
+
+static OoU128 truncate(OoU128 bits, AsgPrimitive prim) {
+  size_t w = width(prim);
+  return w == 128 ? bits : bits & (((OoU128) 1 << w) - 1);
+}
+
+OoI128 oo_const_signed(const OoConst *c) {
+  size_t w = width(c->prim);
+  if (!is_signed(c->prim) || w == 128) {
+    return (OoI128) c->bits;
+  }
+  OoU128 sign = (OoU128) 1 << (w - 1);
+  return (OoI128) ((c->bits ^ sign) - sign);
+}
+
+static OoI128 max_signed(AsgPrimitive prim) {
+  return (OoI128) (((OoU128) 1 << (width(prim) - 1)) - 1);
+}
+
+static bool fits_signed(OoI128 v, AsgPrimitive prim) {
+  return v <= max_signed(prim) && v >= -max_signed(prim) - 1;
+}
+
+static bool fits_unsigned(OoU128 v, AsgPrimitive prim) {
+  return truncate(v, prim) == v;
+}
+
+static OoConst new_int(AsgPrimitive prim, OoU128 bits) {
+  OoConst c;
+  c.tag = OO_CONST_INT;
+  c.prim = prim;
+  c.bits = truncate(bits, prim);
+  c.fields = NULL;
+  c.sids = NULL;
+  return c;
+}
+
+static OoConst new_bool(bool b) {
+  OoConst c = new_int(PRIM_BOOL, b ? 1 : 0);
+  c.tag = OO_CONST_BOOL;
+  c.bits = b ? 1 : 0;
+  return c;
+}
+
+static void free_inner_const(OoConst c) {
+  for (int i = 0; i < sb_count(c.fields); i++) {
+    free_inner_const(*c.fields[i]);
+    free(c.fields[i]);
+  }
+  sb_free(c.fields);
+}
+
+static OoConst copy_const(const OoConst *c) {
+  OoConst copy = *c;
+  copy.fields = NULL;
+  for (int i = 0; i < sb_count(c->fields); i++) {
+    OoConst *field = malloc(sizeof(OoConst));
+    *field = copy_const(c->fields[i]);
+    sb_push(copy.fields, field);
+  }
+  return copy;
+}
+
+static bool not_const(OoContext *cx, OoError *err, AsgExp *exp) {
+  err->tag = OO_ERR_NOT_CONST_EXP;
+  err->not_const_exp = exp;
+  AsgFile *asg = oo_cx_file_of(cx, exp->str);
+  if (asg != NULL) {
+    err->asg = asg;
+  }
+  return false;
+}
+
+static bool arithmetic_error(OoContext *cx, OoError *err, Str str) {
+  err->tag = OO_ERR_CONST_ARITHMETIC;
+  err->const_arithmetic = str;
+  AsgFile *asg = oo_cx_file_of(cx, str);
+  if (asg != NULL) {
+    err->asg = asg;
+  }
+  return false;
+}
+
+// Applies an operator to two ints of the same type. Returns false on
+// overflow, division by zero and shifts by at least the width.
+static bool int_op(AsgBinOp op, const OoConst *lhs, const OoConst *rhs, OoConst *out) {
+  AsgPrimitive prim = lhs->prim;
+  bool sig = is_signed(prim);
+  OoI128 a = oo_const_signed(lhs);
+  OoI128 b = oo_const_signed(rhs);
+  OoI128 r;
+  OoU128 ur;
+  bool overflow;
+
+  switch (op) {
+    case OP_PLUS:
+    case OP_MINUS:
+    case OP_TIMES:
+      if (sig) {
+        if (op == OP_PLUS) {
+          overflow = __builtin_add_overflow(a, b, &r);
+        } else if (op == OP_MINUS) {
+          overflow = __builtin_sub_overflow(a, b, &r);
+        } else {
+          overflow = __builtin_mul_overflow(a, b, &r);
+        }
+        *out = new_int(prim, (OoU128) r);
+        return !overflow && fits_signed(r, prim);
+      } else {
+        if (op == OP_PLUS) {
+          overflow = __builtin_add_overflow(lhs->bits, rhs->bits, &ur);
+        } else if (op == OP_MINUS) {
+          overflow = __builtin_sub_overflow(lhs->bits, rhs->bits, &ur);
+        } else {
+          overflow = __builtin_mul_overflow(lhs->bits, rhs->bits, &ur);
+        }
+        *out = new_int(prim, ur);
+        return !overflow && fits_unsigned(ur, prim);
+      }
+    case OP_WRAPPING_PLUS:
+      *out = new_int(prim, lhs->bits + rhs->bits);
+      return true;
+    case OP_WRAPPING_MINUS:
+      *out = new_int(prim, lhs->bits - rhs->bits);
+      return true;
+    case OP_WRAPPING_TIMES:
+      *out = new_int(prim, lhs->bits * rhs->bits);
+      return true;
+    case OP_DIV:
+    case OP_MOD:
+      if (rhs->bits == 0) {
+        return false;
+      }
+      if (sig) {
+        if (b == -1) {
+          // a / -1 overflows for the minimum (and is undefined in C for I128)
+          *out = new_int(prim, op == OP_DIV ? -(OoU128) a : 0);
+          return op == OP_MOD || a != -max_signed(prim) - 1;
+        }
+        *out = new_int(prim, (OoU128) (op == OP_DIV ? a / b : a % b));
+      } else {
+        *out = new_int(prim, op == OP_DIV ? lhs->bits / rhs->bits : lhs->bits % rhs->bits);
+      }
+      return true;
+    case OP_SHIFT_L:
+    case OP_SHIFT_R:
+      if ((is_signed(rhs->prim) && b < 0) || rhs->bits >= width(prim)) {
+        return false;
+      }
+      if (op == OP_SHIFT_L) {
+        *out = new_int(prim, lhs->bits << (unsigned) rhs->bits);
+      } else if (sig) {
+        *out = new_int(prim, (OoU128) (a >> (unsigned) rhs->bits));
+      } else {
+        *out = new_int(prim, lhs->bits >> (unsigned) rhs->bits);
+      }
+      return true;
+    case OP_OR:
+      *out = new_int(prim, lhs->bits | rhs->bits);
+      return true;
+    case OP_AND:
+      *out = new_int(prim, lhs->bits & rhs->bits);
+      return true;
+    case OP_XOR:
+      *out = new_int(prim, lhs->bits ^ rhs->bits);
+      return true;
+    case OP_EQ:
+      *out = new_bool(lhs->bits == rhs->bits);
+      return true;
+    case OP_NEQ:
+      *out = new_bool(lhs->bits != rhs->bits);
+      return true;
+    case OP_GT:
+      *out = new_bool(sig ? a > b : lhs->bits > rhs->bits);
+      return true;
+    case OP_GET:
+      *out = new_bool(sig ? a >= b : lhs->bits >= rhs->bits);
+      return true;
+    case OP_LT:
+      *out = new_bool(sig ? a < b : lhs->bits < rhs->bits);
+      return true;
+    case OP_LET:
+      *out = new_bool(sig ? a <= b : lhs->bits <= rhs->bits);
+      return true;
+    case OP_LAND:
+    case OP_LOR:
+      break;
+  }
+  abort(); // logical operators are only applied to bools
+}
+
+// Parses a decimal literal, returns false if it does not fit the type.
+// Parses an int literal of type prim. If negated, the literal is the operand of
+// a minus and out is set to its negation, so the magnitude of a signed type may
+// be one larger (for the minimum).
+static bool parse_int(Str str, AsgPrimitive prim, bool negated, OoConst *out) {
+  OoU128 v = 0;
+  for (size_t i = 0; i < str.len; i++) {
+    if (__builtin_mul_overflow(v, 10, &v) || __builtin_add_overflow(v, (OoU128) (str.start[i] - '0'), &v)) {
+      return false;
+    }
+  }
+  *out = new_int(prim, negated ? -v : v);
+  if (is_signed(prim)) {
+    return v <= (OoU128) max_signed(prim) + negated;
+  } else if (negated) {
+    return v == 0;
+  } else {
+    return fits_unsigned(v, prim);
+  }
+}
+
+// Follows aliases.
+static OoType *resolve(OoContext *cx, OoError *err, OoType *t) {
+  if (t != NULL && t->tag == OO_TYPE_BINDING && t->binding->tag == BINDING_TYPE) {
+    return oo_cx_resolve_alias(cx, err, t->binding->type);
+  }
+  return t;
+}
+
+// The integer type expected by t, or PRIM_USIZE.
+static AsgPrimitive expected_int(OoType *t) {
+  if (t != NULL && t->tag == OO_TYPE_BINDING && t->binding->tag == BINDING_PRIMITIVE && width(t->binding->primitive) > 0) {
+    return t->binding->primitive;
+  }
+  return PRIM_USIZE;
+}
+
+// The expected type of the i-th field of a product of type t, or NULL.
+static OoType *expected_field(OoType *t, int i) {
+  if (t != NULL && t->tag == OO_TYPE_PRODUCT_ANON && i < sb_count(t->product_anon)) {
+    return t->product_anon[i];
+  } else if (t != NULL && t->tag == OO_TYPE_PRODUCT_NAMED && i < sb_count(t->product_named.types)) {
+    return t->product_named.types[i];
+  } else if (t != NULL && t->tag == OO_TYPE_PRODUCT_REPEATED) {
+    return t->product_repeated.inner;
+  }
+  return NULL;
+}
+
+static bool layout_query(OoContext *cx, OoError *err, AsgType *type, bool size, OoConst *out) {
+  OoType *t = oo_cx_lower_type(cx, err, type);
+  if (err->tag != OO_ERR_NONE) {
+    return false;
+  }
+  const OoLayout *layout = oo_cx_layout(cx, err, t);
+  if (err->tag != OO_ERR_NONE) {
+    return false;
+  }
+  if (layout == NULL) {
+    err->tag = OO_ERR_NO_LAYOUT;
+    err->no_layout = type;
+    AsgFile *asg = oo_cx_file_of(cx, type->str);
+    if (asg != NULL) {
+      err->asg = asg;
+    }
+    return false;
+  }
+  *out = new_int(PRIM_USIZE, size ? layout->size : layout->align);
+  return true;
+}
+
+static bool eval_repeat(OoContext *cx, OoError *err, AsgRepeat *repeat, OoConst *out) {
+  OoConst lhs;
+  OoConst rhs;
+  bool ok;
+  switch (repeat->tag) {
+    case REPEAT_INT:
+      return parse_int(repeat->str, PRIM_USIZE, false, out) || arithmetic_error(cx, err, repeat->str);
+    case REPEAT_SIZE_OF:
+      return layout_query(cx, err, repeat->size_of, true, out);
+    case REPEAT_ALIGN_OF:
+      return layout_query(cx, err, repeat->align_of, false, out);
+    case REPEAT_BIN_OP:
+      if (!eval_repeat(cx, err, repeat->bin_op.lhs, &lhs) || !eval_repeat(cx, err, repeat->bin_op.rhs, &rhs)) {
+        return false;
+      }
+      ok = int_op(repeat->bin_op.op, &lhs, &rhs, out);
+      return ok || arithmetic_error(cx, err, repeat->str);
+    case REPEAT_MACRO:
+      break;
+  }
+
+  // macros in repeats are not expanded yet
+  err->tag = OO_ERR_NOT_CONST_REPEAT;
+  err->not_const_repeat = repeat;
+  AsgFile *asg = oo_cx_file_of(cx, repeat->str);
+  if (asg != NULL) {
+    err->asg = asg;
+  }
+  return false;
+}
+
+uint64_t oo_cx_eval_repeat(OoContext *cx, OoError *err, AsgRepeat *repeat) {
+  OoConst c;
+  return eval_repeat(cx, err, repeat, &c) ? (uint64_t) c.bits : 0;
+}
+
+static bool eval_exp(OoContext *cx, OoError *err, AsgExp *exp, OoType *expected, OoConst *out);
+
+static bool eval_fields(OoContext *cx, OoError *err, AsgExp *exps, OoType *expected, OoConst *out) {
+  out->tag = OO_CONST_PRODUCT;
+  out->fields = NULL;
+  out->sids = NULL;
+  for (int i = 0; i < sb_count(exps); i++) {
+    OoConst *field = malloc(sizeof(OoConst));
+    if (!eval_exp(cx, err, &exps[i], expected_field(expected, i), field)) {
+      free(field);
+      free_inner_const(*out);
+      return false;
+    }
+    sb_push(out->fields, field);
+  }
+  return true;
+}
+
+static bool eval_bin_op(OoContext *cx, OoError *err, AsgExp *exp, OoType *expected, OoConst *out) {
+  OoConst lhs;
+  OoConst rhs;
+  AsgBinOp op = exp->bin_op.op;
+  bool comparison = op == OP_EQ || op == OP_NEQ || op == OP_GT || op == OP_GET || op == OP_LT || op == OP_LET;
+  bool shift = op == OP_SHIFT_L || op == OP_SHIFT_R;
+
+  // The operands of comparisons have no expected type, the right one is
+  // expected to have the type of the left one.
+  if (!eval_exp(cx, err, exp->bin_op.lhs, comparison ? NULL : expected, &lhs)) {
+    return false;
+  }
+  OoType *rhs_expected = expected;
+  OoType prim;
+  AsgBinding binding;
+  if (comparison && lhs.tag == OO_CONST_INT) {
+    binding.tag = BINDING_PRIMITIVE;
+    binding.primitive = lhs.prim;
+    prim.tag = OO_TYPE_BINDING;
+    prim.binding = &binding;
+    rhs_expected = &prim;
+  } else if (shift) {
+    rhs_expected = NULL;
+  }
+  if (!eval_exp(cx, err, exp->bin_op.rhs, rhs_expected, &rhs)) {
+    free_inner_const(lhs);
+    return false;
+  }
+
+  if (lhs.tag == OO_CONST_BOOL && rhs.tag == OO_CONST_BOOL) {
+    switch (op) {
+      case OP_LAND:
+      case OP_AND:
+        *out = new_bool(lhs.bits && rhs.bits);
+        return true;
+      case OP_LOR:
+      case OP_OR:
+        *out = new_bool(lhs.bits || rhs.bits);
+        return true;
+      case OP_XOR:
+      case OP_NEQ:
+        *out = new_bool(lhs.bits != rhs.bits);
+        return true;
+      case OP_EQ:
+        *out = new_bool(lhs.bits == rhs.bits);
+        return true;
+      default:
+        return not_const(cx, err, exp);
+    }
+  } else if (lhs.tag == OO_CONST_INT && rhs.tag == OO_CONST_INT && (shift || lhs.prim == rhs.prim)) {
+    if (op == OP_LAND || op == OP_LOR) {
+      return not_const(cx, err, exp);
+    }
+    return int_op(op, &lhs, &rhs, out) || arithmetic_error(cx, err, exp->str);
+  } else {
+    free_inner_const(lhs);
+    free_inner_const(rhs);
+    return not_const(cx, err, exp);
+  }
+}
+
+static bool eval_cast(OoContext *cx, OoError *err, AsgExp *exp, OoConst *out) {
+  OoConst inner;
+  if (!eval_exp(cx, err, exp->cast.inner, NULL, &inner)) {
+    return false;
+  }
+  OoType *target = resolve(cx, err, oo_cx_lower_type(cx, err, exp->cast.type));
+  if (err->tag != OO_ERR_NONE) {
+    free_inner_const(inner);
+    return false;
+  }
+
+  if (
+    target != NULL && target->tag == OO_TYPE_BINDING && target->binding->tag == BINDING_PRIMITIVE &&
+    width(target->binding->primitive) > 0 && inner.tag != OO_CONST_PRODUCT
+  ) {
+    OoU128 bits = inner.tag == OO_CONST_INT ? (OoU128) oo_const_signed(&inner) : inner.bits;
+    *out = new_int(target->binding->primitive, bits);
+    return true;
+  }
+  free_inner_const(inner);
+  return not_const(cx, err, exp);
+}
+
+static bool eval_exp(OoContext *cx, OoError *err, AsgExp *exp, OoType *expected, OoConst *out) {
+  expected = resolve(cx, err, expected);
+  if (err->tag != OO_ERR_NONE) {
+    return false;
+  }
+
+  const OoConst *val;
+  OoConst inner;
+  AsgPrimitive prim;
+  switch (exp->tag) {
+    case EXP_LITERAL:
+      switch (exp->lit.tag) {
+        case LITERAL_INT:
+          return parse_int(exp->lit.str, expected_int(expected), false, out) || arithmetic_error(cx, err, exp->str);
+        case LITERAL_TRUE:
+        case LITERAL_FALSE:
+          *out = new_bool(exp->lit.tag == LITERAL_TRUE);
+          return true;
+        default:
+          return not_const(cx, err, exp);
+      }
+    case EXP_ID:
+      if (exp->id.binding.tag != BINDING_VAL || exp->id.binding.val.tag != VAL_VAL) {
+        return not_const(cx, err, exp);
+      }
+      val = oo_cx_eval_val(cx, err, exp->id.binding.val.val);
+      if (val == NULL) {
+        return false;
+      }
+      *out = copy_const(val);
+      return true;
+    case EXP_SIZE_OF:
+      return layout_query(cx, err, exp->size_of, true, out);
+    case EXP_ALIGN_OF:
+      return layout_query(cx, err, exp->align_of, false, out);
+    case EXP_CAST:
+      return eval_cast(cx, err, exp, out);
+    case EXP_NOT:
+      if (!eval_exp(cx, err, exp->exp_not, expected, &inner)) {
+        return false;
+      } else if (inner.tag == OO_CONST_BOOL) {
+        *out = new_bool(!inner.bits);
+        return true;
+      } else if (inner.tag == OO_CONST_INT) {
+        *out = new_int(inner.prim, ~inner.bits);
+        return true;
+      }
+      free_inner_const(inner);
+      return not_const(cx, err, exp);
+    case EXP_NEGATE:
+      if (exp->exp_negate->tag == EXP_LITERAL && exp->exp_negate->lit.tag == LITERAL_INT) {
+        return parse_int(exp->exp_negate->lit.str, expected_int(expected), true, out) || arithmetic_error(cx, err, exp->str);
+      }
+      __attribute__((fallthrough));
+    case EXP_WRAPPING_NEGATE:
+      if (!eval_exp(cx, err, exp->tag == EXP_NEGATE ? exp->exp_negate : exp->exp_wrapping_negate, expected, &inner)) {
+        return false;
+      } else if (inner.tag != OO_CONST_INT) {
+        free_inner_const(inner);
+        return not_const(cx, err, exp);
+      }
+      prim = inner.prim;
+      OoConst zero = new_int(prim, 0);
+      if (exp->tag == EXP_WRAPPING_NEGATE) {
+        return int_op(OP_WRAPPING_MINUS, &zero, &inner, out);
+      }
+      return int_op(OP_MINUS, &zero, &inner, out) || arithmetic_error(cx, err, exp->str);
+    case EXP_BIN_OP:
+      return eval_bin_op(cx, err, exp, expected, out);
+    case EXP_PRODUCT_ANON:
+      return eval_fields(cx, err, exp->product_anon, expected, out);
+    case EXP_PRODUCT_NAMED:
+      if (!eval_fields(cx, err, exp->product_named.inners, expected, out)) {
+        return false;
+      }
+      out->sids = exp->product_named.sids;
+      return true;
+    case EXP_PRODUCT_REPEATED:
+      if (!eval_exp(cx, err, exp->product_repeated.inner, expected_field(expected, 0), &inner)) {
+        return false;
+      }
+      OoConst count;
+      if (!eval_repeat(cx, err, &exp->product_repeated.repeat, &count)) {
+        free_inner_const(inner);
+        return false;
+      }
+      out->tag = OO_CONST_PRODUCT;
+      out->fields = NULL;
+      out->sids = NULL;
+      for (OoU128 i = 0; i < count.bits; i++) {
+        OoConst *field = malloc(sizeof(OoConst));
+        *field = copy_const(&inner);
+        sb_push(out->fields, field);
+      }
+      free_inner_const(inner);
+      return true;
+    case EXP_PRODUCT_ACCESS_ANON:
+      if (!eval_exp(cx, err, exp->product_access_anon.inner, NULL, &inner)) {
+        return false;
+      }
+      if (inner.tag == OO_CONST_PRODUCT && exp->product_access_anon.field < (unsigned long) sb_count(inner.fields)) {
+        *out = copy_const(inner.fields[exp->product_access_anon.field]);
+        free_inner_const(inner);
+        return true;
+      }
+      free_inner_const(inner);
+      return not_const(cx, err, exp);
+    case EXP_PRODUCT_ACCESS_NAMED:
+      if (!eval_exp(cx, err, exp->product_access_named.inner, NULL, &inner)) {
+        return false;
+      }
+      if (inner.tag == OO_CONST_PRODUCT && inner.sids != NULL) {
+        if (exp->product_access_named.position == ASG_NO_POSITION) {
+          exp->product_access_named.position = asg_position(inner.sids, exp->product_access_named.field.str);
+        }
+        if (exp->product_access_named.position < (size_t) sb_count(inner.fields)) {
+          *out = copy_const(inner.fields[exp->product_access_named.position]);
+          free_inner_const(inner);
+          return true;
+        }
+      }
+      free_inner_const(inner);
+      return not_const(cx, err, exp);
+    default:
+      return not_const(cx, err, exp);
+  }
+}
+
+const OoConst *oo_cx_eval_val(OoContext *cx, OoError *err, AsgItemVal *val) {
+  OoConst *c = raxFind(cx->consts, (const char *) &val, sizeof(AsgItemVal *));
+  if (c == &in_progress) {
+    not_const(cx, err, &val->exp);
+    return NULL;
+  } else if (c != raxNotFound) {
+    return c;
+  }
+
+  AsgFile *asg = oo_cx_file_of(cx, val->sid.str);
+  if (asg != NULL && asg->iface) { // the expression is a placeholder
+    err->tag = OO_ERR_IFACE_VAL;
+    err->iface_val = val;
+    err->asg = asg;
+    return NULL;
+  }
+
+  OoType *expected = val->sid.binding.val.oo_type;
+  if (expected == NULL) { // the file of the val is not typed yet
+    expected = oo_cx_lower_type(cx, err, &val->type);
+    if (err->tag != OO_ERR_NONE) {
+      return NULL;
+    }
+  }
+
+  raxInsert(cx->consts, (const char *) &val, sizeof(AsgItemVal *), &in_progress, NULL);
+  c = malloc(sizeof(OoConst));
+  if (!eval_exp(cx, err, &val->exp, expected, c)) {
+    free(c);
+    raxRemove(cx->consts, (const char *) &val, sizeof(AsgItemVal *), NULL);
+    return NULL;
+  }
+  raxInsert(cx->consts, (const char *) &val, sizeof(AsgItemVal *), c, NULL);
+  return c;
+}
+
+void oo_cx_forget_consts(OoContext *cx) {
+  raxIterator it;
+  raxStart(&it, cx->consts);
+  raxSeek(&it, "^", NULL, 0);
+  while (raxNext(&it)) {
+    OoConst *c = it.data;
+    free_inner_const(*c);
+    free(c);
+  }
+  raxStop(&it);
+  raxFree(cx->consts);
+  cx->consts = raxNew();
+}
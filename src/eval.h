@@ -0,0 +1,50 @@
+// Compile-time evaluation of val items and of the repetitions of repeated
+// product types.
+#ifndef OO_EVAL_H
+#define OO_EVAL_H
+
+#include <stdint.h>
+
+#include "context.h"
+
+__extension__ typedef unsigned __int128 OoU128;
+__extension__ typedef __int128 OoI128;
+
+typedef enum {
+  OO_CONST_INT,
+  OO_CONST_BOOL,
+  OO_CONST_PRODUCT
+} OoConstTag;
+
+typedef struct OoConst {
+  OoConstTag tag;
+  AsgPrimitive prim; // the type of an OO_CONST_INT
+  OoU128 bits; // an int in two's complement truncated to the width of prim, or a bool (0 or 1)
+  struct OoConst **fields; // stretchy buffer of owned fields of an OO_CONST_PRODUCT (separately allocated, since sb storage is not aligned for OoU128)
+  AsgSid *sids; // names of the fields of a named product (not owned), NULL otherwise
+} OoConst;
+
+// Evaluates the expression of a val item (whose file must be fine bound). The
+// result is memoized in the context. Integer literals take the type expected
+// by their context (Usize if there is none), arithmetic is checked except for
+// the wrapping operators, and `as` truncates or extends. Errors:
+// - OO_ERR_NOT_CONST_EXP: the expression, or a val it refers to, can not be
+//   evaluated at compile time (this includes vals that refer to themselves)
+// - OO_ERR_CONST_ARITHMETIC: overflow, division by zero, or shifting by at
+//   least the width of the type
+// - OO_ERR_NO_LAYOUT: sizeof or alignof of a type without a layout
+// - OO_ERR_IFACE_VAL: a val of an interface file, which does not retain val
+//   expressions
+const OoConst *oo_cx_eval_val(OoContext *cx, OoError *err, AsgItemVal *val);
+
+// Evaluates the number of repetitions of a repeated product (as a Usize).
+// Repetitions given by macros are reported as OO_ERR_NOT_CONST_REPEAT.
+uint64_t oo_cx_eval_repeat(OoContext *cx, OoError *err, AsgRepeat *repeat);
+
+// Signed value of an OO_CONST_INT (sign extended if its type is signed).
+OoI128 oo_const_signed(const OoConst *c);
+
+// Frees all memoized values (for when the vals they are based on change).
+void oo_cx_forget_consts(OoContext *cx);
+
+#endif
@@ -0,0 +1,361 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "layout.h"
+#include "stretchy_buffer.h"
+
+// Memoized for types whose layout is being computed. Reaching such a type again
+// means that it contains itself, so it has no finite size.
+static OoLayout in_progress;
+
+// Types larger than this have no layout. The bound leaves room to lay out a
+// field after any other or to align any size without overflowing.
+#define MAX_SIZE (SIZE_MAX / 2)
+
+static size_t align_up(size_t offset, size_t align) {
+  return (offset + align - 1) / align * align;
+}
+
+static OoLayout *new_layout(OoType *t, size_t size, size_t align) {
+  OoLayout *l = malloc(sizeof(OoLayout));
+  l->type = t;
+  l->size = size;
+  l->align = align;
+  l->offsets = NULL;
+  l->tag_size = 0;
+  l->summand_offsets = NULL;
+  l->dataful = -1;
+  memset(&l->tag_niche, 0, sizeof(OoNiche));
+  memset(&l->niche, 0, sizeof(OoNiche));
+  return l;
+}
+
+static OoNiche new_niche(size_t offset, size_t size, uint64_t start, uint64_t count) {
+  OoNiche niche;
+  niche.offset = offset;
+  niche.size = size;
+  niche.start = start;
+  niche.count = count;
+  return niche;
+}
+
+static void free_layout(OoLayout *l) {
+  sb_free(l->offsets);
+  for (int i = 0; i < sb_count(l->summand_offsets); i++) {
+    sb_free(l->summand_offsets[i]);
+  }
+  sb_free(l->summand_offsets);
+  free(l);
+}
+
+static OoLayout *primitive_layout(OoType *t, AsgPrimitive prim) {
+  OoLayout *l;
+  switch (prim) {
+    case PRIM_BOOL:
+      l = new_layout(t, 1, 1);
+      l->niche = new_niche(0, 1, 2, 254);
+      return l;
+    case PRIM_U8:
+    case PRIM_I8:
+      return new_layout(t, 1, 1);
+    case PRIM_U16:
+    case PRIM_I16:
+      return new_layout(t, 2, 2);
+    case PRIM_U32:
+    case PRIM_I32:
+    case PRIM_F32:
+      return new_layout(t, 4, 4);
+    case PRIM_U64:
+    case PRIM_I64:
+    case PRIM_F64:
+      return new_layout(t, 8, 8);
+    case PRIM_U128:
+    case PRIM_I128:
+      return new_layout(t, 16, 16);
+    case PRIM_USIZE:
+    case PRIM_ISIZE:
+      return new_layout(t, OO_PTR_SIZE, OO_PTR_SIZE);
+    case PRIM_VOID:
+      return new_layout(t, 0, 1);
+  }
+  abort();
+}
+
+// Lays out the fields one after the other starting at *end, pushing their
+// offsets and updating *end, *align and *niche (to the largest niche of the
+// fields). Returns false if a field has no layout or if they get too large.
+static bool layout_fields(
+  OoContext *cx, OoError *err, OoType **fields, size_t **offsets, size_t *end, size_t *align, OoNiche *niche
+) {
+  for (int i = 0; i < sb_count(fields); i++) {
+    const OoLayout *field = oo_cx_layout(cx, err, fields[i]);
+    if (field == NULL) {
+      return false;
+    }
+    size_t offset = align_up(*end, field->align);
+    if (offset > MAX_SIZE || field->size > MAX_SIZE - offset) {
+      return false;
+    }
+    sb_push(*offsets, offset);
+    *end = offset + field->size;
+    if (field->align > *align) {
+      *align = field->align;
+    }
+    if (field->niche.count > niche->count) {
+      *niche = field->niche;
+      niche->offset += offset;
+    }
+  }
+  return true;
+}
+
+// Lowers the fields of the summands. Summands are not lowered to OoTypes, so
+// this happens here. For the sum of an applied generic, vars are the type
+// variables of the generic and args the types to substitute for them (both
+// NULL otherwise). Returns a stretchy buffer of stretchy buffers of fields, and
+// sets *lowered to false if a field has no OoType.
+static OoType ***summand_fields(OoContext *cx, OoError *err, AsgTypeSum *sum, AsgSid *vars, OoType **args, bool *lowered) {
+  OoType ***fields = NULL;
+  *lowered = true;
+  for (int i = 0; i < sb_count(sum->summands); i++) {
+    AsgSummand *summand = &sum->summands[i];
+    AsgType *inners = summand->tag == SUMMAND_ANON ? summand->anon : summand->named.inners;
+
+    OoType **summand_fields = NULL;
+    for (int j = 0; j < sb_count(inners); j++) {
+      OoType *field = oo_cx_lower_type(cx, err, &inners[j]);
+      if (err->tag == OO_ERR_NONE && field != NULL && vars != NULL) {
+        field = oo_types_substitute(&cx->types, field, vars, args);
+      }
+      sb_push(summand_fields, field);
+      if (field == NULL) {
+        sb_push(fields, summand_fields);
+        *lowered = false;
+        return fields;
+      }
+    }
+    sb_push(fields, summand_fields);
+  }
+  return fields;
+}
+
+// Lays out the summands without a tag if possible (see OoLayout), returns NULL
+// otherwise.
+static OoLayout *niche_sum_layout(OoContext *cx, OoError *err, OoType *t, OoType ***fields) {
+  int count = sb_count(fields);
+  if (count < 2) {
+    return NULL;
+  }
+
+  OoLayout *l = new_layout(t, 0, 1);
+  size_t size = 0;
+  OoNiche niche;
+  memset(&niche, 0, sizeof(OoNiche));
+  for (int i = 0; i < count; i++) {
+    size_t *offsets = NULL;
+    size_t end = 0;
+    OoNiche summand_niche;
+    memset(&summand_niche, 0, sizeof(OoNiche));
+    bool sized = layout_fields(cx, err, fields[i], &offsets, &end, &l->align, &summand_niche);
+    sb_push(l->summand_offsets, offsets);
+    if (!sized || (end > 0 && l->dataful != -1)) {
+      free_layout(l);
+      return NULL;
+    } else if (end > 0) {
+      l->dataful = i;
+      size = end;
+      niche = summand_niche;
+    }
+  }
+
+  if (l->dataful == -1 || niche.count < (uint64_t) count - 1) {
+    free_layout(l);
+    return NULL;
+  }
+  l->size = align_up(size, l->align);
+  l->tag_niche = niche;
+  l->niche = new_niche(niche.offset, niche.size, niche.start + (count - 1), niche.count - (count - 1));
+  return l;
+}
+
+static OoLayout *tagged_sum_layout(OoContext *cx, OoError *err, OoType *t, OoType ***fields) {
+  int count = sb_count(fields);
+  size_t tag_size = count <= 1 ? 0 : (count <= 256 ? 1 : (count <= 65536 ? 2 : 4));
+  OoLayout *l = new_layout(t, 0, tag_size == 0 ? 1 : tag_size);
+  l->tag_size = tag_size;
+  if (tag_size > 0) {
+    l->niche = new_niche(0, tag_size, count, ((uint64_t) 1 << (8 * tag_size)) - count);
+  }
+  size_t size = tag_size;
+
+  for (int i = 0; i < count; i++) {
+    size_t *offsets = NULL;
+    size_t end = tag_size;
+    OoNiche summand_niche;
+    memset(&summand_niche, 0, sizeof(OoNiche));
+    bool sized = layout_fields(cx, err, fields[i], &offsets, &end, &l->align, &summand_niche);
+    sb_push(l->summand_offsets, offsets);
+    if (!sized) {
+      free_layout(l);
+      return NULL;
+    }
+    if (end > size) {
+      size = end;
+    }
+  }
+
+  l->size = align_up(size, l->align);
+  return l;
+}
+
+static OoLayout *sum_layout(OoContext *cx, OoError *err, OoType *t, AsgTypeSum *sum, AsgSid *vars, OoType **args) {
+  bool lowered;
+  OoType ***fields = summand_fields(cx, err, sum, vars, args, &lowered);
+  OoLayout *l = NULL;
+  if (lowered && err->tag == OO_ERR_NONE) {
+    l = niche_sum_layout(cx, err, t, fields);
+    if (l == NULL && err->tag == OO_ERR_NONE) {
+      l = tagged_sum_layout(cx, err, t, fields);
+    }
+  }
+
+  for (int i = 0; i < sb_count(fields); i++) {
+    sb_free(fields[i]);
+  }
+  sb_free(fields);
+  return l;
+}
+
+// Computes the layout of t, which is not a binding of a type or sum type.
+static OoLayout *compute_layout(OoContext *cx, OoError *err, OoType *t) {
+  OoLayout *l;
+  const OoLayout *inner;
+  OoType *inst;
+  AsgItemType *tlf;
+
+  switch (t->tag) {
+    case OO_TYPE_BINDING:
+      return t->binding->tag == BINDING_PRIMITIVE ? primitive_layout(t, t->binding->primitive) : NULL;
+    case OO_TYPE_PTR:
+    case OO_TYPE_PTR_MUT:
+      l = new_layout(t, OO_PTR_SIZE, OO_PTR_SIZE);
+      l->niche = new_niche(0, OO_PTR_SIZE, 0, 1); // null
+      return l;
+    case OO_TYPE_PRODUCT_REPEATED:
+      inner = oo_cx_layout(cx, err, t->product_repeated.inner);
+      if (inner == NULL) {
+        return NULL;
+      }
+      if (inner->size > 0 && t->product_repeated.repetitions > MAX_SIZE / inner->size) {
+        return NULL;
+      }
+      l = new_layout(t, inner->size * t->product_repeated.repetitions, inner->align);
+      if (t->product_repeated.repetitions > 0) {
+        l->niche = inner->niche;
+      }
+      return l;
+    case OO_TYPE_PRODUCT_ANON:
+    case OO_TYPE_PRODUCT_NAMED:
+      l = new_layout(t, 0, 1);
+      size_t end = 0;
+      if (!layout_fields(
+        cx, err, t->tag == OO_TYPE_PRODUCT_ANON ? t->product_anon : t->product_named.types,
+        &l->offsets, &end, &l->align, &l->niche
+      )) {
+        free_layout(l);
+        return NULL;
+      }
+      l->size = align_up(end, l->align);
+      return l;
+    case OO_TYPE_SUM:
+      return sum_layout(cx, err, t, t->sum, NULL, NULL);
+    case OO_TYPE_APP:
+      tlf = t->app.tlf;
+      oo_cx_resolve_alias(cx, err, tlf); // makes sure the generic is lowered
+      if (err->tag != OO_ERR_NONE || tlf->oo_type == NULL || tlf->oo_type->tag != OO_TYPE_GENERIC) {
+        return NULL;
+      }
+      inst = oo_types_instantiate(&cx->types, t);
+      if (inst != t) {
+        inner = oo_cx_layout(cx, err, inst);
+        if (inner == NULL) {
+          return NULL;
+        }
+        // Share the layout of the instantiation, it is only freed via its own entry.
+        return (OoLayout *) inner;
+      } else if (tlf->type.generic.inner->tag == TYPE_SUM) {
+        return sum_layout(cx, err, t, &tlf->type.generic.inner->sum, tlf->type.generic.args, t->app.args);
+      } else {
+        return NULL;
+      }
+    case OO_TYPE_ARRAY:
+    case OO_TYPE_FUN_ANON:
+    case OO_TYPE_FUN_NAMED:
+    case OO_TYPE_GENERIC:
+      return NULL;
+  }
+  abort();
+}
+
+const OoLayout *oo_cx_layout(OoContext *cx, OoError *err, OoType *t) {
+  if (t != NULL && t->tag == OO_TYPE_BINDING) {
+    // Aliases are not memoized, resolving them is constant time once done.
+    switch (t->binding->tag) {
+      case BINDING_TYPE:
+        t = oo_cx_resolve_alias(cx, err, t->binding->type);
+        break;
+      case BINDING_SUM_TYPE:
+        t = oo_cx_resolve_alias(cx, err, &t->binding->sum.type->type);
+        break;
+      default:
+        break;
+    }
+  }
+  if (t == NULL || err->tag != OO_ERR_NONE) {
+    return NULL;
+  }
+
+  OoLayout *l = raxFind(cx->layouts, (const char *) &t, sizeof(OoType *));
+  if (l == &in_progress) {
+    return NULL;
+  } else if (l != raxNotFound) {
+    return l;
+  }
+
+  raxInsert(cx->layouts, (const char *) &t, sizeof(OoType *), &in_progress, NULL);
+  l = compute_layout(cx, err, t);
+  if (err->tag != OO_ERR_NONE) {
+    if (l != NULL && l->type == t) {
+      free_layout(l);
+    }
+    raxRemove(cx->layouts, (const char *) &t, sizeof(OoType *), NULL);
+    return NULL;
+  }
+  raxInsert(cx->layouts, (const char *) &t, sizeof(OoType *), l, NULL);
+  return l;
+}
+
+void oo_cx_forget_layouts(OoContext *cx) {
+  // Collect first, shared layouts must not be freed before all entries are seen.
+  OoLayout **owned = NULL;
+  raxIterator it;
+  raxStart(&it, cx->layouts);
+  raxSeek(&it, "^", NULL, 0);
+  while (raxNext(&it)) {
+    OoLayout *l = it.data;
+    OoType *t;
+    memcpy(&t, it.key, sizeof(OoType *));
+    if (l != NULL && l->type == t) {
+      sb_push(owned, l);
+    }
+  }
+  raxStop(&it);
+
+  for (int i = 0; i < sb_count(owned); i++) {
+    free_layout(owned[i]);
+  }
+  sb_free(owned);
+  raxFree(cx->layouts);
+  cx->layouts = raxNew();
+}
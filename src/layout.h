@@ -0,0 +1,54 @@
+// Sizes, alignments and field offsets of OoTypes, memoized per interned type.
+#ifndef OO_LAYOUT_H
+#define OO_LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "context.h"
+
+// Size and alignment of pointers and of Usize and Isize on the target, which is
+// the host for now.
+#define OO_PTR_SIZE sizeof(void *)
+
+// Values that some field of a type never takes: count consecutive (unsigned,
+// host endian) values starting at start, in the size bytes at offset. Sums
+// containing the type can store their tag there.
+typedef struct OoNiche {
+  size_t offset;
+  size_t size; // 0 if there is no niche
+  uint64_t start;
+  uint64_t count;
+} OoNiche;
+
+// Fields are laid out in declaration order, each at the next offset satisfying
+// its alignment (like C structs).
+//
+// If only one summand of a sum has a size and its fields have a niche large
+// enough for the other summands, the sum has no tag. The other summands are
+// stored as the values of that niche, in declaration order (this is how e.g.
+// an optional pointer stays pointer-sized). Other sums store their tag at
+// offset 0 and the fields of each summand after it.
+typedef struct OoLayout {
+  OoType *type; // the type this was computed for, aliases and applications share the layout of their target
+  size_t size; // a multiple of align
+  size_t align;
+  size_t *offsets; // stretchy buffer, offsets of the fields of a product, NULL for other types
+  size_t tag_size; // bytes of the tag of a sum, 0 for other types and for sums without tag
+  size_t **summand_offsets; // stretchy buffer per summand of a sum of the offsets of its fields
+  int dataful; // index of the summand with a size of a sum without tag, -1 otherwise
+  OoNiche tag_niche; // where the other summands are stored, if dataful is not -1
+  OoNiche niche; // the largest niche of the type
+} OoLayout;
+
+// Returns the layout of t, or NULL if values of t have no size known in
+// advance: type variables, generics, arrays, functions, types of infinite size,
+// types too large for a Usize and macros. Aliases are resolved, generic applications are instantiated, and
+// the results are memoized in the context. Types named by t may belong to files
+// that are not typed yet, they are lowered as needed.
+const OoLayout *oo_cx_layout(OoContext *cx, OoError *err, OoType *t);
+
+// Frees all memoized layouts (for when the types they are based on change).
+void oo_cx_forget_layouts(OoContext *cx);
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE true
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "context.h"
+#include "stretchy_buffer.h"
+
+// A long-running process that keeps an analyzed OoContext around. It watches
+// the mods and deps directories, and after a file changes only analyzes that
+// file and the files depending on it again (see oo_cx_reload). Adding or
+// removing files starts over with a fresh context.
+//
+// Clients connect to the unix socket and send a single line:
+// - `check`: the daemon replies with `ok` or with the current error
+// - `stop`: the daemon replies with `ok` and exits
+//
+// Usage: look_daemon <mods dir> <deps dir> <socket path>
+
+typedef struct Watch {
+  int wd;
+  char *path; // owning
+} Watch;
+
+typedef struct Daemon {
+  const char *mods;
+  const char *deps;
+  OoContext cx;
+  OoError err; // result of the last analysis
+  int inotify;
+  Watch *watches; // owning stretchy buffer
+  AsgFile **changed; // stretchy buffer, files modified since the last analysis
+  bool rebuild; // whether files were added or removed since the last analysis
+} Daemon;
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+
+static void watch_dir(Daemon *d, const char *path) {
+  int wd = inotify_add_watch(d->inotify, path, WATCH_MASK);
+  if (wd < 0) {
+    return;
+  }
+  Watch *w = sb_add(d->watches, 1);
+  w->wd = wd;
+  w->path = strdup(path);
+
+  DIR *dp = opendir(path);
+  if (dp == NULL) {
+    return;
+  }
+  struct dirent *ep;
+  while ((ep = readdir(dp))) {
+    if (ep->d_type == DT_DIR && strcmp(ep->d_name, ".") != 0 && strcmp(ep->d_name, "..") != 0) {
+      char inner[PATH_MAX];
+      snprintf(inner, PATH_MAX, "%s/%s", path, ep->d_name);
+      watch_dir(d, inner);
+    }
+  }
+  closedir(dp);
+}
+
+static void unwatch_all(Daemon *d) {
+  for (int i = 0; i < sb_count(d->watches); i++) {
+    inotify_rm_watch(d->inotify, d->watches[i].wd);
+    free(d->watches[i].path);
+  }
+  sb_free(d->watches);
+  d->watches = NULL;
+}
+
+// Runs all passes on whatever has not been analyzed yet.
+static void analyze(Daemon *d) {
+  OoError *err = &d->err;
+  oo_cx_coarse_bindings(&d->cx, err);
+  if (err->tag != OO_ERR_NONE) {
+    return;
+  }
+  oo_cx_bind_and_kind_check(&d->cx, err);
+  if (err->tag != OO_ERR_NONE) {
+    return;
+  }
+  oo_cx_type_checking(&d->cx, err);
+}
+
+// Creates a fresh context and analyzes everything.
+static void build(Daemon *d) {
+  d->err.tag = OO_ERR_NONE;
+  oo_cx_init(&d->cx, d->mods, d->deps);
+  oo_cx_parse(&d->cx, &d->err, NULL);
+  if (d->err.tag == OO_ERR_NONE) {
+    analyze(d);
+  }
+
+  unwatch_all(d);
+  watch_dir(d, d->mods);
+  watch_dir(d, d->deps);
+}
+
+// Brings the context up to date with all changes seen since the last analysis.
+static void update(Daemon *d) {
+  if (d->rebuild || (d->err.tag != OO_ERR_NONE && sb_count(d->changed) > 0)) {
+    // An error may have left the analysis of a file half done, starting
+    // over is simpler than tracking that.
+    oo_cx_free(&d->cx);
+    build(d);
+  } else if (sb_count(d->changed) > 0) {
+    oo_cx_reload(&d->cx, &d->err, d->changed);
+    if (d->err.tag == OO_ERR_NONE) {
+      analyze(d);
+    }
+  }
+
+  sb_free(d->changed);
+  d->changed = NULL;
+  d->rebuild = false;
+}
+
+static AsgFile *find_file(Daemon *d, const char *path) {
+  for (int i = 0; i < sb_count(d->cx.files); i++) {
+    if (strcmp(d->cx.files[i]->path, path) == 0) {
+      return d->cx.files[i];
+    }
+  }
+  return NULL;
+}
+
+static const char *watch_path(Daemon *d, int wd) {
+  for (int i = 0; i < sb_count(d->watches); i++) {
+    if (d->watches[i].wd == wd) {
+      return d->watches[i].path;
+    }
+  }
+  return NULL;
+}
+
+// Reads all pending inotify events and records what changed.
+static void handle_events(Daemon *d) {
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t len;
+  while ((len = read(d->inotify, buf, sizeof(buf))) > 0) {
+    for (char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + ((struct inotify_event *) p)->len) {
+      struct inotify_event *ev = (struct inotify_event *) p;
+      const char *dir = watch_path(d, ev->wd);
+      if (dir == NULL || ev->len == 0) {
+        continue;
+      }
+
+      char path[PATH_MAX];
+      snprintf(path, PATH_MAX, "%s/%s", dir, ev->name);
+      AsgFile *file = find_file(d, path);
+
+      if (ev->mask & IN_ISDIR) {
+        d->rebuild = true;
+      } else if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+        if (file == NULL) {
+          d->rebuild = true;
+        } else {
+          int i = 0;
+          while (i < sb_count(d->changed) && d->changed[i] != file) {
+            i++;
+          }
+          if (i == sb_count(d->changed)) {
+            sb_push(d->changed, file);
+          }
+        }
+      } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        if (file != NULL) {
+          d->rebuild = true;
+        }
+      }
+    }
+  }
+}
+
+// Answers a single request of a client.
+static bool handle_client(Daemon *d, int fd) {
+  FILE *f = fdopen(fd, "r+");
+  if (f == NULL) {
+    close(fd);
+    return true;
+  }
+
+  char line[64];
+  bool keep_running = true;
+  if (fgets(line, sizeof(line), f) != NULL) {
+    if (strncmp(line, "check", 5) == 0) {
+      update(d);
+      if (d->err.tag == OO_ERR_NONE) {
+        fprintf(f, "ok\n");
+      } else {
+        err_fprint(f, &d->err);
+      }
+    } else if (strncmp(line, "stop", 4) == 0) {
+      fprintf(f, "ok\n");
+      keep_running = false;
+    } else {
+      fprintf(f, "unknown request\n");
+    }
+  }
+
+  fclose(f);
+  return keep_running;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    printf("%s\n", "Usage: look_daemon <mods dir> <deps dir> <socket path>");
+    return 1;
+  }
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(argv[3]) >= sizeof(addr.sun_path)) {
+    printf("%s\n", "Socket path too long.");
+    return 1;
+  }
+  strcpy(addr.sun_path, argv[3]);
+
+  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(argv[3]);
+  if (sock < 0 || bind(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(sock, 8) != 0) {
+    printf("Failed to listen on %s\n", argv[3]);
+    return 1;
+  }
+
+  Daemon d;
+  d.mods = argv[1];
+  d.deps = argv[2];
+  d.watches = NULL;
+  d.changed = NULL;
+  d.rebuild = false;
+  d.inotify = inotify_init1(IN_NONBLOCK);
+  if (d.inotify < 0) {
+    printf("%s\n", "Failed to initialize inotify.");
+    return 1;
+  }
+  build(&d);
+
+  bool running = true;
+  while (running) {
+    struct pollfd fds[2];
+    fds[0].fd = d.inotify;
+    fds[0].events = POLLIN;
+    fds[1].fd = sock;
+    fds[1].events = POLLIN;
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      handle_events(&d);
+      // Analyze eagerly, so that the next check is answered right away.
+      update(&d);
+    }
+    if (fds[1].revents & POLLIN) {
+      int client = accept(sock, NULL, NULL);
+      if (client >= 0) {
+        running = handle_client(&d, client);
+      }
+    }
+  }
+
+  close(sock);
+  unlink(argv[3]);
+  unwatch_all(&d);
+  close(d.inotify);
+  sb_free(d.changed);
+  oo_cx_free(&d.cx);
+  return 0;
+}
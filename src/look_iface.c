@@ -0,0 +1,139 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE true
+#endif
+
+#include <dirent.h>
+#include <linux/limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "asg_cache.h"
+#include "parser.h"
+#include "rax.h"
+#include "stretchy_buffer.h"
+
+// Reads a whole file into a null-terminated, owned string. Returns NULL on failure.
+static char *read_src(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return NULL;
+  }
+  if (fseek(f, 0, SEEK_END)) {
+    fclose(f);
+    return NULL;
+  }
+  long fsize = ftell(f);
+  if (fsize < 0) {
+    fclose(f);
+    return NULL;
+  }
+  rewind(f);
+
+  char *src = malloc(fsize + 1);
+  if (fsize > 0 && fread(src, fsize, 1, f) != 1) {
+    free(src);
+    fclose(f);
+    return NULL;
+  }
+  src[fsize] = 0;
+  fclose(f);
+  return src;
+}
+
+// Parses the file at src_path and writes its interface to out_path.
+static bool emit_file(const char *src_path, const char *out_path, ParserCx *pcx) {
+  char *src = read_src(src_path);
+  if (src == NULL) {
+    printf("Failed to read %s\n", src_path);
+    return false;
+  }
+
+  ParserError err;
+  AsgFile asg;
+  parse_file(src, &err, &asg, pcx);
+  if (err.tag != ERR_NONE) {
+    printf("Syntax error in %s\n", src_path);
+    free(src);
+    return false;
+  }
+
+  char *iface = oo_iface_serialize(&asg);
+  bool ok = false;
+  FILE *f = fopen(out_path, "wb");
+  if (f != NULL) {
+    ok = fwrite(iface, sb_count(iface), 1, f) == 1;
+    ok = (fclose(f) == 0) && ok;
+  }
+  if (!ok) {
+    printf("Failed to write %s\n", out_path);
+  }
+
+  sb_free(iface);
+  free_inner_file(asg);
+  free(src);
+  return ok;
+}
+
+// Mirrors the directory src_dir into out_dir, with interfaces in place of the sources.
+static bool emit_dir(const char *src_dir, const char *out_dir, ParserCx *pcx) {
+  DIR *dp = opendir(src_dir);
+  if (dp == NULL) {
+    printf("Failed to open %s\n", src_dir);
+    return false;
+  }
+  mkdir(out_dir, 0700);
+
+  bool ok = true;
+  struct dirent *ep;
+  while (ok && (ep = readdir(dp))) {
+    if (strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0) {
+      continue;
+    }
+
+    char src_path[PATH_MAX];
+    char out_path[PATH_MAX];
+    snprintf(src_path, PATH_MAX, "%s/%s", src_dir, ep->d_name);
+    snprintf(out_path, PATH_MAX, "%s/%s", out_dir, ep->d_name);
+    if (ep->d_type == DT_DIR) {
+      ok = emit_dir(src_path, out_path, pcx);
+    } else {
+      ok = emit_file(src_path, out_path, pcx);
+    }
+  }
+
+  closedir(dp);
+  return ok;
+}
+
+// Writes the interface files of a deps directory (see OoContext.dep_ifaces),
+// for the configuration given by the features.
+//
+// Usage: look_iface <deps dir> <out dir> [feature...]
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    printf("%s\n", "Usage: look_iface <deps dir> <out dir> [feature...]");
+    return 1;
+  }
+
+  rax *features = raxNew();
+  for (int i = 3; i < argc; i++) {
+    raxInsert(features, argv[i], strlen(argv[i]), NULL, NULL);
+  }
+
+  OoFeatureTable table;
+  oo_features_init(&table);
+  OoFeatureSet enabled = oo_feature_set_compile(&table, features);
+  ParserCx pcx;
+  pcx.features = &table;
+  pcx.enabled = &enabled;
+  pcx.lazy_bodies = true; // bodies are dropped anyway
+
+  int exit = emit_dir(argv[1], argv[2], &pcx) ? 0 : 1;
+
+  oo_feature_set_free(enabled);
+  oo_features_free(&table);
+  raxFree(features);
+  return exit;
+}
@@ -66,6 +66,24 @@ bool look_to_html(OoContext *cx, const char *out_dir) {
   return true;
 }
 
+typedef struct StreamHtml {
+  const char *out_dir;
+  bool ok;
+} StreamHtml;
+
+// Renders a single file during oo_cx_stream, while its bodies are still around.
+static void stream_file_to_html(OoContext *cx, AsgFile *asg, void *data) {
+  StreamHtml *sh = data;
+  FILE *f = open_file(cx, asg->path, sh->out_dir);
+  if (f == NULL) {
+    sh->ok = false;
+    return;
+  }
+
+  render_file(asg, f);
+  fclose(f);
+}
+
 const char *render_item(AsgItem *item, FILE *f) {
   fprintf(f, "<span class=\"item ");
   switch (item->tag) {
@@ -144,11 +162,16 @@ void render_file(AsgFile *asg, FILE *f) {
   }
 }
 
+// Usage: look_to_html <dir> [--stream]
+// With --stream, each file is rendered as soon as it has been analyzed, and its
+// bodies are freed right after (see oo_cx_stream), which bounds the memory usage
+// for large dependency trees.
 int main(int argc, char *argv[]) {
   if (argc < 2) {
     printf("%s\n", "Must supply the directory to render.");
     return 1;
   }
+  bool stream = argc > 2 && strcmp(argv[2], "--stream") == 0;
   size_t dir_len = strlen(argv[1]);
 
   char *out_dir = malloc(dir_len + 6);
@@ -173,6 +196,7 @@ int main(int argc, char *argv[]) {
   raxInsert(features, "posix", 5, NULL, NULL);
 
   oo_cx_init(&cx, mod_dir, deps_dir);
+  cx.streaming = stream;
 
   oo_cx_parse(&cx, &err, features);
   if (err.tag != OO_ERR_NONE) {
@@ -180,6 +204,29 @@ int main(int argc, char *argv[]) {
     return (int) err.tag;
   }
 
+  if (stream) {
+    mkdir(out_dir, 0700);
+    StreamHtml sh;
+    sh.out_dir = out_dir;
+    sh.ok = true;
+    oo_cx_stream(&cx, &err, stream_file_to_html, &sh);
+    if (err.tag != OO_ERR_NONE) {
+      err_print(&err);
+      return (int) err.tag;
+    }
+
+    raxFree(features);
+    oo_cx_free(&cx);
+    free(out_dir);
+    free(deps_dir);
+    free(mod_dir);
+    if (!sh.ok) {
+      printf("%s\n", "Failed to write html.");
+      return 1;
+    }
+    return 0;
+  }
+
   oo_cx_coarse_bindings(&cx, &err);
   if (err.tag != OO_ERR_NONE) {
     err_print(&err);
@@ -3,6 +3,7 @@
 
 #include "lexer.h"
 #include "parser.h"
+#include "cc.h"
 #include "asg.h"
 #include "stretchy_buffer.h"
 #include "rax.h"
@@ -27,6 +28,7 @@ size_t parse_id(const char *src, ParserError *err, AsgId *data) {
       sid->str.len = t.token_len;
       sid->binding.tag = BINDING_NONE;
       sid->binding.private = false;
+      sid->binding.pub = false;
       l = t.len;
       break;
     default:
@@ -74,6 +76,7 @@ size_t parse_sid(const char *src, ParserError *err, AsgSid *data) {
   data->str.start = src + leading_ws;
   data->binding.tag = BINDING_NONE;
   data->binding.private = false;
+  data->binding.pub = false;
 
   if (t.tt != ID) {
     err->tag = ERR_SID;
@@ -198,7 +201,7 @@ size_t parse_bin_op(const char *src, ParserError *err, AsgBinOp *op) {
       *op = OP_TIMES;
       return l;
     case DIV:
-      *op = OP_TIMES;
+      *op = OP_DIV;
       return l;
     case MOD:
       *op = OP_MOD;
@@ -452,15 +455,19 @@ size_t parse_repeat(const char *src, ParserError *err, AsgRepeat *data) {
     data->str.len = l - leading_ws;
     data->tag = REPEAT_MACRO;
   } else if (t.tt == SIZEOF) {
+    data->size_of = malloc(sizeof(AsgType));
     l += parse_size_of(src, err, data->size_of);
     if (err->tag != ERR_NONE) {
+      free(data->size_of);
       return l;
     }
     data->str.len = l - leading_ws;
     data->tag = REPEAT_SIZE_OF;
   } else if (t.tt == ALIGNOF) {
+    data->align_of = malloc(sizeof(AsgType));
     l += parse_align_of(src, err, data->align_of);
     if (err->tag != ERR_NONE) {
+      free(data->align_of);
       return l;
     }
     data->str.len = l - leading_ws;
@@ -472,16 +479,18 @@ size_t parse_repeat(const char *src, ParserError *err, AsgRepeat *data) {
     return l;
   }
 
-  size_t bin_len = parse_bin_op(src + l, err, &(data->bin_op.op));
+  // Not parsed into data directly, the op shares its memory with size_of and align_of.
+  AsgBinOp op;
+  size_t bin_len = parse_bin_op(src + l, err, &op);
   if (err->tag != ERR_NONE) {
     err->tag = ERR_NONE;
     return l;
   }
 
-  if (data->bin_op.op == OP_LAND || data->bin_op.op == OP_LOR ||
-      data->bin_op.op == OP_EQ || data->bin_op.op == OP_NEQ ||
-      data->bin_op.op == OP_GT || data->bin_op.op == OP_GET ||
-      data->bin_op.op == OP_LT || data->bin_op.op == OP_GET) {
+  if (op == OP_LAND || op == OP_LOR ||
+      op == OP_EQ || op == OP_NEQ ||
+      op == OP_GT || op == OP_GET ||
+      op == OP_LT || op == OP_GET) {
     return l;
   }
 
@@ -491,6 +500,7 @@ size_t parse_repeat(const char *src, ParserError *err, AsgRepeat *data) {
   memcpy(lhs, data, sizeof(AsgRepeat));
   AsgRepeat *rhs = malloc(sizeof(AsgRepeat));
   data->tag = REPEAT_BIN_OP;
+  data->bin_op.op = op;
   data->bin_op.lhs = lhs;
   data->bin_op.rhs = rhs;
 
@@ -511,6 +521,12 @@ void free_inner_repeat(AsgRepeat data) {
     free(data.bin_op.lhs);
     free_inner_repeat(*(data.bin_op.rhs));
     free(data.bin_op.rhs);
+  } else if (data.tag == REPEAT_SIZE_OF) {
+    free_inner_type(*data.size_of);
+    free(data.size_of);
+  } else if (data.tag == REPEAT_ALIGN_OF) {
+    free_inner_type(*data.align_of);
+    free(data.align_of);
   }
 }
 
@@ -1024,7 +1040,6 @@ size_t parse_type(const char *src, ParserError *err, AsgType *data) {
       data->sum.pub = pub;
       data->sum.summands = summands;
       data->sum.ns.bindings_by_sid = NULL;
-      data->sum.ns.pub_bindings_by_sid = NULL;
       data->sum.ns.bindings = NULL;
       return l;
     default:
@@ -1298,6 +1313,7 @@ size_t parse_pattern(const char *src, ParserError *err, AsgPattern *data) {
       data->str.len = l - leading_ws;
       data->id.mut = mut;
       data->id.type = type;
+      data->id.slot = 0;
       return l;
     case INT:
     case FLOAT:
@@ -1391,6 +1407,7 @@ size_t parse_pattern(const char *src, ParserError *err, AsgPattern *data) {
             data->str.len = l - leading_ws;
             data->product_named.inners = inners;
             data->product_named.sids = sids;
+            data->product_named.positions = NULL;
             return l;
           } else {
             err->tag = ERR_PATTERN;
@@ -1518,6 +1535,7 @@ size_t parse_pattern(const char *src, ParserError *err, AsgPattern *data) {
               data->summand_named.id = id;
               data->summand_named.fields = inners;
               data->summand_named.sids = sids;
+              data->summand_named.positions = NULL;
               return l;
             } else {
               err->tt = t.tt;
@@ -1608,6 +1626,7 @@ void free_inner_pattern(AsgPattern data) {
     case PATTERN_PRODUCT_NAMED:
       free_sb_patterns(data.product_named.inners);
       sb_free(data.product_named.sids);
+      sb_free(data.product_named.positions);
       break;
     case PATTERN_SUMMAND_ANON:
       free_inner_id(data.summand_anon.id);
@@ -1617,6 +1636,7 @@ void free_inner_pattern(AsgPattern data) {
       free_inner_id(data.summand_named.id);
       free_sb_patterns(data.summand_named.fields);
       sb_free(data.summand_named.sids);
+      sb_free(data.summand_named.positions);
       break;
     default:
       return;
@@ -1654,6 +1674,7 @@ size_t parse_meta(const char *src, ParserError *err, AsgMeta *data) {
   }
   data->name.start = src + leading_ws;
   data->name.len = t.token_len;
+  data->feature = OO_FEATURE_NONE;
 
   t = tokenize(src + l);
   switch (t.tt) {
@@ -1759,7 +1780,8 @@ size_t parse_attr(const char *src, ParserError *err, AsgMeta *data) {
   return l;
 }
 
-size_t parse_attrs(const char *src, ParserError *err, AsgMeta **attrs /* ptr to sb */) {
+// Also resolves the features of cc attributes, unless pcx is NULL.
+size_t parse_attrs(const char *src, ParserError *err, AsgMeta **attrs /* ptr to sb */, ParserCx *pcx) {
   size_t l = 0;
   Token t = tokenize(src + l);
   while (t.tt == BEGIN_ATTRIBUTE) {
@@ -1768,6 +1790,13 @@ size_t parse_attrs(const char *src, ParserError *err, AsgMeta **attrs /* ptr to
     if (err->tag != ERR_NONE) {
       return l;
     }
+
+    if (
+      pcx != NULL && attr->tag == META_UNARY && attr->unary.tag == LITERAL_STRING &&
+      str_eq_parts(attr->name, "cc", 2)
+    ) {
+      attr->feature = oo_features_intern(pcx->features, attr->unary.str.start + 1, attr->unary.str.len - 2);
+    }
     t = tokenize(src + l);
   }
   return l;
@@ -1782,7 +1811,133 @@ void free_sb_exps(AsgExp *sb) {
   sb_free(sb);
 }
 
-size_t parse_block(const char *src, ParserError *err, AsgBlock *data) {
+// Conditional compilation happens during parsing: An item or expression whose
+// cc attributes are not enabled is skipped without building any asg nodes, by
+// skipping tokens until reaching a token that can follow it.
+
+// Whether the token opens or closes a bracket, for skipping disabled code.
+// Angle brackets are not counted, they might be comparison operators.
+static int bracket_delta(TokenType tt) {
+  switch (tt) {
+    case LPAREN:
+    case LBRACKET:
+    case LBRACE:
+    case BEGIN_ATTRIBUTE:
+      return 1;
+    case RPAREN:
+    case RBRACKET:
+    case RBRACE:
+      return -1;
+    default:
+      return 0;
+  }
+}
+
+// Skips a disabled expression, stopping before the first `;` or `}` that is
+// not nested inside brackets.
+static size_t skip_exp(const char *src, ParserError *err) {
+  size_t l = 0;
+  int depth = 0;
+  Token t = tokenize(src);
+
+  while (depth > 0 || (t.tt != SEMI && t.tt != RBRACE)) {
+    if (t.tt == END || token_type_error(t.tt) != NULL) {
+      err->tag = ERR_EXP;
+      err->tt = t.tt;
+      err->src = src + l;
+      return l;
+    }
+
+    depth += bracket_delta(t.tt);
+    l += t.len;
+    t = tokenize(src + l);
+  }
+
+  return l;
+}
+
+// Whether the token t at src begins an item, an attribute, or is the end of the
+// input. A pub only begins an item if an item keyword follows, as sum types
+// (`pub | a | b`) contain a pub as well.
+static bool begins_item(const char *src, Token t) {
+  if (t.tt == PUB) {
+    t = tokenize(src + t.len);
+  }
+  return t.tt == USE || t.tt == TYPE || t.tt == VAL || t.tt == FN ||
+    t.tt == FFI || t.tt == BEGIN_ATTRIBUTE || t.tt == END;
+}
+
+// Skips a disabled item, stopping before the first token that is not nested
+// inside brackets and begins an item, an attribute, or is the end of the input.
+static size_t skip_item(const char *src, ParserError *err) {
+  size_t l = 0;
+  int depth = 0;
+  Token t = tokenize(src);
+
+  // Skip the leading keyword(s), so that they are not mistaken for the next item.
+  if (t.tt == PUB) {
+    l += t.len;
+    t = tokenize(src + l);
+  }
+  if (t.tt == FFI) {
+    l += t.len;
+    t = tokenize(src + l);
+  }
+  l += t.len;
+  t = tokenize(src + l);
+
+  while (depth > 0 || !begins_item(src + l, t)) {
+    if (t.tt == END || token_type_error(t.tt) != NULL) {
+      err->tag = ERR_ITEM;
+      err->tt = t.tt;
+      err->src = src + l;
+      return l;
+    }
+
+    depth += bracket_delta(t.tt);
+    l += t.len;
+    t = tokenize(src + l);
+  }
+
+  return l;
+}
+
+// Skips a block without parsing its contents: data gets the location of the
+// block but no expressions.
+static size_t skip_block(const char *src, ParserError *err, AsgBlock *data) {
+  Token t = tokenize(src);
+  size_t leading_ws = t.len - t.token_len;
+  data->str.start = src + leading_ws;
+  data->exps = NULL;
+  data->attrs = NULL;
+  err->tag = ERR_NONE;
+  size_t l = t.len;
+
+  if (t.tt != LBRACE) {
+    err->tag = ERR_BLOCK;
+    err->tt = t.tt;
+    err->src = src + l;
+    return l;
+  }
+
+  int depth = 1;
+  while (depth > 0) {
+    t = tokenize(src + l);
+    l += t.len;
+    if (t.tt == END || token_type_error(t.tt) != NULL) {
+      err->tag = ERR_BLOCK;
+      err->tt = t.tt;
+      err->src = src + l;
+      return l;
+    }
+    depth += bracket_delta(t.tt);
+  }
+
+  data->str.len = l - leading_ws;
+  return l;
+}
+
+size_t parse_block(const char *src, ParserError *err, AsgBlock *data, ParserCx *pcx) {
   Token t = tokenize(src);
   size_t leading_ws = t.len - t.token_len;
   data->str.start = src + leading_ws;
@@ -1809,39 +1964,24 @@ size_t parse_block(const char *src, ParserError *err, AsgBlock *data) {
     return l;
   }
 
-  AsgMeta **attrs = sb_add(all_attrs, 1); // ptr to an sb
-  *attrs = NULL;
-
-  l += parse_attrs(src + l, err, attrs);
-  if (err->tag != ERR_NONE) {
-    free_sb_exps(exps);
-    free_sb_sb_meta(all_attrs);
-    return l;
-  }
-
-  AsgExp *exp = sb_add(exps, 1);
-  l += parse_exp(src + l, err, exp);
-  if (err->tag != ERR_NONE) {
-    free_sb_exps(exps);
-    free_sb_sb_meta(all_attrs);
-    return l;
-  }
-
-  t = tokenize(src + l);
-  l += t.len;
-
-  while (t.tt == SEMI) {
-    AsgMeta **attrs = sb_add(all_attrs, 1); // ptr to an sb
-    *attrs = NULL;
-    l += parse_attrs(src + l, err, attrs);
+  do {
+    AsgMeta *attrs = NULL;
+    l += parse_attrs(src + l, err, &attrs, pcx);
     if (err->tag != ERR_NONE) {
+      free_sb_meta(attrs);
       free_sb_exps(exps);
       free_sb_sb_meta(all_attrs);
       return l;
     }
 
-    AsgExp *exp = sb_add(exps, 1);
-    l += parse_exp(src + l, err, exp);
+    if (oo_cc_enabled(attrs, pcx == NULL ? NULL : pcx->enabled)) {
+      sb_push(all_attrs, attrs);
+      AsgExp *exp = sb_add(exps, 1);
+      l += parse_exp(src + l, err, exp, pcx);
+    } else {
+      free_sb_meta(attrs);
+      l += skip_exp(src + l, err);
+    }
     if (err->tag != ERR_NONE) {
       free_sb_exps(exps);
       free_sb_sb_meta(all_attrs);
@@ -1850,7 +1990,7 @@ size_t parse_block(const char *src, ParserError *err, AsgBlock *data) {
 
     t = tokenize(src + l);
     l += t.len;
-  }
+  } while (t.tt == SEMI);
 
   if (t.tt == RBRACE) {
     data->str.len = l - leading_ws;
@@ -1881,10 +2021,11 @@ void free_sb_blocks(AsgBlock *sb) {
   sb_free(sb);
 }
 
-size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *data) {
+size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *data, ParserCx *pcx) {
   Token t = tokenize(src);
   size_t leading_ws = t.len - t.token_len;
   data->str.start = src + leading_ws;
+  data->disabled = false;
   err->tag = ERR_NONE;
   size_t l = 0;
 
@@ -1918,7 +2059,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
     case AT:
       l += t.len;
       AsgExp *inner_ref = malloc(sizeof(AsgExp));
-      l += parse_exp(src + l, err, inner_ref);
+      l += parse_exp(src + l, err, inner_ref, pcx);
       if (err->tag != ERR_NONE) {
         free(inner_ref);
       }
@@ -1929,7 +2070,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
     case TILDE:
       l += t.len;
       AsgExp *inner_ref_mut = malloc(sizeof(AsgExp));
-      l += parse_exp(src + l, err, inner_ref_mut);
+      l += parse_exp(src + l, err, inner_ref_mut, pcx);
       if (err->tag != ERR_NONE) {
         free(inner_ref_mut);
       }
@@ -1938,7 +2079,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
       data->ref_mut = inner_ref_mut;
       return l;
     case LBRACE:
-      l += parse_block(src + l, err, &data->block);
+      l += parse_block(src + l, err, &data->block, pcx);
       if (err->tag != ERR_NONE) {
         return l;
       }
@@ -1949,7 +2090,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
       l += t.len;
       AsgExp *inner_array = malloc(sizeof(AsgExp));
 
-      l += parse_exp(src + l, err, inner_array);
+      l += parse_exp(src + l, err, inner_array, pcx);
       if (err->tag != ERR_NONE) {
         free(inner_array);
         return l;
@@ -1994,7 +2135,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
           l += t2.len;
           AsgExp *inner;
           inner = sb_add(inners, 1);
-          l += parse_exp(src + l, err, inner);
+          l += parse_exp(src + l, err, inner, pcx);
           if (err->tag != ERR_NONE) {
             sb_free(sids);
             free_sb_exps(inners);
@@ -2024,7 +2165,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
             }
 
             inner = sb_add(inners, 1);
-            l += parse_exp(src + l, err, inner);
+            l += parse_exp(src + l, err, inner, pcx);
             if (err->tag != ERR_NONE) {
               sb_free(sids);
               free_sb_exps(inners);
@@ -2045,7 +2186,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
       // repeated product, anon product
       AsgExp *inners = NULL;
       AsgExp *inner = sb_add(inners, 1);
-      l += parse_exp(src + l, err, inner);
+      l += parse_exp(src + l, err, inner, pcx);
       if (err->tag != ERR_NONE) {
         free_sb_exps(inners);
         return l;
@@ -2087,7 +2228,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
         // anon product
         while (t.tt == COMMA) {
           inner = sb_add(inners, 1);
-          l += parse_exp(src + l, err, inner);
+          l += parse_exp(src + l, err, inner, pcx);
           if (err->tag != ERR_NONE) {
             free_sb_exps(inners);
             return l;
@@ -2134,7 +2275,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
     case NOT:
       l += t.len;
       AsgExp *inner_not = malloc(sizeof(AsgExp));
-      l += parse_exp(src + l, err, inner_not);
+      l += parse_exp(src + l, err, inner_not, pcx);
       if (err->tag != ERR_NONE) {
         free(inner_not);
       }
@@ -2145,7 +2286,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
     case MINUS:
       l += t.len;
       AsgExp *inner_negate = malloc(sizeof(AsgExp));
-      l += parse_exp(src + l, err, inner_negate);
+      l += parse_exp(src + l, err, inner_negate, pcx);
       if (err->tag != ERR_NONE) {
         free(inner_negate);
       }
@@ -2156,7 +2297,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
     case MINUS_WRAPPING:
       l += t.len;
       AsgExp *inner_wrapping_negate = malloc(sizeof(AsgExp));
-      l += parse_exp(src + l, err, inner_wrapping_negate);
+      l += parse_exp(src + l, err, inner_wrapping_negate, pcx);
       if (err->tag != ERR_NONE) {
         free(inner_wrapping_negate);
       }
@@ -2176,7 +2317,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
         // ExpValAssign
         l += t.len;
         AsgExp *rhs = malloc(sizeof(AsgExp));
-        l += parse_exp(src + l, err, rhs);
+        l += parse_exp(src + l, err, rhs, pcx);
         if (err->tag != ERR_NONE) {
           free(rhs);
           return l;
@@ -2195,13 +2336,13 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
     case IF:
       l += t.len;
       AsgExp *cond = malloc(sizeof(AsgExp));
-      l += parse_exp(src + l, err, cond);
+      l += parse_exp(src + l, err, cond, pcx);
       if (err->tag != ERR_NONE) {
         free(cond);
         return l;
       }
 
-      l += parse_block(src + l, err, &data->exp_if.if_block);
+      l += parse_block(src + l, err, &data->exp_if.if_block, pcx);
       if (err->tag != ERR_NONE) {
         free(cond);
         return l;
@@ -2225,7 +2366,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
           data->exp_if.else_block.exps = NULL;
           data->exp_if.else_block.attrs = NULL;
           AsgExp *exp = sb_add(data->exp_if.else_block.exps, 1);
-          l += parse_exp(src + l, err, exp);
+          l += parse_exp(src + l, err, exp, pcx);
           if (err->tag != ERR_NONE) {
             free(cond);
             free_inner_block(data->exp_if.if_block);
@@ -2240,7 +2381,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
           data->exp_if.else_block.str.len = exp->str.len;
           return l;
         } else {
-          l += parse_block(src + l, err, &data->exp_if.else_block);
+          l += parse_block(src + l, err, &data->exp_if.else_block, pcx);
           if (err->tag != ERR_NONE) {
             free(cond);
             free_inner_block(data->exp_if.if_block);
@@ -2256,13 +2397,13 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
     case WHILE:
       l += t.len;
       AsgExp *cond_while = malloc(sizeof(AsgExp));
-      l += parse_exp(src + l, err, cond_while);
+      l += parse_exp(src + l, err, cond_while, pcx);
       if (err->tag != ERR_NONE) {
         free(cond_while);
         return l;
       }
 
-      l += parse_block(src + l, err, &data->exp_while.block);
+      l += parse_block(src + l, err, &data->exp_while.block, pcx);
       if (err->tag != ERR_NONE) {
         free(cond_while);
         return l;
@@ -2275,7 +2416,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
     case CASE:
       l += t.len;
       AsgExp *matcher_case = malloc(sizeof(AsgExp));
-      l += parse_exp(src + l, err, matcher_case);
+      l += parse_exp(src + l, err, matcher_case, pcx);
       if (err->tag != ERR_NONE) {
         free(matcher_case);
         return l;
@@ -2306,7 +2447,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
         }
 
         AsgBlock *block = sb_add(blocks_case, 1);
-        l += parse_block(src + l, err, block);
+        l += parse_block(src + l, err, block, pcx);
         if (err->tag != ERR_NONE) {
           free(matcher_case);
           free_sb_patterns(patterns_case);
@@ -2327,7 +2468,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
     case LOOP:
       l += t.len;
       AsgExp *matcher_loop = malloc(sizeof(AsgExp));
-      l += parse_exp(src + l, err, matcher_loop);
+      l += parse_exp(src + l, err, matcher_loop, pcx);
       if (err->tag != ERR_NONE) {
         free(matcher_loop);
         return l;
@@ -2358,7 +2499,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
         }
 
         AsgBlock *block = sb_add(blocks_loop, 1);
-        l += parse_block(src + l, err, block);
+        l += parse_block(src + l, err, block, pcx);
         if (err->tag != ERR_NONE) {
           free(matcher_loop);
           free_sb_patterns(patterns_loop);
@@ -2379,7 +2520,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
     case RETURN:
       l += t.len;
       AsgExp *inner_return = malloc(sizeof(AsgExp));
-      size_t tmp0 = parse_exp(src + l, err, inner_return);
+      size_t tmp0 = parse_exp(src + l, err, inner_return, pcx);
       if (err->tag != ERR_NONE) {
         free(inner_return);
         inner_return = NULL;
@@ -2394,7 +2535,7 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
     case BREAK:
       l += t.len;
       AsgExp *inner_break = malloc(sizeof(AsgExp));
-      size_t tmp1 = parse_exp(src + l, err, inner_break);
+      size_t tmp1 = parse_exp(src + l, err, inner_break, pcx);
       if (err->tag != ERR_NONE) {
         free(inner_break);
         inner_break = NULL;
@@ -2433,8 +2574,8 @@ size_t parse_exp_non_left_recursive(const char *src, ParserError *err, AsgExp *d
   }
 }
 
-size_t parse_exp(const char *src, ParserError *err, AsgExp *data) {
-  size_t l = parse_exp_non_left_recursive(src, err, data);
+size_t parse_exp(const char *src, ParserError *err, AsgExp *data, ParserCx *pcx) {
+  size_t l = parse_exp_non_left_recursive(src, err, data, pcx);
   Token t = tokenize(src + l);
 
   while (true) {
@@ -2463,7 +2604,7 @@ size_t parse_exp(const char *src, ParserError *err, AsgExp *data) {
         l += t.len;
 
         AsgExp *array_index = malloc(sizeof(AsgExp));
-        l += parse_exp(src + l, err, array_index);
+        l += parse_exp(src + l, err, array_index, pcx);
         if (err->tag != ERR_NONE) {
           free(array_index);
           return l;
@@ -2517,6 +2658,7 @@ size_t parse_exp(const char *src, ParserError *err, AsgExp *data) {
             data->str.start = l_product_access_named->str.start;
             data->str.len = l - (l_product_access_named->str.start - src);
             data->product_access_named.inner = l_product_access_named;
+            data->product_access_named.position = ASG_NO_POSITION;
             t = tokenize(src + l);
             break;
           default:
@@ -2560,7 +2702,7 @@ size_t parse_exp(const char *src, ParserError *err, AsgExp *data) {
             l += t2.len;
             AsgExp *inner;
             inner = sb_add(inners, 1);
-            l += parse_exp(src + l, err, inner);
+            l += parse_exp(src + l, err, inner, pcx);
             if (err->tag != ERR_NONE) {
               sb_free(sids);
               free_sb_exps(inners);
@@ -2593,7 +2735,7 @@ size_t parse_exp(const char *src, ParserError *err, AsgExp *data) {
               }
 
               inner = sb_add(inners, 1);
-              l += parse_exp(src + l, err, inner);
+              l += parse_exp(src + l, err, inner, pcx);
               if (err->tag != ERR_NONE) {
                 sb_free(sids);
                 free_sb_exps(inners);
@@ -2611,6 +2753,7 @@ size_t parse_exp(const char *src, ParserError *err, AsgExp *data) {
             data->fun_app_named.fun = l_fun_app;
             data->fun_app_named.args = inners;
             data->fun_app_named.sids = sids;
+            data->fun_app_named.positions = NULL;
             t = tokenize(src + l);
             break;
           }
@@ -2618,7 +2761,7 @@ size_t parse_exp(const char *src, ParserError *err, AsgExp *data) {
         // anon fun app
         AsgExp *inners = NULL;
         AsgExp *inner = sb_add(inners, 1);
-        l += parse_exp(src + l, err, inner);
+        l += parse_exp(src + l, err, inner, pcx);
         if (err->tag != ERR_NONE) {
           free_sb_exps(inners);
           free(l_fun_app);
@@ -2637,7 +2780,7 @@ size_t parse_exp(const char *src, ParserError *err, AsgExp *data) {
         } else {
           while (t.tt == COMMA) {
             inner = sb_add(inners, 1);
-            l += parse_exp(src + l, err, inner);
+            l += parse_exp(src + l, err, inner, pcx);
             if (err->tag != ERR_NONE) {
               free_sb_exps(inners);
               free(l_fun_app);
@@ -2708,7 +2851,7 @@ size_t parse_exp(const char *src, ParserError *err, AsgExp *data) {
         }
 
         AsgExp *bin_op_rhs = malloc(sizeof(AsgExp));
-        l += parse_exp(src + l, err, bin_op_rhs);
+        l += parse_exp(src + l, err, bin_op_rhs, pcx);
         if (err->tag != ERR_NONE) {
           free(bin_op_rhs);
           return l;
@@ -2744,7 +2887,7 @@ size_t parse_exp(const char *src, ParserError *err, AsgExp *data) {
         }
 
         AsgExp *assign_rhs = malloc(sizeof(AsgExp));
-        l += parse_exp(src + l, err, assign_rhs);
+        l += parse_exp(src + l, err, assign_rhs, pcx);
         if (err->tag != ERR_NONE) {
           free(assign_rhs);
           return l;
@@ -2773,7 +2916,7 @@ size_t parse_exp(const char *src, ParserError *err, AsgExp *data) {
           }
 
           AsgExp *bin_op_rhs = malloc(sizeof(AsgExp));
-          l += parse_exp(src + l, err, bin_op_rhs);
+          l += parse_exp(src + l, err, bin_op_rhs, pcx);
           if (err->tag != ERR_NONE) {
             free(bin_op_rhs);
             return l;
@@ -2793,7 +2936,7 @@ size_t parse_exp(const char *src, ParserError *err, AsgExp *data) {
         l += assign_len;
 
         AsgExp *foo_assign_rhs = malloc(sizeof(AsgExp));
-        l += parse_exp(src + l, err, foo_assign_rhs);
+        l += parse_exp(src + l, err, foo_assign_rhs, pcx);
         if (err->tag != ERR_NONE) {
           free(foo_assign_rhs);
           return l;
@@ -2942,6 +3085,7 @@ void free_inner_exp(AsgExp data) {
       free(data.fun_app_named.fun);
       free_sb_exps(data.fun_app_named.args);
       sb_free(data.fun_app_named.sids);
+      sb_free(data.fun_app_named.positions);
       break;
     case EXP_CAST:
       free_inner_exp(*data.cast.inner);
@@ -3107,11 +3251,12 @@ void free_sb_items(AsgItem *sb) {
   sb_free(sb);
 }
 
-size_t parse_item(const char *src, ParserError *err, AsgItem *data, AsgFile *asg) {
+size_t parse_item(const char *src, ParserError *err, AsgItem *data, AsgFile *asg, ParserCx *pcx) {
   Token t;
   err->tag = ERR_NONE;
   data->asg = asg;
   data->str.start = src;
+  data->disabled = false;
   size_t l = 0;
 
   t = tokenize(src);
@@ -3155,7 +3300,8 @@ size_t parse_item(const char *src, ParserError *err, AsgItem *data, AsgFile *asg
       }
 
       data->tag = ITEM_TYPE;
-      data->type.oo_type.tag = OO_TYPE_UNINITIALIZED;
+      data->type.oo_type = NULL;
+      data->type.canonical = NULL;
       data->str.len = l;
       return l;
     case VAL:
@@ -3196,13 +3342,13 @@ size_t parse_item(const char *src, ParserError *err, AsgItem *data, AsgFile *asg
       }
       l += t.len;
 
-      l += parse_exp(src + l, err, &data->val.exp);
+      l += parse_exp(src + l, err, &data->val.exp, pcx);
       if (err->tag != ERR_NONE) {
         return l;
       }
 
       data->tag = ITEM_VAL;
-      data->val.sid.binding.val.oo_type.tag = OO_TYPE_UNINITIALIZED;
+      data->val.sid.binding.val.oo_type = NULL;
       data->str.len = l;
       return l;
     case FN:
@@ -3417,7 +3563,14 @@ size_t parse_item(const char *src, ParserError *err, AsgItem *data, AsgFile *asg
         data->fun.ret.product_anon = NULL;
       }
 
-      l += parse_block(src + l, err, &data->fun.body);
+      data->fun.frame_size = 0;
+      if (pcx != NULL && pcx->lazy_bodies) {
+        data->fun.body_src = src + l;
+        l += skip_block(src + l, err, &data->fun.body);
+      } else {
+        data->fun.body_src = NULL;
+        l += parse_block(src + l, err, &data->fun.body, pcx);
+      }
       if (err->tag != ERR_NONE) {
         sb_free(data->fun.type_args);
         sb_free(data->fun.arg_muts);
@@ -3428,7 +3581,7 @@ size_t parse_item(const char *src, ParserError *err, AsgItem *data, AsgFile *asg
       }
 
       data->tag = ITEM_FUN;
-      data->fun.sid.binding.val.oo_type.tag = OO_TYPE_UNINITIALIZED;
+      data->fun.sid.binding.val.oo_type = NULL;
       data->str.len = l;
       return l;
     case FFI:
@@ -3495,7 +3648,7 @@ size_t parse_item(const char *src, ParserError *err, AsgItem *data, AsgFile *asg
         }
 
         data->tag = ITEM_FFI_VAL;
-        data->ffi_val.sid.binding.val.oo_type.tag = OO_TYPE_UNINITIALIZED;
+        data->ffi_val.sid.binding.val.oo_type = NULL;
         data->str.len = l;
         return l;
       }
@@ -3508,66 +3661,6 @@ size_t parse_item(const char *src, ParserError *err, AsgItem *data, AsgFile *asg
   }
 }
 
-void free_sb_oo_types(OoType *sb) {
-  int i;
-  int count = sb_count(sb);
-  for (i = 0; i < count; i++) {
-    free_inner_oo_type(sb[i]);
-  }
-  sb_free(sb);
-}
-
-void free_inner_oo_type(OoType t) {
-  switch (t.tag) {
-    case OO_TYPE_UNINITIALIZED:
-    case OO_TYPE_BINDING:
-    case OO_TYPE_SUM:
-      // noop
-      break;
-    case OO_TYPE_PTR:
-      free_inner_oo_type(*t.ptr);
-      free(t.ptr);
-      break;
-    case OO_TYPE_PTR_MUT:
-      free_inner_oo_type(*t.ptr_mut);
-      free(t.ptr_mut);
-      break;
-    case OO_TYPE_ARRAY:
-      free_inner_oo_type(*t.array);
-      free(t.array);
-      break;
-    case OO_TYPE_PRODUCT_REPEATED:
-      free_inner_oo_type(*t.product_repeated.inner);
-      free(t.product_repeated.inner);
-      break;
-    case OO_TYPE_PRODUCT_ANON:
-      free_sb_oo_types(t.product_anon);
-      break;
-    case OO_TYPE_PRODUCT_NAMED:
-      free_sb_oo_types(t.product_named.types);
-      // sids are shared with the syntax graph and freed by it
-      break;
-    case OO_TYPE_FUN_ANON:
-      free_sb_oo_types(t.fun_anon.args);
-      free_inner_oo_type(*t.fun_anon.ret);
-      free(t.fun_anon.ret);
-      break;
-    case OO_TYPE_FUN_NAMED:
-      free_sb_oo_types(t.fun_named.arg_types);
-      // sids are shared with the syntax graph and freed by it
-      free_inner_oo_type(*t.fun_named.ret);
-      free(t.fun_named.ret);
-      break;
-    case OO_TYPE_GENERIC:
-      free_inner_oo_type(*t.generic.inner);
-      free(t.generic.inner);
-      break;
-    case OO_TYPE_APP:
-      free_sb_oo_types(t.app.args);
-      break;
-  }
-}
-
 void free_inner_item(AsgItem data) {
   switch (data.tag) {
     case ITEM_USE:
@@ -3575,12 +3668,10 @@ void free_inner_item(AsgItem data) {
       break;
     case ITEM_TYPE:
       free_inner_type(data.type.type);
-      free_inner_oo_type(data.type.oo_type);
       break;
     case ITEM_VAL:
       free_inner_type(data.val.type);
       free_inner_exp(data.val.exp);
-      free_inner_oo_type(data.val.sid.binding.val.oo_type);
       break;
     case ITEM_FUN:
       sb_free(data.fun.type_args);
@@ -3589,18 +3680,16 @@ void free_inner_item(AsgItem data) {
       free_sb_types(data.fun.arg_types);
       free_inner_type(data.fun.ret);
       free_inner_block(data.fun.body);
-      free_inner_oo_type(data.fun.sid.binding.val.oo_type);
       break;
     case ITEM_FFI_VAL:
       free_inner_type(data.ffi_val.type);
-      free_inner_oo_type(data.ffi_val.sid.binding.val.oo_type);
       break;
     case ITEM_FFI_INCLUDE:
       break;
   }
 }
 
-size_t parse_file(const char *src, ParserError *err, AsgFile *data) {
+size_t parse_file(const char *src, ParserError *err, AsgFile *data, ParserCx *pcx) {
   Token t;
   err->tag = ERR_NONE;
   err->full_src = src;
@@ -3610,40 +3699,30 @@ size_t parse_file(const char *src, ParserError *err, AsgFile *data) {
   AsgItem *items = NULL;
   AsgMeta **all_attrs = NULL; // sb of sbs
 
-  t = tokenize(src + l);
-
-  AsgMeta **attrs = sb_add(all_attrs, 1); // ptr to an sb
-  *attrs = NULL;
-
-  l += parse_attrs(src + l, err, attrs);
-  if (err->tag != ERR_NONE) {
-    free_sb_items(items);
-    free_sb_sb_meta(all_attrs);
-    return l;
-  }
-
-  AsgItem *item = sb_add(items, 1);
-  l += parse_item(src + l, err, item, data);
-  if (err->tag != ERR_NONE) {
-    free_sb_items(items);
-    free_sb_sb_meta(all_attrs);
-    return l;
-  }
-
-  t = tokenize(src + l);
-
-  while (t.tt != END) {
-    AsgMeta **attrs = sb_add(all_attrs, 1); // ptr to an sb
-    *attrs = NULL;
-    l += parse_attrs(src + l, err, attrs);
+  do {
+    AsgMeta *attrs = NULL;
+    l += parse_attrs(src + l, err, &attrs, pcx);
     if (err->tag != ERR_NONE) {
+      free_sb_meta(attrs);
       free_sb_items(items);
       free_sb_sb_meta(all_attrs);
       return l;
     }
 
-    AsgItem *item = sb_add(items, 1);
-    l += parse_item(src + l, err, item, data);
+    if (oo_cc_enabled(attrs, pcx == NULL ? NULL : pcx->enabled)) {
+      // parse_item frees the parts of a failed item, so it is only added on success
+      AsgItem item;
+      l += parse_item(src + l, err, &item, data, pcx);
+      if (err->tag == ERR_NONE) {
+        sb_push(items, item);
+        sb_push(all_attrs, attrs);
+      } else {
+        free_sb_meta(attrs);
+      }
+    } else {
+      free_sb_meta(attrs);
+      l += skip_item(src + l, err);
+    }
     if (err->tag != ERR_NONE) {
       free_sb_items(items);
       free_sb_sb_meta(all_attrs);
@@ -3651,7 +3730,7 @@ size_t parse_file(const char *src, ParserError *err, AsgFile *data) {
     }
 
     t = tokenize(src + l);
-  }
+  } while (t.tt != END);
 
   data->path = NULL;
   data->str.len = l;
@@ -3665,7 +3744,6 @@ size_t parse_file(const char *src, ParserError *err, AsgFile *data) {
 
 void free_inner_ns(AsgNS ns) {
   raxFree(ns.bindings_by_sid);
-  raxFree(ns.pub_bindings_by_sid);
   sb_free(ns.bindings);
 }
 
@@ -3684,9 +3762,5 @@ void free_ns(AsgNS ns) {
     raxFree(ns.bindings_by_sid);
   }
 
-  if (ns.pub_bindings_by_sid != NULL) {
-    raxFree(ns.pub_bindings_by_sid);
-  }
-
   sb_free(ns.bindings);
 }
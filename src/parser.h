@@ -4,6 +4,7 @@
 #include <stddef.h>
 
 #include "asg.h"
+#include "cc.h"
 #include "lexer.h"
 
 typedef enum {
@@ -37,21 +38,32 @@ typedef struct ParserError {
   const char *path;
 } ParserError;
 
+// Options and shared state of a parser run. Functions taking a ParserCx accept
+// NULL, which parses everything eagerly and without conditional compilation.
+typedef struct ParserCx {
+  // cc attributes are resolved to feature ids in this table.
+  OoFeatureTable *features;
+  // Items and expressions not enabled by this set are skipped, NULL to keep everything.
+  const OoFeatureSet *enabled;
+  // If true, function bodies are only skipped over, see AsgItemFun.body_src.
+  bool lazy_bodies;
+} ParserCx;
+
 // All parser functions return how many bytes of the input they consumed.
 // The first argument is the string (null-terminated) from which to parse.
 // Errors are signaled via the second argument.
 // The actual parsed data is populated via the third argument.
 
-size_t parse_file(const char *src, ParserError *err, AsgFile *data);
+size_t parse_file(const char *src, ParserError *err, AsgFile *data, ParserCx *pcx);
 size_t parse_meta(const char *src, ParserError *err, AsgMeta *data);
-size_t parse_item(const char *src, ParserError *err, AsgItem *data, AsgFile *asg);
+size_t parse_item(const char *src, ParserError *err, AsgItem *data, AsgFile *asg, ParserCx *pcx);
 size_t parse_use_tree(const char *src, ParserError *err, AsgUseTree *data, AsgFile *asg);
 size_t parse_item_type(const char *src, ParserError *err, AsgItemType *data);
 size_t parse_type(const char *src, ParserError *err, AsgType *data);
 size_t parse_summand(const char *src, ParserError *err, AsgSummand *data);
 size_t parse_item_val(const char *src, ParserError *err, AsgItemVal *data);
-size_t parse_exp(const char *src, ParserError *err, AsgExp *data);
-size_t parse_block(const char *src, ParserError *err, AsgBlock *data);
+size_t parse_exp(const char *src, ParserError *err, AsgExp *data, ParserCx *pcx);
+size_t parse_block(const char *src, ParserError *err, AsgBlock *data, ParserCx *pcx);
 size_t parse_pattern(const char *src, ParserError *err, AsgPattern *data);
 size_t parse_item_fun(const char *src, ParserError *err, AsgItemFun *data);
 size_t parse_item_ffi_include(const char *src, ParserError *err, AsgItemFfiInclude *data);
@@ -81,6 +93,4 @@ void free_inner_file(AsgFile data);
 void free_sb_meta(AsgMeta *sb);
 void free_sb_exp(AsgExp *sb);
 
-void free_inner_oo_type(OoType t);
-
 #endif
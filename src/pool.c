@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+#include "stretchy_buffer.h"
+
+#define SLAB_SIZE (64 * 1024)
+
+// Every block is preceded by its total size (header included), so that
+// oo_pool_free and oo_pool_realloc can find the size class of a pointer.
+// Small blocks have only that header, large ones additionally link into the
+// list of large allocations. In both cases the size is the last header field.
+typedef struct OoPoolLarge {
+  OoPoolLarge *prev;
+  OoPoolLarge *next;
+  size_t size;
+} OoPoolLarge;
+
+static size_t block_size(void *ptr) {
+  return ((size_t *) ptr)[-1];
+}
+
+static size_t class_of(size_t block) {
+  return (block / OO_POOL_GRANULARITY) - 1;
+}
+
+void oo_pool_init(OoPool *pool) {
+  for (size_t i = 0; i < OO_POOL_CLASSES; i++) {
+    pool->free_lists[i] = NULL;
+  }
+  pool->slabs = NULL;
+  pool->bump = NULL;
+  pool->bump_end = NULL;
+  pool->large = NULL;
+  pool->in_use = 0;
+  pool->peak = 0;
+  pool->reserved = 0;
+}
+
+static void track(OoPool *pool, size_t block) {
+  pool->in_use += block;
+  if (pool->in_use > pool->peak) {
+    pool->peak = pool->in_use;
+  }
+}
+
+static void *alloc_large(OoPool *pool, size_t size) {
+  size_t block = sizeof(OoPoolLarge) + size;
+  OoPoolLarge *l = malloc(block);
+  if (l == NULL) {
+    return NULL;
+  }
+
+  l->prev = NULL;
+  l->next = pool->large;
+  l->size = block;
+  if (pool->large != NULL) {
+    pool->large->prev = l;
+  }
+  pool->large = l;
+
+  pool->reserved += block;
+  track(pool, block);
+  return l + 1;
+}
+
+void *oo_pool_alloc(OoPool *pool, size_t size) {
+  size_t block = size + sizeof(size_t);
+  block = (block + OO_POOL_GRANULARITY - 1) & ~((size_t) OO_POOL_GRANULARITY - 1);
+  if (block > OO_POOL_MAX_SMALL) {
+    return alloc_large(pool, size);
+  }
+
+  size_t c = class_of(block);
+  char *b = pool->free_lists[c];
+  if (b != NULL) {
+    pool->free_lists[c] = *(void **) (b + sizeof(size_t));
+  } else {
+    if (pool->bump == NULL || (size_t) (pool->bump_end - pool->bump) < block) {
+      // The rest of the current slab is lost, at most OO_POOL_MAX_SMALL bytes.
+      char *slab = malloc(SLAB_SIZE);
+      if (slab == NULL) {
+        return NULL;
+      }
+      sb_push(pool->slabs, slab);
+      pool->reserved += SLAB_SIZE;
+      pool->bump = slab;
+      pool->bump_end = slab + SLAB_SIZE;
+    }
+
+    b = pool->bump;
+    pool->bump += block;
+    *(size_t *) b = block;
+  }
+
+  track(pool, block);
+  return b + sizeof(size_t);
+}
+
+void oo_pool_free(OoPool *pool, void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  size_t block = block_size(ptr);
+  pool->in_use -= block;
+
+  if (block > OO_POOL_MAX_SMALL) {
+    OoPoolLarge *l = ((OoPoolLarge *) ptr) - 1;
+    if (l->prev != NULL) {
+      l->prev->next = l->next;
+    } else {
+      pool->large = l->next;
+    }
+    if (l->next != NULL) {
+      l->next->prev = l->prev;
+    }
+    pool->reserved -= block;
+    free(l);
+  } else {
+    size_t c = class_of(block);
+    *(void **) ptr = pool->free_lists[c];
+    pool->free_lists[c] = (char *) ptr - sizeof(size_t);
+  }
+}
+
+void *oo_pool_realloc(OoPool *pool, void *ptr, size_t size) {
+  if (ptr == NULL) {
+    return oo_pool_alloc(pool, size);
+  }
+
+  size_t block = block_size(ptr);
+  size_t capacity = block - (block > OO_POOL_MAX_SMALL ? sizeof(OoPoolLarge) : sizeof(size_t));
+  if (size <= capacity && block <= OO_POOL_MAX_SMALL) {
+    // Shrinking within the size class (or growing into its padding) is free.
+    return ptr;
+  }
+
+  void *new = oo_pool_alloc(pool, size);
+  if (new == NULL) {
+    return NULL;
+  }
+  memcpy(new, ptr, size < capacity ? size : capacity);
+  oo_pool_free(pool, ptr);
+  return new;
+}
+
+void oo_pool_release(OoPool *pool) {
+  for (int i = 0; i < sb_count(pool->slabs); i++) {
+    free(pool->slabs[i]);
+  }
+  sb_free(pool->slabs);
+
+  OoPoolLarge *l = pool->large;
+  while (l != NULL) {
+    OoPoolLarge *next = l->next;
+    free(l);
+    l = next;
+  }
+
+  oo_pool_init(pool);
+}
@@ -0,0 +1,40 @@
+// A size-class pool allocator for many small, long-lived allocations that are
+// released together (e.g. the radix tree nodes of all namespaces of a context).
+#ifndef OO_POOL_H
+#define OO_POOL_H
+
+#include <stddef.h>
+
+// Allocations of at most this many bytes are served from size classes, larger
+// ones go to malloc (but are still released by oo_pool_release).
+#define OO_POOL_MAX_SMALL 512
+#define OO_POOL_GRANULARITY 16
+#define OO_POOL_CLASSES (OO_POOL_MAX_SMALL / OO_POOL_GRANULARITY)
+
+typedef struct OoPoolLarge OoPoolLarge;
+
+typedef struct OoPool {
+  void *free_lists[OO_POOL_CLASSES]; // singly linked through the blocks themselves
+  char **slabs; // owning stretchy buffer of the slabs small blocks are carved from
+  char *bump; // next unused byte in the current slab
+  char *bump_end;
+  OoPoolLarge *large; // owning doubly linked list of large allocations
+  size_t in_use; // bytes currently handed out (including block headers)
+  size_t peak; // maximum of in_use over the lifetime of the pool
+  size_t reserved; // bytes obtained from malloc
+} OoPool;
+
+void oo_pool_init(OoPool *pool);
+
+// Returns NULL if the underlying malloc fails.
+void *oo_pool_alloc(OoPool *pool, size_t size);
+// Like realloc(3), ptr may be NULL.
+void *oo_pool_realloc(OoPool *pool, void *ptr, size_t size);
+// Returns the block to its size class (or to malloc for large blocks).
+void oo_pool_free(OoPool *pool, void *ptr);
+
+// Frees all memory of the pool at once, invalidating all blocks.
+// The pool can be used again afterwards.
+void oo_pool_release(OoPool *pool);
+
+#endif
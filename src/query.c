@@ -0,0 +1,238 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "query.h"
+#include "stretchy_buffer.h"
+
+#define KEY_SIZE (1 + sizeof(void *))
+
+static void make_key(char *key, OoQueryKind kind, const void *ptr) {
+  key[0] = (char) kind;
+  memcpy(key + 1, &ptr, sizeof(void *));
+}
+
+void oo_queries_init(OoQueryTable *table) {
+  table->queries = raxNew();
+  table->active = NULL;
+  table->computed = 0;
+}
+
+static OoQuery *find(OoQueryTable *table, OoQueryKind kind, const void *ptr) {
+  char key[KEY_SIZE];
+  make_key(key, kind, ptr);
+  OoQuery *q = raxFind(table->queries, key, KEY_SIZE);
+  return q == raxNotFound ? NULL : q;
+}
+
+static void remove_from(OoQuery ***queries, OoQuery *q) {
+  for (int i = 0; i < sb_count(*queries); i++) {
+    if ((*queries)[i] == q) {
+      (*queries)[i] = sb_last(*queries);
+      stb__sbn(*queries) -= 1;
+      return;
+    }
+  }
+}
+
+// Records that the innermost active query uses q.
+static void use(OoQueryTable *table, OoQuery *q) {
+  if (sb_count(table->active) == 0) {
+    return;
+  }
+  OoQuery *user = sb_last(table->active);
+  for (int i = 0; i < sb_count(user->deps); i++) {
+    if (user->deps[i] == q) {
+      return;
+    }
+  }
+  sb_push(user->deps, q);
+  sb_push(q->dependents, user);
+}
+
+OoQuery *oo_queries_get(OoQueryTable *table, OoQueryKind kind, const void *key) {
+  OoQuery *q = find(table, kind, key);
+  if (q != NULL) {
+    use(table, q);
+  }
+  return q;
+}
+
+static OoQuery *add(OoQueryTable *table, OoQueryKind kind, const void *ptr) {
+  OoQuery *q = malloc(sizeof(OoQuery));
+  q->kind = kind;
+  q->key = ptr;
+  q->result = NULL;
+  q->done = false;
+  q->marked = false;
+  q->deps = NULL;
+  q->dependents = NULL;
+
+  char key[KEY_SIZE];
+  make_key(key, kind, ptr);
+  raxInsert(table->queries, key, KEY_SIZE, q, NULL);
+  use(table, q);
+  return q;
+}
+
+OoQuery *oo_queries_begin(OoQueryTable *table, OoQueryKind kind, const void *key) {
+  OoQuery *q = add(table, kind, key);
+  sb_push(table->active, q);
+  table->computed += 1;
+  return q;
+}
+
+void oo_queries_end(OoQueryTable *table, void *result) {
+  OoQuery *q = sb_last(table->active);
+  stb__sbn(table->active) -= 1;
+  q->result = result;
+  q->done = true;
+}
+
+void oo_queries_feed(OoQueryTable *table, OoQueryKind kind, const void *key, void *result) {
+  OoQuery *q = find(table, kind, key);
+  if (q == NULL) {
+    q = add(table, kind, key);
+  } else {
+    use(table, q);
+  }
+  q->result = result;
+  q->done = true;
+}
+
+static void free_query(OoQuery *q) {
+  if (q->kind == OO_QUERY_FUN_BODY) {
+    AsgItemFun **callees = q->result;
+    sb_free(callees);
+  }
+  sb_free(q->deps);
+  sb_free(q->dependents);
+  free(q);
+}
+
+// Adds the unmarked dependents of the marked queries to them, transitively.
+static void mark_dependents(OoQuery ***marked) {
+  for (int i = 0; i < sb_count(*marked); i++) {
+    OoQuery *q = (*marked)[i];
+    for (int j = 0; j < sb_count(q->dependents); j++) {
+      if (!q->dependents[j]->marked) {
+        q->dependents[j]->marked = true;
+        sb_push(*marked, q->dependents[j]);
+      }
+    }
+  }
+}
+
+// Removes all marked queries, unlinking them from the remaining ones.
+static void remove_marked(OoQueryTable *table, OoQuery **marked) {
+  for (int i = 0; i < sb_count(marked); i++) {
+    OoQuery *q = marked[i];
+    for (int j = 0; j < sb_count(q->deps); j++) {
+      if (!q->deps[j]->marked) {
+        remove_from(&q->deps[j]->dependents, q);
+      }
+    }
+    for (int j = 0; j < sb_count(q->dependents); j++) {
+      if (!q->dependents[j]->marked) {
+        remove_from(&q->dependents[j]->deps, q);
+      }
+    }
+  }
+
+  for (int i = 0; i < sb_count(marked); i++) {
+    char key[KEY_SIZE];
+    make_key(key, marked[i]->kind, marked[i]->key);
+    raxRemove(table->queries, key, KEY_SIZE, NULL);
+    free_query(marked[i]);
+  }
+  sb_free(marked);
+}
+
+void oo_queries_abort(OoQueryTable *table) {
+  OoQuery *q = sb_last(table->active);
+  stb__sbn(table->active) -= 1;
+  OoQuery **marked = NULL;
+  q->marked = true;
+  sb_push(marked, q);
+  remove_marked(table, marked);
+}
+
+void oo_queries_invalidate(OoQueryTable *table, OoQueryKind kind, const void *key) {
+  OoQuery *q = find(table, kind, key);
+  if (q == NULL) {
+    return;
+  }
+
+  OoQuery **marked = NULL;
+  q->marked = true;
+  sb_push(marked, q);
+  mark_dependents(&marked);
+  remove_marked(table, marked);
+}
+
+void oo_queries_invalidate_where(OoQueryTable *table, bool (*drop)(const OoQuery *q, void *data), void *data) {
+  OoQuery **marked = NULL;
+  raxIterator it;
+  raxStart(&it, table->queries);
+  raxSeek(&it, "^", NULL, 0);
+  while (raxNext(&it)) {
+    OoQuery *q = it.data;
+    if (drop(q, data)) {
+      q->marked = true;
+      sb_push(marked, q);
+    }
+  }
+  raxStop(&it);
+
+  mark_dependents(&marked);
+  remove_marked(table, marked);
+}
+
+void oo_queries_forget_body(OoQueryTable *table, AsgItemFun *fun) {
+  OoQuery *q = find(table, OO_QUERY_FUN_BODY, fun);
+  if (q == NULL) {
+    return;
+  }
+
+  // The expressions and locals of the body are only ever requested while
+  // checking it, so they are exactly the ones reachable through deps.
+  OoQuery **marked = NULL;
+  q->marked = true;
+  sb_push(marked, q);
+  for (int i = 0; i < sb_count(marked); i++) {
+    OoQuery *m = marked[i];
+    for (int j = 0; j < sb_count(m->deps); j++) {
+      OoQuery *dep = m->deps[j];
+      if (!dep->marked && (dep->kind == OO_QUERY_EXP_TYPE || dep->kind == OO_QUERY_LOCAL_TYPE)) {
+        dep->marked = true;
+        sb_push(marked, dep);
+      }
+    }
+  }
+  mark_dependents(&marked);
+  remove_marked(table, marked);
+}
+
+uint64_t oo_queries_count(const OoQueryTable *table) {
+  return raxSize(table->queries);
+}
+
+void oo_queries_clear(OoQueryTable *table) {
+  raxIterator it;
+  raxStart(&it, table->queries);
+  raxSeek(&it, "^", NULL, 0);
+  while (raxNext(&it)) {
+    free_query(it.data);
+  }
+  raxStop(&it);
+  raxFree(table->queries);
+  table->queries = raxNew();
+  if (table->active != NULL) {
+    stb__sbn(table->active) = 0;
+  }
+}
+
+void oo_queries_free(OoQueryTable *table) {
+  oo_queries_clear(table);
+  raxFree(table->queries);
+  sb_free(table->active);
+}
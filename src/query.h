@@ -0,0 +1,89 @@
+// Memoized results of the analyses of function bodies ("queries"), together
+// with the dependencies between them.
+//
+// A query is identified by its kind and a key (a pointer into the ASG or an
+// interned type). It is computed when it is first requested (see the query
+// functions of the type checker in context.h), and its result is kept here.
+// While a query is computed it is the innermost active query, and every query
+// requested in the meantime is recorded as one of its dependencies. So
+// invalidating a query can also invalidate exactly those queries that were
+// computed from it.
+#ifndef OO_QUERY_H
+#define OO_QUERY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "asg.h"
+#include "rax.h"
+
+typedef enum {
+  OO_QUERY_FUN_TYPE, // key AsgItemFun *, result the OoType * of its signature
+  OO_QUERY_FUN_BODY, // key AsgItemFun *, result an owned stretchy buffer of the AsgItemFun * it refers to
+  OO_QUERY_EXP_TYPE, // key AsgExp *, result its OoType *, NULL if it can not be inferred
+  OO_QUERY_LOCAL_TYPE, // key AsgPatternId *, result its OoType *, NULL if it can not be inferred
+  OO_QUERY_LAYOUT // key OoType *, result its const OoLayout * (owned by the layouts of the context)
+} OoQueryKind;
+
+typedef struct OoQuery {
+  OoQueryKind kind;
+  const void *key;
+  void *result;
+  bool done; // false while the query is being computed
+  bool marked; // used while removing queries
+  struct OoQuery **deps; // stretchy buffer of the queries whose results this one used
+  struct OoQuery **dependents; // stretchy buffer of the queries that used the result of this one
+} OoQuery;
+
+typedef struct OoQueryTable {
+  rax *queries; // kind and key to the owned OoQuery
+  OoQuery **active; // stretchy buffer, the stack of queries being computed
+  uint64_t computed; // number of queries computed so far, i.e. memoization misses
+} OoQueryTable;
+
+void oo_queries_init(OoQueryTable *table);
+
+// Returns the query of the given kind and key, or NULL if it has not been
+// requested yet. A query that is found is recorded as a dependency of the
+// innermost active query.
+OoQuery *oo_queries_get(OoQueryTable *table, OoQueryKind kind, const void *key);
+
+// Adds the query of the given kind and key (which must not exist yet), records
+// it as a dependency of the innermost active query and makes it the innermost
+// active query.
+OoQuery *oo_queries_begin(OoQueryTable *table, OoQueryKind kind, const void *key);
+
+// Completes the innermost active query with the given result.
+void oo_queries_end(OoQueryTable *table, void *result);
+
+// Removes the innermost active query (e.g. after an error), it is computed
+// again when it is requested the next time.
+void oo_queries_abort(OoQueryTable *table);
+
+// Sets the result of a query that is not computed on its own but as a by-product
+// of the innermost active query (e.g. the type of a local from its definition).
+// The query is recorded as a dependency of the innermost active query.
+void oo_queries_feed(OoQueryTable *table, OoQueryKind kind, const void *key, void *result);
+
+// Removes the query (if it exists) and, transitively, all queries that depend
+// on it.
+void oo_queries_invalidate(OoQueryTable *table, OoQueryKind kind, const void *key);
+
+// Removes the queries for which drop returns true and, transitively, all
+// queries that depend on them.
+void oo_queries_invalidate_where(OoQueryTable *table, bool (*drop)(const OoQuery *q, void *data), void *data);
+
+// Removes the OO_QUERY_FUN_BODY query of fun together with the queries about
+// the expressions and locals of its body, for when the body is freed. The
+// queries depending on them are removed as well.
+void oo_queries_forget_body(OoQueryTable *table, AsgItemFun *fun);
+
+// Number of memoized queries.
+uint64_t oo_queries_count(const OoQueryTable *table);
+
+// Removes all queries.
+void oo_queries_clear(OoQueryTable *table);
+
+void oo_queries_free(OoQueryTable *table);
+
+#endif
@@ -138,11 +138,11 @@ static inline void raxStackFree(raxStack *ts) {
  * If datafiled is true, the allocation is made large enough to hold the
  * associated data pointer.
  * Returns the new node pointer. On out of memory NULL is returned. */
-raxNode *raxNewNode(size_t children, int datafield) {
+raxNode *raxNewNode(rax *rax, size_t children, int datafield) {
     size_t nodesize = sizeof(raxNode)+children+
                       sizeof(raxNode*)*children;
     if (datafield) nodesize += sizeof(void*);
-    raxNode *node = rax_malloc(nodesize);
+    raxNode *node = rax_node_malloc(rax,nodesize);
     if (node == NULL) return NULL;
     node->iskey = 0;
     node->isnull = 0;
@@ -154,13 +154,22 @@ raxNode *raxNewNode(size_t children, int datafield) {
 /* Allocate a new rax and return its pointer. On out of memory the function
  * returns NULL. */
 rax *raxNew(void) {
-    rax *rax = rax_malloc(sizeof(*rax));
+    return raxNewWithAllocator(NULL);
+}
+
+/* Like raxNew(), but the rax struct and all of its nodes are allocated
+ * through 'alloc' (see rax_malloc.h). The allocator handle is not copied,
+ * so it must outlive the tree. A NULL allocator selects the default one. */
+rax *raxNewWithAllocator(raxAllocator *alloc) {
+    rax *rax = alloc ? alloc->malloc(alloc->ctx,sizeof(*rax)) :
+                       rax_malloc(sizeof(*rax));
     if (rax == NULL) return NULL;
+    rax->alloc = alloc;
     rax->numele = 0;
     rax->numnodes = 1;
-    rax->head = raxNewNode(0,0);
+    rax->head = raxNewNode(rax,0,0);
     if (rax->head == NULL) {
-        rax_free(rax);
+        rax_node_free(rax,rax);
         return NULL;
     } else {
         return rax;
@@ -176,10 +185,10 @@ rax *raxNew(void) {
 
 /* realloc the node to make room for auxiliary data in order
  * to store an item in that node. On out of memory NULL is returned. */
-raxNode *raxReallocForData(raxNode *n, void *data) {
+raxNode *raxReallocForData(rax *rax, raxNode *n, void *data) {
     if (data == NULL) return n; /* No reallocation needed, setting isnull=1 */
     size_t curlen = raxNodeCurrentLength(n);
-    return rax_realloc(n,curlen+sizeof(void*));
+    return rax_node_realloc(rax,n,curlen+sizeof(void*));
 }
 
 /* Set the node auxiliary data to the specified pointer. */
@@ -213,7 +222,7 @@ void *raxGetData(raxNode *n) {
  * On success the new parent node pointer is returned (it may change because
  * of the realloc, so the caller should discard 'n' and use the new value).
  * On out of memory NULL is returned, and the old node is still valid. */
-raxNode *raxAddChild(raxNode *n, char c, raxNode **childptr, raxNode ***parentlink) {
+raxNode *raxAddChild(rax *rax, raxNode *n, char c, raxNode **childptr, raxNode ***parentlink) {
     assert(n->iscompr == 0);
 
     size_t curlen = sizeof(raxNode)+
@@ -222,15 +231,15 @@ raxNode *raxAddChild(raxNode *n, char c, raxNode **childptr, raxNode ***parentli
     size_t newlen;
 
     /* Alloc the new child we will link to 'n'. */
-    raxNode *child = raxNewNode(0,0);
+    raxNode *child = raxNewNode(rax,0,0);
     if (child == NULL) return NULL;
 
     /* Make space in the original node. */
     if (n->iskey) curlen += sizeof(void*);
     newlen = curlen+sizeof(raxNode*)+1; /* Add 1 char and 1 pointer. */
-    raxNode *newn = rax_realloc(n,newlen);
+    raxNode *newn = rax_node_realloc(rax,n,newlen);
     if (newn == NULL) {
-        rax_free(child);
+        rax_node_free(rax,child);
         return NULL;
     }
     n = newn;
@@ -309,7 +318,7 @@ raxNode *raxAddChild(raxNode *n, char c, raxNode **childptr, raxNode ***parentli
  * The function also returns a child node, since the last node of the
  * compressed chain cannot be part of the chain: it has zero children while
  * we can only compress inner nodes with exactly one child each. */
-raxNode *raxCompressNode(raxNode *n, const char *s, size_t len, raxNode **child) {
+raxNode *raxCompressNode(rax *rax, raxNode *n, const char *s, size_t len, raxNode **child) {
     assert(n->size == 0 && n->iscompr == 0);
     void *data = NULL; /* Initialized only to avoid warnings. */
     size_t newsize;
@@ -317,7 +326,7 @@ raxNode *raxCompressNode(raxNode *n, const char *s, size_t len, raxNode **child)
     debugf("Compress node: %.*s\n", (int)len,s);
 
     /* Allocate the child to link to this node. */
-    *child = raxNewNode(0,0);
+    *child = raxNewNode(rax,0,0);
     if (*child == NULL) return NULL;
 
     /* Make space in the parent node. */
@@ -326,9 +335,9 @@ raxNode *raxCompressNode(raxNode *n, const char *s, size_t len, raxNode **child)
         data = raxGetData(n); /* To restore it later. */
         if (!n->isnull) newsize += sizeof(void*);
     }
-    raxNode *newn = rax_realloc(n,newsize);
+    raxNode *newn = rax_node_realloc(rax,n,newsize);
     if (newn == NULL) {
-        rax_free(*child);
+        rax_node_free(rax,*child);
         return NULL;
     }
     n = newn;
@@ -438,7 +447,7 @@ int raxInsert(rax *rax, const char *s, size_t len, void *data, void **old) {
     if (i == len && (!h->iscompr || j == 0 /* not in the middle if j is 0 */)) {
         debugf("### Insert: node representing key exists\n");
         if (!h->iskey || h->isnull) {
-            h = raxReallocForData(h,data);
+            h = raxReallocForData(rax,h,data);
             if (h) memcpy(parentlink,&h,sizeof(h));
         }
         if (h == NULL) {
@@ -606,20 +615,20 @@ int raxInsert(rax *rax, const char *s, size_t len, void *data, void **old) {
 
         /* 2: Create the split node. Also allocate the other nodes we'll need
          *    ASAP, so that it will be simpler to handle OOM. */
-        raxNode *splitnode = raxNewNode(1, split_node_is_key);
+        raxNode *splitnode = raxNewNode(rax,1, split_node_is_key);
         raxNode *trimmed = NULL;
         raxNode *postfix = NULL;
 
         if (trimmedlen) {
             nodesize = sizeof(raxNode)+trimmedlen+sizeof(raxNode*);
             if (h->iskey && !h->isnull) nodesize += sizeof(void*);
-            trimmed = rax_malloc(nodesize);
+            trimmed = rax_node_malloc(rax,nodesize);
         }
 
         if (postfixlen) {
             nodesize = sizeof(raxNode)+postfixlen+
                        sizeof(raxNode*);
-            postfix = rax_malloc(nodesize);
+            postfix = rax_node_malloc(rax,nodesize);
         }
 
         /* OOM? Abort now that the tree is untouched. */
@@ -627,9 +636,9 @@ int raxInsert(rax *rax, const char *s, size_t len, void *data, void **old) {
             (trimmedlen && trimmed == NULL) ||
             (postfixlen && postfix == NULL))
         {
-            rax_free(splitnode);
-            rax_free(trimmed);
-            rax_free(postfix);
+            rax_node_free(rax,splitnode);
+            rax_node_free(rax,trimmed);
+            rax_node_free(rax,postfix);
             errno = ENOMEM;
             return 0;
         }
@@ -684,7 +693,7 @@ int raxInsert(rax *rax, const char *s, size_t len, void *data, void **old) {
         /* 6. Continue insertion: this will cause the splitnode to
          * get a new child (the non common character at the currently
          * inserted key). */
-        rax_free(h);
+        rax_node_free(rax,h);
         h = splitnode;
     } else if (h->iscompr && i == len) {
     /* ------------------------- ALGORITHM 2 --------------------------- */
@@ -695,15 +704,15 @@ int raxInsert(rax *rax, const char *s, size_t len, void *data, void **old) {
         size_t postfixlen = h->size - j;
         size_t nodesize = sizeof(raxNode)+postfixlen+sizeof(raxNode*);
         if (data != NULL) nodesize += sizeof(void*);
-        raxNode *postfix = rax_malloc(nodesize);
+        raxNode *postfix = rax_node_malloc(rax,nodesize);
 
         nodesize = sizeof(raxNode)+j+sizeof(raxNode*);
         if (h->iskey && !h->isnull) nodesize += sizeof(void*);
-        raxNode *trimmed = rax_malloc(nodesize);
+        raxNode *trimmed = rax_node_malloc(rax,nodesize);
 
         if (postfix == NULL || trimmed == NULL) {
-            rax_free(postfix);
-            rax_free(trimmed);
+            rax_node_free(rax,postfix);
+            rax_node_free(rax,trimmed);
             errno = ENOMEM;
             return 0;
         }
@@ -744,7 +753,7 @@ int raxInsert(rax *rax, const char *s, size_t len, void *data, void **old) {
         /* Finish! We don't need to contine with the insertion
          * algorithm for ALGO 2. The key is already inserted. */
         rax->numele++;
-        rax_free(h);
+        rax_node_free(rax,h);
         return 1; /* Key inserted. */
     }
 
@@ -761,7 +770,7 @@ int raxInsert(rax *rax, const char *s, size_t len, void *data, void **old) {
             size_t comprsize = len-i;
             if (comprsize > RAX_NODE_MAX_SIZE)
                 comprsize = RAX_NODE_MAX_SIZE;
-            raxNode *newh = raxCompressNode(h,s+i,comprsize,&child);
+            raxNode *newh = raxCompressNode(rax,h,s+i,comprsize,&child);
             if (newh == NULL) goto oom;
             h = newh;
             memcpy(parentlink,&h,sizeof(h));
@@ -770,7 +779,7 @@ int raxInsert(rax *rax, const char *s, size_t len, void *data, void **old) {
         } else {
             debugf("Inserting normal node\n");
             raxNode **new_parentlink;
-            raxNode *newh = raxAddChild(h,s[i],&child,&new_parentlink);
+            raxNode *newh = raxAddChild(rax,h,s[i],&child,&new_parentlink);
             if (newh == NULL) goto oom;
             h = newh;
             memcpy(parentlink,&h,sizeof(h));
@@ -780,7 +789,7 @@ int raxInsert(rax *rax, const char *s, size_t len, void *data, void **old) {
         rax->numnodes++;
         h = child;
     }
-    raxNode *newh = raxReallocForData(h,data);
+    raxNode *newh = raxReallocForData(rax,h,data);
     if (newh == NULL) goto oom;
     h = newh;
     if (!h->iskey) rax->numele++;
@@ -838,7 +847,7 @@ raxNode **raxFindParentLink(raxNode *parent, raxNode *child) {
  * removal) is returned. Note that this function does not fix the pointer
  * of the parent node in its parent, so this task is up to the caller.
  * The function never fails for out of memory. */
-raxNode *raxRemoveChild(raxNode *parent, raxNode *child) {
+raxNode *raxRemoveChild(rax *rax, raxNode *parent, raxNode *child) {
     debugnode("raxRemoveChild before", parent);
     /* If parent is a compressed node (having a single child, as for definition
      * of the data structure), the removal of the child consists into turning
@@ -892,11 +901,11 @@ raxNode *raxRemoveChild(raxNode *parent, raxNode *child) {
 
     /* realloc the node according to the theoretical memory usage, to free
      * data if we are over-allocating right now. */
-    raxNode *newnode = rax_realloc(parent,raxNodeCurrentLength(parent));
+    raxNode *newnode = rax_node_realloc(rax,parent,raxNodeCurrentLength(parent));
     if (newnode) {
         debugnode("raxRemoveChild after", newnode);
     }
-    /* Note: if rax_realloc() fails we just return the old address, which
+    /* Note: if rax_node_realloc() fails we just return the old address, which
      * is valid. */
     return newnode ? newnode : parent;
 }
@@ -935,7 +944,7 @@ int raxRemove(rax *rax, const char *s, size_t len, void **old) {
             child = h;
             debugf("Freeing child %p [%.*s] key:%d\n", (void*)child,
                 (int)child->size, (char*)child->data, child->iskey);
-            rax_free(child);
+            rax_node_free(rax,child);
             rax->numnodes--;
             h = raxStackPop(&ts);
              /* If this node has more then one child, or actually holds
@@ -945,7 +954,7 @@ int raxRemove(rax *rax, const char *s, size_t len, void **old) {
         if (child) {
             debugf("Unlinking child %p from parent %p\n",
                 (void*)child, (void*)h);
-            raxNode *new = raxRemoveChild(h,child);
+            raxNode *new = raxRemoveChild(rax,h,child);
             if (new != h) {
                 raxNode *parent = raxStackPeek(&ts);
                 raxNode **parentlink;
@@ -1052,7 +1061,7 @@ int raxRemove(rax *rax, const char *s, size_t len, void **old) {
             /* If we can compress, create the new node and populate it. */
             size_t nodesize =
                 sizeof(raxNode)+comprsize+sizeof(raxNode*);
-            raxNode *new = rax_malloc(nodesize);
+            raxNode *new = rax_node_malloc(rax,nodesize);
             /* An out of memory here just means we cannot optimize this
              * node, but the tree is left in a consistent state. */
             if (new == NULL) {
@@ -1076,7 +1085,7 @@ int raxRemove(rax *rax, const char *s, size_t len, void **old) {
                 raxNode **cp = raxNodeLastChildPtr(h);
                 raxNode *tofree = h;
                 memcpy(&h,cp,sizeof(h));
-                rax_free(tofree); rax->numnodes--;
+                rax_node_free(rax,tofree); rax->numnodes--;
                 if (h->iskey || (!h->iscompr && h->size != 1)) break;
             }
             debugnode("New node",new);
@@ -1117,16 +1126,21 @@ void raxRecursiveFree(rax *rax, raxNode *n, void (*free_callback)(void*)) {
     debugnode("free depth-first",n);
     if (free_callback && n->iskey && !n->isnull)
         free_callback(raxGetData(n));
-    rax_free(n);
+    rax_node_free(rax,n);
     rax->numnodes--;
 }
 
 /* Free a whole radix tree, calling the specified callback in order to
- * free the auxiliary data. */
+ * free the auxiliary data.
+ *
+ * If the tree uses an allocator without a free function, its memory is
+ * reclaimed in bulk by the owner of the allocator, so the nodes are only
+ * visited when there is a callback to run. */
 void raxFreeWithCallback(rax *rax, void (*free_callback)(void*)) {
+    if (rax->alloc && rax->alloc->free == NULL && free_callback == NULL) return;
     raxRecursiveFree(rax,rax->head,free_callback);
     assert(rax->numnodes == 0);
-    rax_free(rax);
+    rax_node_free(rax,rax);
 }
 
 /* Free a whole radix tree. */
@@ -100,7 +100,16 @@ typedef struct raxNode {
     char data[];
 } raxNode;
 
+/* Allocator handle, see rax_malloc.h. */
+typedef struct raxAllocator {
+    void *(*malloc)(void *ctx, size_t size);
+    void *(*realloc)(void *ctx, void *ptr, size_t size);
+    void (*free)(void *ctx, void *ptr); /* NULL if memory is freed in bulk. */
+    void *ctx;
+} raxAllocator;
+
 typedef struct rax {
+    raxAllocator *alloc; /* NULL for the default allocator. */
     raxNode *head;
     uint64_t numele;
     uint64_t numnodes;
@@ -144,6 +153,7 @@ extern void *raxNotFound;
 
 /* Exported API. */
 rax *raxNew(void);
+rax *raxNewWithAllocator(raxAllocator *alloc);
 int raxInsert(rax *rax, const char *s, size_t len, void *data, void **old);
 int raxRemove(rax *rax, const char *s, size_t len, void **old);
 void *raxFind(rax *rax, const char *s, size_t len);
@@ -40,5 +40,20 @@
 #define rax_malloc malloc
 #define rax_realloc realloc
 #define rax_free free
+
+/* Node allocation.
+ *
+ * Trees created with raxNewWithAllocator() route the allocation of the rax
+ * struct and of all their nodes through their raxAllocator, everything else
+ * (walk stacks, iterator keys) is short-lived and always uses the defines
+ * above. If the allocator has no free function, individual nodes are never
+ * freed, the owner of the allocator releases them all at once. */
+#define rax_node_malloc(r,size) ((r)->alloc ? \
+    (r)->alloc->malloc((r)->alloc->ctx,(size)) : rax_malloc(size))
+#define rax_node_realloc(r,ptr,size) ((r)->alloc ? \
+    (r)->alloc->realloc((r)->alloc->ctx,(ptr),(size)) : rax_realloc((ptr),(size)))
+#define rax_node_free(r,ptr) ((r)->alloc ? \
+    ((r)->alloc->free ? (r)->alloc->free((r)->alloc->ctx,(ptr)) : (void) 0) : \
+    rax_free(ptr))
 #endif
 
@@ -0,0 +1,24 @@
+// SHA-256 (FIPS 180-4), used to derive content-addressed cache keys.
+#ifndef OO_SHA256_H
+#define OO_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define OO_SHA256_LEN 32
+
+// Incremental hashing state, feed data with oo_sha256_update.
+typedef struct OoSha256 {
+  uint32_t state[8];
+  uint64_t total; // number of bytes hashed so far
+  uint8_t block[64]; // pending input, the first (total % 64) bytes are valid
+} OoSha256;
+
+void oo_sha256_init(OoSha256 *h);
+void oo_sha256_update(OoSha256 *h, const void *data, size_t len);
+void oo_sha256_final(OoSha256 *h, uint8_t out[OO_SHA256_LEN]);
+
+// Writes the lowercase hex encoding of a digest plus a terminating 0 to out.
+void oo_sha256_hex(const uint8_t digest[OO_SHA256_LEN], char out[2 * OO_SHA256_LEN + 1]);
+
+#endif
@@ -1,10 +1,14 @@
 #include <assert.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "asg.h"
 #include "stretchy_buffer.h"
 #include "context.h"
+#include "eval.h"
+#include "layout.h"
 
 // The kind of a type is the number of type argument it takes. Since only kind 0
 // types can be passed as type arguments, this single number is sufficient.
@@ -42,754 +46,1276 @@ static uint32_t id_kind_arity(OoError *err, AsgId *id) {
   return ar;
 }
 
-static void file_kind_checking(OoContext *cx, OoError *err, AsgFile *asg);
-static void type_kind_checking(OoContext *cx, OoError *err, AsgType *type);
-static void summand_kind_checking(OoContext *cx, OoError *err, AsgSummand *summand);
-static void exp_kind_checking(OoContext *cx, OoError *err, AsgExp *exp);
-static void pattern_kind_checking(OoContext *cx, OoError *err, AsgPattern *p);
-static void block_kind_checking(OoContext *cx, OoError *err, AsgBlock *block);
-
-static void file_kind_checking(OoContext *cx, OoError *err, AsgFile *asg) {
-  err->asg = asg;
-  size_t count = sb_count(asg->items);
-  for (size_t i = 0; i < count; i++) {
-    switch (asg->items[i].tag) {
-      case ITEM_TYPE:
-        type_kind_checking(cx, err, &asg->items[i].type.type);
+// Kind checking is a visitor (see visit.h) with a single post hook, so it only
+// looks at a type application once the ids of the application have been bound.
+static void kind_type_post(void *data, OoError *err, AsgType *type) {
+  size_t count;
+  size_t tlf_kind;
+  switch (type->tag) {
+    case TYPE_APP_ANON:
+      tlf_kind = id_kind_arity(err, &type->app_anon.tlf);
+      if (err->tag != OO_ERR_NONE) {
         break;
-      case ITEM_VAL:
-        type_kind_checking(cx, err, &asg->items[i].val.type);
-        if (err->tag != OO_ERR_NONE) {
-          return;
+      }
+      if (tlf_kind != (size_t) sb_count(type->app_anon.args)) {
+        err->tag = OO_ERR_WRONG_NUMBER_OF_TYPE_ARGS;
+        err->wrong_number_of_type_args = type;
+        break;
+      }
+
+      count = sb_count(type->app_anon.args);
+      for (size_t i = 0; i < count; i++) {
+        if (kind_arity(&type->app_anon.args[i]) != 0) {
+          err->tag = OO_ERR_HIGHER_ORDER_TYPE_ARG;
+          err->higher_order_type_arg = &type->app_anon.args[i];
+          break;
         }
-        exp_kind_checking(cx, err, &asg->items[i].val.exp);
+      }
+      break;
+    case TYPE_APP_NAMED:
+      tlf_kind = id_kind_arity(err, &type->app_named.tlf);
+      if (err->tag != OO_ERR_NONE) {
         break;
-      case ITEM_FUN:
-        for (size_t j = 0; j < (size_t) sb_count(asg->items[i].fun.arg_types); j++) {
-          type_kind_checking(cx, err, &asg->items[i].fun.arg_types[j]);
-          if (err->tag != OO_ERR_NONE) {
-            return;
-          }
+      }
+      if (tlf_kind != (size_t) sb_count(type->app_named.types)) {
+        err->tag = OO_ERR_WRONG_NUMBER_OF_TYPE_ARGS;
+        err->wrong_number_of_type_args = type;
+        break;
+      }
+
+      count = sb_count(type->app_named.types);
+      for (size_t i = 0; i < count; i++) {
+        if (kind_arity(&type->app_named.types[i]) != 0) {
+          err->tag = OO_ERR_HIGHER_ORDER_TYPE_ARG;
+          err->higher_order_type_arg = &type->app_anon.args[i];
+          break;
         }
 
-        type_kind_checking(cx, err, &asg->items[i].fun.ret);
-        if (err->tag != OO_ERR_NONE) {
-          return;
+        assert(type->app_named.tlf.binding.type->type.tag == TYPE_GENERIC);
+        if (!str_eq(type->app_named.tlf.binding.type->type.generic.args[i].str, type->app_named.sids[i].str)) {
+          err->tag = OO_ERR_NAMED_TYPE_APP_SID;
+          err->named_type_app_sid = &type->app_named.sids[i];
+          break;
         }
+      }
+      break;
+    default:
+      break;
+  }
 
-        block_kind_checking(cx, err, &asg->items[i].fun.body);
-        break;
-      case ITEM_FFI_VAL:
-        type_kind_checking(cx, err, &asg->items[i].ffi_val.type);
-        break;
-      case ITEM_USE:
-      case ITEM_FFI_INCLUDE:
-        // noop
-        break;
-    }
+  if (err->tag != OO_ERR_NONE) {
+    err->asg = data;
+  }
+}
+
+void oo_kind_check_visitor(OoVisitor *v, AsgFile *asg) {
+  oo_visitor_init(v, asg);
+  v->type_post = kind_type_post;
+}
 
+void oo_cx_kind_check_file(OoContext *cx, OoError *err, AsgFile *asg) {
+  if (asg->kind_checked) {
+    return;
+  }
+
+  OoVisitor v;
+  oo_kind_check_visitor(&v, asg);
+  oo_visit_file(cx, err, asg, &v, 1);
+  if (err->tag != OO_ERR_NONE) {
+    return;
+  }
+  asg->kind_checked = true;
+}
+
+void oo_cx_kind_checking(OoContext *cx, OoError *err) {
+  int count = sb_count(cx->files);
+  for (int i = 0; i < count; i++) {
+    oo_cx_kind_check_file(cx, err, cx->files[i]);
     if (err->tag != OO_ERR_NONE) {
       return;
     }
   }
 }
 
-static void type_kind_checking(OoContext *cx, OoError *err, AsgType *type) {
-  size_t count;
-  size_t tlf_kind;
-  switch (type->tag) {
+static OoType *asg_type_to_oo_type(OoContext *cx, OoError *err, AsgType *asg_type);
+
+// Lowers a stretchy buffer of types into a stretchy buffer of interned types.
+// Returns NULL (and frees everything) on error.
+static OoType **asg_types_to_oo_types(OoContext *cx, OoError *err, AsgType *asg_types) {
+  OoType **oo_types = NULL;
+  for (int i = 0; i < sb_count(asg_types); i++) {
+    OoType *t = asg_type_to_oo_type(cx, err, &asg_types[i]);
+    if (err->tag != OO_ERR_NONE) {
+      sb_free(oo_types);
+      return NULL;
+    }
+    sb_push(oo_types, t);
+  }
+  return oo_types;
+}
+
+// Compute the (interned) OoType corresponding to an AsgType. Returns NULL for
+// types that are not supported yet (macros).
+static OoType *asg_type_to_oo_type(OoContext *cx, OoError *err, AsgType *asg_type) {
+  OoType shape;
+  switch (asg_type->tag) {
     case TYPE_ID:
-    case TYPE_MACRO:
-      // noop
+      shape.tag = OO_TYPE_BINDING;
+      shape.binding = &asg_type->id.binding;
       break;
+    case TYPE_MACRO:
+      return NULL;
     case TYPE_PTR:
-      type_kind_checking(cx, err, type->ptr);
+      shape.tag = OO_TYPE_PTR;
+      shape.ptr = asg_type_to_oo_type(cx, err, asg_type->ptr);
       break;
     case TYPE_PTR_MUT:
-      type_kind_checking(cx, err, type->ptr_mut);
+      shape.tag = OO_TYPE_PTR_MUT;
+      shape.ptr_mut = asg_type_to_oo_type(cx, err, asg_type->ptr_mut);
       break;
     case TYPE_ARRAY:
-      type_kind_checking(cx, err, type->array);
+      shape.tag = OO_TYPE_ARRAY;
+      shape.array = asg_type_to_oo_type(cx, err, asg_type->array);
       break;
     case TYPE_PRODUCT_REPEATED:
-      type_kind_checking(cx, err, type->product_repeated.inner);
+      shape.tag = OO_TYPE_PRODUCT_REPEATED;
+      shape.product_repeated.inner = asg_type_to_oo_type(cx, err, asg_type->product_repeated.inner);
+      if (err->tag != OO_ERR_NONE) {
+        return NULL;
+      }
+      shape.product_repeated.repetitions = oo_cx_eval_repeat(cx, err, &asg_type->product_repeated.repeat);
       break;
     case TYPE_PRODUCT_ANON:
-      count = sb_count(type->product_anon);
-      for (size_t i = 0; i < count; i++) {
-        type_kind_checking(cx, err, &type->product_anon[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
+      shape.tag = OO_TYPE_PRODUCT_ANON;
+      shape.product_anon = asg_types_to_oo_types(cx, err, asg_type->product_anon);
       break;
     case TYPE_PRODUCT_NAMED:
-      count = sb_count(type->product_named.types);
-      for (size_t i = 0; i < count; i++) {
-        type_kind_checking(cx, err, &type->product_named.types[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
+      shape.tag = OO_TYPE_PRODUCT_NAMED;
+      shape.product_named.types = asg_types_to_oo_types(cx, err, asg_type->product_named.types);
+      shape.product_named.sids = asg_type->product_named.sids;
       break;
     case TYPE_FUN_ANON:
-      count = sb_count(type->fun_anon.args);
-      for (size_t i = 0; i < count; i++) {
-        type_kind_checking(cx, err, &type->fun_anon.args[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
+      shape.tag = OO_TYPE_FUN_ANON;
+      shape.fun_anon.args = asg_types_to_oo_types(cx, err, asg_type->fun_anon.args);
+      if (err->tag != OO_ERR_NONE) {
+        return NULL;
+      }
+      shape.fun_anon.ret = asg_type_to_oo_type(cx, err, asg_type->fun_anon.ret);
+      if (err->tag != OO_ERR_NONE) {
+        sb_free(shape.fun_anon.args);
       }
-      type_kind_checking(cx, err, type->fun_anon.ret);
       break;
     case TYPE_FUN_NAMED:
-      count = sb_count(type->fun_named.arg_types);
-      for (size_t i = 0; i < count; i++) {
-        type_kind_checking(cx, err, &type->fun_named.arg_types[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
+      shape.tag = OO_TYPE_FUN_NAMED;
+      shape.fun_named.arg_types = asg_types_to_oo_types(cx, err, asg_type->fun_named.arg_types);
+      if (err->tag != OO_ERR_NONE) {
+        return NULL;
       }
-      type_kind_checking(cx, err, type->fun_named.ret);
-      break;
-    case TYPE_APP_ANON:
-      tlf_kind = id_kind_arity(err, &type->app_anon.tlf);
+      shape.fun_named.arg_sids = asg_type->fun_named.arg_sids;
+      shape.fun_named.ret = asg_type_to_oo_type(cx, err, asg_type->fun_named.ret);
       if (err->tag != OO_ERR_NONE) {
-        return;
+        sb_free(shape.fun_named.arg_types);
       }
-      if (tlf_kind != (size_t) sb_count(type->app_anon.args)) {
-        err->tag = OO_ERR_WRONG_NUMBER_OF_TYPE_ARGS;
-        err->wrong_number_of_type_args = type;
-        return;
+      break;
+    case TYPE_SUM:
+      shape.tag = OO_TYPE_SUM;
+      shape.sum = &asg_type->sum;
+      break;
+    case TYPE_GENERIC:
+      shape.tag = OO_TYPE_GENERIC;
+      shape.generic.generic_args = sb_count(asg_type->generic.args);
+      shape.generic.inner = asg_type_to_oo_type(cx, err, asg_type->generic.inner);
+      break;
+    case TYPE_APP_ANON:
+      shape.tag = OO_TYPE_APP;
+      switch (asg_type->app_anon.tlf.binding.tag) {
+        case BINDING_TYPE:
+          shape.app.tlf = asg_type->app_anon.tlf.binding.type;
+          break;
+        case BINDING_SUM_TYPE:
+          shape.app.tlf = &asg_type->app_anon.tlf.binding.sum.type->type;
+          break;
+        default:
+          abort();
       }
+      shape.app.args = asg_types_to_oo_types(cx, err, asg_type->app_anon.args);
+      break;
+    case TYPE_APP_NAMED:
+      shape.tag = OO_TYPE_APP;
+      assert(asg_type->app_named.tlf.binding.tag == BINDING_TYPE);
+      shape.app.tlf = asg_type->app_named.tlf.binding.type;
+      shape.app.args = asg_types_to_oo_types(cx, err, asg_type->app_named.types);
+      break;
+  }
 
-      count = sb_count(type->app_anon.args);
-      for (size_t i = 0; i < count; i++) {
-        if (kind_arity(&type->app_anon.args[i]) != 0) {
-          err->tag = OO_ERR_HIGHER_ORDER_TYPE_ARG;
-          err->higher_order_type_arg = &type->app_anon.args[i];
+  if (err->tag != OO_ERR_NONE) {
+    return NULL;
+  }
+  return oo_types_intern(&cx->types, &shape);
+}
+
+OoType *oo_cx_lower_type(OoContext *cx, OoError *err, AsgType *type) {
+  return asg_type_to_oo_type(cx, err, type);
+}
+
+static void file_coarse_types(OoContext *cx, OoError *err, AsgFile *asg) {
+  err->asg = asg;
+  size_t count = sb_count(asg->items);
+  for (size_t i = 0; i < count; i++) {
+    if (asg->items[i].disabled) {
+      continue;
+    }
+
+    OoType fun;
+    switch (asg->items[i].tag) {
+      case ITEM_TYPE:
+        if (asg->items[i].type.oo_type == NULL) { // might have been resolved as an alias already
+          asg->items[i].type.oo_type = asg_type_to_oo_type(cx, err, &asg->items[i].type.type);
+        }
+        break;
+      case ITEM_VAL:
+        asg->items[i].val.sid.binding.val.oo_type = asg_type_to_oo_type(cx, err, &asg->items[i].val.type);
+        break;
+      case ITEM_FUN:
+        fun.tag = OO_TYPE_FUN_NAMED;
+        fun.fun_named.arg_sids = asg->items[i].fun.arg_sids;
+        fun.fun_named.arg_types = asg_types_to_oo_types(cx, err, asg->items[i].fun.arg_types);
+        if (err->tag != OO_ERR_NONE) {
+          return;
+        }
+        fun.fun_named.ret = asg_type_to_oo_type(cx, err, &asg->items[i].fun.ret);
+        if (err->tag != OO_ERR_NONE) {
+          sb_free(fun.fun_named.arg_types);
           return;
         }
+        asg->items[i].fun.sid.binding.val.oo_type = oo_types_intern(&cx->types, &fun);
+        break;
+      case ITEM_FFI_VAL:
+        asg->items[i].ffi_val.sid.binding.val.oo_type = asg_type_to_oo_type(cx, err, &asg->items[i].ffi_val.type);
+        break;
+      case ITEM_USE:
+      case ITEM_FFI_INCLUDE:
+        // noop
+        break;
+    }
+
+    if (err->tag != OO_ERR_NONE) {
+      return;
+    }
+  }
+}
+
+// Follows the chain of aliases starting at the given type item, lowering items
+// that have not been typed yet, and sets the canonical type of every item along
+// the chain (path compression).
+OoType *oo_cx_resolve_alias(OoContext *cx, OoError *err, AsgItemType *item) {
+  AsgItemType **chain = NULL;
+  OoType *canonical = NULL;
+
+  while (item->canonical == NULL) {
+    for (int i = 0; i < sb_count(chain); i++) {
+      if (chain[i] == item) {
+        err->tag = OO_ERR_CYCLIC_ALIAS;
+        err->cyclic_alias = &chain[0]->sid;
+        AsgFile *asg = oo_cx_file_of(cx, chain[0]->sid.str);
+        if (asg != NULL) {
+          err->asg = asg;
+        }
+        sb_free(chain);
+        return NULL;
+      }
+    }
+    sb_push(chain, item);
+
+    if (item->oo_type == NULL) {
+      item->oo_type = asg_type_to_oo_type(cx, err, &item->type);
+      if (err->tag != OO_ERR_NONE) {
+        sb_free(chain);
+        return NULL;
       }
+    }
+
+    OoType *t = item->oo_type;
+    if (t != NULL && t->tag == OO_TYPE_BINDING && t->binding->tag == BINDING_TYPE) {
+      item = t->binding->type;
+    } else if (t != NULL && t->tag == OO_TYPE_BINDING && t->binding->tag == BINDING_SUM_TYPE) {
+      item = &t->binding->sum.type->type;
+    } else {
+      canonical = t;
       break;
-    case TYPE_APP_NAMED:
-      tlf_kind = id_kind_arity(err, &type->app_named.tlf);
+    }
+  }
+
+  if (canonical == NULL) {
+    canonical = item->canonical;
+  }
+  for (int i = 0; i < sb_count(chain); i++) {
+    chain[i]->canonical = canonical;
+  }
+  sb_free(chain);
+  return canonical;
+}
+
+void oo_cx_type_check_file(OoContext *cx, OoError *err, AsgFile *asg) {
+  if (asg->typed) {
+    return;
+  }
+
+  file_coarse_types(cx, err, asg);
+  if (err->tag != OO_ERR_NONE) {
+    return;
+  }
+
+  for (int i = 0; i < sb_count(asg->items); i++) {
+    if (!asg->items[i].disabled && asg->items[i].tag == ITEM_TYPE) {
+      oo_cx_resolve_alias(cx, err, &asg->items[i].type);
       if (err->tag != OO_ERR_NONE) {
         return;
       }
-      if (tlf_kind != (size_t) sb_count(type->app_named.types)) {
-        err->tag = OO_ERR_WRONG_NUMBER_OF_TYPE_ARGS;
-        err->wrong_number_of_type_args = type;
+    }
+  }
+
+  // Interface files only contain placeholders for the expressions of vals.
+  for (int i = 0; !asg->iface && i < sb_count(asg->items); i++) {
+    if (!asg->items[i].disabled && asg->items[i].tag == ITEM_VAL) {
+      oo_cx_eval_val(cx, err, &asg->items[i].val);
+      if (err->tag != OO_ERR_NONE) {
         return;
       }
+      err->asg = asg;
+    }
+  }
+  asg->typed = true;
+}
 
-      count = sb_count(type->app_named.types);
-      for (size_t i = 0; i < count; i++) {
-        if (kind_arity(&type->app_named.types[i]) != 0) {
-          err->tag = OO_ERR_HIGHER_ORDER_TYPE_ARG;
-          err->higher_order_type_arg = &type->app_anon.args[i];
-          return;
-        }
+OoType *oo_cx_canonical_type(OoType *t) {
+  if (t == NULL || t->tag != OO_TYPE_BINDING) {
+    return t;
+  }
+  switch (t->binding->tag) {
+    case BINDING_TYPE:
+      return t->binding->type->canonical;
+    case BINDING_SUM_TYPE:
+      return t->binding->sum.type->type.canonical;
+    default:
+      return t;
+  }
+}
 
-        assert(type->app_named.tlf.binding.type->type.tag == TYPE_GENERIC);
-        if (!str_eq(type->app_named.tlf.binding.type->type.generic.args[i].str, type->app_named.sids[i].str)) {
-          err->tag = OO_ERR_NAMED_TYPE_APP_SID;
-          err->named_type_app_sid = &type->app_named.sids[i];
-          return;
-        }
-      }
-      break;
+static size_t release_syntax_type(AsgType *type);
+
+// Frees the segments of an id, only its final binding is referred to by OoTypes.
+static size_t release_id(AsgId *id) {
+  size_t released = sb_count(id->sids) * sizeof(AsgSid);
+  sb_free(id->sids);
+  id->sids = NULL;
+  return released;
+}
+
+static size_t release_syntax_types(AsgType *types) {
+  size_t released = 0;
+  for (int i = 0; i < sb_count(types); i++) {
+    released += release_syntax_type(&types[i]);
+  }
+  return released;
+}
+
+// Frees the parts of a lowered type that no OoType refers to, i.e. the path
+// segments of ids and the names of named type arguments. Everything an OoType
+// points to (bindings, sids of products and functions, sums) and the spans of
+// all nodes are kept. Returns the number of bytes freed.
+static size_t release_syntax_type(AsgType *type) {
+  size_t released = 0;
+  switch (type->tag) {
+    case TYPE_ID:
+      return release_id(&type->id);
+    case TYPE_MACRO:
+      return 0;
+    case TYPE_PTR:
+      return release_syntax_type(type->ptr);
+    case TYPE_PTR_MUT:
+      return release_syntax_type(type->ptr_mut);
+    case TYPE_ARRAY:
+      return release_syntax_type(type->array);
+    case TYPE_PRODUCT_REPEATED:
+      return release_syntax_type(type->product_repeated.inner);
+    case TYPE_PRODUCT_ANON:
+      return release_syntax_types(type->product_anon);
+    case TYPE_PRODUCT_NAMED:
+      return release_syntax_types(type->product_named.types);
+    case TYPE_FUN_ANON:
+      released += release_syntax_types(type->fun_anon.args);
+      return released + release_syntax_type(type->fun_anon.ret);
+    case TYPE_FUN_NAMED:
+      released += release_syntax_types(type->fun_named.arg_types);
+      return released + release_syntax_type(type->fun_named.ret);
+    case TYPE_APP_ANON:
+      released += release_id(&type->app_anon.tlf);
+      return released + release_syntax_types(type->app_anon.args);
+    case TYPE_APP_NAMED:
+      released += release_id(&type->app_named.tlf);
+      released += sb_count(type->app_named.sids) * sizeof(AsgSid);
+      sb_free(type->app_named.sids);
+      type->app_named.sids = NULL;
+      return released + release_syntax_types(type->app_named.types);
     case TYPE_GENERIC:
-      type_kind_checking(cx, err, type->generic.inner);
-      break;
+      return release_syntax_type(type->generic.inner);
     case TYPE_SUM:
-      count = sb_count(type->sum.summands);
-      for (size_t i = 0; i < count; i++) {
-        summand_kind_checking(cx, err, &type->sum.summands[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
+      for (int i = 0; i < sb_count(type->sum.summands); i++) {
+        AsgSummand *summand = &type->sum.summands[i];
+        if (summand->tag == SUMMAND_ANON) {
+          released += release_syntax_types(summand->anon);
+        } else {
+          released += release_syntax_types(summand->named.inners);
         }
       }
-      break;
+      return released;
   }
+  return released;
 }
 
-static void summand_kind_checking(OoContext *cx, OoError *err, AsgSummand *summand) {
-  size_t count;
-  switch (summand->tag) {
-    case SUMMAND_ANON:
-      count = sb_count(summand->anon);
-      for (size_t i = 0; i < count; i++) {
-        type_kind_checking(cx, err, &summand->anon[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
+void oo_cx_release_file_syntax_types(OoContext *cx, AsgFile *asg) {
+  if (!asg->typed) {
+    return;
+  }
+
+  size_t released = 0;
+  for (int i = 0; i < sb_count(asg->items); i++) {
+    AsgItem *item = &asg->items[i];
+    if (item->disabled) {
+      continue;
+    }
+
+    switch (item->tag) {
+      case ITEM_TYPE:
+        released += release_syntax_type(&item->type.type);
+        break;
+      case ITEM_VAL:
+        released += release_syntax_type(&item->val.type);
+        break;
+      case ITEM_FUN:
+        released += release_syntax_types(item->fun.arg_types);
+        released += release_syntax_type(&item->fun.ret);
+        break;
+      case ITEM_FFI_VAL:
+        released += release_syntax_type(&item->ffi_val.type);
+        break;
+      case ITEM_USE:
+      case ITEM_FFI_INCLUDE:
+        // noop
+        break;
+    }
+  }
+  cx->released_syntax += released;
+}
+
+void oo_cx_release_syntax_types(OoContext *cx) {
+  int count = sb_count(cx->files);
+  for (int i = 0; i < count; i++) {
+    oo_cx_release_file_syntax_types(cx, cx->files[i]);
+  }
+}
+
+// Function bodies are checked by queries (see query.h). Each query below
+// computes one fact on demand, and everything it requests in turn is recorded
+// as its dependency. Types that can not be inferred (e.g. of integer literals
+// without an expected type, or of anything involving sums or macros) are NULL,
+// and NULL is compatible with every type.
+
+static OoType *query_fun_type(OoContext *cx, OoError *err, AsgItemFun *fun);
+static OoType *query_exp_type(OoContext *cx, OoError *err, AsgExp *exp, OoType *expected);
+
+static AsgItem *fun_item(AsgItemFun *fun) {
+  return (AsgItem *) ((char *) fun - offsetof(AsgItem, fun));
+}
+
+static OoType *prim_type(OoContext *cx, AsgPrimitive prim) {
+  AsgBinding b;
+  memset(&b, 0, sizeof(AsgBinding));
+  b.tag = BINDING_PRIMITIVE;
+  b.primitive = prim;
+  OoType shape;
+  shape.tag = OO_TYPE_BINDING;
+  shape.binding = &b;
+  return oo_types_intern(&cx->types, &shape);
+}
+
+static OoType *unit_type(OoContext *cx) {
+  OoType shape;
+  shape.tag = OO_TYPE_PRODUCT_ANON;
+  shape.product_anon = NULL;
+  return oo_types_intern(&cx->types, &shape);
+}
+
+static OoType *ptr_type(OoContext *cx, OoTypeTag tag, OoType *inner) {
+  OoType shape;
+  shape.tag = tag;
+  shape.ptr = inner;
+  return oo_types_intern(&cx->types, &shape);
+}
+
+// Resolves aliases and instantiates generic applications.
+static OoType *resolved(OoContext *cx, OoError *err, OoType *t) {
+  while (t != NULL && err->tag == OO_ERR_NONE) {
+    if (t->tag == OO_TYPE_BINDING && t->binding->tag == BINDING_TYPE) {
+      OoType *canonical = oo_cx_resolve_alias(cx, err, t->binding->type);
+      if (canonical == t) {
+        return t;
       }
-      break;
-    case SUMMAND_NAMED:
-      count = sb_count(summand->named.inners);
-      for (size_t i = 0; i < count; i++) {
-        type_kind_checking(cx, err, &summand->named.inners[i]);
-        if (err->tag != OO_ERR_NONE) {
+      t = canonical;
+    } else if (t->tag == OO_TYPE_APP) {
+      if (oo_cx_resolve_alias(cx, err, t->app.tlf) == NULL && err->tag != OO_ERR_NONE) {
+        return NULL;
+      }
+      OoType *instance = oo_types_instantiate(&cx->types, t);
+      if (instance == t) {
+        return t;
+      }
+      t = instance;
+    } else {
+      return t;
+    }
+  }
+  return err->tag == OO_ERR_NONE ? t : NULL;
+}
+
+static bool is_prim(OoType *t, bool (*pred)(AsgPrimitive)) {
+  return t != NULL && t->tag == OO_TYPE_BINDING && t->binding->tag == BINDING_PRIMITIVE && pred(t->binding->primitive);
+}
+
+static bool prim_is_int(AsgPrimitive prim) {
+  return prim <= PRIM_ISIZE;
+}
+
+static bool prim_is_number(AsgPrimitive prim) {
+  return prim <= PRIM_F64;
+}
+
+static bool prim_is_bool(AsgPrimitive prim) {
+  return prim == PRIM_BOOL;
+}
+
+static bool prim_is_bits(AsgPrimitive prim) {
+  return prim_is_int(prim) || prim == PRIM_BOOL;
+}
+
+static OoType *type_mismatch(OoError *err, AsgExp *exp) {
+  err->tag = OO_ERR_TYPE_MISMATCH;
+  err->type_mismatch = exp;
+  return NULL;
+}
+
+// Errors if the (resolved) type t of exp is known but not the resolved
+// expected type.
+static void expect(OoContext *cx, OoError *err, AsgExp *exp, OoType *t, OoType *expected) {
+  t = resolved(cx, err, t);
+  expected = resolved(cx, err, expected);
+  if (err->tag == OO_ERR_NONE && t != NULL && expected != NULL && t != expected) {
+    type_mismatch(err, exp);
+  }
+}
+
+// Errors if the type t of exp is known but does not satisfy pred.
+static void expect_prim(OoContext *cx, OoError *err, AsgExp *exp, OoType *t, bool (*pred)(AsgPrimitive)) {
+  t = resolved(cx, err, t);
+  if (err->tag == OO_ERR_NONE && t != NULL && !is_prim(t, pred)) {
+    type_mismatch(err, exp);
+  }
+}
+
+static OoType *query_local_type(OoContext *cx, OoError *err, AsgPatternId *id) {
+  OoQuery *q = oo_queries_get(&cx->queries, OO_QUERY_LOCAL_TYPE, id);
+  if (q != NULL) {
+    return q->result;
+  }
+
+  // Not defined by a val, so only the annotation is known.
+  oo_queries_begin(&cx->queries, OO_QUERY_LOCAL_TYPE, id);
+  OoType *t = id->type == NULL ? NULL : asg_type_to_oo_type(cx, err, id->type);
+  if (err->tag != OO_ERR_NONE) {
+    oo_queries_abort(&cx->queries);
+    return NULL;
+  }
+  oo_queries_end(&cx->queries, t);
+  return t;
+}
+
+static const OoLayout *query_layout(OoContext *cx, OoError *err, OoType *t) {
+  OoQuery *q = oo_queries_get(&cx->queries, OO_QUERY_LAYOUT, t);
+  if (q != NULL) {
+    return q->result;
+  }
+
+  oo_queries_begin(&cx->queries, OO_QUERY_LAYOUT, t);
+  const OoLayout *layout = oo_cx_layout(cx, err, t);
+  if (err->tag != OO_ERR_NONE) {
+    oo_queries_abort(&cx->queries);
+    return NULL;
+  }
+  oo_queries_end(&cx->queries, (void *) layout);
+  return layout;
+}
+
+// Assigns types to the ids of a pattern matching a value of type t, checking
+// them against their annotations.
+static void pattern_types(OoContext *cx, OoError *err, AsgPattern *p, OoType *t, AsgExp *exp) {
+  t = resolved(cx, err, t);
+  if (err->tag != OO_ERR_NONE) {
+    return;
+  }
+
+  switch (p->tag) {
+    case PATTERN_ID:
+      if (p->id.type != NULL) {
+        OoType *annotated = asg_type_to_oo_type(cx, err, p->id.type);
+        expect(cx, err, exp, t, annotated);
+        t = annotated;
+      }
+      if (err->tag == OO_ERR_NONE) {
+        oo_queries_feed(&cx->queries, OO_QUERY_LOCAL_TYPE, &p->id, t);
+      }
+      return;
+    case PATTERN_PTR:
+      pattern_types(cx, err, p->ptr, t != NULL && (t->tag == OO_TYPE_PTR || t->tag == OO_TYPE_PTR_MUT) ? t->ptr : NULL, exp);
+      return;
+    case PATTERN_PRODUCT_ANON:
+      for (int i = 0; i < sb_count(p->product_anon) && err->tag == OO_ERR_NONE; i++) {
+        bool field = t != NULL && t->tag == OO_TYPE_PRODUCT_ANON && i < sb_count(t->product_anon);
+        pattern_types(cx, err, &p->product_anon[i], field ? t->product_anon[i] : NULL, exp);
+      }
+      return;
+    case PATTERN_PRODUCT_NAMED:
+      if (t != NULL && t->tag == OO_TYPE_PRODUCT_NAMED) {
+        int missing;
+        size_t *positions = asg_positions(t->product_named.sids, p->product_named.sids, &missing);
+        if (missing >= 0) {
+          type_mismatch(err, exp);
           return;
         }
+        sb_free(p->product_named.positions);
+        p->product_named.positions = positions;
       }
-      break;
+      for (int i = 0; i < sb_count(p->product_named.inners) && err->tag == OO_ERR_NONE; i++) {
+        bool field = t != NULL && t->tag == OO_TYPE_PRODUCT_NAMED;
+        pattern_types(cx, err, &p->product_named.inners[i], field ? t->product_named.types[p->product_named.positions[i]] : NULL, exp);
+      }
+      return;
+    case PATTERN_SUMMAND_ANON:
+      for (int i = 0; i < sb_count(p->summand_anon.fields) && err->tag == OO_ERR_NONE; i++) {
+        pattern_types(cx, err, &p->summand_anon.fields[i], NULL, exp);
+      }
+      return;
+    case PATTERN_SUMMAND_NAMED:
+      for (int i = 0; i < sb_count(p->summand_named.fields) && err->tag == OO_ERR_NONE; i++) {
+        pattern_types(cx, err, &p->summand_named.fields[i], NULL, exp);
+      }
+      return;
+    case PATTERN_BLANK:
+    case PATTERN_LITERAL:
+      return;
   }
 }
 
-static void exp_kind_checking(OoContext *cx, OoError *err, AsgExp *exp) {
-  size_t count;
+// The type of a block is the type of its last expression, the empty product if
+// it has none.
+static OoType *block_type(OoContext *cx, OoError *err, AsgBlock *block, OoType *expected) {
+  int last = sb_count(block->exps) - 1;
+  while (last >= 0 && block->exps[last].disabled) {
+    last -= 1;
+  }
+
+  OoType *t = unit_type(cx);
+  for (int i = 0; i <= last; i++) {
+    if (!block->exps[i].disabled) {
+      t = query_exp_type(cx, err, &block->exps[i], i == last ? expected : NULL);
+      if (err->tag != OO_ERR_NONE) {
+        return NULL;
+      }
+    }
+  }
+  return t;
+}
+
+// The function whose body is being checked.
+static AsgItemFun *current_fun(OoContext *cx) {
+  for (int i = sb_count(cx->queries.active) - 1; i >= 0; i--) {
+    if (cx->queries.active[i]->kind == OO_QUERY_FUN_BODY) {
+      return (AsgItemFun *) cx->queries.active[i]->key;
+    }
+  }
+  return NULL;
+}
+
+static OoType *id_type(OoContext *cx, OoError *err, AsgBinding *b) {
+  if (b->tag != BINDING_VAL) {
+    return NULL;
+  }
+
+  switch (b->val.tag) {
+    case VAL_VAL:
+      if (b->val.val->sid.binding.val.oo_type != NULL) {
+        return b->val.val->sid.binding.val.oo_type;
+      }
+      return asg_type_to_oo_type(cx, err, &b->val.val->type);
+    case VAL_FUN:
+      if (sb_count(b->val.fun->type_args) > 0) {
+        return NULL; // generic functions are not instantiated
+      }
+      return query_fun_type(cx, err, b->val.fun);
+    case VAL_FFI:
+      if (b->val.ffi->sid.binding.val.oo_type != NULL) {
+        return b->val.ffi->sid.binding.val.oo_type;
+      }
+      return asg_type_to_oo_type(cx, err, &b->val.ffi->type);
+    case VAL_ARG:
+      return asg_type_to_oo_type(cx, err, b->val.type);
+    case VAL_PATTERN:
+      return query_local_type(cx, err, b->val.pattern);
+    case VAL_SUMMAND:
+      return NULL; // sums are not lowered
+  }
+  return NULL;
+}
+
+static OoType *fun_app_type(OoContext *cx, OoError *err, AsgExp *exp) {
+  bool named = exp->tag == EXP_FUN_APP_NAMED;
+  AsgExp *fun_exp = named ? exp->fun_app_named.fun : exp->fun_app_anon.fun;
+  AsgExp *args = named ? exp->fun_app_named.args : exp->fun_app_anon.args;
+  OoType *fun = resolved(cx, err, query_exp_type(cx, err, fun_exp, NULL));
+  if (err->tag != OO_ERR_NONE) {
+    return NULL;
+  }
+
+  OoType **arg_types = NULL;
+  AsgSid *arg_sids = NULL;
+  OoType *ret = NULL;
+  if (fun != NULL && fun->tag == OO_TYPE_FUN_ANON && !named) {
+    arg_types = fun->fun_anon.args;
+    ret = fun->fun_anon.ret;
+  } else if (fun != NULL && fun->tag == OO_TYPE_FUN_NAMED) {
+    arg_types = fun->fun_named.arg_types;
+    arg_sids = fun->fun_named.arg_sids;
+    ret = fun->fun_named.ret;
+  } else if (fun != NULL) {
+    return type_mismatch(err, fun_exp);
+  }
+  if (fun != NULL && sb_count(arg_types) != sb_count(args)) {
+    return type_mismatch(err, exp);
+  }
+  if (fun != NULL && named) {
+    int missing;
+    size_t *positions = asg_positions(arg_sids, exp->fun_app_named.sids, &missing);
+    if (missing >= 0) {
+      return type_mismatch(err, &args[missing]);
+    }
+    sb_free(exp->fun_app_named.positions);
+    exp->fun_app_named.positions = positions;
+  }
+
+  for (int i = 0; i < sb_count(args); i++) {
+    OoType *expected = NULL;
+    if (fun != NULL) {
+      expected = arg_types[named ? exp->fun_app_named.positions[i] : (size_t) i];
+    }
+
+    OoType *t = query_exp_type(cx, err, &args[i], expected);
+    if (err->tag == OO_ERR_NONE) {
+      expect(cx, err, &args[i], t, expected);
+    }
+    if (err->tag != OO_ERR_NONE) {
+      return NULL;
+    }
+  }
+  return ret;
+}
+
+static OoType *bin_op_type(OoContext *cx, OoError *err, AsgExp *exp, OoType *expected) {
+  AsgExp *lhs_exp = exp->bin_op.lhs;
+  AsgExp *rhs_exp = exp->bin_op.rhs;
+  OoType *lhs;
+  OoType *rhs;
+  switch (exp->bin_op.op) {
+    case OP_PLUS:
+    case OP_MINUS:
+    case OP_TIMES:
+    case OP_DIV:
+    case OP_MOD:
+    case OP_WRAPPING_PLUS:
+    case OP_WRAPPING_MINUS:
+    case OP_WRAPPING_TIMES:
+    case OP_OR:
+    case OP_AND:
+    case OP_XOR:
+      lhs = query_exp_type(cx, err, lhs_exp, expected);
+      if (err->tag != OO_ERR_NONE) {
+        return NULL;
+      }
+      rhs = query_exp_type(cx, err, rhs_exp, lhs != NULL ? lhs : expected);
+      if (err->tag != OO_ERR_NONE) {
+        return NULL;
+      }
+      bool bits = exp->bin_op.op == OP_OR || exp->bin_op.op == OP_AND || exp->bin_op.op == OP_XOR;
+      expect_prim(cx, err, lhs_exp, lhs, bits ? prim_is_bits : prim_is_number);
+      if (err->tag == OO_ERR_NONE) {
+        expect(cx, err, rhs_exp, rhs, lhs);
+      }
+      return lhs != NULL ? lhs : rhs;
+    case OP_SHIFT_L:
+    case OP_SHIFT_R:
+      lhs = query_exp_type(cx, err, lhs_exp, expected);
+      if (err->tag == OO_ERR_NONE) {
+        expect_prim(cx, err, lhs_exp, lhs, prim_is_int);
+      }
+      if (err->tag == OO_ERR_NONE) {
+        rhs = query_exp_type(cx, err, rhs_exp, NULL);
+      }
+      if (err->tag == OO_ERR_NONE) {
+        expect_prim(cx, err, rhs_exp, rhs, prim_is_int);
+      }
+      return lhs;
+    case OP_LAND:
+    case OP_LOR:
+      lhs = query_exp_type(cx, err, lhs_exp, prim_type(cx, PRIM_BOOL));
+      if (err->tag == OO_ERR_NONE) {
+        expect_prim(cx, err, lhs_exp, lhs, prim_is_bool);
+      }
+      if (err->tag == OO_ERR_NONE) {
+        rhs = query_exp_type(cx, err, rhs_exp, prim_type(cx, PRIM_BOOL));
+      }
+      if (err->tag == OO_ERR_NONE) {
+        expect_prim(cx, err, rhs_exp, rhs, prim_is_bool);
+      }
+      return prim_type(cx, PRIM_BOOL);
+    case OP_EQ:
+    case OP_NEQ:
+    case OP_GT:
+    case OP_GET:
+    case OP_LT:
+    case OP_LET:
+      lhs = query_exp_type(cx, err, lhs_exp, NULL);
+      if (err->tag != OO_ERR_NONE) {
+        return NULL;
+      }
+      rhs = query_exp_type(cx, err, rhs_exp, lhs);
+      if (err->tag == OO_ERR_NONE) {
+        expect(cx, err, rhs_exp, rhs, lhs);
+      }
+      if (err->tag == OO_ERR_NONE && exp->bin_op.op != OP_EQ && exp->bin_op.op != OP_NEQ) {
+        expect_prim(cx, err, lhs_exp, lhs, prim_is_number);
+      }
+      return prim_type(cx, PRIM_BOOL);
+  }
+  return NULL;
+}
+
+// Computes the type of an expression whose context expects the given type
+// (NULL if any). Only the types of literals depend on the expected type, the
+// caller checks whether the result fits.
+static OoType *exp_type(OoContext *cx, OoError *err, AsgExp *exp, OoType *expected) {
+  OoType *inner;
+  OoType *t;
+  expected = resolved(cx, err, expected);
+  if (err->tag != OO_ERR_NONE) {
+    return NULL;
+  }
+
   switch (exp->tag) {
-    case EXP_MACRO:
-      abort(); // macros are evaluated before binding resolution
-      break;
     case EXP_ID:
+      return id_type(cx, err, &exp->id.binding);
+    case EXP_MACRO:
+      return NULL;
     case EXP_LITERAL:
-      // noop
-      break;
+      switch (exp->lit.tag) {
+        case LITERAL_INT:
+          return is_prim(expected, prim_is_int) ? expected : NULL;
+        case LITERAL_FLOAT:
+          return is_prim(expected, prim_is_number) && !is_prim(expected, prim_is_int) ? expected : NULL;
+        case LITERAL_TRUE:
+        case LITERAL_FALSE:
+          return prim_type(cx, PRIM_BOOL);
+        default:
+          return NULL;
+      }
     case EXP_REF:
-      exp_kind_checking(cx, err, exp->ref);
-      break;
     case EXP_REF_MUT:
-      exp_kind_checking(cx, err, exp->ref_mut);
-      break;
+      inner = query_exp_type(cx, err, exp->tag == EXP_REF ? exp->ref : exp->ref_mut,
+        expected != NULL && (expected->tag == OO_TYPE_PTR || expected->tag == OO_TYPE_PTR_MUT) ? expected->ptr : NULL);
+      return inner == NULL ? NULL : ptr_type(cx, exp->tag == EXP_REF ? OO_TYPE_PTR : OO_TYPE_PTR_MUT, inner);
     case EXP_DEREF:
-      exp_kind_checking(cx, err, exp->deref);
-      break;
     case EXP_DEREF_MUT:
-      exp_kind_checking(cx, err, exp->deref_mut);
-      break;
+      inner = resolved(cx, err, query_exp_type(cx, err, exp->tag == EXP_DEREF ? exp->deref : exp->deref_mut, NULL));
+      if (inner == NULL) {
+        return NULL;
+      } else if (inner->tag == OO_TYPE_PTR_MUT || (inner->tag == OO_TYPE_PTR && exp->tag == EXP_DEREF)) {
+        return inner->ptr;
+      }
+      return type_mismatch(err, exp);
     case EXP_ARRAY:
-      exp_kind_checking(cx, err, exp->array);
-      break;
+      inner = query_exp_type(cx, err, exp->array, expected != NULL && expected->tag == OO_TYPE_ARRAY ? expected->array : NULL);
+      return inner == NULL ? NULL : ptr_type(cx, OO_TYPE_ARRAY, inner);
     case EXP_ARRAY_INDEX:
-      exp_kind_checking(cx, err, exp->array_index.arr);
-      if (err->tag != OO_ERR_NONE) {
-        return;
+      inner = resolved(cx, err, query_exp_type(cx, err, exp->array_index.arr, NULL));
+      if (err->tag == OO_ERR_NONE) {
+        t = query_exp_type(cx, err, exp->array_index.index, prim_type(cx, PRIM_USIZE));
       }
-      exp_kind_checking(cx, err, exp->array_index.index);
-      break;
+      if (err->tag == OO_ERR_NONE) {
+        expect_prim(cx, err, exp->array_index.index, t, prim_is_int);
+      }
+      return inner != NULL && inner->tag == OO_TYPE_ARRAY ? inner->array : NULL;
     case EXP_PRODUCT_REPEATED:
-      exp_kind_checking(cx, err, exp->product_repeated.inner);
-      break;
-    case EXP_PRODUCT_ANON:
-      count = sb_count(exp->product_anon);
-      for (size_t i = 0; i < count; i++) {
-        exp_kind_checking(cx, err, &exp->product_anon[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
+      inner = query_exp_type(cx, err, exp->product_repeated.inner,
+        expected != NULL && expected->tag == OO_TYPE_PRODUCT_REPEATED ? expected->product_repeated.inner : NULL);
+      if (inner == NULL || err->tag != OO_ERR_NONE) {
+        return NULL;
       }
-      break;
+      OoType repeated;
+      repeated.tag = OO_TYPE_PRODUCT_REPEATED;
+      repeated.product_repeated.inner = inner;
+      repeated.product_repeated.repetitions = oo_cx_eval_repeat(cx, err, &exp->product_repeated.repeat);
+      return err->tag == OO_ERR_NONE ? oo_types_intern(&cx->types, &repeated) : NULL;
+    case EXP_PRODUCT_ANON:
     case EXP_PRODUCT_NAMED:
-      count = sb_count(exp->product_named.inners);
-      for (size_t i = 0; i < count; i++) {
-        exp_kind_checking(cx, err, &exp->product_named.inners[i]);
+      ;
+      bool named = exp->tag == EXP_PRODUCT_NAMED;
+      AsgExp *fields = named ? exp->product_named.inners : exp->product_anon;
+      OoType **field_types = NULL;
+      bool known = true;
+      for (int i = 0; i < sb_count(fields); i++) {
+        OoType *field_expected = NULL;
+        if (expected != NULL && expected->tag == OO_TYPE_PRODUCT_ANON && !named && i < sb_count(expected->product_anon)) {
+          field_expected = expected->product_anon[i];
+        } else if (expected != NULL && expected->tag == OO_TYPE_PRODUCT_NAMED && named && i < sb_count(expected->product_named.types)) {
+          field_expected = expected->product_named.types[i];
+        }
+        t = query_exp_type(cx, err, &fields[i], field_expected);
         if (err->tag != OO_ERR_NONE) {
-          return;
+          sb_free(field_types);
+          return NULL;
         }
+        known = known && t != NULL;
+        sb_push(field_types, t);
       }
-      break;
+      if (!known) {
+        sb_free(field_types);
+        return NULL;
+      }
+      OoType product;
+      product.tag = named ? OO_TYPE_PRODUCT_NAMED : OO_TYPE_PRODUCT_ANON;
+      if (named) {
+        product.product_named.types = field_types;
+        product.product_named.sids = exp->product_named.sids;
+      } else {
+        product.product_anon = field_types;
+      }
+      return oo_types_intern(&cx->types, &product);
     case EXP_PRODUCT_ACCESS_ANON:
-      exp_kind_checking(cx, err, exp->product_access_anon.inner);
-      break;
+      inner = resolved(cx, err, query_exp_type(cx, err, exp->product_access_anon.inner, NULL));
+      if (inner == NULL) {
+        return NULL;
+      } else if (inner->tag == OO_TYPE_PRODUCT_ANON && exp->product_access_anon.field < (size_t) sb_count(inner->product_anon)) {
+        return inner->product_anon[exp->product_access_anon.field];
+      } else if (inner->tag == OO_TYPE_PRODUCT_REPEATED && exp->product_access_anon.field < inner->product_repeated.repetitions) {
+        return inner->product_repeated.inner;
+      }
+      return type_mismatch(err, exp);
     case EXP_PRODUCT_ACCESS_NAMED:
-      exp_kind_checking(cx, err, exp->product_access_named.inner);
-      break;
-    case EXP_FUN_APP_ANON:
-      exp_kind_checking(cx, err, exp->fun_app_anon.fun);
-      if (err->tag != OO_ERR_NONE) {
-        return;
+      inner = resolved(cx, err, query_exp_type(cx, err, exp->product_access_named.inner, NULL));
+      if (inner == NULL) {
+        return NULL;
       }
-
-      count = sb_count(exp->fun_app_anon.args);
-      for (size_t i = 0; i < count; i++) {
-        exp_kind_checking(cx, err, &exp->fun_app_anon.args[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
+      if (inner->tag == OO_TYPE_PRODUCT_NAMED) {
+        size_t position = asg_position(inner->product_named.sids, exp->product_access_named.field.str);
+        if (position != ASG_NO_POSITION) {
+          exp->product_access_named.position = position;
+          return inner->product_named.types[position];
         }
       }
-      break;
+      return type_mismatch(err, exp);
+    case EXP_FUN_APP_ANON:
     case EXP_FUN_APP_NAMED:
-      exp_kind_checking(cx, err, exp->fun_app_named.fun);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-
-      count = sb_count(exp->fun_app_named.args);
-      for (size_t i = 0; i < count; i++) {
-        exp_kind_checking(cx, err, &exp->fun_app_named.args[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
+      return fun_app_type(cx, err, exp);
     case EXP_CAST:
-      exp_kind_checking(cx, err, exp->cast.inner);
-      if (err->tag != OO_ERR_NONE) {
-        return;
-      }
-
-      type_kind_checking(cx, err, exp->cast.type);
-      break;
+      query_exp_type(cx, err, exp->cast.inner, NULL);
+      return err->tag == OO_ERR_NONE ? asg_type_to_oo_type(cx, err, exp->cast.type) : NULL;
     case EXP_SIZE_OF:
-      type_kind_checking(cx, err, exp->size_of);
-      break;
     case EXP_ALIGN_OF:
-      type_kind_checking(cx, err, exp->align_of);
-      break;
+      ;
+      AsgType *queried = exp->tag == EXP_SIZE_OF ? exp->size_of : exp->align_of;
+      t = asg_type_to_oo_type(cx, err, queried);
+      if (err->tag == OO_ERR_NONE && query_layout(cx, err, t) == NULL && err->tag == OO_ERR_NONE) {
+        err->tag = OO_ERR_NO_LAYOUT;
+        err->no_layout = queried;
+      }
+      return prim_type(cx, PRIM_USIZE);
     case EXP_NOT:
-      exp_kind_checking(cx, err, exp->exp_not);
-      break;
+      t = query_exp_type(cx, err, exp->exp_not, expected);
+      if (err->tag == OO_ERR_NONE) {
+        expect_prim(cx, err, exp->exp_not, t, prim_is_bits);
+      }
+      return t;
     case EXP_NEGATE:
-      exp_kind_checking(cx, err, exp->exp_negate);
-      break;
     case EXP_WRAPPING_NEGATE:
-      exp_kind_checking(cx, err, exp->exp_wrapping_negate);
-      break;
-    case EXP_BIN_OP:
-      exp_kind_checking(cx, err, exp->bin_op.lhs);
-      if (err->tag != OO_ERR_NONE) {
-        return;
+      inner = query_exp_type(cx, err, exp->tag == EXP_NEGATE ? exp->exp_negate : exp->exp_wrapping_negate, expected);
+      if (err->tag == OO_ERR_NONE) {
+        expect_prim(cx, err, exp, inner, exp->tag == EXP_NEGATE ? prim_is_number : prim_is_int);
       }
-
-      exp_kind_checking(cx, err, exp->bin_op.rhs);
-      break;
+      return inner;
+    case EXP_BIN_OP:
+      return bin_op_type(cx, err, exp, expected);
     case EXP_ASSIGN:
-      exp_kind_checking(cx, err, exp->assign.lhs);
-      if (err->tag != OO_ERR_NONE) {
-        return;
+      inner = query_exp_type(cx, err, exp->assign.lhs, NULL);
+      if (err->tag == OO_ERR_NONE) {
+        t = query_exp_type(cx, err, exp->assign.rhs, inner);
       }
-
-      exp_kind_checking(cx, err, exp->assign.rhs);
-      break;
+      if (err->tag == OO_ERR_NONE && exp->assign.op != ASSIGN_SHIFT_L && exp->assign.op != ASSIGN_SHIFT_R) {
+        expect(cx, err, exp->assign.rhs, t, inner);
+      }
+      return unit_type(cx);
     case EXP_VAL:
-      pattern_kind_checking(cx, err, &exp->val);
-      break;
+      pattern_types(cx, err, &exp->val, NULL, exp);
+      return unit_type(cx);
     case EXP_VAL_ASSIGN:
-      pattern_kind_checking(cx, err, &exp->val_assign.lhs);
-      if (err->tag != OO_ERR_NONE) {
-        return;
+      t = NULL;
+      if (exp->val_assign.lhs.tag == PATTERN_ID && exp->val_assign.lhs.id.type != NULL) {
+        t = asg_type_to_oo_type(cx, err, exp->val_assign.lhs.id.type);
       }
-
-      exp_kind_checking(cx, err, exp->val_assign.rhs);
-      break;
+      if (err->tag == OO_ERR_NONE) {
+        t = query_exp_type(cx, err, exp->val_assign.rhs, t);
+      }
+      if (err->tag == OO_ERR_NONE) {
+        pattern_types(cx, err, &exp->val_assign.lhs, t, exp->val_assign.rhs);
+      }
+      return unit_type(cx);
     case EXP_BLOCK:
-      block_kind_checking(cx, err, &exp->block);
-      break;
+      return block_type(cx, err, &exp->block, expected);
     case EXP_IF:
-      exp_kind_checking(cx, err, exp->exp_if.cond);
-      if (err->tag != OO_ERR_NONE) {
-        return;
+      t = query_exp_type(cx, err, exp->exp_if.cond, prim_type(cx, PRIM_BOOL));
+      if (err->tag == OO_ERR_NONE) {
+        expect_prim(cx, err, exp->exp_if.cond, t, prim_is_bool);
       }
-
-      block_kind_checking(cx, err, &exp->exp_if.if_block);
       if (err->tag != OO_ERR_NONE) {
-        return;
+        return NULL;
       }
-
-      block_kind_checking(cx, err, &exp->exp_if.else_block);
-      break;
-    case EXP_CASE:
-      exp_kind_checking(cx, err, exp->exp_case.matcher);
-      if (err->tag != OO_ERR_NONE) {
-        return;
+      if (exp->exp_if.else_block.str.start == NULL) { // no else
+        block_type(cx, err, &exp->exp_if.if_block, NULL);
+        return unit_type(cx);
       }
-
-      count = sb_count(exp->exp_case.patterns);
-      for (size_t i = 0; i < count; i++) {
-        pattern_kind_checking(cx, err, &exp->exp_case.patterns[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-        block_kind_checking(cx, err, &exp->exp_case.blocks[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
+      inner = block_type(cx, err, &exp->exp_if.if_block, expected);
+      if (err->tag == OO_ERR_NONE) {
+        t = block_type(cx, err, &exp->exp_if.else_block, inner != NULL ? inner : expected);
+      }
+      if (err->tag == OO_ERR_NONE) {
+        expect(cx, err, exp, t, inner);
+      }
+      return inner != NULL ? inner : t;
+    case EXP_CASE:
+    case EXP_LOOP:
+      ;
+      AsgExp *matcher = exp->tag == EXP_CASE ? exp->exp_case.matcher : exp->exp_loop.matcher;
+      AsgPattern *patterns = exp->tag == EXP_CASE ? exp->exp_case.patterns : exp->exp_loop.patterns;
+      AsgBlock *blocks = exp->tag == EXP_CASE ? exp->exp_case.blocks : exp->exp_loop.blocks;
+      inner = query_exp_type(cx, err, matcher, NULL);
+      for (int i = 0; i < sb_count(patterns) && err->tag == OO_ERR_NONE; i++) {
+        pattern_types(cx, err, &patterns[i], inner, matcher);
+        if (err->tag == OO_ERR_NONE) {
+          block_type(cx, err, &blocks[i], exp->tag == EXP_CASE ? expected : NULL);
         }
       }
-      break;
+      return NULL;
     case EXP_WHILE:
-      exp_kind_checking(cx, err, exp->exp_while.cond);
-      block_kind_checking(cx, err, &exp->exp_while.block);
-      break;
-    case EXP_LOOP:
-      exp_kind_checking(cx, err, exp->exp_loop.matcher);
-      if (err->tag != OO_ERR_NONE) {
-        return;
+      t = query_exp_type(cx, err, exp->exp_while.cond, prim_type(cx, PRIM_BOOL));
+      if (err->tag == OO_ERR_NONE) {
+        expect_prim(cx, err, exp->exp_while.cond, t, prim_is_bool);
       }
-
-      count = sb_count(exp->exp_case.patterns);
-      for (size_t i = 0; i < count; i++) {
-        pattern_kind_checking(cx, err, &exp->exp_loop.patterns[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-        block_kind_checking(cx, err, &exp->exp_loop.blocks[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
+      if (err->tag == OO_ERR_NONE) {
+        block_type(cx, err, &exp->exp_while.block, NULL);
       }
-      break;
+      return unit_type(cx);
     case EXP_RETURN:
-      if (exp->exp_return != NULL) {
-        exp_kind_checking(cx, err, exp->exp_return);
+      ;
+      OoType *fun = query_fun_type(cx, err, current_fun(cx));
+      OoType *ret = fun == NULL ? NULL : fun->fun_named.ret;
+      if (exp->exp_return == NULL) {
+        expect(cx, err, exp, unit_type(cx), ret);
+      } else {
+        t = query_exp_type(cx, err, exp->exp_return, ret);
+        if (err->tag == OO_ERR_NONE) {
+          expect(cx, err, exp->exp_return, t, ret);
+        }
       }
-      break;
+      return NULL; // does not produce a value
     case EXP_BREAK:
       if (exp->exp_break != NULL) {
-        exp_kind_checking(cx, err, exp->exp_break);
+        query_exp_type(cx, err, exp->exp_break, NULL);
       }
-      break;
+      return NULL;
     case EXP_GOTO:
     case EXP_LABEL:
-      // noop
-      break;
+      return NULL;
   }
+  return NULL;
 }
 
-static void pattern_kind_checking(OoContext *cx, OoError *err, AsgPattern *p) {
-  size_t count;
-  switch (p->tag) {
-    case PATTERN_ID:
-      if (p->id.type != NULL) {
-        type_kind_checking(cx, err, p->id.type);
-      }
-      break;
-    case PATTERN_BLANK:
-    case PATTERN_LITERAL:
-      // noop
-      break;
-    case PATTERN_PTR:
-      pattern_kind_checking(cx, err, p->ptr);
-      break;
-    case PATTERN_PRODUCT_ANON:
-      count = sb_count(p->product_anon);
-      for (size_t i = 0; i < count; i++) {
-        pattern_kind_checking(cx, err, &p->product_anon[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case PATTERN_PRODUCT_NAMED:
-      count = sb_count(p->product_named.inners);
-      for (size_t i = 0; i < count; i++) {
-        pattern_kind_checking(cx, err, &p->product_named.inners[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case PATTERN_SUMMAND_ANON:
-      count = sb_count(p->summand_anon.fields);
-      for (size_t i = 0; i < count; i++) {
-        pattern_kind_checking(cx, err, &p->summand_anon.fields[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case PATTERN_SUMMAND_NAMED:
-      count = sb_count(p->summand_named.fields);
-      for (size_t i = 0; i < count; i++) {
-        pattern_kind_checking(cx, err, &p->summand_named.fields[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
+static OoType *query_exp_type(OoContext *cx, OoError *err, AsgExp *exp, OoType *expected) {
+  OoQuery *q = oo_queries_get(&cx->queries, OO_QUERY_EXP_TYPE, exp);
+  if (q != NULL) {
+    return q->result;
   }
-}
 
-static void block_kind_checking(OoContext *cx, OoError *err, AsgBlock *block) {
-  for (size_t i = 0; i < (size_t) sb_count(block->exps); i++) {
-    exp_kind_checking(cx, err, &block->exps[i]);
-    if (err->tag != OO_ERR_NONE) {
-      return;
-    }
+  oo_queries_begin(&cx->queries, OO_QUERY_EXP_TYPE, exp);
+  OoType *t = exp_type(cx, err, exp, expected);
+  if (err->tag != OO_ERR_NONE) {
+    oo_queries_abort(&cx->queries);
+    return NULL;
   }
+  oo_queries_end(&cx->queries, t);
+  return t;
 }
 
-void oo_cx_kind_checking(OoContext *cx, OoError *err) {
-  int count = sb_count(cx->files);
-  for (int i = 0; i < count; i++) {
-    file_kind_checking(cx, err, cx->files[i]);
+static OoType *query_fun_type(OoContext *cx, OoError *err, AsgItemFun *fun) {
+  if (fun == NULL) {
+    return NULL;
+  }
+  OoQuery *q = oo_queries_get(&cx->queries, OO_QUERY_FUN_TYPE, fun);
+  if (q != NULL) {
+    return q->result;
+  }
+
+  oo_queries_begin(&cx->queries, OO_QUERY_FUN_TYPE, fun);
+  if (fun->sid.binding.val.oo_type == NULL) {
+    AsgFile *outer = err->asg;
+    oo_cx_type_check_file(cx, err, fun_item(fun)->asg);
     if (err->tag != OO_ERR_NONE) {
-      return;
+      oo_queries_abort(&cx->queries);
+      return NULL;
     }
+    err->asg = outer;
   }
+  oo_queries_end(&cx->queries, fun->sid.binding.val.oo_type);
+  return fun->sid.binding.val.oo_type;
 }
 
-// Compute the OoType corresponding to an AsgType. This can recursively invoke
-// itself as needed, if the OoType for a binding site is OO_TYPE_UNINITIALIZED.
-static void asg_type_to_oo_type(OoContext *cx, OoError *err, AsgType *asg_type, OoType *oo_type) {
-  int count;
-  switch (asg_type->tag) {
-    case TYPE_ID:
-      oo_type->tag = OO_TYPE_BINDING;
-      oo_type->binding = &asg_type->id.binding;
-      break;
-    case TYPE_MACRO:
-      // noop
-      break;
-    case TYPE_PTR:
-      oo_type->tag = OO_TYPE_PTR;
-      oo_type->ptr = malloc(sizeof(OoType));
-      asg_type_to_oo_type(cx, err, asg_type->ptr, oo_type->ptr);
-      break;
-    case TYPE_PTR_MUT:
-      oo_type->tag = OO_TYPE_PTR_MUT;
-      oo_type->ptr_mut = malloc(sizeof(OoType));
-      asg_type_to_oo_type(cx, err, asg_type->ptr_mut, oo_type->ptr_mut);
-      break;
-    case TYPE_ARRAY:
-      oo_type->tag = OO_TYPE_ARRAY;
-      oo_type->array = malloc(sizeof(OoType));
-      asg_type_to_oo_type(cx, err, asg_type->array, oo_type->array);
-      break;
-    case TYPE_PRODUCT_REPEATED:
-      oo_type->tag = OO_TYPE_PRODUCT_REPEATED;
-      oo_type->product_repeated.inner = malloc(sizeof(OoType));
-      asg_type_to_oo_type(cx, err, asg_type->product_repeated.inner, oo_type->product_repeated.inner);
-      switch (asg_type->product_repeated.repeat.tag) {
-        case REPEAT_INT:
-          oo_type->product_repeated.repetitions = strtoul(asg_type->product_repeated.repeat.str.start, NULL, 10);
-          break;
-        default:
-          printf("%s\n", "Complex repeats not yet implemented, specify an integer literal directly.");
-          exit(1);
-      }
-      break;
-    case TYPE_PRODUCT_ANON:
-      oo_type->tag = OO_TYPE_PRODUCT_ANON;
-      count = sb_count(asg_type->product_anon);
-      oo_type->product_anon = NULL;
-      sb_add(oo_type->product_anon, count);
-
-      for (size_t i = 0; i < (size_t) count; i++) {
-        asg_type_to_oo_type(cx, err, &asg_type->product_anon[i], &oo_type->product_anon[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
+// Collects the functions whose signatures the queries reachable from q through
+// expressions and locals used.
+static void collect_callees(OoQuery *q, AsgItemFun ***callees) {
+  for (int i = 0; i < sb_count(q->deps); i++) {
+    OoQuery *dep = q->deps[i];
+    if (dep->kind == OO_QUERY_FUN_TYPE) {
+      bool known = false;
+      for (int j = 0; j < sb_count(*callees); j++) {
+        known = known || (*callees)[j] == dep->key;
       }
-      break;
-    case TYPE_PRODUCT_NAMED:
-      oo_type->tag = OO_TYPE_PRODUCT_NAMED;
-      count = sb_count(asg_type->product_named.types);
-      oo_type->product_named.types = NULL;
-      sb_add(oo_type->product_named.types, count);
-      oo_type->product_named.sids = asg_type->product_named.sids;
-
-      for (size_t i = 0; i < (size_t) count; i++) {
-        asg_type_to_oo_type(cx, err, &asg_type->product_named.types[i], &oo_type->product_named.types[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
+      if (!known) {
+        sb_push(*callees, (AsgItemFun *) dep->key);
       }
-      break;
-    case TYPE_FUN_ANON:
-      oo_type->tag = OO_TYPE_FUN_ANON;
-      count = sb_count(asg_type->fun_anon.args);
-      oo_type->fun_anon.args = NULL;
-      sb_add(oo_type->fun_anon.args, count);
+    } else if (dep->kind == OO_QUERY_EXP_TYPE || dep->kind == OO_QUERY_LOCAL_TYPE) {
+      collect_callees(dep, callees);
+    }
+  }
+}
 
-      for (size_t i = 0; i < (size_t) count; i++) {
-        asg_type_to_oo_type(cx, err, &asg_type->fun_anon.args[i], &oo_type->fun_anon.args[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
+// Checks the body of a function against its signature, the result is the
+// stretchy buffer of the functions it refers to.
+static AsgItemFun **query_fun_body(OoContext *cx, OoError *err, AsgItem *item) {
+  AsgItemFun *fun = &item->fun;
+  OoQuery *q = oo_queries_get(&cx->queries, OO_QUERY_FUN_BODY, fun);
+  if (q != NULL) {
+    return q->result;
+  }
 
-      oo_type->fun_anon.ret = malloc(sizeof(OoType));
-      asg_type_to_oo_type(cx, err, asg_type->fun_anon.ret, oo_type->fun_anon.ret);
-      break;
-    case TYPE_FUN_NAMED:
-      oo_type->tag = OO_TYPE_FUN_NAMED;
-      count = sb_count(asg_type->fun_named.arg_types);
-      oo_type->fun_named.arg_types = NULL;
-      sb_add(oo_type->fun_named.arg_types, count);
-      oo_type->fun_named.arg_sids = asg_type->fun_named.arg_sids;
-
-      for (size_t i = 0; i < (size_t) count; i++) {
-        asg_type_to_oo_type(cx, err, &asg_type->fun_named.arg_types[i], &oo_type->fun_named.arg_types[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
+  q = oo_queries_begin(&cx->queries, OO_QUERY_FUN_BODY, fun);
+  // Bodies of interface files are placeholders, and bodies that are not bound
+  // (skipped by a lazy parse, or dropped by oo_cx_stream) can not be checked.
+  if (item->asg->iface || !item->asg->fine_bound || fun->body_src != NULL) {
+    oo_queries_end(&cx->queries, NULL);
+    return NULL;
+  }
 
-      oo_type->fun_named.ret = malloc(sizeof(OoType));
-      asg_type_to_oo_type(cx, err, asg_type->fun_named.ret, oo_type->fun_named.ret);
-      break;
-    case TYPE_SUM:
-      oo_type->tag = OO_TYPE_SUM;
-      oo_type->sum = &asg_type->sum;
-      break;
-    case TYPE_GENERIC:
-      oo_type->tag = OO_TYPE_GENERIC;
-      oo_type->generic.generic_args = sb_count(asg_type->generic.args);
-      oo_type->generic.inner = malloc(sizeof(OoType));
-      asg_type_to_oo_type(cx, err, asg_type->generic.inner, oo_type->generic.inner);
-      break;
-    case TYPE_APP_ANON:
-      oo_type->tag = OO_TYPE_APP;
-      oo_type->app.args = NULL;
-      count = sb_count(asg_type->app_anon.args);
-      sb_add(oo_type->app.args, count);
+  OoType *t = query_fun_type(cx, err, fun);
+  err->asg = item->asg;
+  OoType *body = err->tag == OO_ERR_NONE ? block_type(cx, err, &fun->body, t->fun_named.ret) : NULL;
+  if (err->tag == OO_ERR_NONE && body != NULL) {
+    int last = sb_count(fun->body.exps) - 1;
+    while (last >= 0 && fun->body.exps[last].disabled) {
+      last -= 1;
+    }
+    if (last >= 0) {
+      expect(cx, err, &fun->body.exps[last], body, t->fun_named.ret);
+    }
+  }
+  if (err->tag != OO_ERR_NONE) {
+    oo_queries_abort(&cx->queries);
+    return NULL;
+  }
 
-      switch (asg_type->app_anon.tlf.binding.tag) {
-        case BINDING_TYPE:
-          assert(asg_type->app_anon.tlf.binding.type->oo_type.tag == OO_TYPE_GENERIC);
-          oo_type->app.tlf = &asg_type->app_anon.tlf.binding.type->oo_type.generic;
-          break;
-        case BINDING_SUM_TYPE:
-          assert(asg_type->app_anon.tlf.binding.sum.type->type.oo_type.tag == OO_TYPE_GENERIC);
-          oo_type->app.tlf = &asg_type->app_anon.tlf.binding.sum.type->type.oo_type.generic;
-          break;
-        default:
-          abort();
-      }
+  AsgItemFun **callees = NULL;
+  collect_callees(q, &callees);
+  oo_queries_end(&cx->queries, callees);
+  return callees;
+}
 
-      for (size_t i = 0; i < (size_t) count; i++) {
-        asg_type_to_oo_type(cx, err, &asg_type->app_anon.args[i], &oo_type->app.args[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
-      }
-      break;
-    case TYPE_APP_NAMED:
-      oo_type->tag = OO_TYPE_APP;
-      oo_type->app.args = NULL;
-      count = sb_count(asg_type->app_named.types);
-      sb_add(oo_type->app.args, count);
+OoType *oo_cx_exp_type(OoContext *cx, OoError *err, AsgExp *exp) {
+  return query_exp_type(cx, err, exp, NULL);
+}
 
-      assert(asg_type->app_named.tlf.binding.tag == BINDING_TYPE);
-      assert(asg_type->app_named.tlf.binding.type->oo_type.tag == OO_TYPE_GENERIC);
-      oo_type->app.tlf = &asg_type->app_named.tlf.binding.type->oo_type.generic;
+void oo_cx_check_fun(OoContext *cx, OoError *err, AsgItem *item) {
+  query_fun_body(cx, err, item);
+}
 
-      for (size_t i = 0; i < (size_t) count; i++) {
-        asg_type_to_oo_type(cx, err, &asg_type->app_named.types[i], &oo_type->app.args[i]);
-        if (err->tag != OO_ERR_NONE) {
-          return;
-        }
+void oo_cx_check_file_bodies(OoContext *cx, OoError *err, AsgFile *asg) {
+  for (int i = 0; i < sb_count(asg->items); i++) {
+    if (!asg->items[i].disabled && asg->items[i].tag == ITEM_FUN) {
+      query_fun_body(cx, err, &asg->items[i]);
+      if (err->tag != OO_ERR_NONE) {
+        return;
       }
-      break;
+    }
   }
 }
 
-static void file_coarse_types(OoContext *cx, OoError *err, AsgFile *asg) {
-  err->asg = asg;
-  size_t count = sb_count(asg->items);
-  for (size_t i = 0; i < count; i++) {
-    switch (asg->items[i].tag) {
-      case ITEM_TYPE:
-        asg_type_to_oo_type(cx, err, &asg->items[i].type.type, &asg->items[i].type.oo_type);
-        break;
-      case ITEM_VAL:
-        asg_type_to_oo_type(cx, err, &asg->items[i].val.type, &asg->items[i].val.sid.binding.val.oo_type);
-        break;
-      case ITEM_FUN:
-        asg->items[i].fun.sid.binding.val.oo_type.tag = OO_TYPE_FUN_NAMED;
-        asg->items[i].fun.sid.binding.val.oo_type.fun_named.arg_types = NULL;
-        sb_add(
-          asg->items[i].fun.sid.binding.val.oo_type.fun_named.arg_types,
-          sb_count(asg->items[i].fun.arg_types)
-        );
-        asg->items[i].fun.sid.binding.val.oo_type.fun_named.arg_sids = asg->items[i].fun.arg_sids;
-
-        for (size_t j = 0; j < (size_t) sb_count(asg->items[i].fun.arg_types); j++) {
-          asg_type_to_oo_type(
-            cx, err, &asg->items[i].fun.arg_types[j],
-            &asg->items[i].fun.sid.binding.val.oo_type.fun_named.arg_types[j]
-          );
-          if (err->tag != OO_ERR_NONE) {
-            return;
-          }
-        }
-
-        asg->items[i].fun.sid.binding.val.oo_type.fun_named.ret = malloc(sizeof(OoType));
-        asg_type_to_oo_type(
-          cx, err, &asg->items[i].fun.ret, asg->items[i].fun.sid.binding.val.oo_type.fun_named.ret
-        );
-        break;
-      case ITEM_FFI_VAL:
-        asg_type_to_oo_type(
-          cx, err, &asg->items[i].ffi_val.type, &asg->items[i].ffi_val.sid.binding.val.oo_type
-        );
-        break;
-      case ITEM_USE:
-      case ITEM_FFI_INCLUDE:
-        // noop
-        break;
+void oo_cx_check_reachable(OoContext *cx, OoError *err, AsgItem **roots) {
+  AsgItem **todo = NULL;
+  rax *seen = raxNew();
+  for (int i = 0; i < sb_count(roots); i++) {
+    if (raxInsert(seen, (const char *) &roots[i], sizeof(AsgItem *), NULL, NULL)) {
+      sb_push(todo, roots[i]);
     }
+  }
 
-    if (err->tag != OO_ERR_NONE) {
-      return;
+  while (sb_count(todo) > 0 && err->tag == OO_ERR_NONE) {
+    AsgItem *item = sb_last(todo);
+    stb__sbn(todo) -= 1;
+    AsgItemFun **callees = query_fun_body(cx, err, item);
+    for (int i = 0; i < sb_count(callees); i++) {
+      AsgItem *callee = fun_item(callees[i]);
+      if (raxInsert(seen, (const char *) &callee, sizeof(AsgItem *), NULL, NULL)) {
+        sb_push(todo, callee);
+      }
     }
   }
-}
 
-// static void file_typecheck(OoContext *cx, OoError *err, AsgFile *asg) {
-//   err->asg = asg;
-//   size_t count = sb_count(asg->items);
-//   for (size_t i = 0; i < count; i++) {
-//     switch (asg->items[i].tag) {
-//       case ITEM_VAL:
-//         exp_typecheck(cx, err, &asg->items[i].val.exp, &asg->items[i].val.oo_type);
-//         break;
-//       case ITEM_FUN: // TODO
-//         asg->items[i].fun.oo_type.tag = OO_TYPE_FUN_NAMED;
-//         asg->items[i].fun.oo_type.fun_named.arg_types = NULL;
-//         sb_add(asg->items[i].fun.oo_type.fun_named.arg_types, sb_count(asg->items[i].fun.arg_types));
-//         asg->items[i].fun.oo_type.fun_named.arg_sids = asg->items[i].fun.arg_sids;
-//
-//         for (size_t j = 0; j < (size_t) sb_count(asg->items[i].fun.arg_types); j++) {
-//           asg_type_to_oo_type(
-//             cx, err, &asg->items[i].fun.arg_types[j], &asg->items[i].fun.oo_type.fun_named.arg_types[j]
-//           );
-//           if (err->tag != OO_ERR_NONE) {
-//             return;
-//           }
-//         }
-//
-//         asg->items[i].fun.oo_type.fun_named.ret = malloc(sizeof(OoType));
-//         asg_type_to_oo_type(cx, err, &asg->items[i].fun.ret, asg->items[i].fun.oo_type.fun_named.ret);
-//         break;
-//       case ITEM_USE:
-//       case ITEM_TYPE:
-//       case ITEM_FFI_INCLUDE:
-//       case ITEM_FFI_VAL:
-//         // noop
-//         break;
-//     }
-//
-//     if (err->tag != OO_ERR_NONE) {
-//       return;
-//     }
-//   }
-// }
+  sb_free(todo);
+  raxFree(seen);
+}
 
 // Type checking overview: OoType represents a type. For each item, the type can
 // be derived from the annotation, so this is done in a first step (`file_coarse_types`).
 // Next, the items need to be checked agains their coarse type. For functions,
-// this involves typechecking the function body.
-//
-// // In function bodies, there is a (pretty limited) form of type inference, so
-// // there are some tags that represent types that still need to be inferred. When
-// // these are encountered, a callback is supplied that later sets the correct type.
+// this involves typechecking the function body, which is done by the queries
+// above (there is a pretty limited form of type inference in bodies).
 void oo_cx_type_checking(OoContext *cx, OoError *err) {
   int count = sb_count(cx->files);
   for (int i = 0; i < count; i++) {
-    file_coarse_types(cx, err, cx->files[i]);
+    oo_cx_type_check_file(cx, err, cx->files[i]);
     if (err->tag != OO_ERR_NONE) {
       return;
     }
   }
 
-  // for (int i = 0; i < count; i++) {
-  //   file_typecheck(cx, err, cx->files[i]);
-  //   if (err->tag != OO_ERR_NONE) {
-  //     return;
-  //   }
-  // }
+  for (int i = 0; i < count; i++) {
+    oo_cx_check_file_bodies(cx, err, cx->files[i]);
+    if (err->tag != OO_ERR_NONE) {
+      return;
+    }
+  }
 }
@@ -0,0 +1,348 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "stretchy_buffer.h"
+#include "types.h"
+
+void oo_types_init(OoTypeTable *table) {
+  table->types = raxNew();
+  oo_pool_init(&table->pool);
+  table->key = NULL;
+  table->instances = raxNew();
+  table->instantiated = 0;
+}
+
+static void key_add(OoTypeTable *table, const void *data, size_t len) {
+  memcpy(sb_add(table->key, (int) len), data, len);
+}
+
+static void key_add_ptr(OoTypeTable *table, const void *ptr) {
+  key_add(table, &ptr, sizeof(ptr));
+}
+
+static void key_add_types(OoTypeTable *table, OoType **types) {
+  int count = sb_count(types);
+  key_add(table, &count, sizeof(count));
+  for (int i = 0; i < count; i++) {
+    key_add_ptr(table, types[i]);
+  }
+}
+
+static void key_add_names(OoTypeTable *table, AsgSid *sids) {
+  for (int i = 0; i < sb_count(sids); i++) {
+    key_add(table, &sids[i].str.len, sizeof(size_t));
+    key_add(table, sids[i].str.start, sids[i].str.len);
+  }
+}
+
+// Appends what the binding refers to, which is all that matters for the type.
+static void key_add_binding(OoTypeTable *table, const AsgBinding *b) {
+  key_add(table, &b->tag, sizeof(b->tag));
+  switch (b->tag) {
+    case BINDING_TYPE:
+      key_add_ptr(table, b->type);
+      break;
+    case BINDING_SUM_TYPE:
+      key_add_ptr(table, b->sum.type);
+      break;
+    case BINDING_TYPE_VAR:
+      key_add_ptr(table, b->type_var);
+      break;
+    case BINDING_PRIMITIVE:
+      key_add(table, &b->primitive, sizeof(b->primitive));
+      break;
+    default:
+      // Not a type, rejected by kind checking. Such bindings are not shared.
+      key_add_ptr(table, b);
+      break;
+  }
+}
+
+static void build_key(OoTypeTable *table, const OoType *t) {
+  if (table->key != NULL) {
+    stb__sbn(table->key) = 0;
+  }
+
+  key_add(table, &t->tag, sizeof(t->tag));
+  switch (t->tag) {
+    case OO_TYPE_BINDING:
+      key_add_binding(table, t->binding);
+      break;
+    case OO_TYPE_PTR:
+      key_add_ptr(table, t->ptr);
+      break;
+    case OO_TYPE_PTR_MUT:
+      key_add_ptr(table, t->ptr_mut);
+      break;
+    case OO_TYPE_ARRAY:
+      key_add_ptr(table, t->array);
+      break;
+    case OO_TYPE_PRODUCT_REPEATED:
+      key_add_ptr(table, t->product_repeated.inner);
+      key_add(table, &t->product_repeated.repetitions, sizeof(uint64_t));
+      break;
+    case OO_TYPE_PRODUCT_ANON:
+      key_add_types(table, t->product_anon);
+      break;
+    case OO_TYPE_PRODUCT_NAMED:
+      key_add_types(table, t->product_named.types);
+      key_add_names(table, t->product_named.sids);
+      break;
+    case OO_TYPE_FUN_ANON:
+      key_add_types(table, t->fun_anon.args);
+      key_add_ptr(table, t->fun_anon.ret);
+      break;
+    case OO_TYPE_FUN_NAMED:
+      key_add_types(table, t->fun_named.arg_types);
+      key_add_names(table, t->fun_named.arg_sids);
+      key_add_ptr(table, t->fun_named.ret);
+      break;
+    case OO_TYPE_SUM:
+      key_add_ptr(table, t->sum);
+      break;
+    case OO_TYPE_GENERIC:
+      key_add(table, &t->generic.generic_args, sizeof(size_t));
+      key_add_ptr(table, t->generic.inner);
+      break;
+    case OO_TYPE_APP:
+      key_add_ptr(table, t->app.tlf);
+      key_add_types(table, t->app.args);
+      break;
+  }
+}
+
+// Copies the names of the sids into the pool, the bindings of the copies are unset.
+static AsgSid *copy_names(OoTypeTable *table, AsgSid *sids) {
+  AsgSid *copies = NULL;
+  for (int i = 0; i < sb_count(sids); i++) {
+    AsgSid *copy = sb_add(copies, 1);
+    memset(copy, 0, sizeof(AsgSid));
+    char *name = oo_pool_alloc(&table->pool, sids[i].str.len + 1);
+    memcpy(name, sids[i].str.start, sids[i].str.len);
+    name[sids[i].str.len] = 0;
+    copy->str = str_new(name, sids[i].str.len);
+  }
+  return copies;
+}
+
+static AsgBinding *copy_binding(OoTypeTable *table, const AsgBinding *b) {
+  AsgBinding *copy = oo_pool_alloc(&table->pool, sizeof(AsgBinding));
+  memset(copy, 0, sizeof(AsgBinding));
+  copy->tag = b->tag;
+  switch (b->tag) {
+    case BINDING_TYPE:
+      copy->type = b->type;
+      break;
+    case BINDING_SUM_TYPE:
+      copy->sum = b->sum;
+      break;
+    case BINDING_TYPE_VAR:
+      copy->type_var = b->type_var;
+      break;
+    case BINDING_PRIMITIVE:
+      copy->primitive = b->primitive;
+      break;
+    default:
+      memcpy(copy, b, sizeof(AsgBinding));
+      break;
+  }
+  return copy;
+}
+
+// Frees the stretchy buffers of a type.
+static void free_buffers(OoType *t) {
+  switch (t->tag) {
+    case OO_TYPE_PRODUCT_ANON:
+      sb_free(t->product_anon);
+      break;
+    case OO_TYPE_PRODUCT_NAMED:
+      sb_free(t->product_named.types);
+      break;
+    case OO_TYPE_FUN_ANON:
+      sb_free(t->fun_anon.args);
+      break;
+    case OO_TYPE_FUN_NAMED:
+      sb_free(t->fun_named.arg_types);
+      break;
+    case OO_TYPE_APP:
+      sb_free(t->app.args);
+      break;
+    default:
+      break;
+  }
+}
+
+OoType *oo_types_intern(OoTypeTable *table, const OoType *shape) {
+  build_key(table, shape);
+  OoType *t = raxFind(table->types, table->key, sb_count(table->key));
+  if (t != raxNotFound) {
+    OoType tmp = *shape;
+    free_buffers(&tmp);
+    return t;
+  }
+
+  t = oo_pool_alloc(&table->pool, sizeof(OoType));
+  *t = *shape;
+  if (t->tag == OO_TYPE_BINDING) {
+    t->binding = copy_binding(table, shape->binding);
+  } else if (t->tag == OO_TYPE_PRODUCT_NAMED) {
+    t->product_named.sids = copy_names(table, shape->product_named.sids);
+  } else if (t->tag == OO_TYPE_FUN_NAMED) {
+    t->fun_named.arg_sids = copy_names(table, shape->fun_named.arg_sids);
+  }
+
+  raxInsert(table->types, table->key, sb_count(table->key), t, NULL);
+  return t;
+}
+
+// Interns a copy of types with each entry substituted, NULL if any fails.
+static OoType *substitute(OoTypeTable *table, OoType *t, AsgSid *vars, OoType **args);
+
+static OoType **substitute_all(OoTypeTable *table, OoType **types, AsgSid *vars, OoType **args) {
+  OoType **substituted = NULL;
+  for (int i = 0; i < sb_count(types); i++) {
+    OoType *s = substitute(table, types[i], vars, args);
+    if (s == NULL) {
+      sb_free(substituted);
+      return NULL;
+    }
+    sb_push(substituted, s);
+  }
+  return substituted;
+}
+
+// Replaces the type variables vars by the corresponding args. Returns NULL if
+// t contains a sum, whose summands can not be substituted.
+static OoType *substitute(OoTypeTable *table, OoType *t, AsgSid *vars, OoType **args) {
+  OoType shape = *t;
+  switch (t->tag) {
+    case OO_TYPE_BINDING:
+      if (t->binding->tag == BINDING_TYPE_VAR &&
+        t->binding->type_var >= vars && t->binding->type_var < vars + sb_count(vars)
+      ) {
+        return args[t->binding->type_var - vars];
+      }
+      return t;
+    case OO_TYPE_PTR:
+      shape.ptr = substitute(table, t->ptr, vars, args);
+      if (shape.ptr == NULL) {
+        return NULL;
+      }
+      break;
+    case OO_TYPE_PTR_MUT:
+      shape.ptr_mut = substitute(table, t->ptr_mut, vars, args);
+      if (shape.ptr_mut == NULL) {
+        return NULL;
+      }
+      break;
+    case OO_TYPE_ARRAY:
+      shape.array = substitute(table, t->array, vars, args);
+      if (shape.array == NULL) {
+        return NULL;
+      }
+      break;
+    case OO_TYPE_PRODUCT_REPEATED:
+      shape.product_repeated.inner = substitute(table, t->product_repeated.inner, vars, args);
+      if (shape.product_repeated.inner == NULL) {
+        return NULL;
+      }
+      break;
+    case OO_TYPE_PRODUCT_ANON:
+      shape.product_anon = substitute_all(table, t->product_anon, vars, args);
+      if (shape.product_anon == NULL && sb_count(t->product_anon) > 0) {
+        return NULL;
+      }
+      break;
+    case OO_TYPE_PRODUCT_NAMED:
+      shape.product_named.types = substitute_all(table, t->product_named.types, vars, args);
+      if (shape.product_named.types == NULL && sb_count(t->product_named.types) > 0) {
+        return NULL;
+      }
+      break;
+    case OO_TYPE_FUN_ANON:
+      shape.fun_anon.ret = substitute(table, t->fun_anon.ret, vars, args);
+      if (shape.fun_anon.ret == NULL) {
+        return NULL;
+      }
+      shape.fun_anon.args = substitute_all(table, t->fun_anon.args, vars, args);
+      if (shape.fun_anon.args == NULL && sb_count(t->fun_anon.args) > 0) {
+        return NULL;
+      }
+      break;
+    case OO_TYPE_FUN_NAMED:
+      shape.fun_named.ret = substitute(table, t->fun_named.ret, vars, args);
+      if (shape.fun_named.ret == NULL) {
+        return NULL;
+      }
+      shape.fun_named.arg_types = substitute_all(table, t->fun_named.arg_types, vars, args);
+      if (shape.fun_named.arg_types == NULL && sb_count(t->fun_named.arg_types) > 0) {
+        return NULL;
+      }
+      break;
+    case OO_TYPE_SUM:
+      return NULL;
+    case OO_TYPE_GENERIC:
+      shape.generic.inner = substitute(table, t->generic.inner, vars, args);
+      if (shape.generic.inner == NULL) {
+        return NULL;
+      }
+      break;
+    case OO_TYPE_APP:
+      shape.app.args = substitute_all(table, t->app.args, vars, args);
+      if (shape.app.args == NULL && sb_count(t->app.args) > 0) {
+        return NULL;
+      }
+      break;
+  }
+  return oo_types_intern(table, &shape);
+}
+
+OoType *oo_types_substitute(OoTypeTable *table, OoType *t, AsgSid *vars, OoType **args) {
+  return substitute(table, t, vars, args);
+}
+
+OoType *oo_types_instantiate(OoTypeTable *table, OoType *app) {
+  OoType *inst = raxFind(table->instances, (const char *) &app, sizeof(OoType *));
+  if (inst != raxNotFound) {
+    return inst;
+  }
+
+  OoType *generic = app->app.tlf->oo_type;
+  inst = substitute(table, generic->generic.inner, app->app.tlf->type.generic.args, app->app.args);
+  if (inst == NULL) {
+    inst = app;
+  }
+  raxInsert(table->instances, (const char *) &app, sizeof(OoType *), inst, NULL);
+  table->instantiated += 1;
+  return inst;
+}
+
+void oo_types_forget_instances(OoTypeTable *table) {
+  raxFree(table->instances);
+  table->instances = raxNew();
+}
+
+uint64_t oo_types_count(const OoTypeTable *table) {
+  return raxSize(table->types);
+}
+
+void oo_types_free(OoTypeTable *table) {
+  raxIterator it;
+  raxStart(&it, table->types);
+  raxSeek(&it, "^", NULL, 0);
+  while (raxNext(&it)) {
+    OoType *t = it.data;
+    free_buffers(t);
+    if (t->tag == OO_TYPE_PRODUCT_NAMED) {
+      sb_free(t->product_named.sids);
+    } else if (t->tag == OO_TYPE_FUN_NAMED) {
+      sb_free(t->fun_named.arg_sids);
+    }
+  }
+  raxStop(&it);
+
+  raxFree(table->types);
+  raxFree(table->instances);
+  oo_pool_release(&table->pool);
+  sb_free(table->key);
+}
@@ -0,0 +1,50 @@
+// Hash-consing of OoTypes: every structurally distinct type exists exactly
+// once per table, so two types are equal iff they are the same pointer.
+#ifndef OO_TYPES_H
+#define OO_TYPES_H
+
+#include "asg.h"
+#include "pool.h"
+#include "rax.h"
+
+// Owns all types interned into it, together with their stretchy buffers, the
+// canonical bindings of OO_TYPE_BINDING types and the names of named products
+// and functions.
+typedef struct OoTypeTable {
+  rax *types; // shallow keys (tag and canonical children) to the interned OoType
+  OoPool pool; // backs the types, their canonical bindings and names
+  char *key; // stretchy buffer, reused to build keys
+  rax *instances; // interned OO_TYPE_APP to its instantiation
+  uint64_t instantiated; // number of instantiations built, i.e. cache misses
+} OoTypeTable;
+
+void oo_types_init(OoTypeTable *table);
+
+// Returns the interned type with the structure of shape, whose children must
+// be interned already. Takes ownership of the stretchy buffers of shape
+// (freeing them if the type exists already). The binding of an OO_TYPE_BINDING
+// and the sids of named products and functions are copied, so shape may point
+// into the syntax. Bindings are identified by what they refer to.
+OoType *oo_types_intern(OoTypeTable *table, const OoType *shape);
+
+// Returns the type obtained by substituting the arguments of app (an interned
+// OO_TYPE_APP) for the type variables of the applied generic, whose oo_type
+// must be set. Each application is only instantiated once, later calls return
+// the cached type. Applications nested in the result are not instantiated, so
+// recursive generics work. Sums are not lowered, so a generic containing a sum
+// is its own instantiation (i.e. app is returned).
+OoType *oo_types_instantiate(OoTypeTable *table, OoType *app);
+
+// Replaces the type variables vars (the args of an AsgTypeGeneric) in t by the
+// corresponding args. Returns NULL if t contains a sum.
+OoType *oo_types_substitute(OoTypeTable *table, OoType *t, AsgSid *vars, OoType **args);
+
+// Clears the instantiation cache, for when generics may have changed.
+void oo_types_forget_instances(OoTypeTable *table);
+
+// Number of distinct types in the table.
+uint64_t oo_types_count(const OoTypeTable *table);
+
+void oo_types_free(OoTypeTable *table);
+
+#endif
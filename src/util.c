@@ -10,8 +10,12 @@ Str str_new(const char *start, size_t len) {
 }
 
 void str_print(Str s) {
-  fwrite(s.start, 1, s.len, stdout);
-  printf("\n");
+  str_fprint(stdout, s);
+}
+
+void str_fprint(FILE *f, Str s) {
+  fwrite(s.start, 1, s.len, f);
+  fprintf(f, "\n");
 }
 
 bool str_eq(Str s1, Str s2) {
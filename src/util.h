@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 
 typedef struct Str {
@@ -12,6 +13,7 @@ typedef struct Str {
 
 Str str_new(const char *start, size_t len);
 void str_print(Str s);
+void str_fprint(FILE *f, Str s);
 bool str_eq(Str s1, Str s2);
 bool str_eq_parts(Str s, const char *chars, size_t len);
 
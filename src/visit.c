@@ -0,0 +1,463 @@
+#include <stdlib.h>
+
+#include "visit.h"
+#include "context.h"
+#include "stretchy_buffer.h"
+
+typedef struct Walk {
+  OoContext *cx;
+  OoError *err;
+  OoVisitor *visitors;
+  size_t count;
+} Walk;
+
+// Calls the given pre hook of all visitors, in order.
+#define PRE(w, hook, ...) \
+  for (size_t v_ = 0; v_ < (w)->count && (w)->err->tag == OO_ERR_NONE; v_++) { \
+    if ((w)->visitors[v_].hook != NULL) { \
+      (w)->visitors[v_].hook((w)->visitors[v_].data, (w)->err, __VA_ARGS__); \
+    } \
+  }
+
+// Calls the given post hook of all visitors, in reverse order.
+#define POST(w, hook, ...) \
+  for (size_t v_ = (w)->count; v_ > 0 && (w)->err->tag == OO_ERR_NONE; v_--) { \
+    if ((w)->visitors[v_ - 1].hook != NULL) { \
+      (w)->visitors[v_ - 1].hook((w)->visitors[v_ - 1].data, (w)->err, __VA_ARGS__); \
+    } \
+  }
+
+void oo_visitor_init(OoVisitor *v, void *data) {
+  v->data = data;
+  v->item_pre = NULL;
+  v->item_post = NULL;
+  v->body_pre = NULL;
+  v->body_post = NULL;
+  v->arm_pre = NULL;
+  v->arm_post = NULL;
+  v->type_pre = NULL;
+  v->type_post = NULL;
+  v->pattern_pre = NULL;
+  v->pattern_post = NULL;
+  v->exp_pre = NULL;
+  v->exp_post = NULL;
+}
+
+static void walk_type(Walk *w, AsgType *type);
+static void walk_exp(Walk *w, AsgExp *exp);
+static void walk_block(Walk *w, AsgBlock *block);
+
+static void walk_types(Walk *w, AsgType *types) {
+  for (int i = 0; i < sb_count(types) && w->err->tag == OO_ERR_NONE; i++) {
+    walk_type(w, &types[i]);
+  }
+}
+
+static void walk_repeat(Walk *w, AsgRepeat *repeat) {
+  switch (repeat->tag) {
+    case REPEAT_SIZE_OF:
+      walk_type(w, repeat->size_of);
+      break;
+    case REPEAT_ALIGN_OF:
+      walk_type(w, repeat->align_of);
+      break;
+    case REPEAT_BIN_OP:
+      walk_repeat(w, repeat->bin_op.lhs);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_repeat(w, repeat->bin_op.rhs);
+      break;
+    default:
+      break;
+  }
+}
+
+static void walk_type(Walk *w, AsgType *type) {
+  PRE(w, type_pre, type);
+  if (w->err->tag != OO_ERR_NONE) {
+    return;
+  }
+
+  switch (type->tag) {
+    case TYPE_ID:
+    case TYPE_MACRO:
+      // no children
+      break;
+    case TYPE_PTR:
+      walk_type(w, type->ptr);
+      break;
+    case TYPE_PTR_MUT:
+      walk_type(w, type->ptr_mut);
+      break;
+    case TYPE_ARRAY:
+      walk_type(w, type->array);
+      break;
+    case TYPE_PRODUCT_REPEATED:
+      walk_type(w, type->product_repeated.inner);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_repeat(w, &type->product_repeated.repeat);
+      break;
+    case TYPE_PRODUCT_ANON:
+      walk_types(w, type->product_anon);
+      break;
+    case TYPE_PRODUCT_NAMED:
+      walk_types(w, type->product_named.types);
+      break;
+    case TYPE_FUN_ANON:
+      walk_types(w, type->fun_anon.args);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_type(w, type->fun_anon.ret);
+      break;
+    case TYPE_FUN_NAMED:
+      walk_types(w, type->fun_named.arg_types);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_type(w, type->fun_named.ret);
+      break;
+    case TYPE_APP_ANON:
+      walk_types(w, type->app_anon.args);
+      break;
+    case TYPE_APP_NAMED:
+      walk_types(w, type->app_named.types);
+      break;
+    case TYPE_GENERIC:
+      walk_type(w, type->generic.inner);
+      break;
+    case TYPE_SUM:
+      for (int i = 0; i < sb_count(type->sum.summands) && w->err->tag == OO_ERR_NONE; i++) {
+        AsgSummand *summand = &type->sum.summands[i];
+        walk_types(w, summand->tag == SUMMAND_ANON ? summand->anon : summand->named.inners);
+      }
+      break;
+  }
+  if (w->err->tag != OO_ERR_NONE) {
+    return;
+  }
+
+  POST(w, type_post, type);
+}
+
+static void walk_pattern(Walk *w, AsgPattern *p);
+
+static void walk_patterns(Walk *w, AsgPattern *ps) {
+  for (int i = 0; i < sb_count(ps) && w->err->tag == OO_ERR_NONE; i++) {
+    walk_pattern(w, &ps[i]);
+  }
+}
+
+static void walk_pattern(Walk *w, AsgPattern *p) {
+  PRE(w, pattern_pre, p);
+  if (w->err->tag != OO_ERR_NONE) {
+    return;
+  }
+
+  switch (p->tag) {
+    case PATTERN_ID:
+      if (p->id.type != NULL) {
+        walk_type(w, p->id.type);
+      }
+      break;
+    case PATTERN_BLANK:
+    case PATTERN_LITERAL:
+      // no children
+      break;
+    case PATTERN_PTR:
+      walk_pattern(w, p->ptr);
+      break;
+    case PATTERN_PRODUCT_ANON:
+      walk_patterns(w, p->product_anon);
+      break;
+    case PATTERN_PRODUCT_NAMED:
+      walk_patterns(w, p->product_named.inners);
+      break;
+    case PATTERN_SUMMAND_ANON:
+      walk_patterns(w, p->summand_anon.fields);
+      break;
+    case PATTERN_SUMMAND_NAMED:
+      walk_patterns(w, p->summand_named.fields);
+      break;
+  }
+  if (w->err->tag != OO_ERR_NONE) {
+    return;
+  }
+
+  POST(w, pattern_post, p);
+}
+
+static void walk_exps(Walk *w, AsgExp *exps) {
+  for (int i = 0; i < sb_count(exps) && w->err->tag == OO_ERR_NONE; i++) {
+    walk_exp(w, &exps[i]);
+  }
+}
+
+static void walk_arms(Walk *w, AsgPattern *patterns, AsgBlock *blocks) {
+  for (int i = 0; i < sb_count(patterns) && w->err->tag == OO_ERR_NONE; i++) {
+    PRE(w, arm_pre, &patterns[i], &blocks[i]);
+    if (w->err->tag != OO_ERR_NONE) {
+      return;
+    }
+    walk_pattern(w, &patterns[i]);
+    if (w->err->tag != OO_ERR_NONE) {
+      return;
+    }
+    walk_block(w, &blocks[i]);
+    if (w->err->tag != OO_ERR_NONE) {
+      return;
+    }
+    POST(w, arm_post, &patterns[i], &blocks[i]);
+  }
+}
+
+static void walk_exp(Walk *w, AsgExp *exp) {
+  PRE(w, exp_pre, exp);
+  if (w->err->tag != OO_ERR_NONE) {
+    return;
+  }
+
+  switch (exp->tag) {
+    case EXP_MACRO:
+      abort(); // macros are evaluated before binding resolution
+      break;
+    case EXP_ID:
+    case EXP_LITERAL:
+    case EXP_GOTO:
+    case EXP_LABEL:
+      // no children
+      break;
+    case EXP_REF:
+      walk_exp(w, exp->ref);
+      break;
+    case EXP_REF_MUT:
+      walk_exp(w, exp->ref_mut);
+      break;
+    case EXP_DEREF:
+      walk_exp(w, exp->deref);
+      break;
+    case EXP_DEREF_MUT:
+      walk_exp(w, exp->deref_mut);
+      break;
+    case EXP_ARRAY:
+      walk_exp(w, exp->array);
+      break;
+    case EXP_ARRAY_INDEX:
+      walk_exp(w, exp->array_index.arr);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_exp(w, exp->array_index.index);
+      break;
+    case EXP_PRODUCT_REPEATED:
+      walk_exp(w, exp->product_repeated.inner);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_repeat(w, &exp->product_repeated.repeat);
+      break;
+    case EXP_PRODUCT_ANON:
+      walk_exps(w, exp->product_anon);
+      break;
+    case EXP_PRODUCT_NAMED:
+      walk_exps(w, exp->product_named.inners);
+      break;
+    case EXP_PRODUCT_ACCESS_ANON:
+      walk_exp(w, exp->product_access_anon.inner);
+      break;
+    case EXP_PRODUCT_ACCESS_NAMED:
+      walk_exp(w, exp->product_access_named.inner);
+      break;
+    case EXP_FUN_APP_ANON:
+      walk_exp(w, exp->fun_app_anon.fun);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_exps(w, exp->fun_app_anon.args);
+      break;
+    case EXP_FUN_APP_NAMED:
+      walk_exp(w, exp->fun_app_named.fun);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_exps(w, exp->fun_app_named.args);
+      break;
+    case EXP_CAST:
+      walk_exp(w, exp->cast.inner);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_type(w, exp->cast.type);
+      break;
+    case EXP_SIZE_OF:
+      walk_type(w, exp->size_of);
+      break;
+    case EXP_ALIGN_OF:
+      walk_type(w, exp->align_of);
+      break;
+    case EXP_NOT:
+      walk_exp(w, exp->exp_not);
+      break;
+    case EXP_NEGATE:
+      walk_exp(w, exp->exp_negate);
+      break;
+    case EXP_WRAPPING_NEGATE:
+      walk_exp(w, exp->exp_wrapping_negate);
+      break;
+    case EXP_BIN_OP:
+      walk_exp(w, exp->bin_op.lhs);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_exp(w, exp->bin_op.rhs);
+      break;
+    case EXP_ASSIGN:
+      walk_exp(w, exp->assign.lhs);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_exp(w, exp->assign.rhs);
+      break;
+    case EXP_VAL:
+      walk_pattern(w, &exp->val);
+      break;
+    case EXP_VAL_ASSIGN:
+      walk_exp(w, exp->val_assign.rhs);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_pattern(w, &exp->val_assign.lhs);
+      break;
+    case EXP_BLOCK:
+      walk_block(w, &exp->block);
+      break;
+    case EXP_IF:
+      walk_exp(w, exp->exp_if.cond);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_block(w, &exp->exp_if.if_block);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_block(w, &exp->exp_if.else_block);
+      break;
+    case EXP_CASE:
+      walk_exp(w, exp->exp_case.matcher);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_arms(w, exp->exp_case.patterns, exp->exp_case.blocks);
+      break;
+    case EXP_WHILE:
+      walk_exp(w, exp->exp_while.cond);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_block(w, &exp->exp_while.block);
+      break;
+    case EXP_LOOP:
+      walk_exp(w, exp->exp_loop.matcher);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_arms(w, exp->exp_loop.patterns, exp->exp_loop.blocks);
+      break;
+    case EXP_RETURN:
+      if (exp->exp_return != NULL) {
+        walk_exp(w, exp->exp_return);
+      }
+      break;
+    case EXP_BREAK:
+      if (exp->exp_break != NULL) {
+        walk_exp(w, exp->exp_break);
+      }
+      break;
+  }
+  if (w->err->tag != OO_ERR_NONE) {
+    return;
+  }
+
+  POST(w, exp_post, exp);
+}
+
+static void walk_block(Walk *w, AsgBlock *block) {
+  for (int i = 0; i < sb_count(block->exps) && w->err->tag == OO_ERR_NONE; i++) {
+    if (!block->exps[i].disabled) {
+      walk_exp(w, &block->exps[i]);
+    }
+  }
+}
+
+static void walk_item(Walk *w, AsgFile *asg, AsgItem *item) {
+  PRE(w, item_pre, item);
+  if (w->err->tag != OO_ERR_NONE) {
+    return;
+  }
+
+  switch (item->tag) {
+    case ITEM_TYPE:
+      walk_type(w, &item->type.type);
+      break;
+    case ITEM_VAL:
+      walk_type(w, &item->val.type);
+      if (w->err->tag != OO_ERR_NONE || asg->iface) {
+        break;
+      }
+      walk_exp(w, &item->val.exp);
+      break;
+    case ITEM_FUN:
+      walk_types(w, item->fun.arg_types);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_type(w, &item->fun.ret);
+      if (w->err->tag != OO_ERR_NONE || asg->iface) {
+        break;
+      }
+
+      oo_cx_force_body(w->cx, w->err, item);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      PRE(w, body_pre, item);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      walk_block(w, &item->fun.body);
+      if (w->err->tag != OO_ERR_NONE) {
+        return;
+      }
+      POST(w, body_post, item);
+      break;
+    case ITEM_FFI_VAL:
+      walk_type(w, &item->ffi_val.type);
+      break;
+    case ITEM_USE:
+    case ITEM_FFI_INCLUDE:
+      // no children
+      break;
+  }
+  if (w->err->tag != OO_ERR_NONE) {
+    return;
+  }
+
+  POST(w, item_post, item);
+}
+
+void oo_visit_file(OoContext *cx, OoError *err, AsgFile *asg, OoVisitor *visitors, size_t count) {
+  Walk w;
+  w.cx = cx;
+  w.err = err;
+  w.visitors = visitors;
+  w.count = count;
+
+  for (int i = 0; i < sb_count(asg->items) && err->tag == OO_ERR_NONE; i++) {
+    if (!asg->items[i].disabled) {
+      walk_item(&w, asg, &asg->items[i]);
+    }
+  }
+}
@@ -0,0 +1,52 @@
+// A generic traversal of the items of a file, to which analyses attach as hooks.
+//
+// An analysis is an OoVisitor: a set of hooks that are called before (pre) and
+// after (post) the children of the nodes of some kind are visited, all of which
+// are optional. oo_visit_file runs several visitors in a single traversal: the
+// pre hooks of a node are called in the order of the visitors, the post hooks in
+// the reverse order, so each visitor sees the nodes in the order in which it
+// would see them when running alone, and a visitor can rely on the pre hooks of
+// the visitors before it having run on a node (e.g. on its bindings being
+// resolved). The traversal stops at the first hook that sets an error, without
+// calling any further hooks.
+#ifndef OO_VISIT_H
+#define OO_VISIT_H
+
+#include <stddef.h>
+
+#include "asg.h"
+
+struct OoContext;
+struct OoError;
+
+typedef struct OoVisitor {
+  void *data; // passed to all hooks
+  // Items that are not disabled.
+  void (*item_pre)(void *data, struct OoError *err, AsgItem *item);
+  void (*item_post)(void *data, struct OoError *err, AsgItem *item);
+  // The body of a function item, after the types of its signature.
+  void (*body_pre)(void *data, struct OoError *err, AsgItem *item);
+  void (*body_post)(void *data, struct OoError *err, AsgItem *item);
+  // An arm (pattern and block) of a case or loop expression.
+  void (*arm_pre)(void *data, struct OoError *err, AsgPattern *p, AsgBlock *block);
+  void (*arm_post)(void *data, struct OoError *err, AsgPattern *p, AsgBlock *block);
+  void (*type_pre)(void *data, struct OoError *err, AsgType *type);
+  void (*type_post)(void *data, struct OoError *err, AsgType *type);
+  void (*pattern_pre)(void *data, struct OoError *err, AsgPattern *p);
+  void (*pattern_post)(void *data, struct OoError *err, AsgPattern *p);
+  void (*exp_pre)(void *data, struct OoError *err, AsgExp *exp);
+  void (*exp_post)(void *data, struct OoError *err, AsgExp *exp);
+} OoVisitor;
+
+// Sets data and clears all hooks.
+void oo_visitor_init(OoVisitor *v, void *data);
+
+// Visits the items of the file with the given visitors (an array of count
+// visitors). The children of a node are visited in the order in which their
+// bindings are in scope: the right-hand side of a val assignment comes before
+// its pattern, the type of an id pattern before the pattern itself. Bodies of
+// functions are forced (see oo_cx_force_body). Val expressions and bodies of
+// interface files are not visited, and neither are disabled expressions.
+void oo_visit_file(struct OoContext *cx, struct OoError *err, AsgFile *asg, OoVisitor *visitors, size_t count);
+
+#endif
@@ -11,8 +11,14 @@ void test_cc(void) {
   char *src = "#[cc = \"foo\"]type a = b #[cc = \"bar\"]fn c = () {#[cc = \"bar\"]a; #[cc = \"baz\"]b}";
   ParserError err;
   AsgFile data;
+  OoFeatureTable table;
+  oo_features_init(&table);
+  ParserCx pcx;
+  pcx.features = &table;
+  pcx.enabled = NULL;
+  pcx.lazy_bodies = false;
 
-  assert(parse_file(src, &err, &data) == strlen(src));
+  assert(parse_file(src, &err, &data, &pcx) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(sb_count(data.items) == 2);
@@ -24,25 +30,118 @@ void test_cc(void) {
   assert(sb_count(data.items[1].fun.body.attrs) == 2);
   assert(sb_count(data.items[1].fun.body.attrs[0]) == 1);
   assert(sb_count(data.items[1].fun.body.attrs[1]) == 1);
+  assert(table.count == 3);
+  assert(data.attrs[1][0].feature == data.items[1].fun.body.attrs[0][0].feature);
 
   rax *features = raxNew();
   raxInsert(features, "bar", 3, NULL, NULL);
-  oo_filter_cc(&data, features);
+  OoFeatureSet set = oo_feature_set_compile(&table, features);
+  AsgItem *items = data.items;
+  oo_filter_cc(&data, &set);
+  oo_feature_set_free(set);
 
+  assert(data.items == items);
+  assert(sb_count(data.items) == 2);
+  assert(data.items[0].disabled);
+  assert(!data.items[1].disabled);
+  assert(sb_count(data.items[1].fun.body.exps) == 2);
+  assert(!data.items[1].fun.body.exps[0].disabled);
+  assert(data.items[1].fun.body.exps[1].disabled);
+
+  // Filtering again with other features re-enables nodes.
+  raxInsert(features, "foo", 3, NULL, NULL);
+  raxInsert(features, "baz", 3, NULL, NULL);
+  set = oo_feature_set_compile(&table, features);
+  oo_filter_cc(&data, &set);
+  oo_feature_set_free(set);
+  assert(!data.items[0].disabled);
+  assert(!data.items[1].fun.body.exps[1].disabled);
+
+  free_inner_file(data);
+  raxFree(features);
+  oo_features_free(&table);
+}
+
+void test_cc_parse(void) {
+  char *src = "#[cc = \"foo\"]fn a = () {x; {y}} #[cc = \"bar\"]fn c = () {#[cc = \"bar\"]a; #[cc = \"baz\"]{b; (c)}; d} #[cc = \"foo\"]pub ffi use \"e\"";
+  ParserError err;
+  AsgFile data;
+
+  rax *features = raxNew();
+  raxInsert(features, "bar", 3, NULL, NULL);
+  OoFeatureTable table;
+  oo_features_init(&table);
+  OoFeatureSet set = oo_feature_set_compile(&table, features);
+  ParserCx pcx;
+  pcx.features = &table;
+  pcx.enabled = &set;
+  pcx.lazy_bodies = false;
+
+  assert(parse_file(src, &err, &data, &pcx) == strlen(src));
+  assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(sb_count(data.items) == 1);
   assert(sb_count(data.attrs) == 1);
   assert(data.items[0].tag == ITEM_FUN);
-  assert(sb_count(data.attrs[0]) == 1);
-  assert(sb_count(data.items[0].fun.body.attrs) == 1);
-  assert(sb_count(data.items[0].fun.body.attrs[0]) == 1);
+  assert(sb_count(data.items[0].fun.body.exps) == 2);
+  assert(sb_count(data.items[0].fun.body.attrs) == 2);
+  assert(data.items[0].fun.body.exps[0].tag == EXP_ID);
+  assert(data.items[0].fun.body.exps[1].tag == EXP_ID);
+  assert(sb_count(data.items[0].fun.body.attrs[1]) == 0);
 
   free_inner_file(data);
+
+  // The pub of a sum type does not end a disabled item.
+  src = "#[cc = \"foo\"]type T = pub | a | b #[cc = \"foo\"]pub type Option = <T> => pub | some(T) | none pub type U = pub | c";
+  assert(parse_file(src, &err, &data, &pcx) == strlen(src));
+  assert(err.tag == ERR_NONE);
+  assert(sb_count(data.items) == 1);
+  assert(data.items[0].tag == ITEM_TYPE);
+  assert(data.items[0].pub);
+  assert(data.items[0].type.type.tag == TYPE_SUM);
+  free_inner_file(data);
+
+  src = "fn a = () {#[cc = \"baz\"]{b}";
+  parse_file(src, &err, &data, &pcx);
+  assert(err.tag == ERR_EXP);
+
+  oo_feature_set_free(set);
+  oo_features_free(&table);
+  raxFree(features);
+}
+
+void test_feature_set(void) {
+  OoFeatureTable table;
+  oo_features_init(&table);
+  assert(oo_features_intern(&table, "a", 1) == 0);
+  assert(oo_features_intern(&table, "b", 1) == 1);
+  assert(oo_features_intern(&table, "a", 1) == 0);
+
+  char name[8];
+  for (int i = 0; i < 100; i++) {
+    sprintf(name, "f%d", i);
+    oo_features_intern(&table, name, strlen(name));
+  }
+
+  rax *features = raxNew();
+  raxInsert(features, "b", 1, NULL, NULL);
+  raxInsert(features, "f99", 3, NULL, NULL);
+  OoFeatureSet set = oo_feature_set_compile(&table, features);
+  assert(!oo_feature_set_has(&set, 0));
+  assert(oo_feature_set_has(&set, 1));
+  assert(oo_feature_set_has(&set, oo_features_intern(&table, "f99", 3)));
+  assert(!oo_feature_set_has(&set, oo_features_intern(&table, "f98", 3)));
+  assert(!oo_feature_set_has(&set, 1000));
+
+  oo_feature_set_free(set);
   raxFree(features);
+  oo_features_free(&table);
 }
 
 int main(void) {
   test_cc();
+  test_cc_parse();
+  test_feature_set();
 
   return 0;
 }
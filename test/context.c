@@ -1,12 +1,20 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE true
+#endif
+
 #include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include <linux/limits.h>
 
 #include "../src/stretchy_buffer.h"
 #include "../src/context.h"
+#include "../src/asg_cache.h"
+#include "../src/eval.h"
 #include "../src/util.h"
 
 void test_duplicates(void) {
@@ -79,6 +87,7 @@ void test_coarse_bindings(void) {
 
     oo_cx_coarse_bindings(&cx, &err);
     assert(err.tag == OO_ERR_NONE);
+    assert(cx.rax_pool.in_use > 0); // namespaces live in the pool
 
     raxFree(features);
     oo_cx_free(&cx);
@@ -136,11 +145,1060 @@ void test_fine_bindings(void) {
     oo_cx_free(&cx);
 }
 
+// Returns the file of the context whose path ends in the given suffix.
+static AsgFile *find_file(OoContext *cx, const char *suffix) {
+  for (int i = 0; i < sb_count(cx->files); i++) {
+    const char *path = cx->files[i]->path;
+    if (strcmp(path + strlen(path) - strlen(suffix), suffix) == 0) {
+      return cx->files[i];
+    }
+  }
+  return NULL;
+}
+
+void test_path_cache(void) {
+    char mods[PATH_MAX];
+    getcwd(mods, sizeof(mods));
+    strcat(mods, "/test/example_paths");
+    char deps[PATH_MAX];
+    getcwd(deps, sizeof(deps));
+    strcat(deps, "/test/example_deps");
+
+    rax *features = raxNew();
+    OoError err;
+    err.tag = OO_ERR_NONE;
+    OoContext cx;
+    oo_cx_init(&cx, mods, deps);
+
+    oo_cx_parse(&cx, &err, features);
+    assert(err.tag == OO_ERR_NONE);
+
+    oo_cx_coarse_bindings(&cx, &err);
+    assert(err.tag == OO_ERR_NONE);
+
+    oo_cx_fine_bindings(&cx, &err);
+    assert(err.tag == OO_ERR_NONE);
+
+    AsgFile *a = find_file(&cx, "/a.oo");
+    AsgFile *b = find_file(&cx, "/b.oo");
+    AsgType *u = b->items[1].type.type.product_anon;
+
+    // The first occurrence is resolved by walking the namespaces, the later
+    // ones come from the cache.
+    for (int i = 0; i < 3; i++) {
+      assert(u[i].id.binding.tag == BINDING_TYPE);
+      assert(u[i].id.binding.type == &a->items[0].type);
+      assert(u[i].id.sids[sb_count(u[i].id.sids) - 1].binding.type == &a->items[0].type);
+    }
+    assert(u[1].id.sids[0].binding.tag == BINDING_NS);
+    assert(u[1].id.sids[0].binding.ns == &a->ns);
+    assert(u[0].id.sids[1].binding.pub);
+    assert(!b->items[0].use.branch[0].sid.binding.pub); // use mod::a
+
+    AsgExp *body = b->items[2].fun.body.exps;
+    assert(body[1].id.binding.tag == BINDING_VAL);
+    assert(body[1].id.binding.val.val == &a->items[1].val);
+    assert(body[2].id.binding.val.val == &a->items[1].val);
+
+    raxFree(features);
+    oo_cx_free(&cx);
+}
+
+void test_multi_config(void) {
+  char mods[PATH_MAX];
+  getcwd(mods, sizeof(mods));
+  strcat(mods, "/test/example_cc");
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  AsgFile *asg = find_file(&cx, "/cc.oo");
+  assert(sb_count(asg->items) == 3);
+
+  const char *configs[2] = {"small", "large"};
+  for (int i = 0; i < 2; i++) {
+    rax *features = raxNew();
+    raxInsert(features, configs[i], strlen(configs[i]), NULL, NULL);
+    oo_cx_filter_cc(&cx, features);
+    raxFree(features);
+
+    oo_cx_coarse_bindings(&cx, &err);
+    assert(err.tag == OO_ERR_NONE);
+    oo_cx_fine_bindings(&cx, &err);
+    assert(err.tag == OO_ERR_NONE);
+    oo_cx_kind_checking(&cx, &err);
+    assert(err.tag == OO_ERR_NONE);
+    oo_cx_type_checking(&cx, &err);
+    assert(err.tag == OO_ERR_NONE);
+
+    assert(asg->items[i].disabled == false);
+    assert(asg->items[1 - i].disabled == true);
+    assert(asg->items[2].val.type.id.binding.type == &asg->items[i].type);
+
+    oo_cx_reset_analysis(&cx);
+  }
+
+  oo_cx_free(&cx);
+}
+
+void test_attr_index(void) {
+  char mods[PATH_MAX];
+  getcwd(mods, sizeof(mods));
+  strcat(mods, "/test/example_cc");
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  AsgFile *asg = find_file(&cx, "/cc.oo");
+
+  AsgItem **cc = oo_cx_items_with_attr(&cx, "cc", 2);
+  assert(sb_count(cc) == 2);
+  assert(cc[0] == &asg->items[0]);
+  assert(cc[1] == &asg->items[1]);
+
+  AsgItem **tests = oo_cx_items_with_attr(&cx, "test_pure", 9);
+  assert(sb_count(tests) == 1);
+  assert(tests[0] == &asg->items[2]);
+  assert(oo_cx_attr_id(&cx, "test_pure", 9) != oo_cx_attr_id(&cx, "cc", 2));
+
+  assert(oo_cx_attr_id(&cx, "test", 4) == OO_ATTR_NONE);
+  assert(oo_cx_items_with_attr(&cx, "test", 4) == NULL);
+
+  oo_cx_free(&cx);
+}
+
+void test_lazy_bodies(void) {
+  char mods[PATH_MAX];
+  getcwd(mods, sizeof(mods));
+  strcat(mods, "/test/example_paths");
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  cx.lazy_bodies = true;
+
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  AsgFile *a = find_file(&cx, "/a.oo");
+  AsgFile *b = find_file(&cx, "/b.oo");
+  AsgItemFun *f = &b->items[2].fun;
+  assert(f->body_src != NULL);
+  assert(f->body.exps == NULL);
+  assert(f->body.str.start[0] == '{');
+  assert(f->body.str.start[f->body.str.len - 1] == '}');
+
+  oo_cx_coarse_bindings(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  assert(f->body_src != NULL); // coarse bindings do not need the body
+
+  oo_cx_fine_bindings(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  assert(f->body_src == NULL);
+  assert(sb_count(f->body.exps) == 3);
+  assert(f->body.exps[2].id.binding.val.val == &a->items[1].val);
+
+  oo_cx_free(&cx);
+}
+
+void test_lazy_deps(void) {
+  char mods[PATH_MAX];
+  getcwd(mods, sizeof(mods));
+  strcat(mods, "/test/example_lazy");
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_lazy_deps");
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  cx.lazy_deps = true;
+
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  assert(sb_count(cx.sources) == 1);
+  AsgFile *root = find_file(&cx, "/main.oo");
+  AsgFile *used = find_file(&cx, "/used.oo");
+  AsgFile *unused = find_file(&cx, "/unused.oo");
+  AsgFile *inner = find_file(&cx, "/inner.oo");
+  assert(root->loaded);
+  assert(!used->loaded && !unused->loaded && !inner->loaded);
+
+  oo_cx_coarse_bindings(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  assert(used->loaded && used->coarse_bound); // reached by a use
+  assert(!inner->loaded); // only its directory is used
+
+  oo_cx_fine_bindings(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  assert(inner->loaded && inner->coarse_bound); // reached by a path
+  assert(!unused->loaded);
+  assert(sb_count(cx.sources) == 3);
+
+  AsgType *a = root->items[2].type.type.product_anon;
+  assert(a[0].id.binding.type == &used->items[0].type);
+  assert(a[1].id.binding.type == &inner->items[0].type);
+
+  oo_cx_kind_checking(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_type_checking(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+
+  oo_cx_free(&cx);
+}
+
+// Parses and analyzes example_bindings using the given cache directory.
+static void parse_cached(OoContext *cx, const char *cache_dir) {
+  char mods[PATH_MAX];
+  getcwd(mods, sizeof(mods));
+  strcat(mods, "/test/example_bindings");
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  oo_cx_init(cx, strdup(mods), strdup(deps));
+  cx->cache_dir = cache_dir;
+
+  oo_cx_parse(cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_coarse_bindings(cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_fine_bindings(cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_kind_checking(cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_type_checking(cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+}
+
+static void free_cached(OoContext *cx) {
+  free((char *) cx->mods);
+  free((char *) cx->deps);
+  oo_cx_free(cx);
+}
+
+// Stores the inode numbers of all entries of the directory, in readdir order.
+static int cache_inodes(const char *dir, ino_t *inodes) {
+  DIR *dp = opendir(dir);
+  struct dirent *ep;
+  int count = 0;
+  while ((ep = readdir(dp)) != NULL) {
+    if (ep->d_name[0] != '.') {
+      inodes[count] = ep->d_ino;
+      count++;
+    }
+  }
+  closedir(dp);
+  return count;
+}
+
+void test_asg_cache(void) {
+  char dir[] = "/tmp/look-cache-XXXXXX";
+  assert(mkdtemp(dir) != NULL);
+
+  OoContext parsed;
+  parse_cached(&parsed, dir);
+  ino_t written[64];
+  int count = cache_inodes(dir, written);
+  assert(count == sb_count(parsed.files));
+
+  // Everything is loaded from the cache (no entry is rewritten), and the
+  // loaded asgs encode exactly like the parsed ones.
+  OoContext loaded;
+  parse_cached(&loaded, dir);
+  ino_t read[64];
+  assert(cache_inodes(dir, read) == count);
+  for (int i = 0; i < count; i++) {
+    assert(read[i] == written[i]);
+  }
+  assert(sb_count(loaded.files) == sb_count(parsed.files));
+  for (int i = 0; i < sb_count(parsed.files); i++) {
+    char *a = oo_asg_serialize(parsed.files[i], parsed.sources[i]);
+    char *b = oo_asg_serialize(loaded.files[i], loaded.sources[i]);
+    assert(sb_count(a) == sb_count(b));
+    assert(memcmp(a, b, sb_count(a)) == 0);
+    assert(!oo_asg_deserialize(a, sb_count(a) - 1, parsed.sources[i], strlen(parsed.sources[i]), NULL, NULL));
+    sb_free(a);
+    sb_free(b);
+  }
+  free_cached(&loaded);
+
+  // Corrupt entries are ignored and replaced.
+  DIR *dp = opendir(dir);
+  struct dirent *ep;
+  char entry[PATH_MAX];
+  while ((ep = readdir(dp)) != NULL) {
+    if (ep->d_name[0] != '.') {
+      sprintf(entry, "%s/%s", dir, ep->d_name);
+      FILE *f = fopen(entry, "w");
+      fputs("garbage", f);
+      fclose(f);
+    }
+  }
+  closedir(dp);
+
+  OoContext repaired;
+  parse_cached(&repaired, dir);
+  assert(cache_inodes(dir, read) == count);
+  for (int i = 0; i < count; i++) {
+    assert(read[i] != written[i]);
+  }
+  free_cached(&repaired);
+
+  dp = opendir(dir);
+  while ((ep = readdir(dp)) != NULL) {
+    if (ep->d_name[0] != '.') {
+      sprintf(entry, "%s/%s", dir, ep->d_name);
+      remove(entry);
+    }
+  }
+  closedir(dp);
+  rmdir(dir);
+  free_cached(&parsed);
+}
+
+void test_dep_ifaces(void) {
+  char mods[PATH_MAX];
+  getcwd(mods, sizeof(mods));
+  strcat(mods, "/test/example_iface");
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_iface_deps");
+  char ifaces[] = "/tmp/look-ifaces-XXXXXX";
+  assert(mkdtemp(ifaces) != NULL);
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+
+  AsgFile *src_lib = find_file(&cx, "/lib.oo");
+  char iface_path[PATH_MAX];
+  sprintf(iface_path, "%s/lib.oo", ifaces);
+  char *iface = oo_iface_serialize(src_lib);
+  FILE *f = fopen(iface_path, "wb");
+  assert(fwrite(iface, sb_count(iface), 1, f) == 1);
+  fclose(f);
+  sb_free(iface);
+  size_t src_len = src_lib->str.len;
+  oo_cx_free(&cx);
+
+  oo_cx_init(&cx, mods, deps);
+  cx.dep_ifaces = ifaces;
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_coarse_bindings(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_fine_bindings(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_kind_checking(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_type_checking(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+
+  AsgFile *main = find_file(&cx, "/main.oo");
+  AsgFile *lib = find_file(&cx, "/lib.oo");
+  assert(lib->iface);
+  assert(lib->str.len < src_len);
+  // helper is private and gone, the private type Hidden is still needed by Pair
+  assert(sb_count(lib->items) == 5);
+  assert(str_eq_parts(lib->items[0].type.sid.str, "Hidden", 6));
+  AsgItemFun *twice = &lib->items[3].fun;
+  assert(str_eq_parts(twice->sid.str, "twice", 5));
+  assert(twice->body.exps == NULL);
+  assert(sb_count(lib->attrs[3]) == 1);
+  assert(str_eq_parts(lib->attrs[3][0].name, "inline", 6));
+  assert(lib->items[4].val.exp.tag == EXP_PRODUCT_ANON);
+  assert(main->items[2].fun.body.exps[0].fun_app_anon.fun->id.binding.val.fun == twice);
+
+  // The expression of limit is a placeholder, so neither it nor the vals that
+  // refer to it can be evaluated.
+  assert(oo_cx_eval_val(&cx, &err, &lib->items[4].val) == NULL);
+  assert(err.tag == OO_ERR_IFACE_VAL);
+  assert(err.iface_val == &lib->items[4].val);
+  assert(err.asg == lib);
+  FILE *null = fopen("/dev/null", "w");
+  err_fprint(null, &err);
+  fclose(null);
+
+  oo_cx_free(&cx);
+  remove(iface_path);
+  rmdir(ifaces);
+}
+
+static void write_file(const char *dir, const char *name, const char *content) {
+  char path[PATH_MAX];
+  sprintf(path, "%s/%s", dir, name);
+  FILE *f = fopen(path, "w");
+  fputs(content, f);
+  fclose(f);
+}
+
+static void remove_file(const char *dir, const char *name) {
+  char path[PATH_MAX];
+  sprintf(path, "%s/%s", dir, name);
+  remove(path);
+}
+
+static void analyze(OoContext *cx, OoError *err) {
+  oo_cx_coarse_bindings(cx, err);
+  assert(err->tag == OO_ERR_NONE);
+  oo_cx_fine_bindings(cx, err);
+  assert(err->tag == OO_ERR_NONE);
+  oo_cx_kind_checking(cx, err);
+  assert(err->tag == OO_ERR_NONE);
+  oo_cx_type_checking(cx, err);
+  assert(err->tag == OO_ERR_NONE);
+}
+
+void test_reload(void) {
+  char mods[] = "/tmp/look-reload-XXXXXX";
+  assert(mkdtemp(mods) != NULL);
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+  write_file(mods, "a.oo", "pub type T = U8\n\npub val v: T = 42\n");
+  write_file(mods, "b.oo", "use mod::a\n\nfn f = (x: a::T) -> a::T {\n  a::v\n}\n");
+  write_file(mods, "c.oo", "type C = U16\n\nfn g = (x: C) -> C {\n  x\n}\n");
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  cx.threads = 2;
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  analyze(&cx, &err);
+
+  AsgFile *a = find_file(&cx, "/a.oo");
+  AsgFile *b = find_file(&cx, "/b.oo");
+  AsgFile *c = find_file(&cx, "/c.oo");
+  assert(sb_count(a->dependents) == 1);
+  assert(a->dependents[0] == b);
+  assert(b->items[1].fun.body.exps[0].id.binding.val.val == &a->items[1].val);
+
+  // v moves to a different index, so b has to be bound again, c does not.
+  write_file(mods, "a.oo", "pub type T = U8\n\ntype W = U32\n\npub val v: T = 43\n");
+  AsgFile **changed = NULL;
+  sb_push(changed, a);
+  oo_cx_reload(&cx, &err, changed);
+  sb_free(changed);
+  assert(err.tag == OO_ERR_NONE);
+  assert(sb_count(a->items) == 3);
+  assert(!b->fine_bound && !b->typed);
+  assert(c->fine_bound && c->typed);
+
+  // Only the body of b is checked again, the one of c is still memoized.
+  assert(oo_queries_get(&cx.queries, OO_QUERY_FUN_BODY, &b->items[1].fun) == NULL);
+  assert(oo_queries_get(&cx.queries, OO_QUERY_FUN_BODY, &c->items[1].fun) != NULL);
+  uint64_t computed = cx.queries.computed;
+  analyze(&cx, &err);
+  assert(oo_queries_get(&cx.queries, OO_QUERY_FUN_BODY, &b->items[1].fun) != NULL);
+  uint64_t rechecked = cx.queries.computed - computed;
+  assert(rechecked > 0);
+  oo_cx_check_fun(&cx, &err, &c->items[1]);
+  assert(err.tag == OO_ERR_NONE && cx.queries.computed == computed + rechecked);
+
+  // Reloading b alone checks the same queries again.
+  changed = NULL;
+  sb_push(changed, b);
+  oo_cx_reload(&cx, &err, changed);
+  sb_free(changed);
+  assert(err.tag == OO_ERR_NONE);
+  computed = cx.queries.computed;
+  analyze(&cx, &err);
+  assert(cx.queries.computed - computed == rechecked);
+
+  assert(b->items[1].fun.body.exps[0].id.binding.val.val == &a->items[2].val);
+  assert(b->items[1].fun.arg_types[0].id.binding.type == &a->items[0].type);
+
+  // Binding again reuses the worker pools and the memory freed in them.
+  assert(sb_count(cx.worker_pools) == 2);
+  size_t reserved = cx.worker_pools[0]->pool.reserved + cx.worker_pools[1]->pool.reserved;
+  for (int i = 0; i < 3; i++) {
+    changed = NULL;
+    sb_push(changed, a);
+    oo_cx_reload(&cx, &err, changed);
+    sb_free(changed);
+    analyze(&cx, &err);
+  }
+  assert(sb_count(cx.worker_pools) == 2);
+  assert(cx.worker_pools[0]->pool.reserved + cx.worker_pools[1]->pool.reserved == reserved);
+
+  oo_cx_free(&cx);
+  remove_file(mods, "a.oo");
+  remove_file(mods, "b.oo");
+  remove_file(mods, "c.oo");
+  rmdir(mods);
+}
+
+// Binds the files of the given directory with the given number of threads.
+static void bind_with_threads(OoContext *cx, OoError *err, const char *mods, const char *deps, int threads) {
+  err->tag = OO_ERR_NONE;
+  oo_cx_init(cx, mods, deps);
+  cx->threads = threads;
+  oo_cx_parse(cx, err, NULL);
+  assert(err->tag == OO_ERR_NONE);
+  oo_cx_coarse_bindings(cx, err);
+}
+
+// Asserts that both contexts (of the same directories) bound all top-level
+// sids of all files to the same things.
+static void assert_same_coarse_bindings(OoContext *a, OoContext *b) {
+  assert(sb_count(a->files) == sb_count(b->files));
+  for (int i = 0; i < sb_count(a->files); i++) {
+    AsgFile *fa = a->files[i];
+    AsgFile *fb = b->files[i];
+    assert(strcmp(fa->path, fb->path) == 0);
+    assert(fa->coarse_bound && fb->coarse_bound);
+    assert(raxSize(fa->ns.bindings_by_sid) == raxSize(fb->ns.bindings_by_sid));
+
+    raxIterator ia, ib;
+    raxStart(&ia, fa->ns.bindings_by_sid);
+    raxStart(&ib, fb->ns.bindings_by_sid);
+    raxSeek(&ia, "^", NULL, 0);
+    raxSeek(&ib, "^", NULL, 0);
+    while (raxNext(&ia)) {
+      assert(raxNext(&ib));
+      assert(ia.key_len == ib.key_len && memcmp(ia.key, ib.key, ia.key_len) == 0);
+      AsgBinding *ba = ia.data;
+      AsgBinding *bb = ib.data;
+      assert(ba->tag == bb->tag && ba->pub == bb->pub);
+      assert((ba->file == NULL) == (bb->file == NULL));
+      if (ba->file != NULL) {
+        assert(strcmp(ba->file->path, bb->file->path) == 0);
+      }
+      if (ba->tag == BINDING_NS) {
+        assert(ba->ns->tag == bb->ns->tag);
+        if (ba->ns->tag == NS_FILE) {
+          assert(strcmp(ba->ns->file->path, bb->ns->file->path) == 0);
+        }
+      }
+    }
+    raxStop(&ia);
+    raxStop(&ib);
+
+    assert(sb_count(fa->dependents) == sb_count(fb->dependents));
+  }
+}
+
+void test_parallel_coarse_bindings(void) {
+  char mods[] = "/tmp/look-waves-XXXXXX";
+  assert(mkdtemp(mods) != NULL);
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+  write_file(mods, "a.oo", "pub type A = U8\n");
+  write_file(mods, "b.oo", "use mod::a\n\npub type B = a::A\n");
+  write_file(mods, "c.oo", "pub use mod::a::A\n\npub type C = U16\n");
+  write_file(mods, "d.oo", "use mod::{b::B, c::{A, C}}\n\nuse dep::foo::lib\n");
+  write_file(mods, "e.oo", "use mod::d\n\nuse d::lib\n");
+
+  OoError err;
+  OoContext seq, par;
+  bind_with_threads(&seq, &err, mods, deps, 1);
+  assert(err.tag == OO_ERR_NONE);
+  bind_with_threads(&par, &err, mods, deps, 4);
+  assert(err.tag == OO_ERR_NONE);
+  assert_same_coarse_bindings(&seq, &par);
+
+  AsgFile *a = find_file(&par, "/a.oo");
+  assert(sb_count(a->dependents) == 2); // b and c, d only through c
+
+  oo_cx_fine_bindings(&par, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_kind_checking(&par, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_free(&seq);
+  oo_cx_free(&par);
+
+  // An import cycle is reported for the same use, whatever got bound in parallel.
+  write_file(mods, "f.oo", "use mod::g\n");
+  write_file(mods, "g.oo", "use mod::{f, a}\n");
+  OoError seq_err, par_err;
+  bind_with_threads(&seq, &seq_err, mods, deps, 1);
+  assert(seq_err.tag == OO_ERR_CYCLIC_IMPORTS);
+  bind_with_threads(&par, &par_err, mods, deps, 4);
+  assert(par_err.tag == OO_ERR_CYCLIC_IMPORTS);
+  assert(strcmp(seq_err.asg->path, par_err.asg->path) == 0);
+  assert(str_eq(seq_err.cyclic_import->str, par_err.cyclic_import->str));
+  oo_cx_free(&seq);
+  oo_cx_free(&par);
+
+  const char *names[] = {"a.oo", "b.oo", "c.oo", "d.oo", "e.oo", "f.oo", "g.oo"};
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    remove_file(mods, names[i]);
+  }
+  rmdir(mods);
+}
+
+// Records the files passed by oo_cx_stream, and checks that their bodies are bound.
+static void record_streamed(OoContext *cx, AsgFile *asg, void *data) {
+  (void) cx;
+  AsgFile ***streamed = data;
+  assert(asg->fine_bound && asg->kind_checked && asg->typed);
+  for (int i = 0; i < sb_count(asg->items); i++) {
+    if (asg->items[i].tag == ITEM_FUN) {
+      assert(asg->items[i].fun.body_src == NULL);
+      assert(sb_count(asg->items[i].fun.body.exps) > 0);
+    }
+  }
+  sb_push(*streamed, asg);
+}
+
+void test_stream(void) {
+  char mods[] = "/tmp/look-stream-XXXXXX";
+  assert(mkdtemp(mods) != NULL);
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+  write_file(mods, "b.oo", "use mod::a\n\nfn g = () -> a::T {\n  a::f()\n}\n");
+  write_file(mods, "a.oo", "pub type T = U8\n\npub fn f = () -> T {\n  42\n}\n");
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  cx.streaming = true;
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  assert(sb_count(cx.sources) == 0); // all sources are mapped
+
+  AsgFile **streamed = NULL;
+  oo_cx_stream(&cx, &err, record_streamed, &streamed);
+  assert(err.tag == OO_ERR_NONE);
+  AsgFile *a = find_file(&cx, "/a.oo");
+  AsgFile *b = find_file(&cx, "/b.oo");
+  assert(sb_count(streamed) == 3);
+  int ia = 0;
+  while (streamed[ia] != a) {
+    ia++;
+  }
+  int ib = 0;
+  while (streamed[ib] != b) {
+    ib++;
+  }
+  assert(ia < ib);
+
+  // Bodies are gone, signatures and their source text are still there.
+  assert(b->items[1].fun.body.exps == NULL);
+  assert(b->items[1].fun.body_src != NULL);
+  assert(b->items[1].fun.ret.id.binding.type == &a->items[0].type);
+  assert(str_eq_parts(a->items[1].fun.sid.str, "f", 1));
+  assert(b->items[1].fun.ret.id.sids == NULL); // released after streaming b
+  assert(oo_cx_mem_stats(&cx).released_syntax > 0);
+
+  sb_free(streamed);
+  oo_cx_free(&cx);
+  remove_file(mods, "a.oo");
+  remove_file(mods, "b.oo");
+  rmdir(mods);
+}
+
+void test_release_syntax_types(void) {
+  char mods[PATH_MAX];
+  getcwd(mods, sizeof(mods));
+  strcat(mods, "/test/example_bindings");
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  analyze(&cx, &err);
+
+  AsgFile *lib = find_file(&cx, "/example_bindings/lib.oo");
+  AsgItem *e = &lib->items[6];
+  assert(e->fun.sid.binding.val.oo_type->tag == OO_TYPE_FUN_NAMED);
+  assert(oo_cx_mem_stats(&cx).released_syntax == 0);
+
+  oo_cx_release_syntax_types(&cx);
+  OoMemStats stats = oo_cx_mem_stats(&cx);
+  assert(stats.released_syntax > 0);
+  assert(stats.peak_rss > 0);
+  assert(stats.ns_in_use > 0 && stats.ns_peak >= stats.ns_in_use);
+
+  // The path segments are gone, the types and spans are not.
+  assert(e->fun.arg_types[1].app_anon.tlf.sids == NULL);
+  assert(str_eq_parts(e->fun.arg_types[1].str, "Option<C>", 9));
+  OoType *opt = e->fun.sid.binding.val.oo_type->fun_named.arg_types[1];
+  assert(opt->tag == OO_TYPE_APP);
+  assert(opt->app.tlf == &lib->items[3].type);
+  assert(lib->items[3].type.oo_type->tag == OO_TYPE_GENERIC);
+  assert(opt->app.args[0]->tag == OO_TYPE_BINDING);
+  assert(opt->app.args[0]->binding->type == &lib->items[2].type);
+
+  // Both `()` return types are the same interned type.
+  AsgItem *d = &lib->items[5];
+  assert(d->fun.sid.binding.val.oo_type->fun_named.ret == e->fun.sid.binding.val.oo_type->fun_named.ret);
+
+  oo_cx_release_syntax_types(&cx);
+  assert(oo_cx_mem_stats(&cx).released_syntax == stats.released_syntax);
+
+  oo_cx_free(&cx);
+}
+
+void test_canonical_types(void) {
+  char mods[] = "/tmp/look-alias-XXXXXX";
+  assert(mkdtemp(mods) != NULL);
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+  write_file(mods, "a.oo", "use mod::b\n\npub type A = b::B\n\ntype P = @A\n");
+  write_file(mods, "b.oo", "pub type B = C\n\ntype C = U8\n");
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  analyze(&cx, &err);
+
+  AsgFile *a = find_file(&cx, "/a.oo");
+  AsgFile *b = find_file(&cx, "/b.oo");
+  OoType *u8 = b->items[1].type.oo_type;
+  assert(u8->tag == OO_TYPE_BINDING && u8->binding->primitive == PRIM_U8);
+  assert(a->items[1].type.canonical == u8);
+  assert(b->items[0].type.canonical == u8);
+  assert(b->items[1].type.canonical == u8);
+  assert(oo_cx_canonical_type(a->items[1].type.oo_type) == u8);
+  assert(a->items[2].type.canonical == a->items[2].type.oo_type);
+  assert(oo_cx_canonical_type(a->items[2].type.oo_type->ptr) == u8);
+  oo_cx_free(&cx);
+
+  write_file(mods, "b.oo", "pub type B = C\n\ntype C = B\n");
+  err.tag = OO_ERR_NONE;
+  oo_cx_init(&cx, mods, deps);
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_coarse_bindings(&cx, &err);
+  oo_cx_fine_bindings(&cx, &err);
+  oo_cx_kind_checking(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_type_checking(&cx, &err);
+  assert(err.tag == OO_ERR_CYCLIC_ALIAS);
+  assert(
+    (err.asg == find_file(&cx, "/a.oo") && str_eq_parts(err.cyclic_alias->str, "A", 1)) ||
+    (err.asg == find_file(&cx, "/b.oo") && str_eq_parts(err.cyclic_alias->str, "B", 1))
+  );
+  oo_cx_free(&cx);
+
+  // A loop reached through the layout of a val is reported in the file of the loop.
+  write_file(mods, "a.oo", "use mod::b\n\nval s: Usize = sizeof(b::B)\n");
+  err.tag = OO_ERR_NONE;
+  oo_cx_init(&cx, mods, deps);
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_coarse_bindings(&cx, &err);
+  oo_cx_fine_bindings(&cx, &err);
+  oo_cx_kind_checking(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_type_checking(&cx, &err);
+  assert(err.tag == OO_ERR_CYCLIC_ALIAS);
+  assert(err.asg == find_file(&cx, "/b.oo"));
+  FILE *null = fopen("/dev/null", "w");
+  err_fprint(null, &err);
+  fclose(null);
+  oo_cx_free(&cx);
+
+  remove_file(mods, "a.oo");
+  remove_file(mods, "b.oo");
+  rmdir(mods);
+}
+
+static AsgItem **item_sb(AsgItem *item) {
+  AsgItem **items = NULL;
+  sb_push(items, item);
+  return items;
+}
+
+// The body of the last item of the file a.oo.
+static AsgExp *a_body(OoContext *cx) {
+  AsgFile *a = find_file(cx, "/a.oo");
+  return sb_last(a->items).fun.body.exps;
+}
+
+void test_check_bodies(void) {
+  char mods[] = "/tmp/look-bodies-XXXXXX";
+  assert(mkdtemp(mods) != NULL);
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+  write_file(mods, "a.oo",
+    "fn id = (x: U8) -> U8 {\n  x\n}\n\n"
+    "fn twice = (x: U8) -> U8 {\n  val y = id(x);\n  y + id(3)\n}\n\n"
+    "fn other = () -> Bool {\n  1 < 2\n}\n"
+  );
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  oo_cx_parse(&cx, &err, NULL);
+  oo_cx_coarse_bindings(&cx, &err);
+  oo_cx_fine_bindings(&cx, &err);
+  oo_cx_kind_checking(&cx, &err);
+  AsgFile *a = find_file(&cx, "/a.oo");
+  oo_cx_type_check_file(&cx, &err, a);
+  assert(err.tag == OO_ERR_NONE);
+
+  // Only the functions reachable from the root are checked.
+  AsgItem **roots = item_sb(&a->items[1]);
+  oo_cx_check_reachable(&cx, &err, roots);
+  assert(err.tag == OO_ERR_NONE);
+  assert(oo_queries_get(&cx.queries, OO_QUERY_FUN_BODY, &a->items[0].fun) != NULL);
+  assert(oo_queries_get(&cx.queries, OO_QUERY_FUN_BODY, &a->items[1].fun) != NULL);
+  assert(oo_queries_get(&cx.queries, OO_QUERY_FUN_BODY, &a->items[2].fun) == NULL);
+
+  OoType *u8 = a->items[0].fun.sid.binding.val.oo_type->fun_named.ret;
+  AsgExp *sum = &a->items[1].fun.body.exps[1];
+  assert(oo_cx_exp_type(&cx, &err, sum) == u8);
+  assert(oo_cx_exp_type(&cx, &err, sum->bin_op.lhs) == u8); // the local y
+
+  // Checking again is memoized, invalidating the signature of id only
+  // invalidates the bodies using it.
+  uint64_t computed = cx.queries.computed;
+  oo_cx_check_file_bodies(&cx, &err, a);
+  assert(cx.queries.computed > computed);
+  computed = cx.queries.computed;
+  oo_cx_check_file_bodies(&cx, &err, a);
+  assert(cx.queries.computed == computed);
+  oo_queries_invalidate(&cx.queries, OO_QUERY_FUN_TYPE, &a->items[0].fun);
+  assert(oo_queries_get(&cx.queries, OO_QUERY_FUN_BODY, &a->items[1].fun) == NULL);
+  assert(oo_queries_get(&cx.queries, OO_QUERY_FUN_BODY, &a->items[2].fun) != NULL);
+  assert(oo_queries_get(&cx.queries, OO_QUERY_EXP_TYPE, sum) == NULL);
+  oo_cx_check_fun(&cx, &err, &a->items[1]);
+  assert(err.tag == OO_ERR_NONE && oo_cx_exp_type(&cx, &err, sum) == u8);
+  sb_free(roots);
+  oo_cx_free(&cx);
+
+  const char *wrong[] = {
+    "fn f = (x: U8) -> Bool {\n  x\n}\n",
+    "fn f = (x: U8, y: U16) -> U8 {\n  x + y\n}\n",
+    "fn f = (x: U8) -> U8 {\n  f(x, x)\n}\n",
+    "fn f = (x: (U8, Bool)) -> U8 {\n  x.2\n}\n",
+    "fn f = (x: U8) -> U8 {\n  if x {\n    return x\n  } else {\n    x\n  }\n}\n",
+    "fn f = () -> U8 {\n  val x: Bool = 1 == 2;\n  return x\n}\n",
+  };
+  for (size_t i = 0; i < sizeof(wrong) / sizeof(wrong[0]); i++) {
+    write_file(mods, "a.oo", wrong[i]);
+    err.tag = OO_ERR_NONE;
+    oo_cx_init(&cx, mods, deps);
+    oo_cx_parse(&cx, &err, NULL);
+    assert(err.tag == OO_ERR_NONE);
+    oo_cx_coarse_bindings(&cx, &err);
+    oo_cx_fine_bindings(&cx, &err);
+    oo_cx_kind_checking(&cx, &err);
+    assert(err.tag == OO_ERR_NONE);
+    oo_cx_type_checking(&cx, &err);
+    assert(err.tag == OO_ERR_TYPE_MISMATCH);
+    oo_cx_free(&cx);
+  }
+
+  remove_file(mods, "a.oo");
+  rmdir(mods);
+}
+
+void test_named_positions(void) {
+  char mods[] = "/tmp/look-positions-XXXXXX";
+  assert(mkdtemp(mods) != NULL);
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+  write_file(mods, "a.oo",
+    "type P = (x: U8, y: Bool)\n\n"
+    "type S = | A(u: U8, v: Bool) | B\n\n"
+    "fn f = (a: U8, b: Bool) -> U8 {\n  a\n}\n\n"
+    "fn g = (p: P, s: S) -> U8 {\n"
+    "  val (y = q, x = r) = p;\n"
+    "  case s {\n    | S::A(v = w, u = z) {\n      return z\n    }\n    _ {\n      return r\n    }\n  };\n"
+    "  f(b = q, a = p.y)\n"
+    "}\n"
+  );
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_coarse_bindings(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_fine_bindings(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+
+  // Summand fields are resolved by fine binding.
+  AsgExp *body = a_body(&cx);
+  AsgPattern *summand = &body[1].exp_case.patterns[0];
+  assert(summand->summand_named.positions[0] == 1 && summand->summand_named.positions[1] == 0);
+
+  // The others once the types are known.
+  AsgPattern *product = &body[0].val_assign.lhs;
+  assert(product->product_named.positions == NULL);
+  oo_cx_kind_checking(&cx, &err);
+  oo_cx_type_checking(&cx, &err);
+  assert(err.tag == OO_ERR_TYPE_MISMATCH); // p.y is a Bool
+  oo_cx_free(&cx);
+
+  write_file(mods, "a.oo",
+    "type P = (x: U8, y: Bool)\n\n"
+    "fn f = (a: U8, b: Bool) -> U8 {\n  a\n}\n\n"
+    "fn g = (p: P) -> U8 {\n"
+    "  val (y = q, x = r) = p;\n"
+    "  f(b = q, a = p.x)\n"
+    "}\n"
+  );
+  err.tag = OO_ERR_NONE;
+  oo_cx_init(&cx, mods, deps);
+  oo_cx_parse(&cx, &err, NULL);
+  oo_cx_coarse_bindings(&cx, &err);
+  oo_cx_bind_and_kind_check(&cx, &err);
+  oo_cx_type_checking(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+
+  body = a_body(&cx);
+  product = &body[0].val_assign.lhs;
+  assert(product->product_named.positions[0] == 1 && product->product_named.positions[1] == 0);
+  AsgExp *app = &body[1];
+  assert(app->fun_app_named.positions[0] == 1 && app->fun_app_named.positions[1] == 0);
+  assert(app->fun_app_named.args[1].product_access_named.position == 0);
+  oo_cx_free(&cx);
+
+  const char *wrong[] = {
+    "fn f = (a: U8, b: Bool) -> U8 {\n  f(a = 1, a = 2)\n}\n",
+    "fn f = (a: U8, b: Bool) -> U8 {\n  f(a = 1, c = 1 == 1)\n}\n",
+    "fn f = (p: (x: U8, y: Bool)) -> U8 {\n  val (z = q) = p;\n  0\n}\n",
+  };
+  for (size_t i = 0; i < sizeof(wrong) / sizeof(wrong[0]); i++) {
+    write_file(mods, "a.oo", wrong[i]);
+    err.tag = OO_ERR_NONE;
+    oo_cx_init(&cx, mods, deps);
+    oo_cx_parse(&cx, &err, NULL);
+    oo_cx_coarse_bindings(&cx, &err);
+    oo_cx_bind_and_kind_check(&cx, &err);
+    assert(err.tag == OO_ERR_NONE);
+    oo_cx_type_checking(&cx, &err);
+    assert(err.tag == OO_ERR_TYPE_MISMATCH);
+    oo_cx_free(&cx);
+  }
+
+  // Fields of named summand patterns are checked by fine binding.
+  const char *wrong_summands[] = {
+    "type S = | A(u: U8, v: Bool)\n\nfn f = (s: S) -> () {\n  case s {\n    | S::A(u = x, w = y) {}\n  }\n}\n",
+    "type S = | A(u: U8, v: Bool)\n\nfn f = (s: S) -> () {\n  case s {\n    | S::A(u = x, u = y) {}\n  }\n}\n",
+    "type S = | A(U8, Bool)\n\nfn f = (s: S) -> () {\n  case s {\n    | S::A(u = x) {}\n  }\n}\n",
+  };
+  const char wrong_fields[] = {'w', 'u', 'u'};
+  for (size_t i = 0; i < sizeof(wrong_summands) / sizeof(wrong_summands[0]); i++) {
+    write_file(mods, "a.oo", wrong_summands[i]);
+    err.tag = OO_ERR_NONE;
+    oo_cx_init(&cx, mods, deps);
+    oo_cx_parse(&cx, &err, NULL);
+    assert(err.tag == OO_ERR_NONE);
+    oo_cx_coarse_bindings(&cx, &err);
+    oo_cx_fine_bindings(&cx, &err);
+    assert(err.tag == OO_ERR_SUMMAND_FIELD);
+    assert(err.asg == find_file(&cx, "/a.oo"));
+    assert(err.summand_field->str.len == 1 && err.summand_field->str.start[0] == wrong_fields[i]);
+    oo_cx_free(&cx);
+  }
+
+  remove_file(mods, "a.oo");
+  rmdir(mods);
+}
+
+void test_frame_slots(void) {
+  char mods[] = "/tmp/look-slots-XXXXXX";
+  assert(mkdtemp(mods) != NULL);
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+  write_file(mods, "a.oo",
+    "fn f = (a: U8, b: U8) -> U8 {\n"
+    "  val c = a;\n"
+    "  case b {\n    d {\n      return d\n    }\n    (e, g) {\n      return g\n    }\n  };\n"
+    "  val h = c;\n"
+    "  h\n"
+    "}\n"
+  );
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  oo_cx_parse(&cx, &err, NULL);
+  oo_cx_coarse_bindings(&cx, &err);
+  oo_cx_fine_bindings(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+
+  AsgItemFun *f = &find_file(&cx, "/a.oo")->items[0].fun;
+  AsgExp *body = f->body.exps;
+  assert(body[0].val_assign.lhs.id.slot == 2);
+  assert(body[0].val_assign.rhs->id.binding.val.slot == 0); // a
+
+  // The arms share the slots after c, h reuses them.
+  AsgExp *c = &body[1];
+  assert(c->exp_case.matcher->id.binding.val.slot == 1); // b
+  assert(c->exp_case.patterns[0].id.slot == 3);
+  assert(c->exp_case.patterns[1].product_anon[0].id.slot == 3);
+  assert(c->exp_case.patterns[1].product_anon[1].id.slot == 4);
+  assert(c->exp_case.blocks[1].exps[0].exp_return->id.binding.val.slot == 4); // g
+  assert(body[2].val_assign.lhs.id.slot == 3);
+  assert(body[3].id.binding.val.slot == 3);
+  assert(f->frame_size == 5);
+
+  oo_cx_free(&cx);
+  remove_file(mods, "a.oo");
+  rmdir(mods);
+}
+
 int main(void) {
   test_coarse_bindings();
   test_duplicates();
   test_use_duplicates();
   test_fine_bindings();
+  test_path_cache();
+  test_multi_config();
+  test_attr_index();
+  test_lazy_bodies();
+  test_lazy_deps();
+  test_asg_cache();
+  test_dep_ifaces();
+  test_reload();
+  test_parallel_coarse_bindings();
+  test_stream();
+  test_release_syntax_types();
+  test_canonical_types();
+  test_check_bodies();
+  test_named_positions();
+  test_frame_slots();
 
   return 0;
 }
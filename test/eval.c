@@ -0,0 +1,160 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE true
+#endif
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/limits.h>
+
+#include "../src/stretchy_buffer.h"
+#include "../src/context.h"
+#include "../src/eval.h"
+
+static const OoConst *item_val(OoContext *cx, AsgFile *asg, int i) {
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  const OoConst *c = oo_cx_eval_val(cx, &err, &asg->items[i].val);
+  assert(err.tag == OO_ERR_NONE);
+  return c;
+}
+
+static void analyze(OoContext *cx, OoError *err) {
+  oo_cx_parse(cx, err, NULL);
+  assert(err->tag == OO_ERR_NONE);
+  oo_cx_coarse_bindings(cx, err);
+  assert(err->tag == OO_ERR_NONE);
+  oo_cx_fine_bindings(cx, err);
+  assert(err->tag == OO_ERR_NONE);
+  oo_cx_kind_checking(cx, err);
+  assert(err->tag == OO_ERR_NONE);
+  oo_cx_type_checking(cx, err);
+}
+
+void test_eval(void) {
+  char mods[PATH_MAX];
+  getcwd(mods, sizeof(mods));
+  strcat(mods, "/test/example_eval");
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  analyze(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+
+  AsgFile *lib = cx.files[0];
+
+  // val a: U8 = 200
+  const OoConst *a = item_val(&cx, lib, 0);
+  assert(a->tag == OO_CONST_INT && a->prim == PRIM_U8 && a->bits == 200);
+  assert(item_val(&cx, lib, 0) == a);
+
+  // val b: U8 = a +% 100
+  assert(item_val(&cx, lib, 1)->bits == 44);
+
+  // val c: U16 = a as U16 * 2
+  assert(item_val(&cx, lib, 2)->prim == PRIM_U16 && item_val(&cx, lib, 2)->bits == 400);
+
+  // val d: I8 = 127 +% 1
+  const OoConst *d = item_val(&cx, lib, 3);
+  assert(d->prim == PRIM_I8 && d->bits == 128 && oo_const_signed(d) == -128);
+
+  // the largest I128 and U128
+  assert(oo_const_signed(item_val(&cx, lib, 4)) == (OoI128) (((OoU128) 1 << 127) - 1));
+  assert(item_val(&cx, lib, 5)->bits == ~(OoU128) 0);
+
+  // val g: Usize = sizeof((U8, U32))
+  assert(item_val(&cx, lib, 6)->prim == PRIM_USIZE && item_val(&cx, lib, 6)->bits == 8);
+
+  // val h: (U8, Bool) = (a, a > 100), val i: U8 = h.0
+  const OoConst *h = item_val(&cx, lib, 7);
+  assert(h->tag == OO_CONST_PRODUCT && sb_count(h->fields) == 2);
+  assert(h->fields[0]->bits == 200 && h->fields[1]->tag == OO_CONST_BOOL && h->fields[1]->bits == 1);
+  assert(item_val(&cx, lib, 8)->bits == 200);
+
+  // val j: (U8; 3) = (7; 3)
+  const OoConst *j = item_val(&cx, lib, 9);
+  assert(sb_count(j->fields) == 3 && j->fields[2]->prim == PRIM_U8 && j->fields[2]->bits == 7);
+
+  // val k: U8 = 255 as I8 as U8
+  assert(item_val(&cx, lib, 10)->bits == 255);
+
+  // val l: (x: U8, y: I8) = (x = 1, y = d / -2), val m: I8 = l.y
+  assert(oo_const_signed(item_val(&cx, lib, 12)) == 64);
+
+  // val n: Usize = sizeof((U8; 65536 * 65536))
+  assert(item_val(&cx, lib, 13)->bits == (OoU128) 1 << 32);
+
+  // the smallest I8, I64 and I128
+  assert(oo_const_signed(item_val(&cx, lib, 14)) == -128);
+  assert(oo_const_signed(item_val(&cx, lib, 15)) == INT64_MIN);
+  assert(oo_const_signed(item_val(&cx, lib, 16)) == -(OoI128) (((OoU128) 1 << 127) - 1) - 1);
+
+  oo_cx_free(&cx);
+}
+
+static void write_file(const char *dir, const char *name, const char *content) {
+  char path[PATH_MAX];
+  sprintf(path, "%s/%s", dir, name);
+  FILE *f = fopen(path, "w");
+  fputs(content, f);
+  fclose(f);
+}
+
+static void remove_file(const char *dir, const char *name) {
+  char path[PATH_MAX];
+  sprintf(path, "%s/%s", dir, name);
+  remove(path);
+}
+
+// Analyzes a single file with the given source, returns the tag of the error.
+static OoErrorTag eval_error(const char *src) {
+  char mods[] = "/tmp/look-eval-XXXXXX";
+  assert(mkdtemp(mods) != NULL);
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+  write_file(mods, "a.oo", src);
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  analyze(&cx, &err);
+  OoErrorTag tag = err.tag;
+
+  oo_cx_free(&cx);
+  remove_file(mods, "a.oo");
+  rmdir(mods);
+  return tag;
+}
+
+void test_eval_errors(void) {
+  assert(eval_error("val a: U8 = 200 + 100\n") == OO_ERR_CONST_ARITHMETIC);
+  assert(eval_error("val a: I8 = b / -1\n\nval b: I8 = 127 +% 1\n") == OO_ERR_CONST_ARITHMETIC);
+  assert(eval_error("val a: U8 = 256\n") == OO_ERR_CONST_ARITHMETIC);
+  assert(eval_error("val a: I8 = -129\n") == OO_ERR_CONST_ARITHMETIC);
+  assert(eval_error("val a: U8 = -1\n") == OO_ERR_CONST_ARITHMETIC);
+  assert(eval_error("val a: U8 = -0\n") == OO_ERR_NONE);
+  assert(eval_error("val a: U32 = 1 << 32\n") == OO_ERR_CONST_ARITHMETIC);
+  assert(eval_error("val a: U8 = a + 1\n") == OO_ERR_NOT_CONST_EXP);
+  assert(eval_error("val a: U8 = b\n\nval b: U8 = a\n") == OO_ERR_NOT_CONST_EXP);
+  assert(eval_error("val a: U8 = 7 / 3 - 3\n") == OO_ERR_CONST_ARITHMETIC);
+  assert(eval_error("val a: (U8; 4 - 5) = (0; 0)\n") == OO_ERR_CONST_ARITHMETIC);
+  assert(eval_error("type A = (U8; $n())\n") == OO_ERR_NOT_CONST_REPEAT);
+  assert(eval_error("val a: Usize = sizeof(((U64; 65536 * 65536 * 65536); 65536))\n") == OO_ERR_NO_LAYOUT);
+  assert(eval_error("val a: Usize = sizeof(((U64; 65536 * 65536 * 65536 * 4095), (U64; 65536 * 65536 * 65536 * 4095)))\n") == OO_ERR_NO_LAYOUT);
+}
+
+int main(void) {
+  test_eval();
+  test_eval_errors();
+  return 0;
+}
@@ -0,0 +1,124 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/limits.h>
+
+#include "../src/stretchy_buffer.h"
+#include "../src/context.h"
+#include "../src/layout.h"
+
+static const OoLayout *item_layout(OoContext *cx, AsgFile *asg, int i) {
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  const OoLayout *layout = oo_cx_layout(cx, &err, asg->items[i].type.oo_type);
+  assert(err.tag == OO_ERR_NONE);
+  return layout;
+}
+
+void test_layout(void) {
+  char mods[PATH_MAX];
+  getcwd(mods, sizeof(mods));
+  strcat(mods, "/test/example_layout");
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_coarse_bindings(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_fine_bindings(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_kind_checking(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_type_checking(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+
+  AsgFile *lib = cx.files[0];
+
+  // type Pair = (U8, U32)
+  const OoLayout *pair = item_layout(&cx, lib, 0);
+  assert(pair->size == 8 && pair->align == 4);
+  assert(sb_count(pair->offsets) == 2 && pair->offsets[0] == 0 && pair->offsets[1] == 4);
+  assert(item_layout(&cx, lib, 0) == pair);
+
+  // type Named = (a: U16, b: @U8, c: U8)
+  const OoLayout *named = item_layout(&cx, lib, 1);
+  assert(named->offsets[1] == OO_PTR_SIZE && named->offsets[2] == 2 * OO_PTR_SIZE);
+  assert(named->size == 3 * OO_PTR_SIZE && named->align == OO_PTR_SIZE);
+
+  // type Alias = Pair
+  assert(item_layout(&cx, lib, 2) == pair);
+
+  // type Arr = (U16; 3)
+  assert(item_layout(&cx, lib, 3)->size == 6 && item_layout(&cx, lib, 3)->align == 2);
+
+  // type Sized = (U8; sizeof(Alias) + alignof(U64))
+  assert(lib->items[4].type.oo_type->product_repeated.repetitions == 16);
+  assert(item_layout(&cx, lib, 4)->size == 16);
+
+  // type Either = | Left(U8) | Right(U64, U8)
+  const OoLayout *either = item_layout(&cx, lib, 5);
+  assert(either->tag_size == 1);
+  assert(either->summand_offsets[0][0] == 1);
+  assert(either->summand_offsets[1][0] == 8 && either->summand_offsets[1][1] == 16);
+  assert(either->size == 24 && either->align == 8);
+
+  // type Wrap = <T> => (T, U8), type WrapU32 = Wrap<U32>
+  assert(item_layout(&cx, lib, 6) == NULL);
+  const OoLayout *wrap = item_layout(&cx, lib, 7);
+  assert(wrap->size == 8 && wrap->offsets[1] == 4);
+
+  // type Maybe = <T> => | Some(T) | None, type MaybeU16 = Maybe<U16>
+  assert(item_layout(&cx, lib, 8) == NULL);
+  const OoLayout *maybe = item_layout(&cx, lib, 9);
+  assert(maybe->tag_size == 1 && maybe->summand_offsets[0][0] == 2);
+  assert(sb_count(maybe->summand_offsets[1]) == 0);
+  assert(maybe->size == 4);
+
+  // type Unsized = [U8], type Infinite = (U8, Infinite)
+  assert(item_layout(&cx, lib, 10) == NULL);
+  assert(item_layout(&cx, lib, 11) == NULL);
+
+  // type OptPtr = Maybe<@U8>, the null pointer is none
+  const OoLayout *opt_ptr = item_layout(&cx, lib, 12);
+  assert(opt_ptr->size == OO_PTR_SIZE && opt_ptr->tag_size == 0);
+  assert(opt_ptr->dataful == 0);
+  assert(opt_ptr->tag_niche.start == 0 && opt_ptr->tag_niche.count == 1);
+  assert(opt_ptr->niche.count == 0);
+
+  // type OptBool = Maybe<Bool>, type OptOptBool = Maybe<Maybe<Bool>>
+  const OoLayout *opt_bool = item_layout(&cx, lib, 13);
+  assert(opt_bool->size == 1 && opt_bool->tag_niche.start == 2);
+  const OoLayout *opt_opt_bool = item_layout(&cx, lib, 14);
+  assert(opt_opt_bool->size == 1 && opt_opt_bool->tag_niche.start == 3);
+  assert(opt_opt_bool->niche.start == 4 && opt_opt_bool->niche.count == 252);
+
+  // type OptOptPtr = Maybe<Maybe<@U8>>, no values left for the outer none
+  const OoLayout *opt_opt_ptr = item_layout(&cx, lib, 15);
+  assert(opt_opt_ptr->dataful == -1 && opt_opt_ptr->tag_size == 1);
+  assert(opt_opt_ptr->size == 2 * OO_PTR_SIZE);
+
+  // type OptEither = Maybe<Either>, none is stored as a third tag of Either
+  const OoLayout *opt_either = item_layout(&cx, lib, 16);
+  assert(opt_either->size == either->size);
+  assert(opt_either->tag_niche.offset == 0 && opt_either->tag_niche.start == 2);
+
+  // type OptPair = Maybe<Pair>, Pair has no niche
+  const OoLayout *opt_pair = item_layout(&cx, lib, 17);
+  assert(opt_pair->tag_size == 1 && opt_pair->summand_offsets[0][0] == 4);
+  assert(opt_pair->size == 12);
+
+  oo_cx_free(&cx);
+}
+
+int main(void) {
+  test_layout();
+  return 0;
+}
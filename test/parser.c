@@ -161,6 +161,15 @@ void test_repeat(void) {
   assert(data.bin_op.rhs->macro.name.start == src + 7);
   assert(data.bin_op.rhs->macro.name.len == 3);
   free_inner_repeat(data);
+
+  src = "sizeof(U8) * 2";
+  assert(parse_repeat(src, &err, &data) == strlen(src));
+  assert(err.tag == ERR_NONE);
+  assert(data.tag == REPEAT_BIN_OP);
+  assert(data.bin_op.lhs->tag == REPEAT_SIZE_OF);
+  assert(data.bin_op.lhs->size_of->tag == TYPE_ID);
+  assert(data.bin_op.rhs->tag == REPEAT_INT);
+  free_inner_repeat(data);
 }
 
 void test_type(void) {
@@ -661,7 +670,7 @@ void test_exp(void) {
   ParserError err;
   AsgExp data;
 
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src) - 1);
   assert(data.str.start == src + 1);
@@ -670,7 +679,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " $foo()";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_MACRO);
   assert(data.str.len == strlen(src) - 1);
@@ -678,7 +687,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " 42";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src) - 1);
   assert(data.str.start == src + 1);
@@ -689,7 +698,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " 0.0";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src) - 1);
   assert(data.str.start == src + 1);
@@ -700,7 +709,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " \"abc\"";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src) - 1);
   assert(data.str.start == src + 1);
@@ -711,7 +720,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " @a";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_REF);
   assert(data.str.len == strlen(src) - 1);
@@ -722,7 +731,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " ~@a";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_REF_MUT);
   assert(data.str.len == strlen(src) - 1);
@@ -733,7 +742,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " [@a]";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_ARRAY);
   assert(data.str.len == strlen(src) - 1);
@@ -744,7 +753,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (@A; 42)";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_PRODUCT_REPEATED);
   assert(data.str.len == strlen(src) - 1);
@@ -756,7 +765,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " ( )";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_PRODUCT_ANON);
   assert(data.str.len == strlen(src) - 1);
@@ -765,7 +774,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (A)";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_PRODUCT_ANON);
   assert(data.str.len == strlen(src) - 1);
@@ -777,7 +786,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (A, @B)";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_PRODUCT_ANON);
   assert(data.str.len == strlen(src) - 1);
@@ -792,7 +801,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (a = A)";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_PRODUCT_NAMED);
   assert(data.str.len == strlen(src) - 1);
@@ -807,7 +816,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (a = A, b = @B)";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_PRODUCT_NAMED);
   assert(data.str.len == strlen(src) - 1);
@@ -827,7 +836,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " sizeof ( @ a )";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_SIZE_OF);
   assert(data.str.len == strlen(src) - 1);
@@ -838,7 +847,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " alignof ( @ a )";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_ALIGN_OF);
   assert(data.str.len == strlen(src) - 1);
@@ -849,7 +858,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " !@a";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_NOT);
   assert(data.str.len == strlen(src) - 1);
@@ -860,7 +869,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " -@a";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_NEGATE);
   assert(data.str.len == strlen(src) - 1);
@@ -871,7 +880,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " -%@a";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_WRAPPING_NEGATE);
   assert(data.str.len == strlen(src) - 1);
@@ -882,7 +891,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " val a";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_VAL);
   assert(data.str.len == strlen(src) - 1);
@@ -893,7 +902,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " val a = @b";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_VAL_ASSIGN);
   assert(data.str.len == strlen(src) - 1);
@@ -907,7 +916,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " {}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_BLOCK);
   assert(data.str.len == strlen(src) - 1);
@@ -917,7 +926,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " {a}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_BLOCK);
   assert(data.str.len == strlen(src) - 1);
@@ -929,7 +938,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " {a; b}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_BLOCK);
   assert(data.str.len == strlen(src) - 1);
@@ -943,7 +952,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " {#[foo]#[bar]a}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_BLOCK);
   assert(data.str.len == strlen(src) - 1);
@@ -955,7 +964,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " {a; #[foo]#[bar]b}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_BLOCK);
   assert(data.str.len == strlen(src) - 1);
@@ -969,7 +978,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " if a {}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_IF);
   assert(data.str.len == strlen(src) - 1);
@@ -980,7 +989,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " if a {} else {}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_IF);
   assert(data.str.len == strlen(src) - 1);
@@ -991,7 +1000,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " if a {} else if b {}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_IF);
   assert(data.str.len == strlen(src) - 1);
@@ -1006,7 +1015,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " while a {}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_WHILE);
   assert(data.str.len == strlen(src) - 1);
@@ -1016,7 +1025,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " case a {}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_CASE);
   assert(data.str.len == strlen(src) - 1);
@@ -1026,7 +1035,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " case a {_{}}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_CASE);
   assert(data.str.len == strlen(src) - 1);
@@ -1037,7 +1046,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " case a {_{}_{}}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_CASE);
   assert(data.str.len == strlen(src) - 1);
@@ -1048,7 +1057,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " loop a {}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_LOOP);
   assert(data.str.len == strlen(src) - 1);
@@ -1058,7 +1067,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " loop a {_{}}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_LOOP);
   assert(data.str.len == strlen(src) - 1);
@@ -1069,7 +1078,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " loop a {_{}_{}}";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_LOOP);
   assert(data.str.len == strlen(src) - 1);
@@ -1080,7 +1089,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " return";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_RETURN);
   assert(data.str.len == strlen(src) - 1);
@@ -1089,7 +1098,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " return @a";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_RETURN);
   assert(data.str.len == strlen(src) - 1);
@@ -1100,7 +1109,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " break";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_BREAK);
   assert(data.str.len == strlen(src) - 1);
@@ -1109,7 +1118,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " break @a";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_BREAK);
   assert(data.str.len == strlen(src) - 1);
@@ -1120,7 +1129,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " goto a";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_GOTO);
   assert(data.str.len == strlen(src) - 1);
@@ -1130,7 +1139,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " label a";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_LABEL);
   assert(data.str.len == strlen(src) - 1);
@@ -1140,7 +1149,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " a@";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_DEREF);
   assert(data.str.len == strlen(src) - 1);
@@ -1151,7 +1160,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " a@@";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_DEREF);
   assert(data.str.len == strlen(src) - 1);
@@ -1162,7 +1171,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " a~";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_DEREF_MUT);
   assert(data.str.len == strlen(src) - 1);
@@ -1173,7 +1182,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " a[@b]";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_ARRAY_INDEX);
   assert(data.str.len == strlen(src) - 1);
@@ -1183,7 +1192,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " a.42";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_PRODUCT_ACCESS_ANON);
   assert(data.str.len == strlen(src) - 1);
@@ -1193,7 +1202,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " a.42foo";
-  assert(parse_exp(src, &err, &data) == 5);
+  assert(parse_exp(src, &err, &data, NULL) == 5);
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_PRODUCT_ACCESS_ANON);
   assert(data.str.len == 4);
@@ -1203,7 +1212,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " a.b";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_PRODUCT_ACCESS_NAMED);
   assert(data.str.len == strlen(src) - 1);
@@ -1213,7 +1222,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " a()";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_FUN_APP_ANON);
   assert(data.str.len == strlen(src) - 1);
@@ -1223,7 +1232,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " a(@42)";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_FUN_APP_ANON);
   assert(data.str.len == strlen(src) - 1);
@@ -1233,7 +1242,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " a(b, @42)";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_FUN_APP_ANON);
   assert(data.str.len == strlen(src) - 1);
@@ -1243,7 +1252,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " a(b = @42)";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_FUN_APP_NAMED);
   assert(data.str.len == strlen(src) - 1);
@@ -1254,7 +1263,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " a(b = c, d = e)";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_FUN_APP_NAMED);
   assert(data.str.len == strlen(src) - 1);
@@ -1265,7 +1274,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (@a) as @b";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_CAST);
   assert(data.str.len == strlen(src) - 1);
@@ -1275,7 +1284,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (@a) + @b";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_BIN_OP);
   assert(data.str.len == strlen(src) - 1);
@@ -1286,7 +1295,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (@a) +% @b";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_BIN_OP);
   assert(data.str.len == strlen(src) - 1);
@@ -1297,7 +1306,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (@a) < @b";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_BIN_OP);
   assert(data.str.len == strlen(src) - 1);
@@ -1308,7 +1317,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (@a) << @b";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_BIN_OP);
   assert(data.str.len == strlen(src) - 1);
@@ -1319,7 +1328,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (@a) += @b";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_ASSIGN);
   assert(data.str.len == strlen(src) - 1);
@@ -1330,7 +1339,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (@a) +%= @b";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_ASSIGN);
   assert(data.str.len == strlen(src) - 1);
@@ -1341,7 +1350,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (@a) <<= @b";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_ASSIGN);
   assert(data.str.len == strlen(src) - 1);
@@ -1352,7 +1361,7 @@ void test_exp(void) {
   free_inner_exp(data);
 
   src = " (@a) = @b";
-  assert(parse_exp(src, &err, &data) == strlen(src));
+  assert(parse_exp(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.tag == EXP_ASSIGN);
   assert(data.str.len == strlen(src) - 1);
@@ -1467,7 +1476,7 @@ void test_item(void) {
   ParserError err;
   AsgItem data;
 
-  assert(parse_item(src, &err, &data, asg) == strlen(src));
+  assert(parse_item(src, &err, &data, asg, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(data.tag == ITEM_USE);
@@ -1476,7 +1485,7 @@ void test_item(void) {
   free_inner_item(data);
 
   src = "use a::b";
-  assert(parse_item(src, &err, &data, asg) == strlen(src));
+  assert(parse_item(src, &err, &data, asg, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(data.tag == ITEM_USE);
@@ -1485,7 +1494,7 @@ void test_item(void) {
   free_inner_item(data);
 
   src = "type a =@ b";
-  assert(parse_item(src, &err, &data, asg) == strlen(src));
+  assert(parse_item(src, &err, &data, asg, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(data.tag == ITEM_TYPE);
@@ -1495,7 +1504,7 @@ void test_item(void) {
   free_inner_item(data);
 
   src = "val a: @A = @b";
-  assert(parse_item(src, &err, &data, asg) == strlen(src));
+  assert(parse_item(src, &err, &data, asg, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(data.tag == ITEM_VAL);
@@ -1507,7 +1516,7 @@ void test_item(void) {
   free_inner_item(data);
 
   src = "pub val mut a: @A = @b";
-  assert(parse_item(src, &err, &data, asg) == strlen(src));
+  assert(parse_item(src, &err, &data, asg, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(data.tag == ITEM_VAL);
@@ -1519,7 +1528,7 @@ void test_item(void) {
   free_inner_item(data);
 
   src = "fn a = () {}";
-  assert(parse_item(src, &err, &data, asg) == strlen(src));
+  assert(parse_item(src, &err, &data, asg, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(data.tag == ITEM_FUN);
@@ -1534,7 +1543,7 @@ void test_item(void) {
   free_inner_item(data);
 
   src = "fn a = <T> => (b: T) -> @c {a}";
-  assert(parse_item(src, &err, &data, asg) == strlen(src));
+  assert(parse_item(src, &err, &data, asg, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(data.tag == ITEM_FUN);
@@ -1548,7 +1557,7 @@ void test_item(void) {
   free_inner_item(data);
 
   src = "fn a = <T, U> => (b: T, d: U) -> @c {a; b}";
-  assert(parse_item(src, &err, &data, asg) == strlen(src));
+  assert(parse_item(src, &err, &data, asg, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(data.tag == ITEM_FUN);
@@ -1562,7 +1571,7 @@ void test_item(void) {
   free_inner_item(data);
 
   src = "ffi use(foo.h)";
-  assert(parse_item(src, &err, &data, asg) == strlen(src));
+  assert(parse_item(src, &err, &data, asg, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(data.tag == ITEM_FFI_INCLUDE);
@@ -1572,7 +1581,7 @@ void test_item(void) {
   free_inner_item(data);
 
   src = "ffi a: @B";
-  assert(parse_item(src, &err, &data, asg) == strlen(src));
+  assert(parse_item(src, &err, &data, asg, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(data.tag == ITEM_FFI_VAL);
@@ -1583,7 +1592,7 @@ void test_item(void) {
   free_inner_item(data);
 
   src = "pub ffi mut a: @B";
-  assert(parse_item(src, &err, &data, asg) == strlen(src));
+  assert(parse_item(src, &err, &data, asg, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(data.tag == ITEM_FFI_VAL);
@@ -1599,7 +1608,7 @@ void test_file(void) {
   ParserError err;
   AsgFile data;
 
-  assert(parse_file(src, &err, &data) == strlen(src));
+  assert(parse_file(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(sb_count(data.items) == 1);
@@ -1609,7 +1618,7 @@ void test_file(void) {
   free_inner_file(data);
 
   src = "#[foo]#[bar] type a = b";
-  assert(parse_file(src, &err, &data) == strlen(src));
+  assert(parse_file(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(sb_count(data.items) == 1);
@@ -1620,7 +1629,7 @@ void test_file(void) {
   free_inner_file(data);
 
   src = "type a = b type c = @d";
-  assert(parse_file(src, &err, &data) == strlen(src));
+  assert(parse_file(src, &err, &data, NULL) == strlen(src));
   assert(err.tag == ERR_NONE);
   assert(data.str.len == strlen(src));
   assert(sb_count(data.items) == 2);
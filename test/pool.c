@@ -0,0 +1,105 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/pool.h"
+#include "../src/rax.h"
+
+void test_alloc_free(void) {
+  OoPool pool;
+  oo_pool_init(&pool);
+
+  char *a = oo_pool_alloc(&pool, 10);
+  char *b = oo_pool_alloc(&pool, 10);
+  assert(a != b);
+  assert((uintptr_t) a % sizeof(void *) == 0);
+  memset(a, 'a', 10);
+  memset(b, 'b', 10);
+  assert(pool.in_use == 64); // 10 bytes and the header round up to 32
+
+  oo_pool_free(&pool, a);
+  assert(pool.in_use == 32);
+  char *c = oo_pool_alloc(&pool, 20);
+  assert(c == a); // reuses the block of the same size class
+  assert(b[9] == 'b');
+
+  char *big = oo_pool_alloc(&pool, 4 * OO_POOL_MAX_SMALL);
+  memset(big, 'x', 4 * OO_POOL_MAX_SMALL);
+  assert(pool.in_use > 4 * OO_POOL_MAX_SMALL);
+  oo_pool_free(&pool, big);
+  assert(pool.in_use == 64);
+  assert(pool.peak > 4 * OO_POOL_MAX_SMALL);
+
+  oo_pool_release(&pool);
+  assert(pool.in_use == 0);
+  assert(pool.reserved == 0);
+}
+
+void test_realloc(void) {
+  OoPool pool;
+  oo_pool_init(&pool);
+
+  char *a = oo_pool_realloc(&pool, NULL, 4);
+  memcpy(a, "abcd", 4);
+  assert(oo_pool_realloc(&pool, a, 6) == a); // fits into the padding
+  a = oo_pool_realloc(&pool, a, 100);
+  assert(memcmp(a, "abcd", 4) == 0);
+  a = oo_pool_realloc(&pool, a, 2 * OO_POOL_MAX_SMALL);
+  assert(memcmp(a, "abcd", 4) == 0);
+  a = oo_pool_realloc(&pool, a, 3);
+  assert(memcmp(a, "abc", 3) == 0);
+
+  oo_pool_release(&pool);
+}
+
+static void *pool_malloc(void *pool, size_t size) {
+  return oo_pool_alloc(pool, size);
+}
+
+static void *pool_realloc(void *pool, void *ptr, size_t size) {
+  return oo_pool_realloc(pool, ptr, size);
+}
+
+static void pool_free(void *pool, void *ptr) {
+  oo_pool_free(pool, ptr);
+}
+
+void test_rax(void) {
+  OoPool pool;
+  oo_pool_init(&pool);
+  raxAllocator alloc = { pool_malloc, pool_realloc, pool_free, &pool };
+
+  rax *r = raxNewWithAllocator(&alloc);
+  char key[8];
+  for (int i = 0; i < 1000; i++) {
+    int len = sprintf(key, "k%d", i);
+    assert(raxInsert(r, key, len, (void *) (uintptr_t) (i + 1), NULL));
+  }
+  assert(raxSize(r) == 1000);
+  assert(pool.in_use > 0);
+  assert(raxFind(r, "k123", 4) == (void *) 124);
+  assert(raxRemove(r, "k123", 4, NULL));
+  assert(raxFind(r, "k123", 4) == raxNotFound);
+
+  raxFree(r);
+  assert(pool.in_use == 0);
+
+  // Without a free function, the tree is released in bulk with the pool.
+  r = raxNewWithAllocator(&alloc);
+  raxInsert(r, "abc", 3, NULL, NULL);
+  alloc.free = NULL;
+  raxFree(r);
+  assert(pool.in_use > 0);
+
+  oo_pool_release(&pool);
+}
+
+int main(void) {
+  test_alloc_free();
+  test_realloc();
+  test_rax();
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../src/stretchy_buffer.h"
+#include "../src/query.h"
+
+void test_memoization(void) {
+  OoQueryTable table;
+  oo_queries_init(&table);
+  AsgItemFun fun;
+  AsgExp exp;
+  int result;
+
+  assert(oo_queries_get(&table, OO_QUERY_FUN_BODY, &fun) == NULL);
+  OoQuery *body = oo_queries_begin(&table, OO_QUERY_FUN_BODY, &fun);
+  assert(!body->done);
+  OoQuery *e = oo_queries_begin(&table, OO_QUERY_EXP_TYPE, &exp);
+  oo_queries_end(&table, &result);
+  oo_queries_end(&table, NULL);
+  assert(body->done && e->done && e->result == &result);
+  assert(sb_count(body->deps) == 1 && body->deps[0] == e);
+  assert(sb_count(e->dependents) == 1 && e->dependents[0] == body);
+
+  // keys of different kinds are different queries
+  assert(oo_queries_get(&table, OO_QUERY_EXP_TYPE, &exp) == e);
+  assert(oo_queries_get(&table, OO_QUERY_FUN_BODY, &exp) == NULL);
+  assert(oo_queries_count(&table) == 2 && table.computed == 2);
+
+  oo_queries_free(&table);
+}
+
+static bool is_layout(const OoQuery *q, void *data) {
+  (void) data;
+  return q->kind == OO_QUERY_LAYOUT;
+}
+
+void test_invalidation(void) {
+  OoQueryTable table;
+  oo_queries_init(&table);
+  AsgItemFun f;
+  AsgItemFun g;
+  AsgExp f_exp;
+  AsgExp g_exp;
+  AsgPatternId local;
+  OoType t;
+
+  // The bodies of f and g both use the layout of t, only f has a local.
+  oo_queries_begin(&table, OO_QUERY_FUN_BODY, &f);
+  oo_queries_begin(&table, OO_QUERY_EXP_TYPE, &f_exp);
+  oo_queries_feed(&table, OO_QUERY_LOCAL_TYPE, &local, &t);
+  oo_queries_begin(&table, OO_QUERY_LAYOUT, &t);
+  oo_queries_end(&table, NULL);
+  oo_queries_end(&table, &t);
+  oo_queries_end(&table, NULL);
+
+  oo_queries_begin(&table, OO_QUERY_FUN_BODY, &g);
+  oo_queries_begin(&table, OO_QUERY_EXP_TYPE, &g_exp);
+  assert(oo_queries_get(&table, OO_QUERY_LAYOUT, &t) != NULL);
+  oo_queries_end(&table, &t);
+  oo_queries_end(&table, NULL);
+  assert(oo_queries_count(&table) == 6);
+
+  // Invalidating the layout invalidates everything computed from it.
+  oo_queries_invalidate(&table, OO_QUERY_LAYOUT, &t);
+  assert(oo_queries_count(&table) == 1);
+  assert(oo_queries_get(&table, OO_QUERY_LOCAL_TYPE, &local) != NULL);
+
+  // So does invalidating it by its kind.
+  oo_queries_begin(&table, OO_QUERY_FUN_BODY, &g);
+  oo_queries_begin(&table, OO_QUERY_LAYOUT, &t);
+  oo_queries_end(&table, NULL);
+  oo_queries_end(&table, NULL);
+  oo_queries_invalidate_where(&table, is_layout, NULL);
+  assert(oo_queries_count(&table) == 1);
+  assert(oo_queries_get(&table, OO_QUERY_FUN_BODY, &g) == NULL);
+  oo_queries_clear(&table);
+
+  // Forgetting a body keeps the queries it used that are not part of it.
+  oo_queries_begin(&table, OO_QUERY_FUN_BODY, &f);
+  oo_queries_begin(&table, OO_QUERY_EXP_TYPE, &f_exp);
+  oo_queries_begin(&table, OO_QUERY_LAYOUT, &t);
+  oo_queries_end(&table, NULL);
+  oo_queries_end(&table, &t);
+  oo_queries_end(&table, NULL);
+  oo_queries_forget_body(&table, &f);
+  assert(oo_queries_count(&table) == 1);
+  OoQuery *layout = oo_queries_get(&table, OO_QUERY_LAYOUT, &t);
+  assert(layout != NULL && sb_count(layout->dependents) == 0);
+
+  // Aborting removes the query, but not what it computed so far.
+  oo_queries_begin(&table, OO_QUERY_FUN_BODY, &g);
+  oo_queries_begin(&table, OO_QUERY_EXP_TYPE, &g_exp);
+  oo_queries_end(&table, NULL);
+  oo_queries_abort(&table);
+  assert(oo_queries_get(&table, OO_QUERY_FUN_BODY, &g) == NULL);
+  OoQuery *e = oo_queries_get(&table, OO_QUERY_EXP_TYPE, &g_exp);
+  assert(e != NULL && sb_count(e->dependents) == 0);
+
+  oo_queries_free(&table);
+}
+
+int main(void) {
+  test_memoization();
+  test_invalidation();
+  return 0;
+}
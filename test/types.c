@@ -0,0 +1,136 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/stretchy_buffer.h"
+#include "../src/types.h"
+
+static OoType *primitive(OoTypeTable *table, AsgPrimitive prim) {
+  AsgBinding b;
+  memset(&b, 0, sizeof(AsgBinding));
+  b.tag = BINDING_PRIMITIVE;
+  b.primitive = prim;
+
+  OoType shape;
+  shape.tag = OO_TYPE_BINDING;
+  shape.binding = &b;
+  return oo_types_intern(table, &shape);
+}
+
+static OoType *ptr(OoTypeTable *table, OoType *inner) {
+  OoType shape;
+  shape.tag = OO_TYPE_PTR;
+  shape.ptr = inner;
+  return oo_types_intern(table, &shape);
+}
+
+static AsgSid sid(char *name) {
+  AsgSid s;
+  memset(&s, 0, sizeof(AsgSid));
+  s.str = str_new(name, strlen(name));
+  return s;
+}
+
+static OoType *named(OoTypeTable *table, char *a, OoType *ta, char *b, OoType *tb) {
+  AsgSid *sids = NULL;
+  sb_push(sids, sid(a));
+  sb_push(sids, sid(b));
+
+  OoType shape;
+  shape.tag = OO_TYPE_PRODUCT_NAMED;
+  shape.product_named.types = NULL;
+  sb_push(shape.product_named.types, ta);
+  sb_push(shape.product_named.types, tb);
+  shape.product_named.sids = sids;
+  OoType *t = oo_types_intern(table, &shape);
+  sb_free(sids);
+  return t;
+}
+
+void test_interning(void) {
+  OoTypeTable table;
+  oo_types_init(&table);
+
+  // The same primitive from two binding sites is a single type.
+  OoType *u8 = primitive(&table, PRIM_U8);
+  assert(primitive(&table, PRIM_U8) == u8);
+  OoType *u16 = primitive(&table, PRIM_U16);
+  assert(u16 != u8);
+  assert(u8->binding->tag == BINDING_PRIMITIVE && u8->binding->primitive == PRIM_U8);
+
+  assert(ptr(&table, u8) == ptr(&table, primitive(&table, PRIM_U8)));
+  assert(ptr(&table, u8) != ptr(&table, u16));
+
+  // The names are copied, and take part in the structure.
+  char x[] = "x";
+  OoType *xy = named(&table, x, u8, "y", u16);
+  x[0] = 'z';
+  assert(str_eq_parts(xy->product_named.sids[0].str, "x", 1));
+  assert(named(&table, "x", u8, "y", u16) == xy);
+  assert(named(&table, "x", u8, "yy", u16) != xy);
+  assert(named(&table, "x", u16, "y", u16) != xy);
+
+  // u8, u16, two ptrs, three named products
+  assert(oo_types_count(&table) == 7);
+
+  oo_types_free(&table);
+}
+
+static OoType *app(OoTypeTable *table, AsgItemType *tlf, OoType *arg) {
+  OoType shape;
+  shape.tag = OO_TYPE_APP;
+  shape.app.tlf = tlf;
+  shape.app.args = NULL;
+  sb_push(shape.app.args, arg);
+  return oo_types_intern(table, &shape);
+}
+
+void test_instantiate(void) {
+  OoTypeTable table;
+  oo_types_init(&table);
+  OoType *u8 = primitive(&table, PRIM_U8);
+  OoType *u16 = primitive(&table, PRIM_U16);
+
+  // type Ptr = <T> => @T
+  AsgItemType item;
+  memset(&item, 0, sizeof(AsgItemType));
+  item.type.tag = TYPE_GENERIC;
+  item.type.generic.args = NULL;
+  sb_push(item.type.generic.args, sid("T"));
+  AsgBinding var;
+  memset(&var, 0, sizeof(AsgBinding));
+  var.tag = BINDING_TYPE_VAR;
+  var.type_var = &item.type.generic.args[0];
+  OoType shape;
+  shape.tag = OO_TYPE_BINDING;
+  shape.binding = &var;
+  OoType *t = oo_types_intern(&table, &shape);
+  shape.tag = OO_TYPE_GENERIC;
+  shape.generic.generic_args = 1;
+  shape.generic.inner = ptr(&table, t);
+  item.oo_type = oo_types_intern(&table, &shape);
+
+  OoType *ptr_u8 = oo_types_instantiate(&table, app(&table, &item, u8));
+  assert(ptr_u8 == ptr(&table, u8));
+  assert(table.instantiated == 1);
+  assert(oo_types_instantiate(&table, app(&table, &item, u8)) == ptr_u8);
+  assert(table.instantiated == 1);
+  assert(oo_types_instantiate(&table, app(&table, &item, u16)) == ptr(&table, u16));
+  assert(table.instantiated == 2);
+
+  // Applications in the arguments are substituted but not instantiated.
+  OoType *nested = app(&table, &item, app(&table, &item, u8));
+  assert(oo_types_instantiate(&table, nested) == ptr(&table, app(&table, &item, u8)));
+  assert(table.instantiated == 3);
+
+  sb_free(item.type.generic.args);
+  oo_types_free(&table);
+}
+
+int main(void) {
+  test_interning();
+  test_instantiate();
+  return 0;
+}
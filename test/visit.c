@@ -0,0 +1,233 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE true
+#endif
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/limits.h>
+
+#include "../src/stretchy_buffer.h"
+#include "../src/context.h"
+#include "../src/visit.h"
+
+// A visitor that logs its id (negated for post hooks) into a shared log.
+typedef struct Recorder {
+  int id;
+  int **log;
+  int items;
+  int arms;
+  int exps;
+} Recorder;
+
+static void record_item_pre(void *data, OoError *err, AsgItem *item) {
+  (void) err;
+  (void) item;
+  Recorder *r = data;
+  r->items += 1;
+}
+
+static void record_arm_pre(void *data, OoError *err, AsgPattern *p, AsgBlock *block) {
+  (void) err;
+  (void) p;
+  (void) block;
+  Recorder *r = data;
+  r->arms += 1;
+}
+
+static void record_type_pre(void *data, OoError *err, AsgType *type) {
+  (void) err;
+  (void) type;
+  Recorder *r = data;
+  sb_push(*r->log, r->id);
+}
+
+static void record_type_post(void *data, OoError *err, AsgType *type) {
+  (void) err;
+  (void) type;
+  Recorder *r = data;
+  sb_push(*r->log, -r->id);
+}
+
+static void record_exp_pre(void *data, OoError *err, AsgExp *exp) {
+  (void) exp;
+  Recorder *r = data;
+  r->exps += 1;
+  if (r->id == 3) {
+    err->tag = OO_ERR_NOT_CONST_EXP;
+    err->not_const_exp = exp;
+  }
+}
+
+static void recorder_init(Recorder *r, OoVisitor *v, int id, int **log) {
+  r->id = id;
+  r->log = log;
+  r->items = 0;
+  r->arms = 0;
+  r->exps = 0;
+  oo_visitor_init(v, r);
+  v->item_pre = record_item_pre;
+  v->arm_pre = record_arm_pre;
+  v->type_pre = record_type_pre;
+  v->type_post = record_type_post;
+  v->exp_pre = record_exp_pre;
+}
+
+static void bindings_cx(OoContext *cx) {
+  char mods[PATH_MAX];
+  getcwd(mods, sizeof(mods));
+  strcat(mods, "/test/example_bindings");
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  oo_cx_init(cx, mods, deps);
+  oo_cx_parse(cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_coarse_bindings(cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+}
+
+void test_visit_order(void) {
+  OoContext cx;
+  bindings_cx(&cx);
+  AsgFile *lib = cx.files[0];
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  int *log = NULL;
+  Recorder rs[2];
+  OoVisitor vs[2];
+  recorder_init(&rs[0], &vs[0], 1, &log);
+  recorder_init(&rs[1], &vs[1], 2, &log);
+  oo_visit_file(&cx, &err, lib, vs, 2);
+  assert(err.tag == OO_ERR_NONE);
+
+  assert(rs[0].items == sb_count(lib->items) && rs[1].items == rs[0].items);
+  assert(rs[0].arms == 2); // the case in e
+  assert(rs[0].exps > 0 && rs[1].exps == rs[0].exps);
+
+  // Pre hooks run in order, post hooks in reverse order, and the hooks of a
+  // node enclose the ones of its children.
+  assert(sb_count(log) > 0 && sb_count(log) % 4 == 0);
+  int depth = 0;
+  for (int i = 0; i < sb_count(log); i += 2) {
+    if (log[i] > 0) {
+      assert(log[i] == 1 && log[i + 1] == 2);
+      depth += 1;
+    } else {
+      assert(log[i] == -2 && log[i + 1] == -1);
+      depth -= 1;
+    }
+    assert(depth >= 0);
+  }
+  assert(depth == 0);
+
+  // The traversal stops at the first error.
+  Recorder failing;
+  recorder_init(&rs[1], &vs[1], 2, &log);
+  recorder_init(&failing, &vs[0], 3, &log);
+  oo_visit_file(&cx, &err, lib, vs, 2);
+  assert(err.tag == OO_ERR_NOT_CONST_EXP);
+  assert(failing.exps == 1 && rs[1].exps == 0);
+
+  sb_free(log);
+  oo_cx_free(&cx);
+}
+
+void test_fused_pass(void) {
+  OoContext separate;
+  bindings_cx(&separate);
+  OoContext fused;
+  bindings_cx(&fused);
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  oo_cx_fine_bindings(&separate, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_kind_checking(&separate, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_bind_and_kind_check(&fused, &err);
+  assert(err.tag == OO_ERR_NONE);
+
+  AsgFile *a = separate.files[0];
+  AsgFile *b = fused.files[0];
+  assert(b->fine_bound && b->kind_checked);
+
+  // type A = <B> => (B, C, Bool)
+  AsgType *ta = a->items[0].type.type.generic.inner->product_anon;
+  AsgType *tb = b->items[0].type.type.generic.inner->product_anon;
+  assert(tb[0].id.binding.tag == BINDING_TYPE_VAR && tb[0].id.binding.type_var == &b->items[0].type.type.generic.args[0]);
+  assert(ta[0].id.binding.type_var == &a->items[0].type.type.generic.args[0]);
+  assert(tb[1].id.binding.tag == BINDING_TYPE && tb[1].id.binding.type == &b->items[2].type);
+  assert(tb[2].id.binding.tag == ta[2].id.binding.tag);
+
+  // case opt { | Option::Some(inner) ... | None ... }
+  AsgExp *ca = &a->items[6].fun.body.exps[0];
+  AsgExp *cb = &b->items[6].fun.body.exps[0];
+  assert(cb->exp_case.matcher->id.binding.val.tag == VAL_ARG);
+  assert(cb->exp_case.matcher->id.binding.val.arg == &b->items[6].fun.arg_sids[1]);
+  assert(ca->exp_case.patterns[0].summand_anon.id.binding.tag == cb->exp_case.patterns[0].summand_anon.id.binding.tag);
+
+  oo_cx_type_checking(&fused, &err);
+  assert(err.tag == OO_ERR_NONE);
+
+  oo_cx_free(&separate);
+  oo_cx_free(&fused);
+}
+
+// Runs the fused pass on a single file with the given source, returns the tag
+// of the error.
+static OoErrorTag fused_error(const char *src) {
+  char mods[] = "/tmp/look-visit-XXXXXX";
+  assert(mkdtemp(mods) != NULL);
+  char deps[PATH_MAX];
+  getcwd(deps, sizeof(deps));
+  strcat(deps, "/test/example_deps");
+  char path[PATH_MAX];
+  sprintf(path, "%s/a.oo", mods);
+  FILE *f = fopen(path, "w");
+  fputs(src, f);
+  fclose(f);
+
+  OoError err;
+  err.tag = OO_ERR_NONE;
+  OoContext cx;
+  oo_cx_init(&cx, mods, deps);
+  oo_cx_parse(&cx, &err, NULL);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_coarse_bindings(&cx, &err);
+  assert(err.tag == OO_ERR_NONE);
+  oo_cx_bind_and_kind_check(&cx, &err);
+  OoErrorTag tag = err.tag;
+  if (tag != OO_ERR_NONE) {
+    assert(err.asg == cx.files[0]);
+  }
+
+  oo_cx_free(&cx);
+  remove(path);
+  rmdir(mods);
+  return tag;
+}
+
+void test_fused_errors(void) {
+  assert(fused_error("type A = <T> => T\n\ntype B = A<U8>\n") == OO_ERR_NONE);
+  assert(fused_error("type A = <T> => T\n\ntype B = A<U8, U8>\n") == OO_ERR_WRONG_NUMBER_OF_TYPE_ARGS);
+  assert(fused_error("type B = X\n") == OO_ERR_NONEXISTING_SID);
+  assert(fused_error("val a: U8 = 1\n\ntype B = a\n") == OO_ERR_BINDING_NOT_TYPE);
+  assert(fused_error("fn f = (x: U8) -> () {\n  y\n}\n") == OO_ERR_NONEXISTING_SID);
+  assert(fused_error("fn f = (x: U8, x: U8) -> () {}\n") == OO_ERR_DUP_ID_SCOPE);
+  assert(fused_error("fn f = <T> => (x: T) -> () {\n  val y: U8 = 1;\n  y\n}\n") == OO_ERR_NONE);
+}
+
+int main(void) {
+  test_visit_order();
+  test_fused_pass();
+  test_fused_errors();
+  return 0;
+}